@@ -273,6 +273,109 @@ validate_binary_file() {
 # BUILD LOGIC
 # ==============================================================================
 
+# Compile one C++ helper for the target, or reuse a prebuilt copy from bin/<platform>/.
+# Called from build_binary and relies on its build_dir, bundled_dir, ext, ffmpeg_plat,
+# extra_cxx_flags and version locals.
+# Usage: build_helper <target> <name> <source> <description> <windows flags> <posix flags>
+build_helper() {
+	local target=$1
+	local name=$2
+	local src=$3
+	local description=$4
+	local win_flags=$5
+	local posix_flags=$6
+
+	local bin_helper="$BIN_DIR/$ffmpeg_plat/$name$ext"
+	local build_helper_path="$build_dir/$name$ext"
+
+	if [[ -f "$bin_helper" ]]; then
+		cp "$bin_helper" "$build_helper_path"
+		validate_binary_file "$target" "$build_helper_path" || true
+		return 0
+	fi
+
+	log_info "  -> Compiling $name helper..."
+	if [[ ! -f "$src" ]]; then
+		log_error "$name source not found at $src"
+		exit 1
+	fi
+
+	mkdir -p "$BIN_DIR/$ffmpeg_plat"
+	local temp_helper="$bin_helper.tmp"
+
+	if is_windows "$target"; then
+		local compiler="x86_64-w64-mingw32-g++"
+		local res_compiler="x86_64-w64-mingw32-windres"
+		if [[ "$target" == "win-arm64" ]]; then
+			compiler="aarch64-w64-mingw32-g++"
+			res_compiler="aarch64-w64-mingw32-windres"
+		fi
+
+		# Generate and compile resources
+		local res_rc="$bundled_dir/$name.rc"
+		local res_obj="$bundled_dir/$name.res.o"
+
+		cat > "$res_rc" <<EOF
+#include <windows.h>
+VS_VERSION_INFO VERSIONINFO
+FILEVERSION     $major,$minor,$patch,0
+PRODUCTVERSION  $major,$minor,$patch,0
+FILEFLAGSMASK   VS_FFI_FILEFLAGSMASK
+FILEFLAGS       0x0L
+FILEOS          VOS_NT_WINDOWS32
+FILETYPE        VFT_APP
+FILESUBTYPE     VFT2_UNKNOWN
+BEGIN
+    BLOCK "StringFileInfo"
+    BEGIN
+        BLOCK "040904b0"
+        BEGIN
+            VALUE "CompanyName",      "MAX Video Downloader"
+            VALUE "FileDescription",  "MAX Video Downloader $description"
+            VALUE "FileVersion",      "$VERSION"
+            VALUE "InternalName",     "$name"
+            VALUE "LegalCopyright",   "Copyright (C) 2026 MAX Video Downloader"
+            VALUE "OriginalFilename", "$name.exe"
+            VALUE "ProductName",      "MAX Video Downloader"
+            VALUE "ProductVersion",   "$VERSION"
+        END
+    END
+    BLOCK "VarFileInfo"
+    BEGIN
+        VALUE "Translation", 0x409, 1200
+    END
+END
+EOF
+		"$res_compiler" "$res_rc" -o "$res_obj"
+
+		# Compile with resource and PE mitigations
+		"$compiler" "$src" "$res_obj" $extra_cxx_flags $win_flags -Wl,--major-subsystem-version,6,--minor-subsystem-version,0 -o "$temp_helper"
+	elif is_mac "$target"; then
+		local mac_cxx
+		mac_cxx=$(xcrun --find clang++)
+		local mac_sdk
+		mac_sdk=$(xcrun --sdk macosx --show-sdk-path)
+		local mac_arch
+		local mac_min_version
+		if [[ "$target" == "mac-arm64" ]]; then
+			mac_arch="arm64"
+			mac_min_version="11.0"
+		else
+			mac_arch="x86_64"
+			mac_min_version="10.10"
+		fi
+		export MACOSX_DEPLOYMENT_TARGET="$mac_min_version"
+		"$mac_cxx" "$src" $extra_cxx_flags $posix_flags -arch "$mac_arch" -mmacosx-version-min="$mac_min_version" -isysroot "$mac_sdk" -stdlib=libc++ -o "$temp_helper"
+		unset MACOSX_DEPLOYMENT_TARGET
+	elif is_linux "$target"; then
+		g++ -std=c++11 "$src" $extra_cxx_flags $posix_flags -o "$temp_helper"
+	fi
+
+	mv "$temp_helper" "$bin_helper"
+	cp "$bin_helper" "$build_helper_path"
+	validate_binary_file "$target" "$build_helper_path" || true
+}
+
 build_binary() {
 	local target=$1
 	log_info "Starting build for target: $target"
@@ -339,163 +442,26 @@ build_binary() {
 		log_warn "FFmpeg binaries not found in $ffmpeg_src. Build will lack ffmpeg!"
 	fi
 
-	# 3. Build Helpers (Diskspace)
-	local diskspace_src="$TOOLS_DIR/diskspace/src/diskspace.cpp"
-	local bin_diskspace="$BIN_DIR/$ffmpeg_plat/mvd-diskspace$ext"
-	local build_diskspace="$build_dir/mvd-diskspace$ext"
-
-	if [[ -f "$bin_diskspace" ]]; then
-		cp "$bin_diskspace" "$build_diskspace"
-		validate_binary_file "$target" "$build_diskspace" || true
-	else
-		log_info "  -> Compiling diskspace helper..."
-		if [[ ! -f "$diskspace_src" ]]; then
-			log_error "Diskspace source not found at $diskspace_src"
-			exit 1
-		fi
-
-		mkdir -p "$BIN_DIR/$ffmpeg_plat"
-		local temp_diskspace="$bin_diskspace.tmp"
-
-		if is_windows "$target"; then
-			local compiler="x86_64-w64-mingw32-g++"
-			local res_compiler="x86_64-w64-mingw32-windres"
-			if [[ "$target" == "win-arm64" ]]; then
-				compiler="aarch64-w64-mingw32-g++"
-				res_compiler="aarch64-w64-mingw32-windres"
-			fi
-
-			# Generate and compile resources
-			local res_rc="$bundled_dir/diskspace.rc"
-			local res_obj="$bundled_dir/diskspace.res.o"
-			
-			cat > "$res_rc" <<EOF
-#include <windows.h>
-VS_VERSION_INFO VERSIONINFO
-FILEVERSION     $major,$minor,$patch,0
-PRODUCTVERSION  $major,$minor,$patch,0
-FILEFLAGSMASK   VS_FFI_FILEFLAGSMASK
-FILEFLAGS       0x0L
-FILEOS          VOS_NT_WINDOWS32
-FILETYPE        VFT_APP
-FILESUBTYPE     VFT2_UNKNOWN
-BEGIN
-    BLOCK "StringFileInfo"
-    BEGIN
-        BLOCK "040904b0"
-        BEGIN
-            VALUE "CompanyName",      "MAX Video Downloader"
-            VALUE "FileDescription",  "MAX Video Downloader Disk Space Helper"
-            VALUE "FileVersion",      "$VERSION"
-            VALUE "InternalName",     "mvd-diskspace"
-            VALUE "LegalCopyright",   "Copyright (C) 2026 MAX Video Downloader"
-            VALUE "OriginalFilename", "mvd-diskspace.exe"
-            VALUE "ProductName",      "MAX Video Downloader"
-            VALUE "ProductVersion",   "$VERSION"
-        END
-    END
-    BLOCK "VarFileInfo"
-    BEGIN
-        VALUE "Translation", 0x409, 1200
-    END
-END
-EOF
-			"$res_compiler" "$res_rc" -o "$res_obj"
-
-			# Compile with resource and PE mitigations
-			"$compiler" "$diskspace_src" "$res_obj" $extra_cxx_flags -static -Wl,--major-subsystem-version,6,--minor-subsystem-version,0 -o "$temp_diskspace"
-		elif is_mac "$target"; then
-			local mac_cxx
-			mac_cxx=$(xcrun --find clang++)
-			local mac_sdk
-			mac_sdk=$(xcrun --sdk macosx --show-sdk-path)
-			local mac_arch
-			if [[ "$target" == "mac-arm64" ]]; then
-				mac_arch="arm64"
-				mac_min_version="11.0"
-			else
-				mac_arch="x86_64"
-				mac_min_version="10.10"
-			fi
-			export MACOSX_DEPLOYMENT_TARGET="$mac_min_version"
-			"$mac_cxx" "$diskspace_src" $extra_cxx_flags -arch "$mac_arch" -mmacosx-version-min="$mac_min_version" -isysroot "$mac_sdk" -stdlib=libc++ -o "$temp_diskspace"
-			unset MACOSX_DEPLOYMENT_TARGET
-		elif is_linux "$target"; then
-			g++ -std=c++11 "$diskspace_src" $extra_cxx_flags -o "$temp_diskspace"
-		fi
+	# 3. Build Helpers
+	build_helper "$target" "mvd-diskspace" "$TOOLS_DIR/diskspace/src/diskspace.cpp" "Disk Space Helper" "-static" ""
+	build_helper "$target" "mvd-tsconcat" "$TOOLS_DIR/tsconcat/src/tsconcat.cpp" "MPEG-TS Concatenation Helper" "-static" ""
+	build_helper "$target" "mvd-fmp4" "$TOOLS_DIR/fmp4/src/fmp4.cpp" "Fragmented MP4 Assembly Helper" "-static" ""
+	build_helper "$target" "mvd-faststart" "$TOOLS_DIR/faststart/src/faststart.cpp" "MP4 Faststart Helper" "-static" "-pthread"
+	build_helper "$target" "mvd-fsutil" "$TOOLS_DIR/fsutil/src/fsutil.cpp" "Filesystem Batch Helper" "-static" "-pthread"
 
-		mv "$temp_diskspace" "$bin_diskspace"
-		cp "$bin_diskspace" "$build_diskspace"
-		validate_binary_file "$target" "$build_diskspace" || true
+	# Direct download writer (POSIX only; Windows keeps Node's write stream)
+	if ! is_windows "$target"; then
+		build_helper "$target" "mvd-writer" "$TOOLS_DIR/writer/src/writer.cpp" "Download Writer Helper" "" "-pthread"
 	fi
 
-	# 4. Build Helpers (FileUI - Windows Only)
-	if is_windows "$target"; then
-		local fileui_src="$TOOLS_DIR/fileui/src/pick.cpp"
-		local bin_fileui="$BIN_DIR/$ffmpeg_plat/mvd-fileui$ext"
-		local build_fileui="$build_dir/mvd-fileui$ext"
+	# Native-messaging front end: answers the handshake before the Node engine boots
+	build_helper "$target" "mvd-host" "$TOOLS_DIR/host/src/host.cpp" "Native Messaging Front End" "-static" "-pthread"
 
-		if [[ -f "$bin_fileui" ]]; then
-			cp "$bin_fileui" "$build_fileui"
-			validate_binary_file "$target" "$build_fileui" || true
-		else
-			log_info "  -> Compiling fileui helper..."
-			if [[ ! -f "$fileui_src" ]]; then
-				log_error "FileUI source not found at $fileui_src"
-				exit 1
-			fi
-			local compiler="x86_64-w64-mingw32-g++"
-			local res_compiler="x86_64-w64-mingw32-windres"
-			if [[ "$target" == "win-arm64" ]]; then
-				compiler="aarch64-w64-mingw32-g++"
-				res_compiler="aarch64-w64-mingw32-windres"
-			fi
-
-			# Generate and compile resources
-			local res_rc="$bundled_dir/fileui.rc"
-			local res_obj="$bundled_dir/fileui.res.o"
-
-			cat > "$res_rc" <<EOF
-#include <windows.h>
-VS_VERSION_INFO VERSIONINFO
-FILEVERSION     $major,$minor,$patch,0
-PRODUCTVERSION  $major,$minor,$patch,0
-FILEFLAGSMASK   VS_FFI_FILEFLAGSMASK
-FILEFLAGS       0x0L
-FILEOS          VOS_NT_WINDOWS32
-FILETYPE        VFT_APP
-FILESUBTYPE     VFT2_UNKNOWN
-BEGIN
-    BLOCK "StringFileInfo"
-    BEGIN
-        BLOCK "040904b0"
-        BEGIN
-            VALUE "CompanyName",      "MAX Video Downloader"
-            VALUE "FileDescription",  "MAX Video Downloader File UI Helper"
-            VALUE "FileVersion",      "$VERSION"
-            VALUE "InternalName",     "mvd-fileui"
-            VALUE "LegalCopyright",   "Copyright (C) 2026 MAX Video Downloader"
-            VALUE "OriginalFilename", "mvd-fileui.exe"
-            VALUE "ProductName",      "MAX Video Downloader"
-            VALUE "ProductVersion",   "$VERSION"
-        END
-    END
-    BLOCK "VarFileInfo"
-    BEGIN
-        VALUE "Translation", 0x409, 1200
-    END
-END
-EOF
-			"$res_compiler" "$res_rc" -o "$res_obj"
-
-			mkdir -p "$BIN_DIR/$ffmpeg_plat"
-			local temp_fileui="$bin_fileui.tmp"
-			# Compile with resource and PE mitigations
-			"$compiler" "$fileui_src" "$res_obj" $extra_cxx_flags -fno-exceptions -fno-rtti -lole32 -luuid -lshell32 -lshlwapi -Wl,--major-subsystem-version,6,--minor-subsystem-version,0 -o "$temp_fileui"
-			mv "$temp_fileui" "$bin_fileui"
-			cp "$bin_fileui" "$build_fileui"
-			validate_binary_file "$target" "$build_fileui" || true
-		fi
+	# 4. Build Helpers (FileUI - Windows shell dialogs; XDG portal dialogs on Linux)
+	if is_windows "$target"; then
+		build_helper "$target" "mvd-fileui" "$TOOLS_DIR/fileui/src/pick.cpp" "File UI Helper" "-fno-exceptions -fno-rtti -lole32 -luuid -lshell32 -lshlwapi" ""
+	elif is_linux "$target"; then
+		build_helper "$target" "mvd-fileui" "$TOOLS_DIR/fileui/src/pick.cpp" "File UI Helper" "" "-ldl"
 	fi
 
 	# 5. Compile Main Binary (pkg)
@@ -690,6 +656,34 @@ EOF
 	fi
 }
 
+# ==============================================================================
+# DEVELOPER TOOLS (host platform only, never shipped)
+# ==============================================================================
+
+build_dev_tools() {
+	local out_dir="$BUILD_ROOT/devtools"
+	mkdir -p "$out_dir"
+
+	local cxx="g++"
+	if [[ "$(uname -s)" == "Darwin" ]]; then
+		check_tool "xcrun"
+		cxx=$(xcrun --find clang++)
+	else
+		check_tool "g++"
+	fi
+
+	log_info "Compiling trace converter (mvd-trace)..."
+	"$cxx" -std=c++11 -O2 "$TOOLS_DIR/trace/src/trace2json.cpp" -o "$out_dir/mvd-trace"
+
+	log_info "Compiling benchmark origin (mvd-origin)..."
+	"$cxx" -std=c++11 -O2 -pthread "$TOOLS_DIR/bench/src/origin.cpp" -o "$out_dir/mvd-origin"
+
+	log_info "Compiling native messaging load generator (mvd-nmload)..."
+	"$cxx" -std=c++11 -O2 -pthread "$TOOLS_DIR/bench/src/nmload.cpp" -o "$out_dir/mvd-nmload"
+
+	log_info "✓ Developer tools ready in build/devtools"
+}
+
 # ==============================================================================
 # PUBLISH UTILITIES
 # ==============================================================================
@@ -840,12 +834,13 @@ COMMAND=$1
 TARGET=$2
 
 # Validate Command
-if [[ "$COMMAND" != "build" && "$COMMAND" != "dist" && "$COMMAND" != "publish" && "$COMMAND" != "scan" ]]; then
+if [[ "$COMMAND" != "build" && "$COMMAND" != "dist" && "$COMMAND" != "publish" && "$COMMAND" != "scan" && "$COMMAND" != "devtools" ]]; then
 	echo "Usage:"
 	echo "  $0 build <target|all>"
 	echo "  $0 dist <target|all>"
 	echo "  $0 publish"
 	echo "  $0 scan"
+	echo "  $0 devtools"
 	echo
 	echo "Available targets:"
 	echo "  ${ALL_TARGETS[*]}"
@@ -880,6 +875,15 @@ if [[ "$COMMAND" == "publish" ]]; then
 	exit 0
 fi
 
+if [[ "$COMMAND" == "devtools" ]]; then
+	if [[ -n "$TARGET" ]]; then
+		log_error "devtools command does not accept a target argument"
+		exit 1
+	fi
+	build_dev_tools
+	exit 0
+fi
+
 if [[ "$COMMAND" == "scan" ]]; then
 	if [[ -n "$TARGET" ]]; then
 		log_error "scan command does not accept a target argument"
@@ -0,0 +1,274 @@
+#!/usr/bin/env node
+
+/**
+ * End-to-end download benchmark for MAX Video Downloader CoApp
+ * Starts the synthetic origin (build/devtools/mvd-origin), drives a real host binary over
+ * native messaging with download-v2 / direct-download requests, and reports throughput
+ * and time to first progress for each scenario.
+ *
+ * Usage:
+ *   node scripts/bench.js --host build/linux-x64/mvdcoapp [--origin PATH] [--runs 3]
+ *     [--scenarios direct,hls-ts,hls-fmp4,hls-aes,dash,dash-timeline]
+ *     [--spec b8M-d60-s4] [--size 256M] [--impair l20-j5] [--hash xxh3,sha256] [--out DIR] [--json]
+ */
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const http = require('http');
+const { spawn } = require('child_process');
+
+const EXTENSION_ORIGIN = 'chrome-extension://bkblnddclhmmgjlmbofhakhhbklkcofd/';
+const REQUEST_TIMEOUT_MS = 30 * 60 * 1000;
+
+// Each scenario maps to an origin path and the request the extension would send for it
+const SCENARIOS = {
+  'direct': { kind: 'direct' },
+  'hls-ts': { kind: 'stream', file: 'ts.m3u8', format: 'hls', container: 'ts' },
+  'hls-fmp4': { kind: 'stream', file: 'fmp4.m3u8', format: 'hls', container: 'mp4' },
+  'hls-aes': { kind: 'stream', file: 'ts.m3u8', format: 'hls', container: 'ts', tokens: ['aes'] },
+  'dash': { kind: 'stream', file: 'manifest.mpd', format: 'dash', container: 'mp4' },
+  'dash-timeline': { kind: 'stream', file: 'manifest.mpd', format: 'dash', container: 'mp4', tokens: ['tl'] },
+};
+
+// CLI Args parsing
+const args = process.argv.slice(2);
+function getArgValue(flag) {
+  const index = args.findIndex(a => a === flag || a.startsWith(`${flag}=`));
+  if (index === -1) return null;
+  const arg = args[index];
+  if (arg.includes('=')) return arg.split('=')[1];
+  const next = args[index + 1];
+  return (next && !next.startsWith('--')) ? next : null;
+}
+
+const hostPath = getArgValue('--host');
+const originPath = path.resolve(getArgValue('--origin') || path.join(__dirname, '..', 'build', 'devtools', 'mvd-origin'));
+const runs = Math.max(1, Number(getArgValue('--runs')) || 1);
+const spec = getArgValue('--spec') || 'b8M-d60-s4';
+const fileSize = getArgValue('--size') || '256M';
+const impair = getArgValue('--impair');
+const hash = getArgValue('--hash');
+const scenarioNames = (getArgValue('--scenarios') || Object.keys(SCENARIOS).join(',')).split(',').filter(Boolean);
+const jsonOutput = args.includes('--json');
+
+if (!hostPath) {
+  console.error('[ERROR] Missing required --host argument (path to a built mvdcoapp binary)');
+  process.exit(1);
+}
+if (!fs.existsSync(originPath)) {
+  console.error(`[ERROR] Origin not found at ${originPath} (run ./build-coapp.sh devtools)`);
+  process.exit(1);
+}
+const unknown = scenarioNames.filter(name => !SCENARIOS[name]);
+if (unknown.length) {
+  console.error(`[ERROR] Unknown scenario(s): ${unknown.join(', ')} (known: ${Object.keys(SCENARIOS).join(', ')})`);
+  process.exit(1);
+}
+
+const outDir = path.resolve(getArgValue('--out') || fs.mkdtempSync(path.join(os.tmpdir(), 'mvd-bench-')));
+fs.mkdirSync(outDir, { recursive: true });
+
+function startOrigin() {
+  return new Promise((resolve, reject) => {
+    const child = spawn(originPath, ['--quiet'], { stdio: ['ignore', 'pipe', 'inherit'] });
+    let buffer = '';
+    child.on('error', reject);
+    child.on('exit', code => reject(new Error(`Origin exited early (code ${code})`)));
+    child.stdout.on('data', (chunk) => {
+      buffer += chunk.toString();
+      const match = /PORT=(\d+)/.exec(buffer);
+      if (match) resolve({ child, baseUrl: `http://127.0.0.1:${match[1]}` });
+    });
+  });
+}
+
+// Native messaging peer: 4-byte little-endian length prefix + JSON, replies matched by id
+function startHost() {
+  const resolved = path.resolve(hostPath);
+  const child = /\.[cm]?js$/.test(resolved)
+    ? spawn(process.execPath, [resolved, EXTENSION_ORIGIN], { stdio: ['pipe', 'pipe', 'inherit'] })
+    : spawn(resolved, [EXTENSION_ORIGIN], { stdio: ['pipe', 'pipe', 'inherit'] });
+
+  const pending = new Map();
+  const listeners = new Set();
+  let buffer = Buffer.alloc(0);
+  let nextId = 1;
+
+  child.stdout.on('data', (chunk) => {
+    buffer = Buffer.concat([buffer, chunk]);
+    while (buffer.length >= 4) {
+      const length = buffer.readUInt32LE(0);
+      if (buffer.length < 4 + length) break;
+      const message = JSON.parse(buffer.subarray(4, 4 + length).toString('utf8'));
+      buffer = buffer.subarray(4 + length);
+      listeners.forEach(listener => listener(message));
+      if (message.id && pending.has(message.id)) {
+        pending.get(message.id)(message);
+        pending.delete(message.id);
+      }
+    }
+  });
+  let exited = false;
+  child.stdin.on('error', () => {}); // surfaces as the exit below
+  child.on('exit', () => {
+    exited = true;
+    pending.forEach(resolve => resolve({ success: false, error: 'Host exited' }));
+    pending.clear();
+  });
+
+  return {
+    child,
+    onMessage(listener) {
+      listeners.add(listener);
+      return () => listeners.delete(listener);
+    },
+    request(message) {
+      if (exited) return Promise.reject(new Error('Host exited'));
+      const id = `bench-${nextId++}`;
+      const payload = Buffer.from(JSON.stringify({ ...message, id }), 'utf8');
+      const header = Buffer.alloc(4);
+      header.writeUInt32LE(payload.length, 0);
+      child.stdin.write(Buffer.concat([header, payload]));
+      return new Promise((resolve, reject) => {
+        const timer = setTimeout(() => reject(new Error(`${message.command} timed out`)), REQUEST_TIMEOUT_MS);
+        pending.set(id, (reply) => {
+          clearTimeout(timer);
+          resolve(reply);
+        });
+      });
+    }
+  };
+}
+
+function fetchText(url) {
+  return new Promise((resolve, reject) => {
+    http.get(url, (res) => {
+      let body = '';
+      res.setEncoding('utf8');
+      res.on('data', (chunk) => { body += chunk; });
+      res.on('end', () => (res.statusCode === 200 ? resolve(body) : reject(new Error(`HTTP ${res.statusCode} for ${url}`))));
+    }).on('error', reject);
+  });
+}
+
+function specPath(extraTokens = []) {
+  return [spec, impair, ...extraTokens].filter(Boolean).join('-');
+}
+
+// The host keeps a persistent segment cache keyed by URL; a fresh nonce keeps every run cold
+let nonceCounter = 0;
+function nonceToken() {
+  return `n${Date.now()}${nonceCounter++}`;
+}
+
+async function buildRequest(name, baseUrl, downloadId) {
+  const scenario = SCENARIOS[name];
+  const common = { downloadId, saveDir: outDir, allowOverwrite: true, ...(hash ? { hash } : {}) };
+
+  if (scenario.kind === 'direct') {
+    return {
+      command: 'direct-download',
+      ...common,
+      url: `${baseUrl}/v/${specPath([nonceToken()])}/file-${fileSize}.bin`,
+      filename: `${downloadId}.bin`,
+    };
+  }
+
+  const manifestUrl = `${baseUrl}/v/${specPath([...(scenario.tokens || []), nonceToken()])}/${scenario.file}`;
+  const token = `mvd-bench-${downloadId}`;
+  return {
+    command: 'download-v2',
+    ...common,
+    queue: false,
+    filename: `${downloadId}.${scenario.container}`,
+    container: scenario.container,
+    inlineInputs: [{ token, format: scenario.format, content: await fetchText(manifestUrl), baseUrl: manifestUrl }],
+    argsBeforeOutput: ['-hide_banner', '-loglevel', 'error', '-i', token, '-c', 'copy', '-y'],
+  };
+}
+
+async function runOnce(host, name, baseUrl, run) {
+  const downloadId = `bench-${name}-${run}`;
+  const request = await buildRequest(name, baseUrl, downloadId);
+  const startedAt = process.hrtime.bigint();
+  let firstProgressAt = null;
+
+  const unsubscribe = host.onMessage((message) => {
+    if (message.downloadId !== downloadId || firstProgressAt !== null) return;
+    if (message.command === 'download-progress' && !message.queued && (message.downloadedBytes || 0) > 0) {
+      firstProgressAt = process.hrtime.bigint();
+    }
+  });
+  const result = await host.request(request);
+  const finishedAt = process.hrtime.bigint();
+  unsubscribe();
+
+  const seconds = Number(finishedAt - startedAt) / 1e9;
+  const bytes = result.path && fs.existsSync(result.path) ? fs.statSync(result.path).size : 0;
+  if (result.path) fs.rmSync(result.path, { force: true });
+  return {
+    scenario: name,
+    run,
+    success: !!result.success,
+    bytes,
+    seconds,
+    mbPerSec: result.success && seconds > 0 ? bytes / seconds / 1e6 : 0,
+    firstProgressMs: firstProgressAt !== null ? Number(firstProgressAt - startedAt) / 1e6 : null,
+    ...(result.hashes ? { hashes: result.hashes } : {}),
+    ...(result.success ? {} : { error: result.error || result.key || 'failed' }),
+  };
+}
+
+function median(values) {
+  const sorted = values.slice().sort((a, b) => a - b);
+  return sorted.length ? sorted[Math.floor(sorted.length / 2)] : null;
+}
+
+function printTable(results) {
+  console.log(`\nspec=${specPath()} size=${fileSize} runs=${runs}${hash ? ` hash=${hash}` : ''}\n`);
+  console.log('scenario          ok   median MB/s   best MB/s   median first-progress ms');
+  for (const name of scenarioNames) {
+    const rows = results.filter(row => row.scenario === name);
+    const ok = rows.filter(row => row.success);
+    const rates = ok.map(row => row.mbPerSec);
+    const firsts = ok.map(row => row.firstProgressMs).filter(value => value !== null);
+    const format = (value, digits) => (value === null || value === undefined ? '-' : value.toFixed(digits));
+    console.log(
+      `${name.padEnd(16)}  ${`${ok.length}/${rows.length}`.padEnd(4)} ${format(median(rates), 1).padStart(13)} ` +
+      `${format(rates.length ? Math.max(...rates) : null, 1).padStart(11)} ${format(median(firsts), 0).padStart(26)}`
+    );
+    rows.filter(row => !row.success).forEach(row => console.log(`    run ${row.run}: ${row.error}`));
+  }
+}
+
+async function main() {
+  const origin = await startOrigin();
+  const host = startHost();
+  const results = [];
+  try {
+    for (const name of scenarioNames) {
+      for (let run = 1; run <= runs; run++) {
+        const row = await runOnce(host, name, origin.baseUrl, run);
+        results.push(row);
+        if (!jsonOutput) {
+          console.error(`[INFO] ${name} #${run}: ${row.success ? `${row.mbPerSec.toFixed(1)} MB/s` : row.error}`);
+        }
+      }
+    }
+  } finally {
+    host.child.stdin.end();
+    host.child.kill();
+    origin.child.removeAllListeners('exit');
+    origin.child.kill('SIGTERM');
+  }
+
+  if (jsonOutput) console.log(JSON.stringify({ spec: specPath(), size: fileSize, runs, results }, null, 2));
+  else printTable(results);
+  process.exit(results.every(row => row.success) ? 0 : 1);
+}
+
+main().catch((err) => {
+  console.error(`[ERROR] ${err.message}`);
+  process.exit(1);
+});
@@ -0,0 +1,210 @@
+import fs from 'fs';
+import os from 'os';
+import { logDebug, getFreeDiskSpace } from '../utils/utils';
+
+/**
+ * Admission – Resource-aware concurrency limit for download-v2 jobs
+ *
+ * Jobs wait in a priority queue (live first, then `priority`, then arrival) and are
+ * admitted one at a time while the machine has headroom:
+ *   - fewer than MIN_RUNNING jobs are always admitted,
+ *   - CPU busy time (os.cpus() deltas) must stay under CPU_BUSY_LIMIT,
+ *   - the target volume must keep FREE_SPACE_RESERVE free (diskspace helper),
+ *   - aggregate write throughput (growth of the running jobs' output files) must still
+ *     scale: each extra job is a probe, and if it does not raise throughput by
+ *     PROBE_GAIN within PROBE_MS the current count becomes the ceiling for a while.
+ * Queued jobs see their position as download-progress messages with `queued: true`.
+ */
+
+const TICK_MS = 1000;
+const MIN_RUNNING = 2;
+const MAX_RUNNING = Math.max(MIN_RUNNING, os.cpus().length);
+const CPU_BUSY_LIMIT = 0.85;
+const FREE_SPACE_RESERVE = 2 * 1024 * 1024 * 1024;
+const PROBE_MS = 5000;
+const PROBE_GAIN = 1.1;
+const CEILING_TTL_MS = 60000;
+const RATE_SMOOTHING = 0.3;
+
+const queue = []; // pending jobs, kept sorted
+const running = new Map(); // downloadId -> { outputPath, lastSize }
+let sequence = 0;
+let tickTimer = null;
+let cpuSample = null;
+let cpuBusy = 0;
+let writeRate = 0; // bytes/s, smoothed
+let lastRateAt = 0;
+let probe = null; // { count, rateBefore, at }
+let ceiling = { count: Infinity, at: 0 };
+
+function readCpuTimes() {
+    let idle = 0;
+    let total = 0;
+    for (const cpu of os.cpus()) {
+        for (const [kind, value] of Object.entries(cpu.times)) {
+            total += value;
+            if (kind === 'idle') idle += value;
+        }
+    }
+    return { idle, total };
+}
+
+function sampleCpu() {
+    const next = readCpuTimes();
+    if (cpuSample && next.total > cpuSample.total) {
+        cpuBusy = 1 - ((next.idle - cpuSample.idle) / (next.total - cpuSample.total));
+    }
+    cpuSample = next;
+}
+
+async function sampleWriteRate() {
+    const now = Date.now();
+    let written = 0;
+    await Promise.all([...running.values()].map(async (job) => {
+        if (!job.outputPath) return;
+        try {
+            const { size } = await fs.promises.stat(job.outputPath);
+            written += Math.max(0, size - job.lastSize);
+            job.lastSize = size;
+        } catch { /* not created yet, or already finalized */ }
+    }));
+    if (lastRateAt) {
+        const instant = written / Math.max(0.001, (now - lastRateAt) / 1000);
+        writeRate = writeRate ? writeRate + RATE_SMOOTHING * (instant - writeRate) : instant;
+    }
+    lastRateAt = now;
+}
+
+function sortQueue() {
+    queue.sort((a, b) => (Number(b.live) - Number(a.live)) || (b.priority - a.priority) || (a.sequence - b.sequence));
+}
+
+function reportPositions() {
+    queue.forEach((job, index) => {
+        if (job.reportedPosition === index + 1) return;
+        job.reportedPosition = index + 1;
+        job.responder.send({
+            command: 'download-progress',
+            downloadId: job.downloadId,
+            queued: true,
+            queuePosition: index + 1,
+            queueLength: queue.length
+        });
+    });
+}
+
+async function canAdmit(job) {
+    const count = running.size;
+    if (count < MIN_RUNNING) return true;
+    if (count >= MAX_RUNNING) return false;
+
+    const now = Date.now();
+    if (probe) {
+        if (now - probe.at < PROBE_MS) return false;
+        if (writeRate < probe.rateBefore * PROBE_GAIN) {
+            ceiling = { count: probe.count, at: now };
+            logDebug(`[Admission] Write throughput stopped scaling at ${probe.count} jobs (${Math.round(writeRate / 1024)} KiB/s)`);
+        }
+        probe = null;
+    }
+    if (now - ceiling.at > CEILING_TTL_MS) ceiling = { count: Infinity, at: 0 };
+    if (count >= ceiling.count) return false;
+    if (cpuBusy > CPU_BUSY_LIMIT) return false;
+
+    const free = job.dir ? await getFreeDiskSpace(job.dir) : null;
+    if (free !== null && free < FREE_SPACE_RESERVE) return false;
+
+    probe = { count: count + 1, rateBefore: writeRate, at: now };
+    return true;
+}
+
+let ticking = false;
+async function tick() {
+    if (ticking) return;
+    ticking = true;
+    try {
+        sampleCpu();
+        await sampleWriteRate();
+        while (queue.length > 0 && await canAdmit(queue[0])) {
+            const job = queue.shift();
+            running.set(job.downloadId, { outputPath: null, lastSize: 0 });
+            logDebug(`[Admission] Admitting ${job.downloadId} (${running.size} running, ${queue.length} queued, cpu ${Math.round(cpuBusy * 100)}%)`);
+            job.resolve(true);
+        }
+        reportPositions();
+        if (queue.length === 0 && running.size === 0 && tickTimer) {
+            clearInterval(tickTimer);
+            tickTimer = null;
+            lastRateAt = 0;
+            writeRate = 0;
+        }
+    } finally {
+        ticking = false;
+    }
+}
+
+function ensureTicking() {
+    if (tickTimer) return;
+    cpuSample = readCpuTimes();
+    tickTimer = setInterval(() => { void tick(); }, TICK_MS);
+}
+
+/**
+ * Wait for a download slot. Resolves to true once admitted, or false when the job was
+ * canceled while queued. Admitted jobs must call releaseDownloadSlot when they end.
+ */
+export function acquireDownloadSlot(downloadId, { dir = null, priority = 0, live = false, responder }) {
+    ensureTicking();
+    // Live recordings cannot wait without losing the live edge
+    if (live || (running.size < MIN_RUNNING && queue.length === 0)) {
+        running.set(downloadId, { outputPath: null, lastSize: 0 });
+        return Promise.resolve(true);
+    }
+
+    return new Promise((resolve) => {
+        queue.push({
+            downloadId,
+            dir,
+            priority: Number(priority) || 0,
+            live,
+            sequence: sequence++,
+            responder,
+            resolve,
+            reportedPosition: 0
+        });
+        sortQueue();
+        logDebug(`[Admission] Queued ${downloadId} (${queue.length} waiting, ${running.size} running)`);
+        void tick();
+    });
+}
+
+// Lets throughput sampling follow the job's output file once its path is known
+export function trackDownloadOutput(downloadId, outputPath) {
+    const job = running.get(downloadId);
+    if (job) job.outputPath = outputPath;
+}
+
+export function releaseDownloadSlot(downloadId) {
+    if (!running.delete(downloadId)) return;
+    // A finished job lowers throughput on its own; that says nothing about the probe
+    if (probe && running.size < probe.count) probe = null;
+    if (queue.length > 0) void tick();
+}
+
+export function cancelQueuedDownload(downloadId) {
+    const index = queue.findIndex(job => job.downloadId === downloadId);
+    if (index < 0) return false;
+    const [job] = queue.splice(index, 1);
+    job.resolve(false);
+    reportPositions();
+    return true;
+}
+
+export function setQueuedDownloadPriority(downloadId, priority) {
+    const job = queue.find(entry => entry.downloadId === downloadId);
+    if (!job) return false;
+    job.priority = Number(priority) || 0;
+    sortQueue();
+    reportPositions();
+    return true;
+}
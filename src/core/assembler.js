@@ -0,0 +1,233 @@
+import { spawn } from 'child_process';
+import fs from 'fs';
+import { logDebug, getFullEnv, checkBinaries, normalizeForFsWindows } from '../utils/utils';
+import { parseHlsMediaPlaylist } from '../utils/playlist';
+import { register } from './processes';
+import { fetchSegment } from './segment-cache';
+import { traceInstant, traceLabel, TraceEvent } from './trace';
+import { readDigestLine } from './writer';
+
+/**
+ * Assembler – Native HLS assembly that skips the ffmpeg remux pass
+ *
+ * Segments are fetched through the segment cache and their paths streamed to a helper:
+ * mvd-tsconcat for MPEG-TS playlists, mvd-fmp4 for fMP4/CMAF playlists (init section
+ * first, then fragments). Only plain `-c copy` jobs qualify; anything that needs
+ * ffmpeg to touch packets (filters, maps, bitstream filters) keeps the ffmpeg path.
+ */
+
+const PREFETCH_SEGMENTS = 4;
+const PROGRESS_INTERVAL_MS = 500;
+
+// Flags that only affect how ffmpeg fetches or logs, not what it writes
+const PASSIVE_VALUE_FLAGS = new Set(['-headers', '-user_agent', '-referer', '-loglevel', '-v', '-protocol_whitelist', '-allowed_extensions', '-stats_period']);
+const PASSIVE_SWITCHES = new Set(['-y', '-n', '-hide_banner', '-nostdin', '-stats', '-nostats']);
+const CODEC_FLAG = /^-(c|codec|vcodec|acodec|scodec)(:[a-z](:\d+)?)?$/;
+const FMP4_CONTAINERS = new Set(['mp4', 'm4v', 'm4a']);
+
+function isCopyOnlyJob(args, token, muxer) {
+    let inputs = 0;
+    let copies = 0;
+    for (let index = 0; index < args.length; index += 1) {
+        const flag = String(args[index]);
+        const value = args[index + 1];
+        if (PASSIVE_SWITCHES.has(flag)) continue;
+        if (index + 1 >= args.length) return false;
+        index += 1;
+        if (PASSIVE_VALUE_FLAGS.has(flag)) continue;
+        if (flag === '-i' && value === token) inputs += 1;
+        else if (CODEC_FLAG.test(flag) && value === 'copy') copies += 1;
+        else if (flag === '-f' && value === muxer) continue;
+        // Fragmented output already starts with moov, and fMP4 audio is never ADTS
+        else if (muxer === 'mp4' && (flag === '-movflags' || (flag === '-bsf:a' && value === 'aac_adtstoasc'))) continue;
+        else if (flag === '-map' && value === '0') continue;
+        else return false;
+    }
+    return inputs === 1 && copies > 0;
+}
+
+/**
+ * Decide whether a download-v2 request can be assembled natively.
+ * Returns { helper, playlist } or null (with the reason logged) to keep the ffmpeg path.
+ */
+export function getNativeAssemblyPlan(params) {
+    const { argsBeforeOutput, inlineInputs, container, nativeAssembly } = params;
+    const reject = (reason) => {
+        logDebug(`[Assembler] Using ffmpeg for ${params.downloadId}: ${reason}`);
+        return null;
+    };
+
+    if (nativeAssembly === false) return null;
+    const normalizedContainer = String(container || '').toLowerCase();
+    const muxer = normalizedContainer === 'ts' ? 'mpegts' : (FMP4_CONTAINERS.has(normalizedContainer) ? 'mp4' : null);
+    if (!muxer) return null;
+    if (!Array.isArray(inlineInputs) || inlineInputs.length !== 1 || inlineInputs[0]?.format !== 'hls') return null;
+    if (!Array.isArray(argsBeforeOutput) || !isCopyOnlyJob(argsBeforeOutput, inlineInputs[0].token, muxer)) {
+        return reject('arguments need ffmpeg');
+    }
+
+    const playlist = parseHlsMediaPlaylist(inlineInputs[0].content, inlineInputs[0].baseUrl);
+    if (!playlist) return reject('not a resolvable media playlist');
+    if (!playlist.endList) return reject('playlist is live');
+    if (playlist.encrypted) return reject('playlist is encrypted');
+    if (muxer === 'mpegts' && playlist.initSection) return reject('fMP4 segments into a TS container');
+    if (muxer === 'mp4' && !playlist.initSection) return reject('TS segments into an MP4 container');
+
+    const helper = muxer === 'mp4' ? 'fmp4' : 'tsconcat';
+    try {
+        checkBinaries(helper);
+    } catch {
+        return reject(`${helper} helper missing`);
+    }
+    return { helper, playlist };
+}
+
+/**
+ * Fetch and assemble the playlist into context.partialPath (reported as context.finalPath).
+ * Resolves to a download-finished message, or null when the caller should fall back to ffmpeg.
+ */
+export async function assembleNatively(plan, responder, context) {
+    const { downloadId, finalPath, finalFilename, partialPath, startedAt, traceId, headers, shaper, hashes = [], onStart } = context;
+    const { helper, playlist } = plan;
+    const writePath = normalizeForFsWindows(partialPath);
+    const inputs = playlist.initSection ? [playlist.initSection, ...playlist.segments] : playlist.segments;
+    const total = inputs.length;
+
+    const args = ['--output', writePath, '--stdin-list'];
+    if (hashes.length) args.push('--hash', hashes.join(','));
+    const child = spawn(checkBinaries(helper), args, { env: getFullEnv() });
+    register(child);
+    traceInstant(TraceEvent.SPAWN, traceId, traceLabel(helper), child.pid || 0);
+
+    let stopRequested = false;
+    const controller = {
+        killed: false,
+        // cancel-download-v2 sends ffmpeg's 'q'; stop fetching and let the helper close the file the same way
+        stdin: {
+            writable: true,
+            write() {
+                stopRequested = true;
+                return true;
+            }
+        },
+        kill(signal) {
+            if (this.killed) return false;
+            this.killed = true;
+            stopRequested = true;
+            child.kill(signal);
+            return true;
+        }
+    };
+    if (onStart) onStart(controller);
+    logDebug(`[Assembler] Assembling ${total} inputs with ${helper}`, { downloadId, finalPath });
+
+    let stdoutBuffer = '';
+    let report = null;
+    const digests = {};
+    let outputBytes = 0;
+    let lastProgressAt = 0;
+    child.stdout.on('data', (chunk) => {
+        stdoutBuffer += chunk.toString();
+        const lines = stdoutBuffer.split('\n');
+        stdoutBuffer = lines.pop();
+        for (const line of lines) {
+            const segmentMatch = /^SEGMENT=(\d+) BYTES=(\d+)/.exec(line);
+            if (segmentMatch) {
+                outputBytes = Number(segmentMatch[2]);
+                const now = Date.now();
+                if ((now - lastProgressAt) < PROGRESS_INTERVAL_MS) continue;
+                lastProgressAt = now;
+                traceInstant(TraceEvent.PROGRESS_FLUSH, traceId, 0, outputBytes);
+                responder.send({
+                    command: 'download-progress',
+                    downloadId,
+                    downloadedBytes: outputBytes,
+                    progress: Math.min(99.999, Math.round(((Number(segmentMatch[1]) + 1) / total) * 100000) / 1000),
+                    elapsedTime: Math.round((now - startedAt) / 1000)
+                });
+            } else if (line.startsWith('REPORT=')) {
+                try {
+                    report = JSON.parse(line.slice('REPORT='.length));
+                } catch { /* ignore */ }
+            } else {
+                readDigestLine(line, digests);
+            }
+        }
+    });
+
+    let stderr = '';
+    child.stderr.on('data', (chunk) => { stderr += chunk.toString(); });
+    child.stdin.on('error', () => { /* helper exited early; surfaced through its exit code */ });
+
+    const exited = new Promise((resolve) => {
+        child.on('close', (code, signal) => resolve({ code, signal }));
+        child.on('error', (err) => resolve({ code: null, error: err }));
+    });
+
+    let fetchError = null;
+    try {
+        const pending = [];
+        const startFetch = (index) => {
+            const segment = inputs[index];
+            const promise = fetchSegment(segment.url, { range: segment.range, headers, shaper });
+            promise.catch(() => {});
+            pending[index] = promise;
+        };
+        for (let index = 0; index < Math.min(PREFETCH_SEGMENTS, total); index += 1) startFetch(index);
+
+        for (let index = 0; index < total && !stopRequested; index += 1) {
+            const cached = await pending[index];
+            pending[index] = null;
+            if (index + PREFETCH_SEGMENTS < total) startFetch(index + PREFETCH_SEGMENTS);
+            if (!child.stdin.writable) break;
+            child.stdin.write(`${cached.path}\n`);
+        }
+    } catch (err) {
+        fetchError = err;
+        child.kill();
+    }
+    child.stdin.end();
+
+    const { code, error } = await exited;
+    const canceled = controller.killed;
+
+    if (code === 0 && !fetchError && !canceled) {
+        traceInstant(TraceEvent.DOWNLOAD_FINISHED, traceId, 1, outputBytes);
+        logDebug('[Assembler] Native assembly finished', { downloadId, report });
+        return {
+            command: 'download-finished',
+            downloadId,
+            success: true,
+            path: finalPath,
+            fileExists: true,
+            filename: finalFilename,
+            totalBytes: report?.bytesOut ?? outputBytes,
+            ...(report ? { health: report } : {}),
+            ...(Object.keys(digests).length ? { hashes: digests } : {})
+        };
+    }
+
+    try { if (fs.existsSync(writePath)) fs.unlinkSync(writePath); } catch { /* ignore best-effort cleanup */ }
+
+    if (canceled) {
+        traceInstant(TraceEvent.DOWNLOAD_FINISHED, traceId, 0, outputBytes);
+        return {
+            command: 'download-finished',
+            downloadId,
+            success: false,
+            fileExists: false,
+            canceled: true,
+            key: 'USER_CANCELLED',
+            error: 'Download canceled'
+        };
+    }
+
+    logDebug('[Assembler] Native assembly failed, falling back to ffmpeg', {
+        downloadId,
+        code,
+        error: (fetchError || error)?.message,
+        helper,
+        stderr: stderr.trim().split('\n').slice(-5).join('\n')
+    });
+    return null;
+}
@@ -0,0 +1,181 @@
+import { Transform } from 'stream';
+import { logDebug } from '../utils/utils';
+
+/**
+ * Bandwidth – Global token-bucket scheduler for host-side downloads
+ *
+ * Every download registers a job; the bytes it pulls from the network pass through
+ * throttle streams that hold chunks until the scheduler grants them tokens. A tick
+ * refills the bucket at the global rate and hands it out in two tiers:
+ *   1. Live jobs are strict priority and never wait: their chunks pass immediately and
+ *      are charged to the bucket (which may go into debt), so bulk jobs absorb the cost.
+ *   2. Other backlogged jobs split what is left in proportion to their weights.
+ * A limit of 0 disables shaping; throttles then forward chunks untouched.
+ */
+
+const TICK_MS = 25;
+const BURST_SECONDS = 0.25;
+const MIN_BURST_BYTES = 256 * 1024; // at least a few socket reads, or large chunks could never qualify
+
+const jobs = new Map(); // downloadId -> job
+let limitBytesPerSec = 0;
+let tokens = 0;
+let lastRefillAt = 0;
+let tickTimer = null;
+
+function burstBytes() {
+    return Math.max(MIN_BURST_BYTES, limitBytesPerSec * BURST_SECONDS);
+}
+
+function release(job, entry) {
+    job.queuedBytes -= entry.chunk.length;
+    job.bytes += entry.chunk.length;
+    entry.callback(null, entry.chunk);
+}
+
+function tick() {
+    const now = Date.now();
+    tokens = Math.min(burstBytes(), tokens + ((now - lastRefillAt) / 1000) * limitBytesPerSec);
+    lastRefillAt = now;
+
+    const backlogged = [...jobs.values()].filter(job => job.queue.length > 0);
+    if (backlogged.length === 0) {
+        clearInterval(tickTimer);
+        tickTimer = null;
+        return;
+    }
+    if (tokens <= 0) return;
+
+    // Tokens move into per-job credit, which carries over so chunks larger than one tick's share still go through
+    const totalWeight = backlogged.reduce((sum, job) => sum + job.weight, 0);
+    const available = tokens;
+    tokens = 0;
+    for (const job of backlogged) {
+        job.credit += available * (job.weight / totalWeight);
+        while (job.queue.length > 0 && job.credit >= job.queue[0].chunk.length) {
+            const entry = job.queue.shift();
+            job.credit -= entry.chunk.length;
+            release(job, entry);
+        }
+        // A throttle holds one chunk at a time; leftover credit pays for its next one on arrival
+        job.credit = Math.min(job.credit, burstBytes());
+    }
+}
+
+function ensureTicking() {
+    if (tickTimer) return;
+    lastRefillAt = Date.now();
+    tickTimer = setInterval(tick, TICK_MS);
+}
+
+function admit(job, chunk, callback) {
+    if (limitBytesPerSec <= 0) {
+        job.bytes += chunk.length;
+        callback(null, chunk);
+        return;
+    }
+    if (job.live) {
+        // Debt is bounded so bulk jobs resume soon after a live job outgrows the cap
+        tokens = Math.max(-burstBytes(), tokens - chunk.length);
+        job.bytes += chunk.length;
+        callback(null, chunk);
+        return;
+    }
+    if (job.queue.length === 0 && job.credit >= chunk.length) {
+        job.credit -= chunk.length;
+        job.bytes += chunk.length;
+        callback(null, chunk);
+        return;
+    }
+    job.queue.push({ chunk, callback });
+    job.queuedBytes += chunk.length;
+    ensureTicking();
+}
+
+function normalizeWeight(weight) {
+    const value = Number(weight);
+    return Number.isFinite(value) && value > 0 ? Math.min(value, 1000) : 1;
+}
+
+/**
+ * Register a download with the scheduler. The returned handle creates throttle streams
+ * for each network response of the job and must be released when the job ends.
+ */
+export function registerBandwidthJob(downloadId, { weight = 1, live = false } = {}) {
+    const job = {
+        downloadId,
+        weight: normalizeWeight(weight),
+        live: Boolean(live),
+        shapeable: true, // false once the job's bytes take a path that bypasses the throttles
+        queue: [],
+        queuedBytes: 0,
+        credit: 0,
+        bytes: 0,
+        createThrottle() {
+            return new Transform({
+                transform(chunk, encoding, callback) {
+                    admit(job, chunk, callback);
+                }
+            });
+        },
+        release() {
+            // Pending callbacks belong to streams that are being torn down with the job
+            job.queue = [];
+            job.queuedBytes = 0;
+            if (jobs.get(downloadId) === job) jobs.delete(downloadId);
+        }
+    };
+    jobs.set(downloadId, job);
+    return job;
+}
+
+export function isBandwidthLimited() {
+    return limitBytesPerSec > 0;
+}
+
+function flushAll() {
+    for (const job of jobs.values()) {
+        for (const entry of job.queue.splice(0)) release(job, entry);
+        job.credit = 0;
+    }
+}
+
+/**
+ * set-bandwidth: adjust the global cap and per-job weights/priorities at runtime.
+ * { limitBytesPerSec?: number (0 = unlimited), downloads?: { [downloadId]: { weight?, live? } } }
+ * The reply lists each job with `shapeable: false` when its bytes bypass the throttles
+ * (spliced direct downloads, ffmpeg jobs without inline manifests, jobs started as live
+ * while no limit was set), so a new limit cannot slow it.
+ */
+export async function handleSetBandwidth(request) {
+    if (request.limitBytesPerSec !== undefined) {
+        const limit = Number(request.limitBytesPerSec);
+        limitBytesPerSec = Number.isFinite(limit) && limit > 0 ? Math.floor(limit) : 0;
+        tokens = Math.min(tokens, burstBytes());
+        if (limitBytesPerSec === 0) flushAll();
+        logDebug(`[Bandwidth] Limit set to ${limitBytesPerSec ? `${limitBytesPerSec} B/s` : 'unlimited'}`);
+    }
+
+    for (const [downloadId, settings] of Object.entries(request.downloads || {})) {
+        const job = jobs.get(downloadId);
+        if (!job || !settings) continue;
+        if (settings.weight !== undefined) job.weight = normalizeWeight(settings.weight);
+        if (settings.live !== undefined) {
+            job.live = Boolean(settings.live);
+            if (job.live) for (const entry of job.queue.splice(0)) release(job, entry);
+        }
+    }
+
+    return {
+        success: true,
+        limitBytesPerSec,
+        downloads: [...jobs.values()].map(job => ({
+            downloadId: job.downloadId,
+            weight: job.weight,
+            live: job.live,
+            shapeable: job.shapeable,
+            bytes: job.bytes,
+            queuedBytes: job.queuedBytes
+        }))
+    };
+}
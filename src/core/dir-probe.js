@@ -0,0 +1,86 @@
+import fs from 'fs';
+import path from 'path';
+import { spawn } from 'child_process';
+import { BINARIES } from '../utils/config';
+import { logDebug, normalizeForFsWindows } from '../utils/utils';
+import { register } from './processes';
+
+/**
+ * Directory Probe – Writability and write-strategy support of a target folder
+ *
+ * `mvd-fsutil probe` answers with faccessat(AT_EACCESS) and an unnamed O_TMPFILE scratch
+ * inode (a hidden name unlinked at once where O_TMPFILE is missing; volume flags alone on
+ * Windows), so checking a folder no longer drops a visible file for sync clients and
+ * antivirus to react to. Besides writability it reports whether the filesystem can
+ * preallocate, hold sparse files, clone (reflink) and rename atomically; direct downloads
+ * of known size preallocate their output where that does not mean writing zeros. Answers
+ * are cached per directory for a few minutes.
+ */
+
+const PROBE_TTL_MS = 5 * 60 * 1000;
+const PROBE_TIMEOUT_MS = 5000;
+
+const cache = new Map(); // dir -> { expiresAt, result: Promise }
+
+function parseProbe(stdout) {
+    const fields = {};
+    for (const line of stdout.split('\n')) {
+        const separator = line.indexOf('=');
+        if (separator > 0) fields[line.slice(0, separator)] = line.slice(separator + 1).trim();
+    }
+    if (!('WRITABLE' in fields)) return null;
+    return {
+        writable: fields.WRITABLE === '1',
+        error: fields.ERROR || null,
+        fsType: fields.FSTYPE || 'unknown',
+        tmpfile: fields.TMPFILE === '1',
+        fallocate: fields.FALLOCATE === '1',
+        sparse: fields.SPARSE === '1',
+        reflink: fields.REFLINK === '1',
+        atomicRename: fields.ATOMIC_RENAME === '1'
+    };
+}
+
+function runProbe(dir) {
+    return new Promise((resolve) => {
+        const child = spawn(BINARIES.fsutil, ['probe']);
+        register(child);
+        let stdout = '';
+        const timer = setTimeout(() => child.kill('SIGKILL'), PROBE_TIMEOUT_MS);
+        child.stdout.on('data', (chunk) => { stdout += chunk.toString(); });
+        child.stdin.on('error', () => {});
+        child.on('error', (err) => {
+            clearTimeout(timer);
+            logDebug(`[DirProbe] ${dir}: ${err.message}`);
+            resolve(null);
+        });
+        child.on('close', (code) => {
+            clearTimeout(timer);
+            const result = code === 0 ? parseProbe(stdout) : null;
+            if (result) logDebug(`[DirProbe] ${dir}: ${stdout.trim().split('\n').join(' ')}`);
+            else logDebug(`[DirProbe] ${dir}: probe failed (code ${code})`);
+            resolve(result);
+        });
+        child.stdin.end(dir);
+    });
+}
+
+/**
+ * Capabilities of `dir`: { writable, error, fsType, tmpfile, fallocate, sparse, reflink,
+ * atomicRename }, or null when the helper is unavailable (callers keep their old checks).
+ * `fresh` skips the cache, for checks right after the user picked the folder.
+ */
+export function probeDirectory(dir, { fresh = false } = {}) {
+    if (!BINARIES.fsutil || !fs.existsSync(BINARIES.fsutil)) return Promise.resolve(null);
+    const key = normalizeForFsWindows(path.resolve(dir));
+    const cached = cache.get(key);
+    if (!fresh && cached && cached.expiresAt > Date.now()) return cached.result;
+
+    const result = runProbe(key);
+    cache.set(key, { expiresAt: Date.now() + PROBE_TTL_MS, result });
+    // Don't remember failures or unwritable answers; the user may fix permissions and retry
+    result.then((value) => {
+        if ((!value || !value.writable) && cache.get(key)?.result === result) cache.delete(key);
+    });
+    return result;
+}
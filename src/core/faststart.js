@@ -0,0 +1,108 @@
+import { spawn } from 'child_process';
+import fs from 'fs';
+import path from 'path';
+import { logDebug, getFullEnv, checkBinaries, normalizeForFsWindows } from '../utils/utils';
+import { register } from './processes';
+import { traceInstant, traceLabel, TraceEvent } from './trace';
+
+/**
+ * Faststart – Moves a muxed MP4's moov in front of mdat without a second full rewrite
+ *
+ * ffmpeg's `-movflags +faststart` reads the finished file back and rewrites every byte of it
+ * before the job can report. Jobs that ask for it are muxed without the flag instead, and
+ * mvd-faststart relocates the moov afterwards as a separate stage at idle CPU/disk priority:
+ * on Linux the payload is shifted with FALLOC_FL_INSERT_RANGE (no media bytes move), elsewhere
+ * it is copied in large blocks into a sibling that replaces the file. A relocation that fails
+ * leaves the file as muxed, complete and playable, only not streamable from the start.
+ */
+
+const FASTSTART_FLAG = 'faststart';
+const EXIT_STOPPED = 6;
+
+/**
+ * Args for muxing `argsBeforeOutput` without ffmpeg's faststart pass, or null when the job
+ * doesn't request faststart or the helper is missing (ffmpeg keeps doing it then)
+ */
+export function getDeferredFaststartArgs(argsBeforeOutput) {
+    const outputStart = argsBeforeOutput.lastIndexOf('-i') + 2;
+    const flagIndex = argsBeforeOutput.indexOf('-movflags', outputStart);
+    if (flagIndex < 0 || flagIndex + 1 >= argsBeforeOutput.length) return null;
+    const flags = String(argsBeforeOutput[flagIndex + 1]).split(/(?=[+-])/).filter(Boolean);
+    const kept = flags.filter(flag => flag.replace(/^[+-]/, '') !== FASTSTART_FLAG);
+    if (kept.length === flags.length || flags.some(flag => flag === `-${FASTSTART_FLAG}`)) return null;
+    try {
+        checkBinaries('faststart');
+    } catch {
+        return null;
+    }
+
+    const args = [...argsBeforeOutput];
+    if (kept.length) args.splice(flagIndex + 1, 1, kept.join(''));
+    else args.splice(flagIndex, 2);
+    return args;
+}
+
+/**
+ * Relocate filePath's moov. Progress of the copy fallback is reported as download-progress
+ * with `stage: 'faststart'`. `onStart(child)` hands out the helper so the download can be
+ * canceled meanwhile: it stops on a `q` line like ffmpeg, leaving the file as muxed.
+ * Resolves to { success, method, stopped, error }; never rejects.
+ */
+export function relocateMoov(filePath, { downloadId, traceId = 0, responder = null, startedAt = Date.now(), onStart = null } = {}) {
+    return new Promise((resolve) => {
+        const begunAt = Date.now();
+        let child;
+        try {
+            child = spawn(checkBinaries('faststart'), ['--low-priority', normalizeForFsWindows(filePath)], { env: getFullEnv() });
+        } catch (err) {
+            resolve({ success: false, error: err.message });
+            return;
+        }
+        register(child);
+        traceInstant(TraceEvent.SPAWN, traceId, traceLabel('faststart'), child.pid || 0);
+        onStart?.(child);
+
+        let stdoutBuffer = '';
+        let stderr = '';
+        let method = null;
+        child.stdout.on('data', (chunk) => {
+            stdoutBuffer += chunk.toString();
+            const lines = stdoutBuffer.split('\n');
+            stdoutBuffer = lines.pop();
+            for (const line of lines) {
+                const progress = /^PROGRESS=(\d+)\/(\d+)/.exec(line);
+                if (progress && responder) {
+                    responder.send({
+                        command: 'download-progress',
+                        downloadId,
+                        stage: 'faststart',
+                        progress: Math.min(99.999, Math.round((Number(progress[1]) / Math.max(1, Number(progress[2]))) * 100000) / 1000),
+                        elapsedTime: Math.round((Date.now() - startedAt) / 1000)
+                    });
+                } else if (line.startsWith('STATUS=')) {
+                    method = /METHOD=(\w+)/.exec(line)?.[1] || 'none';
+                }
+            }
+        });
+        child.stderr.on('data', (chunk) => { stderr += chunk.toString(); });
+        child.on('error', (err) => resolve({ success: false, error: err.message }));
+        child.on('close', (code, signal) => {
+            if (code === 0) {
+                logDebug(`[Faststart] ${downloadId}: moov relocated (${method}) in ${Date.now() - begunAt}ms`);
+                resolve({ success: true, method });
+                return;
+            }
+            if (code === EXIT_STOPPED || signal) {
+                // A helper killed mid-copy can't clean up its sibling
+                const { dir, base } = path.parse(filePath);
+                fs.rm(normalizeForFsWindows(path.join(dir, `.${base}.faststart`)), { force: true }, () => {});
+                logDebug(`[Faststart] ${downloadId}: relocation stopped, keeping the file as muxed`);
+                resolve({ success: false, stopped: true });
+                return;
+            }
+            const error = stderr.trim().split('\n').pop() || `exit code ${code}`;
+            logDebug(`[Faststart] ${downloadId}: relocation failed, keeping the file as muxed: ${error}`);
+            resolve({ success: false, error });
+        });
+    });
+}
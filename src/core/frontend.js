@@ -0,0 +1,54 @@
+import fs from 'fs';
+import path from 'path';
+import { TEMP_DIR, FRONTEND_HANDSHAKE_FILE, ALLOWED_IDS, BINARIES } from '../utils/config';
+import { logDebug, getConnectionInfo } from '../utils/utils';
+
+/**
+ * Front End – Contract with the native front end (tools/host, shipped as mvd-host)
+ *
+ * The browser manifest points at mvd-host, which answers the handshake and a few cheap
+ * commands without booting Node. It hands the connection to this engine on the first
+ * command it cannot serve: bytes it already read arrive through the file named by
+ * MVD_HANDOFF_INPUT, and MVD_HANDOFF_HANDSHAKE=1 means validateConnection was already sent.
+ * Everything the front end needs for the handshake comes from FRONTEND_HANDSHAKE_FILE,
+ * rewritten on every messaging boot, so capabilities and versions are never duplicated.
+ */
+
+export function takeFrontEndHandoff() {
+    const inputPath = process.env.MVD_HANDOFF_INPUT;
+    const handshakeSent = process.env.MVD_HANDOFF_HANDSHAKE === '1';
+    // Not for ffmpeg and the helpers, which inherit the environment
+    delete process.env.MVD_HANDOFF_INPUT;
+    delete process.env.MVD_HANDOFF_HANDSHAKE;
+
+    let input = null;
+    if (inputPath && path.dirname(inputPath) === TEMP_DIR && path.basename(inputPath).startsWith('handoff-')) {
+        try {
+            input = fs.readFileSync(inputPath);
+            fs.unlinkSync(inputPath);
+        } catch (err) {
+            logDebug('[FrontEnd] Failed to read handed-off input:', err.message);
+        }
+    }
+    if (inputPath || handshakeSent) logDebug(`[FrontEnd] Took over connection (${input ? input.length : 0} pending bytes)`);
+    return { input, handshakeSent };
+}
+
+export function writeFrontEndHandshake() {
+    // pid, lastValidation and logFileSize are filled in by the front end per connection
+    const { pid, lastValidation, logFileSize, ...info } = getConnectionInfo(); // eslint-disable-line no-unused-vars
+    const lines = [
+        `location=${process.execPath}`,
+        ...ALLOWED_IDS.map(id => `allowed=${id}`),
+        ...Object.values(BINARIES).filter(Boolean).map(binaryPath => `binary=${binaryPath}`),
+        `info=${JSON.stringify(info)}`
+    ];
+    const tempPath = `${FRONTEND_HANDSHAKE_FILE}.${process.pid}.tmp`;
+    try {
+        fs.writeFileSync(tempPath, `${lines.join('\n')}\n`);
+        fs.renameSync(tempPath, FRONTEND_HANDSHAKE_FILE);
+    } catch (err) {
+        logDebug('[FrontEnd] Failed to write handshake file:', err.message);
+        try { fs.unlinkSync(tempPath); } catch { /* ignore */ }
+    }
+}
@@ -0,0 +1,123 @@
+import { fetchText } from './segment-cache';
+import { parseHlsMasterPlaylist, parseHlsMediaPlaylist, byteRangeLength } from '../utils/playlist';
+import { logDebug, CoAppError, normalizeDownloadHeaders } from '../utils/utils';
+
+/**
+ * HLS Analyzer – Variant and rendition details for a master playlist without ffprobe
+ *
+ * The extension used to probe each variant with ffprobe to learn its resolution, codecs,
+ * duration and size. All of that is in the playlists themselves: the master carries
+ * bandwidth, resolution, codecs and rendition groups, and each media playlist gives the exact
+ * duration (sum of EXTINF) plus, when segments are byte ranges, the exact size. Media
+ * playlists are fetched concurrently over the shared keep-alive pool; sizes that cannot be
+ * computed are estimated from (AVERAGE-)BANDWIDTH × duration and flagged as such.
+ */
+
+const PLAYLIST_CONCURRENCY = 6;
+
+async function mapLimited(items, limit, worker) {
+    const results = new Array(items.length);
+    let next = 0;
+    const run = async () => {
+        while (next < items.length) {
+            const index = next++;
+            results[index] = await worker(items[index]);
+        }
+    };
+    await Promise.all(Array.from({ length: Math.min(limit, items.length) }, run));
+    return results;
+}
+
+/**
+ * Duration, segment layout and size of one media playlist. `bandwidth` (bits/s) is only
+ * used for the estimate when byte ranges don't pin the size down.
+ */
+function describeMediaPlaylist(playlist, bandwidth) {
+    const ranged = [playlist.initSection, ...playlist.segments].filter(Boolean);
+    const exact = ranged.every(part => byteRangeLength(part.range) !== null);
+    const size = exact
+        ? ranged.reduce((total, part) => total + byteRangeLength(part.range), 0)
+        : (bandwidth ? Math.round(bandwidth * playlist.duration / 8) : null);
+    return {
+        duration: playlist.duration,
+        segments: playlist.segments.length,
+        targetDuration: playlist.targetDuration,
+        mediaSequence: playlist.mediaSequence,
+        playlistType: playlist.playlistType,
+        live: !playlist.endList && playlist.playlistType !== 'VOD',
+        encryption: playlist.encryption,
+        discontinuities: playlist.discontinuities,
+        initSection: Boolean(playlist.initSection),
+        size,
+        sizeExact: exact
+    };
+}
+
+async function analyzeMediaUrl(url, headers, bandwidth) {
+    try {
+        const { url: finalUrl, content } = await fetchText(url, headers);
+        const playlist = parseHlsMediaPlaylist(content, finalUrl);
+        if (!playlist) return { error: 'Not a media playlist' };
+        return describeMediaPlaylist(playlist, bandwidth);
+    } catch (err) {
+        logDebug(`[HlsAnalyzer] ${url}: ${err.message}`);
+        return { error: err.message };
+    }
+}
+
+/**
+ * analyze-hls: { url, content?, headers?, mediaPlaylists? }
+ * `content` is the already-fetched playlist text (`url` is then only its base);
+ * `mediaPlaylists: false` stops at the master.
+ */
+export async function handleAnalyzeHls(params) {
+    const { url, content, mediaPlaylists = true } = params;
+    const headers = normalizeDownloadHeaders(params.headers) || {};
+
+    let baseUrl = url;
+    let text = content;
+    if (typeof text !== 'string') {
+        try {
+            ({ url: baseUrl, content: text } = await fetchText(url, headers));
+        } catch (err) {
+            throw new CoAppError(`Failed to fetch playlist: ${err.message}`, 'EIO');
+        }
+    }
+
+    const master = parseHlsMasterPlaylist(text, baseUrl);
+    if (!master) {
+        const playlist = parseHlsMediaPlaylist(text, baseUrl);
+        if (!playlist) throw new CoAppError('Not an HLS playlist', 'EINVAL');
+        return { success: true, type: 'media', url: baseUrl, ...describeMediaPlaylist(playlist, 0) };
+    }
+
+    // Each playlist once, even when several variants or renditions share it
+    const details = new Map();
+    if (mediaPlaylists) {
+        const bandwidths = new Map();
+        for (const variant of master.variants) {
+            bandwidths.set(variant.url, Math.max(bandwidths.get(variant.url) || 0, variant.averageBandwidth || variant.bandwidth));
+        }
+        for (const rendition of master.media) {
+            if (rendition.url && !bandwidths.has(rendition.url)) bandwidths.set(rendition.url, 0);
+        }
+        const urls = [...bandwidths.keys()];
+        const results = await mapLimited(urls, PLAYLIST_CONCURRENCY, playlistUrl => analyzeMediaUrl(playlistUrl, headers, bandwidths.get(playlistUrl)));
+        urls.forEach((playlistUrl, index) => details.set(playlistUrl, results[index]));
+    }
+
+    const variants = master.variants.map(variant => ({ ...variant, ...(details.get(variant.url) || {}) }));
+    const media = master.media.map(rendition => ({ ...rendition, ...(rendition.url ? details.get(rendition.url) || {} : {}) }));
+    const durations = [...variants, ...media].map(entry => entry.duration).filter(Number.isFinite);
+    logDebug(`[HlsAnalyzer] ${variants.length} variant(s), ${media.length} rendition(s), ${details.size} media playlist(s) fetched`);
+
+    return {
+        success: true,
+        type: 'master',
+        url: baseUrl,
+        duration: durations.length ? Math.max(...durations) : null,
+        variants,
+        media,
+        iFrameVariants: master.iFrameVariants
+    };
+}
@@ -1,6 +1,6 @@
 import os from 'os';
 import path from 'path';
-import { promises as fs, realpathSync } from 'fs';
+import { promises as fs, realpathSync, existsSync } from 'fs';
 import { spawn } from 'child_process';
 import { logDebug } from '../utils/utils';
 import { getLinuxModalCommand } from './linux-dialog';
@@ -168,9 +168,16 @@ async function copyFolderRecursive(src, dest) {
   }
 }
 
+// Browsers launch the native front end (mvd-host) when it ships next to the engine;
+// it answers the handshake itself and starts the engine on the first real command
+function manifestTarget(execPath) {
+  const frontEnd = path.join(path.dirname(execPath), `mvd-host${process.platform === 'win32' ? '.exe' : ''}`);
+  return existsSync(frontEnd) ? frontEnd : execPath;
+}
+
 function createManifest(browserType, customExecPath) {
   const execPath = customExecPath || realpathSync(process.execPath);
-  const base = { name: 'pro.maxvideodownloader.coapp', description: 'MAX Video Downloader CoApp', path: execPath, type: 'stdio' };
+  const base = { name: 'pro.maxvideodownloader.coapp', description: 'MAX Video Downloader CoApp', path: manifestTarget(execPath), type: 'stdio' };
   return browserType === 'firefox' 
     ? { ...base, allowed_extensions: ['max-video-downloader@rostislav.dev'] }
     : { ...base, allowed_origins: ['chrome-extension://bkblnddclhmmgjlmbofhakhhbklkcofd/', 'chrome-extension://kjinbaahkmjgkkedfdgpkkelehofieke/', 'chrome-extension://hkakpofpmdphjlkojabkfjapnhjfebdl/'] };
@@ -1,6 +1,7 @@
 import { IS_MACOS, IS_LINUX, IS_WINDOWS, APP_VERSION } from '../utils/config';
 import { install, uninstall } from './installer';
 import { getConnectionInfo } from '../utils/utils';
+import { setTraceFlag } from './trace';
 
 export function showUsage() {
     console.log('MVD CoApp - MAX Video Downloader Native Messaging Host');
@@ -9,6 +10,7 @@ export function showUsage() {
     console.log('  mvdcoapp -h, --help        Show this help message');
     console.log('  mvdcoapp -v, --version     Show version information');
     console.log('  mvdcoapp --info            Show system info');
+    console.log('  mvdcoapp --trace on|off    Record hot-path timing traces for new sessions');
     
     if (IS_WINDOWS) {
         console.log('\nOn Windows, CoApp is managed by the Installer/Uninstaller.');
@@ -48,6 +50,16 @@ export function handleCliArgs(args) {
         console.log(JSON.stringify(getConnectionInfo(), null, 2));
         process.exit(0);
     }
+    if (arg === '--trace') {
+        const state = args[1];
+        if (state !== 'on' && state !== 'off') {
+            console.log('Usage: mvdcoapp --trace on|off');
+            process.exit(1);
+        }
+        setTraceFlag(state === 'on');
+        console.log(`Tracing ${state === 'on' ? 'enabled' : 'disabled'} for new sessions`);
+        process.exit(0);
+    }
     if (arg === '-i' || arg === '--install' || arg === '-u' || arg === '--uninstall') {
         if (IS_WINDOWS) {
             console.log('\n[Error] On Windows, CoApp is managed by the official Installer/Uninstaller.');
@@ -1,10 +1,16 @@
-import { spawnSync } from 'child_process';
+import { spawn, spawnSync } from 'child_process';
 import fs from 'fs';
 import path from 'path';
 import os from 'os';
 import { logDebug, CoAppError } from '../utils/utils';
+import { BINARIES } from '../utils/config';
+import { register } from './processes';
 import { pathToFileURL, fileURLToPath } from 'url';
 
+// mvd-fileui exit codes on Linux
+const FILEUI_CANCELLED = 1;
+const FILEUI_UNAVAILABLE = 2;
+
 let sessionBus = null;
 
 function getSessionBus() {
@@ -93,6 +99,40 @@ async function tryPortalDialog(type, options) {
     }
 }
 
+// The FileChooser portal through mvd-fileui (libdbus in C++): the dialog is up in
+// milliseconds instead of after loading dbus-next. { missing: true } when the helper isn't
+// installed, { unavailable: true } when no portal answered.
+function tryNativePortalDialog(type, options) {
+    if (!BINARIES.fileui || !fs.existsSync(BINARIES.fileui)) return Promise.resolve({ missing: true });
+
+    const seedPath = (options.defaultPath && fs.existsSync(options.defaultPath)) ? options.defaultPath : resolveDownloads();
+    const args = ['--mode', type === 'directory' ? 'pick-folder' : 'save-file',
+        '--title', options.title || (type === 'directory' ? 'Choose Directory' : 'Save As'),
+        '--initial', seedPath];
+    if (type !== 'directory' && options.defaultName) args.push('--name', options.defaultName);
+
+    return new Promise((resolve) => {
+        const child = spawn(BINARIES.fileui, args);
+        register(child);
+        let stdout = '';
+        let stderr = '';
+        child.stdout.on('data', (chunk) => { stdout += chunk.toString(); });
+        child.stderr.on('data', (chunk) => { stderr += chunk.toString(); });
+        child.on('error', (err) => {
+            logDebug('Native portal dialog failed:', err.message);
+            resolve({ missing: true });
+        });
+        child.on('close', (code) => {
+            if (code === 0 && stdout) resolve({ path: stdout });
+            else if (code === FILEUI_CANCELLED) resolve({ cancelled: true });
+            else {
+                logDebug(`Native portal dialog unavailable (code ${code}): ${stderr.trim()}`);
+                resolve(code === FILEUI_UNAVAILABLE ? { unavailable: true } : { missing: true });
+            }
+        });
+    });
+}
+
 let cachedTool = null;
 
 function pickDirectTool() {
@@ -163,7 +203,12 @@ function runDirectTool(tool, type, options) {
 
 export async function getLinuxDialog(type, title, defaultPath, defaultName) {
     const options = { title, defaultPath, defaultName };
-    const portalResult = await tryPortalDialog(type, options);
+    const nativeResult = await tryNativePortalDialog(type, options);
+    if (nativeResult.path) return { cmd: 'echo', args: [nativeResult.path] };
+    if (nativeResult.cancelled) throw new CoAppError('Dialog cancelled', 'USER_CANCELLED');
+
+    // When the helper found no portal, dbus-next won't either
+    const portalResult = nativeResult.unavailable ? { failed: true } : await tryPortalDialog(type, options);
     if (portalResult.path) return { cmd: 'echo', args: [portalResult.path] };
     if (portalResult.cancelled) throw new CoAppError('Dialog cancelled', 'USER_CANCELLED');
 
@@ -0,0 +1,515 @@
+import http from 'http';
+import fs from 'fs';
+import path from 'path';
+import { logDebug } from '../utils/utils';
+import { parseByteRange } from '../utils/playlist';
+import { fetchSegment, fetchText, originGet } from './segment-cache';
+
+/**
+ * Loopback – One shared 127.0.0.1 server that fronts every staged ffmpeg job
+ *
+ * Each job opens a session with its own route table. Inline manifests are served as-is;
+ * with proxying enabled, segment, variant playlist, key and DASH BaseURL requests are
+ * rewritten to loopback routes that fetch from the origin with the job's headers through
+ * the shared keep-alive pool. Sessions opened with `cache` read segments through the
+ * on-disk segment cache; the others (jobs proxied only so a bandwidth limit can reach
+ * them) stream segments straight from the origin. The server closes once the last session
+ * is released.
+ */
+
+const LOOPBACK_HOST = '127.0.0.1';
+const MAX_REDIRECTS = 5;
+const PASSTHROUGH_HEADERS = ['content-type', 'content-length', 'content-range', 'accept-ranges', 'last-modified', 'etag'];
+
+const sessions = new Map(); // id -> session
+let serverState = null; // { server, port } once listening
+let serverPromise = null;
+let nextSessionId = 1;
+
+function resolveHttpUri(uri, baseUrl) {
+    try {
+        const absolute = new URL(uri, baseUrl || undefined);
+        return (absolute.protocol === 'http:' || absolute.protocol === 'https:') ? absolute.toString() : null;
+    } catch {
+        return null;
+    }
+}
+
+function keepExtension(url, fallback = '') {
+    let extension = '';
+    try {
+        extension = path.extname(new URL(url).pathname);
+    } catch { /* ignore */ }
+    // ffmpeg's HLS demuxer checks segment extensions, so keep the original one
+    return /^\.[A-Za-z0-9]{1,5}$/.test(extension) ? extension : fallback;
+}
+
+/**
+ * Point the URIs of an HLS playlist at loopback routes.
+ * Media playlists: segments and init sections (byte ranges become part of the cached
+ * resource, so their tags are dropped) and key URIs. Master playlists: variant and
+ * rendition playlists, which are fetched and rewritten the same way when requested.
+ * URIs that do not resolve to http(s) are left untouched.
+ */
+export function rewriteHlsPlaylist(content, baseUrl, routes) {
+    const nextOffsets = new Map();
+    const isMedia = content.includes('#EXTINF');
+    const out = [];
+    let pendingRange = null;
+
+    const rewriteUriAttribute = (line, register) => line.replace(/URI="([^"]+)"/, (match, uri) => {
+        const absolute = resolveHttpUri(uri, baseUrl);
+        return absolute ? `URI="${register(absolute)}"` : match;
+    });
+
+    for (const line of content.split(/\r?\n/)) {
+        const trimmed = line.trim();
+
+        if (trimmed.startsWith('#EXT-X-BYTERANGE:')) {
+            pendingRange = { line, spec: trimmed.slice('#EXT-X-BYTERANGE:'.length) };
+            continue;
+        }
+
+        if (trimmed.startsWith('#EXT-X-MAP:')) {
+            const uriMatch = /URI="([^"]+)"/.exec(trimmed);
+            const absolute = uriMatch ? resolveHttpUri(uriMatch[1], baseUrl) : null;
+            if (!absolute) {
+                out.push(line);
+                continue;
+            }
+            const rangeMatch = /BYTERANGE="([^"]+)"/.exec(trimmed);
+            const range = rangeMatch ? parseByteRange(rangeMatch[1], nextOffsets, absolute) : null;
+            const attrs = trimmed.slice('#EXT-X-MAP:'.length)
+                .replace(/,?BYTERANGE="[^"]*"/, '')
+                .replace(/URI="[^"]+"/, `URI="${routes.segment(absolute, range)}"`)
+                .replace(/^,/, '');
+            out.push(`#EXT-X-MAP:${attrs}`);
+            continue;
+        }
+
+        if (trimmed.startsWith('#EXT-X-KEY:') || trimmed.startsWith('#EXT-X-SESSION-KEY:')) {
+            out.push(rewriteUriAttribute(line, routes.key));
+            continue;
+        }
+
+        if (trimmed.startsWith('#EXT-X-MEDIA:') || trimmed.startsWith('#EXT-X-I-FRAME-STREAM-INF:')) {
+            out.push(rewriteUriAttribute(line, routes.playlist));
+            continue;
+        }
+
+        if (!trimmed || trimmed.startsWith('#')) {
+            out.push(line);
+            continue;
+        }
+
+        const absolute = resolveHttpUri(trimmed, baseUrl);
+        if (!absolute) {
+            if (pendingRange) out.push(pendingRange.line);
+            out.push(line);
+            pendingRange = null;
+            continue;
+        }
+
+        if (!isMedia) {
+            out.push(routes.playlist(absolute));
+            continue;
+        }
+
+        const range = pendingRange ? parseByteRange(pendingRange.spec, nextOffsets, absolute) : null;
+        pendingRange = null;
+        out.push(routes.segment(absolute, range));
+    }
+
+    return out.join('\n');
+}
+
+/**
+ * Route a DASH manifest through the origin proxy. Absolute URLs in BaseURL elements and
+ * segment URL attributes are mapped onto `origin-<n>/` prefixes; the MPD-level base (the
+ * manifest URL itself when none is given) is made absolute first, so every relative
+ * SegmentTemplate/SegmentList URL ffmpeg builds resolves to the loopback server.
+ */
+export function rewriteDashManifest(content, baseUrl, routes) {
+    const periodIndex = content.search(/<(?:\w+:)?Period[\s>]/);
+    const mpdLevelEnd = periodIndex >= 0 ? periodIndex : content.length;
+    let hasMpdBase = false;
+
+    let rewritten = content.replace(/(<(?:\w+:)?BaseURL(?:\s[^>]*)?>)([^<]*)(<\/(?:\w+:)?BaseURL>)/g, (match, open, text, close, offset) => {
+        const isMpdLevel = offset < mpdLevelEnd;
+        if (isMpdLevel) hasMpdBase = true;
+        const trimmed = text.trim();
+        const absolute = /^https?:\/\//i.test(trimmed) ? trimmed : (isMpdLevel ? resolveHttpUri(trimmed, baseUrl) : null);
+        return absolute ? `${open}${routes.origin(absolute)}${close}` : match;
+    });
+
+    rewritten = rewritten.replace(/\s(media|initialization|sourceURL|index)="(https?:\/\/[^"]+)"/gi,
+        (match, name, url) => ` ${name}="${routes.origin(url)}"`);
+
+    const manifestBase = resolveHttpUri('.', baseUrl);
+    if (!hasMpdBase && manifestBase) {
+        rewritten = rewritten.replace(/(<(?:\w+:)?MPD(?:\s[^>]*)?>)/, `$1<BaseURL>${routes.origin(manifestBase)}</BaseURL>`);
+    }
+    return rewritten;
+}
+
+function sendStatus(res, status, headers = {}) {
+    if (res.headersSent) {
+        res.destroy();
+        return;
+    }
+    res.writeHead(status, headers);
+    res.end();
+}
+
+/**
+ * Forward a request to the origin without caching (keys, open-ended ranges).
+ * Redirects are followed here so ffmpeg never leaves the loopback server. With a `window`
+ * (see segmentWindow) the origin's byte range is reported relative to the segment.
+ */
+function proxyPassthrough(url, range, req, res, session, { window = null, redirectCount = 0 } = {}) {
+    const requestHeaders = { ...(session.headers || {}) };
+    if (range) requestHeaders.Range = range;
+
+    let upstream;
+    try {
+        upstream = originGet(url, requestHeaders, (response) => {
+            const status = response.statusCode || 502;
+            if ([301, 302, 303, 307, 308].includes(status) && response.headers.location && redirectCount < MAX_REDIRECTS) {
+                response.resume();
+                proxyPassthrough(new URL(response.headers.location, url).toString(), range, req, res, session, { window, redirectCount: redirectCount + 1 });
+                return;
+            }
+            const forwarded = { 'Cache-Control': 'no-store' };
+            for (const name of PASSTHROUGH_HEADERS) {
+                if (response.headers[name] !== undefined) forwarded[name] = response.headers[name];
+            }
+            let servedStatus = status;
+            if (window && status === 206) {
+                const origin = /^bytes (\d+)-(\d+)\//.exec(response.headers['content-range'] || '');
+                delete forwarded['content-range'];
+                if (!window.partial) servedStatus = 200;
+                else if (origin) forwarded['content-range'] = `bytes ${Number(origin[1]) - window.start}-${Number(origin[2]) - window.start}/${window.length}`;
+            } else if (window && status === 200) {
+                // The origin ignored the range; the segment can't be cut out of it here
+                response.resume();
+                sendStatus(res, 502);
+                return;
+            }
+            res.writeHead(servedStatus, forwarded);
+            if (req.method === 'HEAD') {
+                response.resume();
+                res.end();
+                return;
+            }
+            response.on('error', () => res.destroy());
+            (session.shaper ? response.pipe(session.shaper.createThrottle()) : response).pipe(res);
+        });
+    } catch {
+        sendStatus(res, 400);
+        return;
+    }
+    upstream.on('error', (err) => {
+        logDebug(`[Loopback] Origin request failed (${err.message}): ${url}`);
+        sendStatus(res, 502);
+    });
+    // Only abort when ffmpeg hung up early; a finished exchange returns the socket to the pool
+    res.on('close', () => { if (!res.writableEnded) upstream.destroy(); });
+}
+
+/**
+ * Origin range for a request against a byte-range segment (`bytes=a-b`), plus the window
+ * proxyPassthrough needs to answer it relative to the segment; null when it can't be met
+ */
+function segmentWindow(segmentRange, requestRange) {
+    const outer = /^bytes=(\d+)-(\d+)$/.exec(segmentRange || '');
+    if (!outer) return null;
+    const start = Number(outer[1]);
+    const last = Number(outer[2]);
+    const length = last - start + 1;
+    const inner = /^bytes=(\d*)-(\d*)$/.exec(requestRange || '');
+    if (!inner || (!inner[1] && !inner[2])) return { range: segmentRange, window: { start, length, partial: false } };
+
+    let from = inner[1] ? Number(inner[1]) : Math.max(0, length - Number(inner[2]));
+    let to = inner[1] && inner[2] ? Math.min(length - 1, Number(inner[2])) : length - 1;
+    if (from > to) return null;
+    return { range: `bytes=${start + from}-${start + to}`, window: { start, length, partial: true } };
+}
+
+// Stream a segment from the origin, without the disk cache
+function proxySegment(segment, req, res, session) {
+    if (!segment.range) {
+        proxyPassthrough(segment.url, req.headers.range, req, res, session);
+        return;
+    }
+    const target = segmentWindow(segment.range, req.headers.range);
+    if (!target) {
+        sendStatus(res, 416);
+        return;
+    }
+    proxyPassthrough(segment.url, target.range, req, res, session, { window: target.window });
+}
+
+async function serveCachedSegment(segment, req, res, session) {
+    if (!session.cache) {
+        proxySegment(segment, req, res, session);
+        return;
+    }
+    let cached;
+    try {
+        cached = await fetchSegment(segment.url, { range: segment.range, headers: session.headers, shaper: session.shaper });
+    } catch (err) {
+        logDebug(`[Loopback] Segment cache fetch failed (${err.message}): ${segment.url}`);
+        // Serve it uncached rather than failing the job
+        proxySegment(segment, req, res, session);
+        return;
+    }
+
+    let start = 0;
+    let end = cached.size - 1;
+    let status = 200;
+    const rangeMatch = /^bytes=(\d*)-(\d*)$/.exec(req.headers.range || '');
+    if (rangeMatch && cached.size > 0 && (rangeMatch[1] || rangeMatch[2])) {
+        if (rangeMatch[1]) {
+            start = Number(rangeMatch[1]);
+            if (rangeMatch[2]) end = Math.min(end, Number(rangeMatch[2]));
+        } else {
+            start = Math.max(0, cached.size - Number(rangeMatch[2]));
+        }
+        if (start > end) {
+            sendStatus(res, 416, { 'Content-Range': `bytes */${cached.size}` });
+            return;
+        }
+        status = 206;
+    }
+
+    res.writeHead(status, {
+        'Content-Type': 'application/octet-stream',
+        'Content-Length': Math.max(0, end - start + 1),
+        'Accept-Ranges': 'bytes',
+        'Cache-Control': 'no-store',
+        ...(status === 206 ? { 'Content-Range': `bytes ${start}-${end}/${cached.size}` } : {})
+    });
+
+    if (req.method === 'HEAD' || cached.size === 0) {
+        res.end();
+        return;
+    }
+
+    fs.createReadStream(cached.path, { start, end })
+        .on('error', () => res.destroy())
+        .pipe(res);
+}
+
+// DASH SegmentBase requests closed byte ranges of one file; each range is cached on its own
+async function serveOriginRequest(url, req, res, session) {
+    const rangeMatch = /^bytes=(\d+)-(\d+)$/.exec(req.headers.range || '');
+    if (!session.cache || (req.headers.range && !rangeMatch)) {
+        proxyPassthrough(url, req.headers.range, req, res, session);
+        return;
+    }
+    if (!rangeMatch) {
+        await serveCachedSegment({ url, range: null }, req, res, session);
+        return;
+    }
+
+    let cached;
+    try {
+        cached = await fetchSegment(url, { range: req.headers.range, headers: session.headers, shaper: session.shaper });
+    } catch (err) {
+        logDebug(`[Loopback] Ranged fetch failed (${err.message}), passing through: ${url}`);
+        proxyPassthrough(url, req.headers.range, req, res, session);
+        return;
+    }
+    const start = Number(rangeMatch[1]);
+    res.writeHead(206, {
+        'Content-Type': 'application/octet-stream',
+        'Content-Length': cached.size,
+        'Content-Range': `bytes ${start}-${start + cached.size - 1}/*`,
+        'Cache-Control': 'no-store'
+    });
+    if (req.method === 'HEAD' || cached.size === 0) {
+        res.end();
+        return;
+    }
+    fs.createReadStream(cached.path)
+        .on('error', () => res.destroy())
+        .pipe(res);
+}
+
+async function serveProxiedPlaylist(session, url, req, res) {
+    let playlist;
+    try {
+        playlist = await fetchText(url, session.headers);
+    } catch (err) {
+        logDebug(`[Loopback] Playlist fetch failed (${err.message}): ${url}`);
+        sendStatus(res, 502);
+        return;
+    }
+    const content = rewriteHlsPlaylist(playlist.content, playlist.url, session.routes);
+    res.writeHead(200, {
+        'Content-Type': 'application/vnd.apple.mpegurl',
+        'Content-Length': Buffer.byteLength(content, 'utf8'),
+        'Cache-Control': 'no-store'
+    });
+    res.end(req.method === 'HEAD' ? undefined : content);
+}
+
+function handleRequest(req, res) {
+    let requestUrl;
+    try {
+        requestUrl = new URL(req.url || '/', `http://${LOOPBACK_HOST}`);
+    } catch {
+        sendStatus(res, 400);
+        return;
+    }
+
+    const match = /^\/s(\d+)(\/.*)$/.exec(requestUrl.pathname);
+    const session = match ? sessions.get(Number(match[1])) : null;
+    if (!session || (req.method !== 'GET' && req.method !== 'HEAD')) {
+        sendStatus(res, 404);
+        return;
+    }
+    const routePath = match[2];
+
+    const manifest = session.manifests.get(routePath);
+    if (manifest) {
+        res.writeHead(200, {
+            'Content-Type': manifest.mimeType,
+            'Content-Length': manifest.byteLength,
+            'Cache-Control': 'no-store'
+        });
+        res.end(req.method === 'HEAD' ? undefined : manifest.content);
+        return;
+    }
+
+    const target = session.targets.get(routePath);
+    if (target?.kind === 'segment') {
+        void serveCachedSegment(target, req, res, session);
+        return;
+    }
+    if (target?.kind === 'playlist') {
+        void serveProxiedPlaylist(session, target.url, req, res);
+        return;
+    }
+    if (target?.kind === 'key') {
+        proxyPassthrough(target.url, req.headers.range, req, res, session);
+        return;
+    }
+
+    const originMatch = /^\/origin-(\d+)\/(.*)$/.exec(routePath);
+    const origin = originMatch ? session.origins[Number(originMatch[1])] : null;
+    if (origin) {
+        void serveOriginRequest(`${origin}/${originMatch[2]}${requestUrl.search}`, req, res, session);
+        return;
+    }
+
+    sendStatus(res, 404);
+}
+
+function acquireServer() {
+    if (serverPromise) return serverPromise;
+    serverPromise = new Promise((resolve, reject) => {
+        const server = http.createServer(handleRequest);
+        // ffmpeg keeps its HLS/DASH connections persistent; let it reuse them
+        server.keepAliveTimeout = 5000;
+        server.headersTimeout = 6000;
+
+        server.once('error', reject);
+        server.listen(0, LOOPBACK_HOST, () => {
+            server.removeListener('error', reject);
+            const address = server.address();
+            if (!address || typeof address === 'string') {
+                server.close(() => reject(new Error('Failed to resolve manifest loopback port')));
+                return;
+            }
+            serverState = { server, port: address.port };
+            logDebug(`[Loopback] Listening on ${LOOPBACK_HOST}:${address.port}`);
+            resolve(serverState);
+        });
+    });
+    serverPromise.catch(() => { serverPromise = null; });
+    return serverPromise;
+}
+
+async function releaseServer() {
+    if (sessions.size > 0 || !serverState) return;
+    const { server } = serverState;
+    serverState = null;
+    serverPromise = null;
+    server.closeAllConnections?.();
+    await new Promise(resolve => server.close(() => resolve()));
+    logDebug('[Loopback] Closed');
+}
+
+/**
+ * Open a loopback session for one job. `headers` are injected into every origin request,
+ * whose bytes are charged to the `shaper` bandwidth job; `proxy` enables URI rewriting
+ * in addManifest (otherwise manifests are served verbatim) and `cache` routes the proxied
+ * segments through the on-disk segment cache.
+ */
+export async function openLoopbackSession({ headers = null, shaper = null, proxy = false, cache = false } = {}) {
+    let port = 0;
+    // The last session may have closed the server while this one waited for it
+    while (!port || serverState?.port !== port) ({ port } = await acquireServer());
+    const id = nextSessionId++;
+    const prefix = `http://${LOOPBACK_HOST}:${port}/s${id}`;
+    const targetsByKey = new Map();
+
+    const session = {
+        id,
+        headers,
+        shaper,
+        cache,
+        manifests: new Map(),
+        targets: new Map(),
+        origins: [],
+        segmentCount: 0
+    };
+
+    // Live playlists are refetched and re-rewritten, so identical URIs map to one stable route
+    const registerTarget = (kind, url, range, extension) => {
+        const key = `${kind}\n${url}\n${range || ''}`;
+        let routePath = targetsByKey.get(key);
+        if (!routePath) {
+            routePath = `/${kind}-${session.targets.size}${extension}`;
+            targetsByKey.set(key, routePath);
+            session.targets.set(routePath, { kind, url, range });
+            if (kind === 'segment') session.segmentCount += 1;
+        }
+        return `${prefix}${routePath}`;
+    };
+
+    session.routes = {
+        segment: (url, range) => registerTarget('segment', url, range, keepExtension(url)),
+        playlist: (url) => registerTarget('playlist', url, null, '.m3u8'),
+        key: (url) => registerTarget('key', url, null, ''),
+        origin: (url) => {
+            const parsed = new URL(url);
+            let index = session.origins.indexOf(parsed.origin);
+            if (index < 0) index = session.origins.push(parsed.origin) - 1;
+            return `${prefix}/origin-${index}${parsed.pathname}${parsed.search}`;
+        }
+    };
+
+    session.addManifest = (content, { format, mimeType, baseUrl }) => {
+        let served = content;
+        if (proxy && format === 'hls') served = rewriteHlsPlaylist(content, baseUrl, session.routes);
+        else if (proxy && format === 'dash') served = rewriteDashManifest(content, baseUrl, session.routes);
+
+        const routePath = `/manifest-${session.manifests.size}.${format === 'dash' ? 'mpd' : 'm3u8'}`;
+        session.manifests.set(routePath, {
+            mimeType,
+            content: served,
+            byteLength: Buffer.byteLength(served, 'utf8')
+        });
+        return `${prefix}${routePath}`;
+    };
+
+    session.close = async () => {
+        if (!sessions.delete(id)) return;
+        await releaseServer();
+    };
+
+    sessions.set(id, session);
+    return session;
+}
@@ -0,0 +1,156 @@
+import fs from 'fs';
+import crypto from 'crypto';
+import { PROBE_CACHE_FILE, PROBE_CACHE_MAX_BYTES, PROBE_CACHE_TTL_MS } from '../utils/config';
+import { logDebug, normalizeDownloadHeaders } from '../utils/utils';
+
+/**
+ * Probe Cache – Persistent ffprobe results keyed by arguments, headers and inline inputs
+ *
+ * The extension probes every detected stream and variant again after each page reload,
+ * usually from a freshly started host. Results live in one append-only file under
+ * TEMP_DIR, one record per line:
+ *   <sha256 key>\t<expiresAt ms>\t<result JSON>
+ * Loading indexes the file without parsing any JSON (key -> byte range of the buffer), so a
+ * hit costs a Map lookup plus one JSON.parse. Concurrent hosts append with O_APPEND and pick
+ * up each other's records on a miss by reading whatever the file grew by. Past
+ * PROBE_CACHE_MAX_BYTES the file is rewritten with the newest live half of the records.
+ */
+
+const KEY_LENGTH = 64;
+const NEWLINE = 0x0A;
+
+let buffer = Buffer.alloc(0); // file bytes read so far (complete records only)
+let fileId = null; // dev:ino of the file buffer was read from
+const entries = new Map(); // key -> { expiresAt, start, end } | { expiresAt, json }, oldest write first
+let loaded = false;
+
+export function probeCacheKey({ tool, args, headers, inlineInputs }) {
+    const inputs = Array.isArray(inlineInputs)
+        ? inlineInputs.map(input => [input.token, input.format, input.baseUrl, input.content])
+        : null;
+    return crypto.createHash('sha256')
+        .update(JSON.stringify([tool, args, normalizeDownloadHeaders(headers) || null, inputs]))
+        .digest('hex');
+}
+
+// Index records in chunk, which starts at buffer offset `base`; returns bytes consumed
+function indexRecords(chunk, base) {
+    let lineStart = 0;
+    for (let newline = chunk.indexOf(NEWLINE); newline !== -1; newline = chunk.indexOf(NEWLINE, lineStart)) {
+        const keyEnd = lineStart + KEY_LENGTH;
+        const expiresEnd = chunk.indexOf(0x09, keyEnd + 1);
+        if (chunk[keyEnd] === 0x09 && expiresEnd !== -1 && expiresEnd < newline) {
+            const key = chunk.toString('latin1', lineStart, keyEnd);
+            const expiresAt = Number(chunk.toString('latin1', keyEnd + 1, expiresEnd));
+            entries.delete(key);
+            if (expiresAt > Date.now()) entries.set(key, { expiresAt, start: base + expiresEnd + 1, end: base + newline });
+        }
+        lineStart = newline + 1;
+    }
+    return lineStart;
+}
+
+// Read whatever the file grew by since the last call (our own appends included)
+function readNewRecords() {
+    let fd = null;
+    try {
+        fd = fs.openSync(PROBE_CACHE_FILE, 'r');
+        const stats = fs.fstatSync(fd);
+        const size = stats.size;
+        const id = `${stats.dev}:${stats.ino}`;
+        if (id !== fileId || size < buffer.length) {
+            // Replaced by a compaction (ours or another host's); start over
+            fileId = id;
+            buffer = Buffer.alloc(0);
+            entries.clear();
+        }
+        if (size === buffer.length) return;
+        const chunk = Buffer.alloc(size - buffer.length);
+        const got = fs.readSync(fd, chunk, 0, chunk.length, buffer.length);
+        const consumed = indexRecords(chunk.subarray(0, got), buffer.length);
+        buffer = Buffer.concat([buffer, chunk.subarray(0, consumed)]);
+    } catch (err) {
+        if (err.code !== 'ENOENT') logDebug('[ProbeCache] Failed to read cache:', err.message);
+    } finally {
+        if (fd !== null) fs.closeSync(fd);
+    }
+}
+
+function readEntry(entry) {
+    return entry.json ?? buffer.toString('utf8', entry.start, entry.end);
+}
+
+/**
+ * Return the cached result for key, or null. Misses re-check the file for records
+ * written by other hosts before giving up.
+ */
+export function lookupProbe(key) {
+    if (!loaded) {
+        loaded = true;
+        readNewRecords();
+    }
+    let entry = entries.get(key);
+    if (!entry) {
+        readNewRecords();
+        entry = entries.get(key);
+    }
+    if (!entry) return null;
+    if (entry.expiresAt <= Date.now()) {
+        entries.delete(key);
+        return null;
+    }
+    try {
+        return JSON.parse(readEntry(entry));
+    } catch {
+        entries.delete(key);
+        return null;
+    }
+}
+
+function compact() {
+    const now = Date.now();
+    const live = [...entries.entries()].filter(([, entry]) => entry.expiresAt > now);
+    const lines = [];
+    let bytes = 0;
+    for (let index = live.length - 1; index >= 0; index -= 1) {
+        const [key, entry] = live[index];
+        const line = `${key}\t${entry.expiresAt}\t${readEntry(entry)}\n`;
+        bytes += Buffer.byteLength(line);
+        if (bytes > PROBE_CACHE_MAX_BYTES / 2) break;
+        lines.unshift(line);
+    }
+
+    const tempPath = `${PROBE_CACHE_FILE}.${process.pid}.tmp`;
+    try {
+        fs.writeFileSync(tempPath, lines.join(''));
+        fs.renameSync(tempPath, PROBE_CACHE_FILE);
+    } catch (err) {
+        logDebug('[ProbeCache] Compaction failed:', err.message);
+        try { fs.unlinkSync(tempPath); } catch { /* ignore */ }
+        return;
+    }
+    buffer = Buffer.alloc(0);
+    entries.clear();
+    readNewRecords();
+    logDebug(`[ProbeCache] Compacted to ${entries.size} of ${live.length} live records`);
+}
+
+/**
+ * Remember a successful probe result. The record is appended in a single write, which
+ * O_APPEND keeps intact next to other hosts' appends.
+ */
+export function storeProbe(key, result) {
+    const expiresAt = Date.now() + PROBE_CACHE_TTL_MS;
+    const json = JSON.stringify(result);
+    entries.delete(key);
+    entries.set(key, { expiresAt, json });
+    try {
+        fs.appendFileSync(PROBE_CACHE_FILE, `${key}\t${expiresAt}\t${json}\n`);
+        if (fs.statSync(PROBE_CACHE_FILE).size > PROBE_CACHE_MAX_BYTES) {
+            readNewRecords();
+            compact();
+        }
+    } catch (err) {
+        logDebug('[ProbeCache] Failed to store result:', err.message);
+    }
+}
@@ -0,0 +1,562 @@
+import fs from 'fs';
+import path from 'path';
+import { Writable } from 'stream';
+import { logDebug, getFreeDiskSpace, normalizeForFsWindows } from '../utils/utils';
+import { IS_WINDOWS, LIVE_PART_MAX_BYTES, LIVE_PART_MAX_SECONDS, LIVE_PART_SYNC_MS } from '../utils/config';
+
+/**
+ * Segmented Recorder – Crash-safe live recordings split into self-contained parts
+ *
+ * ffmpeg streams a fragmented container to stdout (MPEG-TS, or fragmented MP4 with an empty
+ * moov) and the recorder finds the fragment boundaries in the byte stream: for TS the PAT in
+ * front of a video keyframe (any random access point when there is no video), for fMP4 the
+ * first box after an mdat whose moof starts every track on a sync sample. Bytes reach disk
+ * one whole fragment at a time and are fdatasync'ed at boundaries (at most once per
+ * LIVE_PART_SYNC_MS), so a crash or power loss costs at most the fragment in flight.
+ *
+ * Parts rotate at a boundary once they reach `maxBytes` or `maxSeconds` of wall-clock time.
+ * Before the next part opens, free space is checked against the size the last part reached
+ * in that time; a recording that would not fit stops cleanly instead of dying on ENOSPC
+ * (which, if it happens anyway, truncates the part back to its last boundary).
+ *
+ * `<stem>.parts.json` lists the parts. They concatenate losslessly: TS parts byte by byte,
+ * fMP4 parts by dropping the first `initBytes` (the repeated init segment) of every part
+ * after the first. Each part also plays on its own.
+ */
+
+const TS_PACKET_SIZE = 188;
+const TS_SYNC_BYTE = 0x47;
+const PAT_LOOKBACK_PACKETS = 8; // ffmpeg writes PAT/PMT right before a keyframe's first packet
+const VIDEO_STREAM_TYPES = new Set([0x01, 0x02, 0x10, 0x1B, 0x24, 0x33, 0x42, 0xEA]);
+const FMP4_MAX_FRAGMENT_US = 10000000; // audio-only input has no keyframes to fragment at
+const MAX_INIT_BYTES = 4 * 1024 * 1024;
+const SAMPLE_IS_NON_SYNC = 0x00010000; // sample_is_non_sync_sample in fMP4 sample flags
+const FREE_SPACE_RESERVE = 64 * 1024 * 1024;
+const INDEX_VERSION = 1;
+
+const FORMATS = {
+    ts: 'mpegts',
+    mp4: 'fmp4',
+    m4a: 'fmp4',
+    m4v: 'fmp4',
+    mov: 'fmp4'
+};
+
+function positive(value) {
+    const number = Number(value);
+    return number > 0 ? number : null;
+}
+
+function formatSize(bytes) {
+    return `${(bytes / (1024 * 1024)).toFixed(1)} MB`;
+}
+
+/**
+ * Recording settings of a live download-v2 request with `segmented: true` or
+ * `segmented: { maxBytes, maxSeconds }`: { format, maxBytes, maxSeconds }, or null when the
+ * request doesn't ask for parts or its container can't be fragmented.
+ */
+export function getSegmentedRecording(request) {
+    const option = request.segmented;
+    if (!option) return null;
+    const format = FORMATS[String(request.container || '').toLowerCase()];
+    if (!format) {
+        logDebug(`[Recorder] ${request.downloadId}: container ${request.container} can't be recorded in parts`);
+        return null;
+    }
+    const settings = typeof option === 'object' ? option : {};
+    return {
+        format,
+        maxBytes: positive(settings.maxBytes) ?? LIVE_PART_MAX_BYTES,
+        maxSeconds: positive(settings.maxSeconds) ?? LIVE_PART_MAX_SECONDS
+    };
+}
+
+/**
+ * ffmpeg args that stream `format` to stdout; muxer options meant for a seekable file are
+ * replaced
+ */
+export function getSegmentedOutputArgs(argsBeforeOutput, format) {
+    const inputEnd = argsBeforeOutput.lastIndexOf('-i') + 2;
+    const outputArgs = [];
+    for (let i = inputEnd; i < argsBeforeOutput.length; i++) {
+        if (argsBeforeOutput[i] === '-f' || argsBeforeOutput[i] === '-movflags' || argsBeforeOutput[i] === '-frag_duration') {
+            i++;
+            continue;
+        }
+        outputArgs.push(argsBeforeOutput[i]);
+    }
+    const muxer = format === 'fmp4'
+        ? ['-f', 'mp4', '-movflags', '+frag_keyframe+empty_moov+default_base_moof', '-frag_duration', String(FMP4_MAX_FRAGMENT_US)]
+        : ['-f', 'mpegts'];
+    return [...argsBeforeOutput.slice(0, inputEnd), ...outputArgs, ...muxer, 'pipe:1'];
+}
+
+// --- Boundary scanners ------------------------------------------------------
+// push(chunk) returns { cuts, safe }: stream offsets where a new fragment starts, and the
+// offset below which no later cut can land (bytes past it are held back)
+
+class TsScanner {
+    constructor() {
+        this.initBytes = 0;
+        this.carry = Buffer.alloc(0);
+        this.offset = 0; // stream offset of carry[0]
+        this.packetIndex = 0;
+        this.lastPat = -1;
+        this.lastPatPacket = 0;
+        this.lastCut = 0;
+        this.pmtPids = new Set();
+        this.videoPids = new Set();
+    }
+
+    push(chunk) {
+        const buffer = this.carry.length ? Buffer.concat([this.carry, chunk]) : chunk;
+        const cuts = [];
+        let pos = 0;
+        while (pos + TS_PACKET_SIZE <= buffer.length) {
+            if (buffer[pos] !== TS_SYNC_BYTE) {
+                const next = buffer.indexOf(TS_SYNC_BYTE, pos + 1);
+                pos = next === -1 ? buffer.length : next;
+                continue;
+            }
+            const cut = this.readPacket(buffer, pos);
+            if (cut > this.lastCut) {
+                cuts.push(cut);
+                this.lastCut = cut;
+            }
+            pos += TS_PACKET_SIZE;
+            this.packetIndex++;
+        }
+        // Keep a partial packet for the next chunk
+        const consumed = Math.min(pos, buffer.length);
+        this.carry = buffer.subarray(consumed);
+        this.offset += consumed;
+
+        const patPending = this.lastPat > this.lastCut && this.packetIndex - this.lastPatPacket <= PAT_LOOKBACK_PACKETS;
+        return { cuts, safe: patPending ? this.lastPat : this.offset };
+    }
+
+    // Returns the stream offset of a cut this packet completes, or -1
+    readPacket(buffer, pos) {
+        const payloadStart = (buffer[pos + 1] & 0x40) !== 0;
+        const pid = ((buffer[pos + 1] & 0x1F) << 8) | buffer[pos + 2];
+        const adaptation = (buffer[pos + 3] >> 4) & 0x3;
+        const end = pos + TS_PACKET_SIZE;
+        const packetOffset = this.offset + pos;
+        let payload = pos + 4;
+        let randomAccess = false;
+        if (adaptation & 0x2) {
+            const length = buffer[pos + 4];
+            randomAccess = length > 0 && (buffer[pos + 5] & 0x40) !== 0;
+            payload += 1 + length;
+        }
+        const hasPayload = (adaptation & 0x1) !== 0 && payload < end;
+
+        if (pid === 0) {
+            this.lastPat = packetOffset;
+            this.lastPatPacket = this.packetIndex;
+            if (payloadStart && hasPayload) this.readPat(buffer, payload, end);
+            return -1;
+        }
+        if (this.pmtPids.has(pid)) {
+            if (payloadStart && hasPayload) this.readPmt(buffer, payload, end);
+            return -1;
+        }
+        if (!randomAccess || !payloadStart) return -1;
+        if (this.videoPids.size && !this.videoPids.has(pid)) return -1;
+        const patFresh = this.lastPat >= 0 && this.packetIndex - this.lastPatPacket <= PAT_LOOKBACK_PACKETS;
+        return patFresh ? this.lastPat : packetOffset;
+    }
+
+    // Section start after the pointer field, or -1 when it doesn't fit the packet
+    static sectionStart(buffer, payload, end) {
+        const start = payload + 1 + buffer[payload];
+        return start + 3 <= end ? start : -1;
+    }
+
+    readPat(buffer, payload, end) {
+        const start = TsScanner.sectionStart(buffer, payload, end);
+        if (start < 0) return;
+        const sectionEnd = Math.min(end, start + 3 + (((buffer[start + 1] & 0x0F) << 8) | buffer[start + 2]) - 4);
+        for (let i = start + 8; i + 4 <= sectionEnd; i += 4) {
+            const program = (buffer[i] << 8) | buffer[i + 1];
+            if (program !== 0) this.pmtPids.add(((buffer[i + 2] & 0x1F) << 8) | buffer[i + 3]);
+        }
+    }
+
+    readPmt(buffer, payload, end) {
+        const start = TsScanner.sectionStart(buffer, payload, end);
+        if (start < 0 || start + 12 > end) return;
+        const sectionEnd = Math.min(end, start + 3 + (((buffer[start + 1] & 0x0F) << 8) | buffer[start + 2]) - 4);
+        let i = start + 12 + (((buffer[start + 10] & 0x0F) << 8) | buffer[start + 11]);
+        while (i + 5 <= sectionEnd) {
+            if (VIDEO_STREAM_TYPES.has(buffer[i])) this.videoPids.add(((buffer[i + 1] & 0x1F) << 8) | buffer[i + 2]);
+            i += 5 + (((buffer[i + 3] & 0x0F) << 8) | buffer[i + 4]);
+        }
+    }
+}
+
+function* childBoxes(body, start = 0, end = body.length) {
+    let pos = start;
+    while (pos + 8 <= end) {
+        const size = body.readUInt32BE(pos);
+        const type = body.toString('latin1', pos + 4, pos + 8);
+        const boxEnd = size === 0 ? end : pos + size;
+        if (size !== 0 && size < 8) return;
+        if (boxEnd > end) return;
+        yield { type, start: pos + 8, end: boxEnd };
+        pos = boxEnd;
+    }
+}
+
+class Mp4Scanner {
+    constructor() {
+        this.initBytes = null; // known once the first moof shows up
+        this.offset = 0; // stream offset of the next byte
+        this.skip = 0; // body bytes of the current box still to pass
+        this.header = Buffer.alloc(16);
+        this.headerLength = 0;
+        this.boxStart = 0;
+        this.afterMdat = false;
+        this.body = null; // moov/moof body being collected
+        this.bodyType = null;
+        this.bodyLength = 0;
+        this.pendingCut = null; // start of a fragment whose moof hasn't been read yet
+        this.trackFlags = new Map(); // track_ID -> trex default_sample_flags
+    }
+
+    push(chunk) {
+        const cuts = [];
+        let pos = 0;
+        while (pos < chunk.length) {
+            if (this.skip > 0) {
+                const step = Math.min(this.skip, chunk.length - pos);
+                if (this.body) {
+                    chunk.copy(this.body, this.bodyLength, pos, pos + step);
+                    this.bodyLength += step;
+                }
+                this.skip -= step;
+                pos += step;
+                this.offset += step;
+                if (this.skip === 0 && this.body) this.readBody(cuts);
+                continue;
+            }
+            if (this.headerLength === 0) this.boxStart = this.offset;
+            const wanted = this.headerLength >= 8 && this.header.readUInt32BE(0) === 1 ? 16 : 8;
+            const step = Math.min(wanted - this.headerLength, chunk.length - pos);
+            chunk.copy(this.header, this.headerLength, pos, pos + step);
+            this.headerLength += step;
+            pos += step;
+            this.offset += step;
+            if (this.headerLength < 8 || (this.headerLength === 8 && this.header.readUInt32BE(0) === 1)) continue;
+            this.readBox(cuts);
+        }
+        const safe = this.headerLength ? this.boxStart : this.offset;
+        return { cuts, safe: this.pendingCut === null ? safe : Math.min(safe, this.pendingCut) };
+    }
+
+    readBox(cuts) {
+        const size32 = this.header.readUInt32BE(0);
+        const type = this.header.toString('latin1', 4, 8);
+        const size = size32 === 1 ? Number(this.header.readBigUInt64BE(8)) : size32;
+        if (type !== 'mdat' && this.afterMdat && this.pendingCut === null) this.pendingCut = this.boxStart;
+        if (type === 'moof' && this.initBytes === null) this.initBytes = this.boxStart;
+        this.afterMdat = type === 'mdat';
+        // size 0: the box runs to the end of the stream
+        this.skip = size32 === 0 ? Infinity : Math.max(0, size - this.headerLength);
+        this.headerLength = 0;
+
+        const collect = (type === 'moof' || type === 'moov') && this.skip <= MAX_INIT_BYTES;
+        if (collect) {
+            this.body = Buffer.alloc(this.skip);
+            this.bodyType = type;
+            this.bodyLength = 0;
+            if (this.skip === 0) this.readBody(cuts);
+        } else if (type === 'moof' || type === 'mdat') {
+            // A moof too big to read (or none at all): take the boundary rather than never cutting
+            this.resolveCut(cuts, true);
+        }
+    }
+
+    readBody(cuts) {
+        const body = this.body;
+        const type = this.bodyType;
+        this.body = null;
+        this.bodyType = null;
+        if (type === 'moov') this.readTrex(body);
+        else this.resolveCut(cuts, this.startsWithSync(body));
+    }
+
+    resolveCut(cuts, sync) {
+        if (this.pendingCut === null) return;
+        if (sync) cuts.push(this.pendingCut);
+        this.pendingCut = null;
+    }
+
+    readTrex(moov) {
+        for (const box of childBoxes(moov)) {
+            if (box.type !== 'mvex') continue;
+            for (const trex of childBoxes(moov, box.start, box.end)) {
+                if (trex.type !== 'trex' || trex.start + 24 > trex.end) continue;
+                this.trackFlags.set(moov.readUInt32BE(trex.start + 4), moov.readUInt32BE(trex.start + 20));
+            }
+        }
+    }
+
+    // A fragment is a clean place to start a part when every track's first sample is a sync
+    // sample (ffmpeg also flushes on -frag_duration, which can land mid-GOP)
+    startsWithSync(moof) {
+        for (const traf of childBoxes(moof)) {
+            if (traf.type !== 'traf') continue;
+            let defaultFlags = null;
+            for (const box of childBoxes(moof, traf.start, traf.end)) {
+                if (box.type === 'tfhd' && box.start + 8 <= box.end) {
+                    const flags = moof.readUInt32BE(box.start) & 0xFFFFFF;
+                    let field = box.start + 8;
+                    if (flags & 0x1) field += 8; // base_data_offset
+                    if (flags & 0x2) field += 4; // sample_description_index
+                    if (flags & 0x8) field += 4; // default_sample_duration
+                    if (flags & 0x10) field += 4; // default_sample_size
+                    defaultFlags = this.trackFlags.get(moof.readUInt32BE(box.start + 4)) ?? 0;
+                    if (flags & 0x20 && field + 4 <= box.end) defaultFlags = moof.readUInt32BE(field);
+                } else if (box.type === 'trun' && box.start + 8 <= box.end) {
+                    if (moof.readUInt32BE(box.start + 4) === 0) continue;
+                    const flags = moof.readUInt32BE(box.start) & 0xFFFFFF;
+                    let field = box.start + 8;
+                    if (flags & 0x1) field += 4; // data_offset
+                    let sampleFlags = defaultFlags ?? 0;
+                    if (flags & 0x4) {
+                        sampleFlags = moof.readUInt32BE(field);
+                    } else if (flags & 0x400) {
+                        if (flags & 0x100) field += 4; // sample_duration
+                        if (flags & 0x200) field += 4; // sample_size
+                        sampleFlags = moof.readUInt32BE(field);
+                    }
+                    if (sampleFlags & SAMPLE_IS_NON_SYNC) return false;
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+}
+
+// --- Recorder ---------------------------------------------------------------
+
+function isOutOfSpace(err) {
+    return err?.code === 'ENOSPC' || err?.code === 'EDQUOT';
+}
+
+async function writeAll(handle, buffer) {
+    let written = 0;
+    while (written < buffer.length) {
+        const { bytesWritten } = await handle.write(buffer, written, buffer.length - written);
+        written += bytesWritten;
+    }
+}
+
+// A new directory entry survives a crash only once the directory itself is synced
+async function syncDirectory(dir) {
+    if (IS_WINDOWS) return;
+    let handle = null;
+    try {
+        handle = await fs.promises.open(dir, 'r');
+        await handle.sync();
+    } catch { /* not supported by every filesystem */ } finally {
+        await handle?.close().catch(() => {});
+    }
+}
+
+// Part names derive from the final output name; pick a stem none of them collide with
+function chooseStem(finalPath) {
+    const { dir, name, ext } = path.parse(finalPath);
+    for (let attempt = 1; ; attempt++) {
+        const stem = attempt === 1 ? name : `${name} (${attempt})`;
+        const base = path.join(dir, stem);
+        if (!fs.existsSync(normalizeForFsWindows(`${base}.part001${ext}`)) && !fs.existsSync(normalizeForFsWindows(`${base}.parts.json`))) {
+            return { base, ext };
+        }
+    }
+}
+
+/**
+ * Sink for ffmpeg's stdout that records `format` ('mpegts' | 'fmp4') in parts next to
+ * finalPath. `onPart(path)` fires when a part opens; `onStop(key, message)` when the
+ * recording has to end early (ffmpeg should then be asked to quit; further input is
+ * discarded). Once `done` resolves, `sink.parts`, `sink.indexPath` and `sink.stopped`
+ * describe the result.
+ */
+export function createSegmentedRecorder(finalPath, { downloadId, format, maxBytes, maxSeconds, traceId = 0, onPart = null, onStop = null }) {
+    const scanner = format === 'fmp4' ? new Mp4Scanner() : new TsScanner();
+    const { base, ext } = chooseStem(finalPath);
+    const dir = path.dirname(finalPath);
+    const indexPath = `${base}.parts.json`;
+    const index = { version: INDEX_VERSION, format, initBytes: 0, complete: false, parts: [] };
+
+    let queue = [];
+    let queueStart = 0; // stream offset of queue[0]
+    let queueEnd = 0;
+    let initChunks = [];
+    let initCollected = 0;
+    let init = null;
+    let part = null;
+    let lastRate = 0; // bytes per second of the last finished part
+
+    const sink = { backend: 'recorder', digests: {}, parts: [], indexPath, stopped: null };
+
+    function stop(key, message) {
+        if (sink.stopped) return;
+        sink.stopped = { key, error: message };
+        logDebug(`[Recorder] ${downloadId}: stopping, ${message}`);
+        queue = [];
+        onStop?.(key, message);
+    }
+
+    // Remove bytes [queueStart, offset) from the queue
+    function take(offset) {
+        const wanted = offset - queueStart;
+        const buffers = [];
+        let taken = 0;
+        while (taken < wanted) {
+            const head = queue[0];
+            const step = Math.min(head.length, wanted - taken);
+            buffers.push(step === head.length ? head : head.subarray(0, step));
+            if (step === head.length) queue.shift();
+            else queue[0] = head.subarray(step);
+            taken += step;
+        }
+        queueStart = offset;
+        return buffers.length === 1 ? buffers[0] : Buffer.concat(buffers, taken);
+    }
+
+    async function writeIndex() {
+        const tmpPath = normalizeForFsWindows(`${indexPath}.tmp`);
+        const handle = await fs.promises.open(tmpPath, 'w');
+        try {
+            await writeAll(handle, Buffer.from(JSON.stringify(index, null, 2)));
+            await handle.datasync();
+        } finally {
+            await handle.close();
+        }
+        await fs.promises.rename(tmpPath, normalizeForFsWindows(indexPath));
+    }
+
+    async function openPart() {
+        const number = index.parts.length + 1;
+        const partPath = `${base}.part${String(number).padStart(3, '0')}${ext}`;
+        const handle = await fs.promises.open(normalizeForFsWindows(partPath), 'wx');
+        part = { path: partPath, handle, bytes: 0, boundary: 0, startedAt: Date.now(), syncedAt: Date.now() };
+        if (init) {
+            await writeAll(handle, init);
+            part.bytes = part.boundary = init.length;
+        }
+        index.parts.push({ file: path.basename(partPath), bytes: part.bytes, startedAt: new Date(part.startedAt).toISOString(), seconds: 0, complete: false });
+        sink.parts.push(partPath);
+        await syncDirectory(normalizeForFsWindows(dir));
+        await writeIndex();
+        logDebug(`[Recorder] ${downloadId}: writing ${partPath}`);
+        onPart?.(partPath);
+    }
+
+    async function closePart() {
+        if (!part) return;
+        const current = part;
+        part = null;
+        await current.handle.datasync();
+        await current.handle.close();
+        const seconds = (Date.now() - current.startedAt) / 1000;
+        Object.assign(index.parts[index.parts.length - 1], { bytes: current.bytes, seconds: Math.round(seconds * 10) / 10, complete: true });
+        if (seconds > 0) lastRate = current.bytes / seconds;
+        await writeIndex();
+    }
+
+    async function hasRoomForPart() {
+        const free = await getFreeDiskSpace(dir, traceId);
+        if (free === null) return true;
+        const expected = Math.min(maxBytes, lastRate > 0 ? lastRate * maxSeconds : maxBytes);
+        if (free >= expected + FREE_SPACE_RESERVE) return true;
+        stop('insufficientSpace', `Not enough disk space for the next part: about ${formatSize(expected)} needed, ${formatSize(free)} available`);
+        return false;
+    }
+
+    async function write(offset) {
+        if (offset <= queueStart) return;
+        const bytes = take(offset);
+        if (format === 'fmp4' && init === null && initCollected < MAX_INIT_BYTES) {
+            initChunks.push(Buffer.from(bytes.subarray(0, MAX_INIT_BYTES - initCollected)));
+            initCollected += Math.min(bytes.length, MAX_INIT_BYTES - initCollected);
+        }
+        if (!part) await openPart();
+        try {
+            await writeAll(part.handle, bytes);
+            part.bytes += bytes.length;
+        } catch (err) {
+            if (!isOutOfSpace(err)) throw err;
+            // Leave the part ending on a whole fragment
+            await part.handle.truncate(part.boundary).catch(() => {});
+            part.bytes = part.boundary;
+            stop('insufficientSpace', `Disk full while writing ${path.basename(part.path)}`);
+        }
+    }
+
+    async function boundary() {
+        if (format === 'fmp4' && init === null && scanner.initBytes !== null) {
+            init = Buffer.concat(initChunks).subarray(0, scanner.initBytes);
+            index.initBytes = init.length;
+            initChunks = [];
+        }
+        part.boundary = part.bytes;
+        const now = Date.now();
+        if (part.bytes >= maxBytes || now - part.startedAt >= maxSeconds * 1000) {
+            await closePart();
+            if (await hasRoomForPart()) await openPart();
+            return;
+        }
+        if (now - part.syncedAt >= LIVE_PART_SYNC_MS) {
+            await part.handle.datasync();
+            part.syncedAt = now;
+        }
+    }
+
+    async function consume(chunk) {
+        if (sink.stopped) return;
+        queue.push(chunk);
+        queueEnd += chunk.length;
+        const { cuts, safe } = scanner.push(chunk);
+        for (const cut of cuts) {
+            await write(cut);
+            if (sink.stopped) return;
+            if (part) await boundary();
+            if (sink.stopped) return;
+        }
+        await write(safe);
+    }
+
+    async function finish() {
+        if (!sink.stopped) await write(queueEnd);
+        await closePart();
+        if (!index.parts.length) return;
+        index.complete = true;
+        await writeIndex();
+        logDebug(`[Recorder] ${downloadId}: ${index.parts.length} part(s), index ${indexPath}`);
+    }
+
+    sink.stream = new Writable({
+        write(chunk, encoding, callback) {
+            consume(chunk).then(() => callback(), callback);
+        },
+        final(callback) {
+            finish().then(() => callback(), callback);
+        }
+    });
+    sink.destroy = (error) => sink.stream.destroy(error);
+    sink.done = new Promise((resolve, reject) => {
+        sink.stream.on('finish', resolve);
+        sink.stream.on('error', (err) => {
+            part?.handle.close().catch(() => {});
+            part = null;
+            reject(err);
+        });
+    });
+    return sink;
+}
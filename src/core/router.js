@@ -7,7 +7,12 @@ import { handleDownload } from '../handlers/downloader';
 import { handleFileSystem } from '../handlers/filesystem';
 import { handleRunTool } from '../handlers/tools';
 import { Protocol } from './protocol';
+import { handleSetBandwidth } from './bandwidth';
+import { handleAnalyzeHls } from './hls-analyzer';
+import { takeFrontEndHandoff, writeFrontEndHandshake } from './frontend';
+import { setQueuedDownloadPriority } from './admission';
 import { clearProcessing, getActiveProcessCount, setProcessCountCallback } from './processes';
+import { initTrace, traceBegin, traceEnd, traceInstant, traceLabel, traceScope, TraceEvent } from './trace';
 
 const HANDLERS = {
     'download-v2': handleDownload,
@@ -15,6 +20,12 @@ const HANDLERS = {
     'cancel-download-v2': handleDownload,
     'fileSystem': handleFileSystem,
     'runTool': handleRunTool,
+    'set-bandwidth': handleSetBandwidth,
+    'analyze-hls': handleAnalyzeHls,
+    'set-download-priority': async (req) => {
+        const requeued = setQueuedDownloadPriority(req.downloadId, req.priority);
+        return { success: requeued, downloadId: req.downloadId, ...(requeued ? {} : { key: 'ENOENT', error: 'Not queued' }) };
+    },
     'get-disk-space': async (req) => {
         const free = await getFreeDiskSpace(req.path || os.homedir());
         return { success: true, freeDiskSpace: free };
@@ -67,6 +78,10 @@ function validateRequest(request) {
 }
 
 export async function routeRequest(request, protocol) {
+    const traceId = traceScope(request.downloadId ?? request.id ?? request.command);
+    const traceCommand = traceLabel(request.command);
+    traceInstant(TraceEvent.REQUEST_RECEIVED, traceId, traceCommand);
+
     const handler = HANDLERS[request.command];
     if (!handler) {
         logDebug(`[Router] Unknown command received: ${request.command}`);
@@ -74,6 +89,8 @@ export async function routeRequest(request, protocol) {
         return;
     }
 
+    let traceSpan = TraceEvent.ROUTE_REQUEST;
+    traceBegin(traceSpan, traceId, traceCommand);
     try {
         validateRequest(request);
 
@@ -92,6 +109,9 @@ export async function routeRequest(request, protocol) {
             reportLogStatus({ send: (msg) => protocol.send(msg) });
         }
 
+        traceEnd(traceSpan, traceId, traceCommand);
+        traceSpan = TraceEvent.HANDLER;
+        traceBegin(traceSpan, traceId, traceCommand);
         const result = await handler(request, { send: (msg) => protocol.send(msg) });
         if (result) protocol.send(result, request.id);
     } catch (err) {
@@ -104,6 +124,7 @@ export async function routeRequest(request, protocol) {
             substitutions: err.substitutions || []
         }, request.id);
     } finally {
+        traceEnd(traceSpan, traceId, traceCommand);
         activeHandlers = Math.max(0, activeHandlers - 1);
         if (activeHandlers === 0) {
             startIdleTimer();
@@ -113,6 +134,9 @@ export async function routeRequest(request, protocol) {
 }
 
 export function initializeMessaging() {
+    initTrace();
+    const handoff = takeFrontEndHandoff();
+
     const protocol = new Protocol(
         (message) => routeRequest(message, protocol),
         () => {
@@ -130,10 +154,14 @@ export function initializeMessaging() {
 
     startIdleTimer();
 
-    // Initial handshake info
-    protocol.send(getConnectionInfo());
+    // Initial handshake info (already answered when mvd-host handed the connection over)
+    if (!handoff.handshakeSent) protocol.send(getConnectionInfo());
+    writeFrontEndHandshake();
 
     // Non-blocking binary check
     const status = checkBinaries();
     if (!status.success) protocol.send({ command: 'binary-status', ...status });
+
+    // Requests the front end read before handing over
+    if (handoff.input) protocol.handleData(handoff.input);
 }
@@ -0,0 +1,234 @@
+import fs, { promises as fsp } from 'fs';
+import path from 'path';
+import http from 'http';
+import https from 'https';
+import crypto from 'crypto';
+import { SEGMENT_CACHE_DIR, SEGMENT_CACHE_MAX_BYTES, SEGMENT_FETCH_TIMEOUT, ORIGIN_MAX_SOCKETS, ORIGIN_KEEPALIVE_MS } from '../utils/config';
+import { logDebug } from '../utils/utils';
+
+/**
+ * Segment Cache – On-disk LRU of fetched media segments shared across jobs
+ *
+ * Entries are keyed by URL + byte range and stored as `<sha256>.seg` under TEMP_DIR.
+ * Downloads land in a `.part` file and are renamed into place only once complete,
+ * so a reader never sees a torn segment. mtime doubles as the LRU clock, which keeps
+ * eviction order across host restarts and between concurrently running hosts.
+ */
+
+const STALE_PART_MS = 60 * 60 * 1000;
+const MAX_REDIRECTS = 5;
+
+const entries = new Map(); // key -> { size, lastUsed }
+const inflight = new Map(); // key -> Promise<{ path, size }>
+let totalBytes = 0;
+let loaded = false;
+
+// Keep-alive pools shared by every host-side origin fetch, so concurrent jobs against
+// the same CDN reuse warm TCP/TLS connections instead of handshaking per segment
+const agents = {
+    'http:': new http.Agent({ keepAlive: true, keepAliveMsecs: ORIGIN_KEEPALIVE_MS, maxSockets: ORIGIN_MAX_SOCKETS }),
+    'https:': new https.Agent({ keepAlive: true, keepAliveMsecs: ORIGIN_KEEPALIVE_MS, maxSockets: ORIGIN_MAX_SOCKETS })
+};
+
+/**
+ * Issue a GET through the shared keep-alive pool. Idle sockets are unref'd by Node,
+ * so the pool never keeps the host alive on its own.
+ */
+export function originGet(url, headers, callback) {
+    const parsedUrl = new URL(url);
+    const transport = parsedUrl.protocol === 'https:' ? https : http;
+    return transport.get(parsedUrl, { headers, agent: agents[parsedUrl.protocol] }, callback);
+}
+
+/**
+ * GET a text resource (playlists, manifests) through the pool, following redirects.
+ * Resolves to { url, content } with the final URL after redirects.
+ */
+export function fetchText(url, headers, redirectCount = 0) {
+    return new Promise((resolve, reject) => {
+        let request;
+        try {
+            request = originGet(url, headers || {}, (response) => {
+                const status = response.statusCode || 0;
+                if ([301, 302, 303, 307, 308].includes(status) && response.headers.location && redirectCount < MAX_REDIRECTS) {
+                    response.resume();
+                    fetchText(new URL(response.headers.location, url).toString(), headers, redirectCount + 1).then(resolve, reject);
+                    return;
+                }
+                if (status < 200 || status >= 300) {
+                    response.resume();
+                    reject(new Error(`Playlist fetch failed with HTTP ${status}`));
+                    return;
+                }
+                const chunks = [];
+                response.on('data', (chunk) => chunks.push(chunk));
+                response.on('error', reject);
+                response.on('end', () => resolve({ url, content: Buffer.concat(chunks).toString('utf8') }));
+            });
+        } catch (err) {
+            reject(err);
+            return;
+        }
+        request.on('error', reject);
+    });
+}
+
+function entryPath(key) {
+    return path.join(SEGMENT_CACHE_DIR, `${key}.seg`);
+}
+
+export function segmentKey(url, range) {
+    return crypto.createHash('sha256').update(`${url}\n${range || ''}`).digest('hex');
+}
+
+function loadIndex() {
+    if (loaded) return;
+    loaded = true;
+    try {
+        fs.mkdirSync(SEGMENT_CACHE_DIR, { recursive: true });
+        const now = Date.now();
+        for (const name of fs.readdirSync(SEGMENT_CACHE_DIR)) {
+            const fullPath = path.join(SEGMENT_CACHE_DIR, name);
+            try {
+                const stats = fs.statSync(fullPath);
+                if (name.endsWith('.seg')) {
+                    entries.set(name.slice(0, -4), { size: stats.size, lastUsed: stats.mtimeMs });
+                    totalBytes += stats.size;
+                } else if (name.endsWith('.part') && now - stats.mtimeMs > STALE_PART_MS) {
+                    fs.unlinkSync(fullPath);
+                }
+            } catch { /* ignore */ }
+        }
+    } catch (err) {
+        logDebug('[SegmentCache] Failed to load index:', err.message);
+    }
+}
+
+function touch(key, entry) {
+    const now = Date.now();
+    entry.lastUsed = now;
+    const stamp = new Date(now);
+    fsp.utimes(entryPath(key), stamp, stamp).catch(() => {});
+}
+
+function evict(keepKey) {
+    if (totalBytes <= SEGMENT_CACHE_MAX_BYTES) return;
+    const ordered = [...entries.entries()].sort((a, b) => a[1].lastUsed - b[1].lastUsed);
+    for (const [key, entry] of ordered) {
+        if (totalBytes <= SEGMENT_CACHE_MAX_BYTES) break;
+        if (key === keepKey || inflight.has(key)) continue;
+        try {
+            fs.unlinkSync(entryPath(key));
+        } catch (err) {
+            // Still open by a reader on Windows; retry on the next eviction pass
+            if (err.code !== 'ENOENT') continue;
+        }
+        entries.delete(key);
+        totalBytes -= entry.size;
+    }
+}
+
+/**
+ * Return the cached file for url/range without touching the network, or null.
+ */
+export function lookupSegment(url, range) {
+    loadIndex();
+    const key = segmentKey(url, range);
+    const entry = entries.get(key);
+    if (!entry) return null;
+    if (!fs.existsSync(entryPath(key))) {
+        // Evicted by another host process
+        entries.delete(key);
+        totalBytes -= entry.size;
+        return null;
+    }
+    touch(key, entry);
+    return { path: entryPath(key), size: entry.size };
+}
+
+function downloadToFile(url, headers, range, targetPath, shaper, redirectCount = 0) {
+    return new Promise((resolve, reject) => {
+        const requestHeaders = { ...(headers || {}) };
+        if (range) requestHeaders.Range = range;
+
+        let req;
+        try {
+            req = originGet(url, requestHeaders, onResponse);
+        } catch {
+            reject(new Error(`Invalid segment URL: ${url}`));
+            return;
+        }
+
+        function onResponse(response) {
+            const status = response.statusCode || 0;
+            if ([301, 302, 303, 307, 308].includes(status) && response.headers.location) {
+                response.resume();
+                if (redirectCount >= MAX_REDIRECTS) {
+                    reject(new Error('Segment redirect limit exceeded'));
+                    return;
+                }
+                const nextUrl = new URL(response.headers.location, url).toString();
+                downloadToFile(nextUrl, headers, range, targetPath, shaper, redirectCount + 1).then(resolve, reject);
+                return;
+            }
+
+            // A 200 for a ranged request would cache the wrong bytes under this key
+            if (range ? status !== 206 : (status < 200 || status >= 300)) {
+                response.resume();
+                reject(new Error(`Segment fetch failed with HTTP ${status}`));
+                return;
+            }
+
+            let size = 0;
+            const out = fs.createWriteStream(targetPath);
+            response.on('data', (chunk) => { size += chunk.length; });
+            response.on('error', reject);
+            out.on('error', reject);
+            out.on('finish', () => resolve(size));
+            (shaper ? response.pipe(shaper.createThrottle()) : response).pipe(out);
+        }
+
+        req.setTimeout(SEGMENT_FETCH_TIMEOUT, () => req.destroy(new Error('Segment fetch timed out')));
+        req.on('error', reject);
+    });
+}
+
+/**
+ * Fetch a segment through the cache. Concurrent callers for the same key share one download.
+ * `shaper` is the bandwidth job that network bytes are charged to.
+ * Resolves to { path, size, cached }.
+ */
+export async function fetchSegment(url, { range = null, headers = null, shaper = null } = {}) {
+    const hit = lookupSegment(url, range);
+    if (hit) return { ...hit, cached: true };
+
+    const key = segmentKey(url, range);
+    if (inflight.has(key)) {
+        const shared = await inflight.get(key);
+        return { ...shared, cached: true };
+    }
+
+    const promise = (async () => {
+        const partPath = path.join(SEGMENT_CACHE_DIR, `${key}.${process.pid}-${Math.random().toString(36).slice(2)}.part`);
+        try {
+            const size = await downloadToFile(url, headers, range, partPath, shaper);
+            await fsp.rename(partPath, entryPath(key));
+            const previous = entries.get(key);
+            if (previous) totalBytes -= previous.size;
+            entries.set(key, { size, lastUsed: Date.now() });
+            totalBytes += size;
+            evict(key);
+            return { path: entryPath(key), size };
+        } catch (err) {
+            fsp.unlink(partPath).catch(() => {});
+            throw err;
+        }
+    })();
+
+    inflight.set(key, promise);
+    try {
+        return { ...(await promise), cached: false };
+    } finally {
+        inflight.delete(key);
+    }
+}
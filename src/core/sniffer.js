@@ -0,0 +1,979 @@
+import { originGet } from './segment-cache';
+import { logDebug } from '../utils/utils';
+
+/**
+ * Media Sniffer – ffprobe-shaped metadata for progressive files read straight off the origin
+ *
+ * Probing a progressive MP4/WebM/TS with ffprobe costs a process spawn, a TLS handshake and
+ * usually several sequential reads. The few fields the extension shows (duration, codecs,
+ * resolution, sample rate, bitrate) sit in small, well-known structures, so they are parsed
+ * here from HTTP range reads over the shared keep-alive pool:
+ *   MP4       top-level boxes up to moov (one extra range when moov sits after mdat)
+ *   Matroska  EBML header, Segment Info and Tracks (SeekHead when Tracks follows Clusters)
+ *   MPEG-TS   PAT/PMT, SPS/ADTS/AC-3 headers of the first PES, and the last PTS from a tail range
+ * The common case is a single 64KB range request. Anything unexpected returns null and the
+ * caller falls back to ffprobe.
+ */
+
+const HEAD_BYTES = 64 * 1024;
+const TAIL_BYTES = 128 * 1024;
+const MAX_BOX_BYTES = 32 * 1024 * 1024; // moov / Tracks larger than this are left to ffprobe
+const MAX_REDIRECTS = 5;
+const REQUEST_TIMEOUT_MS = 10000;
+
+const MP4_FORMAT = 'mov,mp4,m4a,3gp,3g2,mj2';
+const MATROSKA_FORMAT = 'matroska,webm';
+const TS_FORMAT = 'mpegts';
+
+/**
+ * Range reads over one URL; windows already fetched are served from memory
+ */
+class RangeReader {
+    constructor(url, headers) {
+        this.url = url;
+        this.headers = headers || {};
+        this.total = null;
+        this.windows = [];
+        this.requests = 0;
+    }
+
+    // Up to `length` bytes at `start`; shorter only at end of file
+    async read(start, length) {
+        const end = start + length;
+        for (const window of this.windows) {
+            if (start >= window.start && end <= window.start + window.data.length) {
+                return window.data.subarray(start - window.start, end - window.start);
+            }
+        }
+        let fetchEnd = Math.max(end, start + HEAD_BYTES);
+        if (this.total !== null) fetchEnd = Math.min(fetchEnd, this.total);
+        if (fetchEnd <= start) return Buffer.alloc(0);
+        const data = await this.fetch(start, fetchEnd - 1, 0);
+        this.windows.push({ start, data });
+        return data.subarray(0, Math.min(length, data.length));
+    }
+
+    fetch(start, end, redirects) {
+        this.requests += 1;
+        const wanted = end - start + 1;
+        return new Promise((resolve, reject) => {
+            const request = originGet(this.url, { ...this.headers, Range: `bytes=${start}-${end}` }, (response) => {
+                const status = response.statusCode;
+                if (status >= 300 && status < 400 && response.headers.location) {
+                    response.resume();
+                    if (redirects >= MAX_REDIRECTS) return reject(new Error('Too many redirects'));
+                    this.url = new URL(response.headers.location, this.url).toString();
+                    return this.fetch(start, end, redirects + 1).then(resolve, reject);
+                }
+                if (status === 206) {
+                    const match = /\/(\d+)\s*$/.exec(response.headers['content-range'] || '');
+                    if (match) this.total = Number(match[1]);
+                } else if (status === 200 && start === 0) {
+                    // No range support: read what was asked for and drop the connection
+                    const length = Number(response.headers['content-length']);
+                    if (Number.isFinite(length)) this.total = length;
+                } else {
+                    response.resume();
+                    return reject(new Error(status === 200 ? 'Range requests not supported' : `HTTP ${status}`));
+                }
+
+                const chunks = [];
+                let received = 0;
+                const done = () => resolve(Buffer.concat(chunks, Math.min(received, wanted)));
+                response.on('data', (chunk) => {
+                    chunks.push(chunk);
+                    received += chunk.length;
+                    if (received >= wanted) {
+                        response.removeAllListeners('end');
+                        if (status === 200) request.destroy();
+                        done();
+                    }
+                });
+                response.on('end', done);
+                response.on('error', reject);
+            });
+            request.setTimeout(REQUEST_TIMEOUT_MS, () => request.destroy(new Error('Sniff request timed out')));
+            request.on('error', reject);
+        });
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Shared helpers
+// ---------------------------------------------------------------------------------------------
+
+const AAC_SAMPLE_RATES = [96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350];
+const AAC_PROFILES = { 1: 'Main', 2: 'LC', 3: 'SSR', 4: 'LTP', 5: 'HE-AAC', 29: 'HE-AACv2' };
+const CHANNEL_LAYOUTS = { 1: 'mono', 2: 'stereo', 6: '5.1', 8: '7.1' };
+const H264_PROFILES = { 66: 'Baseline', 77: 'Main', 88: 'Extended', 100: 'High', 110: 'High 10', 122: 'High 4:2:2', 244: 'High 4:4:4 Predictive' };
+const HEVC_PROFILES = { 1: 'Main', 2: 'Main 10', 3: 'Main Still Picture', 4: 'Rext' };
+
+function gcd(a, b) {
+    return b ? gcd(b, a % b) : a;
+}
+
+function ratio(num, den) {
+    if (!num || !den) return '0/0';
+    const divisor = gcd(Math.round(num), Math.round(den));
+    return `${Math.round(num) / divisor}/${Math.round(den) / divisor}`;
+}
+
+// Nanosecond frame durations are rounded; snap them back to integer or NTSC (x/1001) rates
+function frameRateFromNs(nanoseconds) {
+    const fps = 1e9 / nanoseconds;
+    if (Math.abs(fps - Math.round(fps)) < 1e-3) return `${Math.round(fps)}/1`;
+    const ntsc = Math.round(fps * 1.001);
+    if (Math.abs(fps - ntsc / 1.001) < 1e-3) return `${ntsc * 1000}/1001`;
+    return ratio(1e9, nanoseconds);
+}
+
+function seconds(value) {
+    return value.toFixed(6);
+}
+
+function h264Profile(profileIdc, constraints) {
+    if (profileIdc === 66 && constraints & 0x40) return 'Constrained Baseline';
+    return H264_PROFILES[profileIdc];
+}
+
+class BitReader {
+    constructor(bytes) {
+        this.bytes = bytes;
+        this.bit = 0;
+    }
+
+    u(count) {
+        let value = 0;
+        for (let index = 0; index < count; index += 1) {
+            const byte = this.bytes[this.bit >> 3];
+            if (byte === undefined) throw new Error('Bitstream truncated');
+            value = value * 2 + ((byte >> (7 - (this.bit & 7))) & 1);
+            this.bit += 1;
+        }
+        return value;
+    }
+
+    ue() {
+        let zeros = 0;
+        while (this.u(1) === 0) {
+            if (++zeros > 31) throw new Error('Bad Exp-Golomb code');
+        }
+        return zeros ? 2 ** zeros - 1 + this.u(zeros) : 0;
+    }
+
+    se() {
+        const code = this.ue();
+        return code & 1 ? (code + 1) / 2 : -code / 2;
+    }
+}
+
+// Strip emulation-prevention bytes (00 00 03) from a NAL payload
+function unescapeRbsp(nal) {
+    const out = [];
+    let zeros = 0;
+    for (const byte of nal) {
+        if (zeros >= 2 && byte === 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = byte === 0 ? zeros + 1 : 0;
+        out.push(byte);
+    }
+    return Buffer.from(out);
+}
+
+function skipScalingList(reader, size) {
+    let last = 8;
+    let next = 8;
+    for (let index = 0; index < size; index += 1) {
+        if (next !== 0) next = (last + reader.se() + 256) % 256;
+        if (next !== 0) last = next;
+    }
+}
+
+const HIGH_PROFILES = new Set([100, 110, 122, 244, 44, 83, 86, 118, 128, 138, 139, 134, 135]);
+
+/**
+ * Profile, level and cropped picture size from an H.264 SPS NAL (header byte included)
+ */
+function parseH264Sps(nal) {
+    const reader = new BitReader(unescapeRbsp(nal.subarray(1)));
+    const profileIdc = reader.u(8);
+    const constraints = reader.u(8);
+    const levelIdc = reader.u(8);
+    reader.ue(); // seq_parameter_set_id
+    let chromaFormat = 1;
+    if (HIGH_PROFILES.has(profileIdc)) {
+        chromaFormat = reader.ue();
+        if (chromaFormat === 3) reader.u(1);
+        reader.ue(); // bit_depth_luma_minus8
+        reader.ue(); // bit_depth_chroma_minus8
+        reader.u(1);
+        if (reader.u(1)) {
+            for (let index = 0; index < (chromaFormat !== 3 ? 8 : 12); index += 1) {
+                if (reader.u(1)) skipScalingList(reader, index < 6 ? 16 : 64);
+            }
+        }
+    }
+    reader.ue(); // log2_max_frame_num_minus4
+    const pocType = reader.ue();
+    if (pocType === 0) {
+        reader.ue();
+    } else if (pocType === 1) {
+        reader.u(1);
+        reader.se();
+        reader.se();
+        const cycle = reader.ue();
+        for (let index = 0; index < cycle; index += 1) reader.se();
+    }
+    reader.ue(); // max_num_ref_frames
+    reader.u(1);
+    const widthMbs = reader.ue() + 1;
+    const heightMapUnits = reader.ue() + 1;
+    const frameMbsOnly = reader.u(1);
+    if (!frameMbsOnly) reader.u(1);
+    reader.u(1);
+    let crop = [0, 0, 0, 0];
+    if (reader.u(1)) crop = [reader.ue(), reader.ue(), reader.ue(), reader.ue()];
+
+    const cropX = chromaFormat === 0 || chromaFormat === 3 ? 1 : 2;
+    const cropY = (chromaFormat === 1 ? 2 : 1) * (2 - frameMbsOnly);
+    return {
+        profile: h264Profile(profileIdc, constraints),
+        level: levelIdc,
+        width: widthMbs * 16 - cropX * (crop[0] + crop[1]),
+        height: (2 - frameMbsOnly) * heightMapUnits * 16 - cropY * (crop[2] + crop[3])
+    };
+}
+
+// AudioSpecificConfig (MP4 esds / Matroska CodecPrivate)
+function parseAudioSpecificConfig(bytes) {
+    if (!bytes || bytes.length < 2) return null;
+    let objectType = bytes[0] >> 3;
+    let rateIndex = ((bytes[0] & 7) << 1) | (bytes[1] >> 7);
+    let channels = (bytes[1] >> 3) & 0x0F;
+    if (objectType === 31) {
+        if (bytes.length < 3) return null;
+        objectType = 32 + (((bytes[0] & 7) << 3) | (bytes[1] >> 5));
+        rateIndex = (bytes[1] >> 1) & 0x0F;
+        channels = ((bytes[1] & 1) << 3) | (bytes[2] >> 5);
+    }
+    return { profile: AAC_PROFILES[objectType], sampleRate: AAC_SAMPLE_RATES[rateIndex], channels };
+}
+
+function audioStream(base, sampleRate, channels) {
+    return {
+        ...base,
+        codec_type: 'audio',
+        ...(sampleRate ? { sample_rate: String(sampleRate) } : {}),
+        ...(channels ? { channels } : {}),
+        ...(CHANNEL_LAYOUTS[channels] ? { channel_layout: CHANNEL_LAYOUTS[channels] } : {})
+    };
+}
+
+function describeFormat(formatName, streams, duration, size, startTime = 0, tags = null) {
+    return {
+        streams: streams.map((stream, index) => ({ index, codec_name: stream.codec_name, codec_type: stream.codec_type, ...stream })),
+        format: {
+            nb_streams: streams.length,
+            nb_programs: 0,
+            format_name: formatName,
+            start_time: seconds(startTime),
+            duration: seconds(duration),
+            ...(size ? { size: String(size), bit_rate: String(Math.round(size * 8 / duration)) } : {}),
+            probe_score: 100,
+            ...(tags ? { tags } : {})
+        }
+    };
+}
+
+// ---------------------------------------------------------------------------------------------
+// MP4
+// ---------------------------------------------------------------------------------------------
+
+const MP4_TOP_LEVEL = new Set(['ftyp', 'styp', 'moov', 'mdat', 'free', 'skip', 'wide', 'uuid', 'pdin', 'sidx', 'moof', 'mfra', 'meta']);
+
+function readUint64(buffer, offset) {
+    return buffer.readUInt32BE(offset) * 2 ** 32 + buffer.readUInt32BE(offset + 4);
+}
+
+// Child boxes of buffer[start, end): [{ type, start (payload), end }]
+function mp4Boxes(buffer, start, end) {
+    const boxes = [];
+    let offset = start;
+    while (offset + 8 <= end) {
+        let size = buffer.readUInt32BE(offset);
+        const type = buffer.toString('latin1', offset + 4, offset + 8);
+        let header = 8;
+        if (size === 1) {
+            if (offset + 16 > end) break;
+            size = readUint64(buffer, offset + 8);
+            header = 16;
+        } else if (size === 0) {
+            size = end - offset;
+        }
+        if (size < header || offset + size > end) break;
+        boxes.push({ type, start: offset + header, end: offset + size });
+        offset += size;
+    }
+    return boxes;
+}
+
+function mp4Child(buffer, box, type) {
+    return box ? mp4Boxes(buffer, box.start, box.end).find(child => child.type === type) : undefined;
+}
+
+function mp4Path(buffer, box, ...types) {
+    return types.reduce((current, type) => mp4Child(buffer, current, type), box);
+}
+
+// Version-dependent (timescale, duration) of mvhd/mdhd
+function mp4Times(buffer, box) {
+    const version = buffer[box.start];
+    return version === 1
+        ? { timescale: buffer.readUInt32BE(box.start + 20), duration: readUint64(buffer, box.start + 24), language: box.start + 32 }
+        : { timescale: buffer.readUInt32BE(box.start + 12), duration: buffer.readUInt32BE(box.start + 16), language: box.start + 20 };
+}
+
+function mp4Language(buffer, offset) {
+    const packed = buffer.readUInt16BE(offset);
+    const language = String.fromCharCode(((packed >> 10) & 31) + 0x60, ((packed >> 5) & 31) + 0x60, (packed & 31) + 0x60);
+    return /^[a-z]{3}$/.test(language) && language !== 'und' ? language : null;
+}
+
+// MPEG-4 descriptor walk inside esds: { objectType, avgBitrate, config }
+function parseEsds(buffer, box) {
+    const result = {};
+    let offset = box.start + 4;
+    const readLength = () => {
+        let length = 0;
+        for (let index = 0; index < 4 && offset < box.end; index += 1) {
+            const byte = buffer[offset++];
+            length = (length << 7) | (byte & 0x7F);
+            if (!(byte & 0x80)) break;
+        }
+        return length;
+    };
+    while (offset + 2 <= box.end) {
+        const tag = buffer[offset++];
+        const length = readLength();
+        if (tag === 0x03) {
+            const flags = buffer[offset + 2];
+            offset += 3;
+            if (flags & 0x80) offset += 2;
+            if (flags & 0x40) offset += 1 + buffer[offset];
+            if (flags & 0x20) offset += 2;
+        } else if (tag === 0x04) {
+            result.objectType = buffer[offset];
+            result.avgBitrate = buffer.readUInt32BE(offset + 9);
+            offset += 13;
+        } else if (tag === 0x05) {
+            result.config = buffer.subarray(offset, offset + length);
+            break;
+        } else {
+            offset += length;
+        }
+    }
+    return result;
+}
+
+const MP4_VIDEO_CODECS = { avc1: 'h264', avc3: 'h264', hvc1: 'hevc', hev1: 'hevc', av01: 'av1', vp09: 'vp9', vp08: 'vp8', mp4v: 'mpeg4' };
+const MP4_AUDIO_CODECS = { mp4a: 'aac', Opus: 'opus', 'ac-3': 'ac3', 'ec-3': 'eac3', fLaC: 'flac', '.mp3': 'mp3', alac: 'alac' };
+const MP4_SUBTITLE_CODECS = { tx3g: 'mov_text', wvtt: 'webvtt', stpp: 'ttml' };
+
+function describeMp4Track(buffer, trak) {
+    const mdia = mp4Child(buffer, trak, 'mdia');
+    const mdhd = mp4Child(buffer, mdia, 'mdhd');
+    const hdlr = mp4Child(buffer, mdia, 'hdlr');
+    const stbl = mp4Path(buffer, mdia, 'minf', 'stbl');
+    const stsd = mp4Child(buffer, stbl, 'stsd');
+    if (!mdhd || !hdlr || !stsd || buffer.readUInt32BE(stsd.start + 4) < 1) return null;
+
+    const handler = buffer.toString('latin1', hdlr.start + 8, hdlr.start + 12);
+    const { timescale, duration, language } = mp4Times(buffer, mdhd);
+    const [entry] = mp4Boxes(buffer, stsd.start + 8, stsd.end);
+    if (!entry || !timescale) return null;
+    const entryStart = entry.start - 8;
+    let tag = entry.type;
+
+    const stream = {
+        codec_tag_string: tag,
+        codec_tag: `0x${Buffer.from(tag, 'latin1').readUInt32LE(0).toString(16).padStart(8, '0')}`,
+        time_base: `1/${timescale}`,
+        start_pts: 0,
+        start_time: seconds(0),
+        duration_ts: duration,
+        duration: seconds(duration / timescale)
+    };
+
+    // Sample table: frame count for the frame rate, byte count for the bitrate
+    const stts = mp4Child(buffer, stbl, 'stts');
+    const stsz = mp4Child(buffer, stbl, 'stsz');
+    let frames = 0;
+    if (stts) {
+        const count = buffer.readUInt32BE(stts.start + 4);
+        for (let index = 0; index < count && stts.start + 16 + index * 8 <= stts.end; index += 1) {
+            frames += buffer.readUInt32BE(stts.start + 8 + index * 8);
+        }
+    }
+    if (stsz) {
+        const sampleSize = buffer.readUInt32BE(stsz.start + 4);
+        const sampleCount = buffer.readUInt32BE(stsz.start + 8);
+        let bytes = sampleSize * sampleCount;
+        if (!sampleSize) {
+            for (let index = 0; index < sampleCount && stsz.start + 16 + index * 4 <= stsz.end; index += 1) {
+                bytes += buffer.readUInt32BE(stsz.start + 12 + index * 4);
+            }
+        }
+        if (bytes && duration) stream.bit_rate = String(Math.round(bytes * 8 * timescale / duration));
+        if (sampleCount) stream.nb_frames = String(sampleCount);
+    }
+    const lang = mp4Language(buffer, language);
+    if (lang) stream.tags = { language: lang };
+
+    if (tag === 'encv' || tag === 'enca') {
+        const frma = mp4Path(buffer, { start: entryStart + (tag === 'encv' ? 86 : 36), end: entry.end }, 'sinf', 'frma');
+        if (frma) tag = buffer.toString('latin1', frma.start, frma.start + 4);
+    }
+
+    if (handler === 'vide') {
+        const codec = MP4_VIDEO_CODECS[tag];
+        if (!codec || entry.end - entryStart < 86) return null;
+        const children = { start: entryStart + 86, end: entry.end };
+        Object.assign(stream, {
+            codec_name: codec,
+            codec_type: 'video',
+            width: buffer.readUInt16BE(entryStart + 32),
+            height: buffer.readUInt16BE(entryStart + 34)
+        });
+        const avcC = mp4Child(buffer, children, 'avcC');
+        const hvcC = mp4Child(buffer, children, 'hvcC');
+        if (avcC && avcC.end - avcC.start >= 4) {
+            stream.profile = h264Profile(buffer[avcC.start + 1], buffer[avcC.start + 2]);
+            stream.level = buffer[avcC.start + 3];
+        } else if (hvcC && hvcC.end - hvcC.start >= 13) {
+            stream.profile = HEVC_PROFILES[buffer[hvcC.start + 1] & 0x1F];
+            stream.level = buffer[hvcC.start + 12];
+        }
+        if (frames && duration) {
+            stream.r_frame_rate = ratio(frames * timescale, duration);
+            stream.avg_frame_rate = stream.r_frame_rate;
+        }
+        return stream;
+    }
+
+    if (handler === 'soun') {
+        let codec = MP4_AUDIO_CODECS[tag];
+        if (!codec || entry.end - entryStart < 36) return null;
+        const version = buffer.readUInt16BE(entryStart + 16);
+        let channels = buffer.readUInt16BE(entryStart + 24);
+        let sampleRate = buffer.readUInt32BE(entryStart + 32) >>> 16;
+        const children = { start: entryStart + 36 + (version === 1 ? 16 : version === 2 ? 36 : 0), end: entry.end };
+        const esds = mp4Child(buffer, children, 'esds');
+        if (esds) {
+            const { objectType, config } = parseEsds(buffer, esds);
+            if (objectType === 0x69 || objectType === 0x6B) codec = 'mp3';
+            const asc = codec === 'aac' ? parseAudioSpecificConfig(config) : null;
+            if (asc?.profile) stream.profile = asc.profile;
+            if (asc?.channels && !channels) channels = asc.channels;
+        }
+        if (codec === 'opus') sampleRate = 48000;
+        if (version === 2) {
+            sampleRate = Math.round(buffer.readDoubleBE(entryStart + 40));
+            channels = buffer.readUInt32BE(entryStart + 48);
+        }
+        return audioStream({ ...stream, codec_name: codec }, sampleRate, channels);
+    }
+
+    if (['text', 'sbtl', 'subt'].includes(handler) && MP4_SUBTITLE_CODECS[tag]) {
+        return { ...stream, codec_name: MP4_SUBTITLE_CODECS[tag], codec_type: 'subtitle' };
+    }
+    return { ...stream, codec_type: 'data' };
+}
+
+async function sniffMp4(reader) {
+    let offset = 0;
+    let majorBrand = null;
+    let moov = null;
+    while (reader.total === null || offset + 8 <= reader.total) {
+        const header = await reader.read(offset, 16);
+        if (header.length < 8) break;
+        let size = header.readUInt32BE(0);
+        const type = header.toString('latin1', 4, 8);
+        if (!MP4_TOP_LEVEL.has(type)) return null;
+        if (size === 1) {
+            if (header.length < 16) return null;
+            size = readUint64(header, 8);
+        } else if (size === 0) {
+            if (reader.total === null) return null;
+            size = reader.total - offset;
+        }
+        if (size < 8) return null;
+        if (type === 'ftyp' && header.length >= 12) majorBrand = header.toString('latin1', 8, 12);
+        if (type === 'moov') {
+            if (size > MAX_BOX_BYTES) return null;
+            moov = await reader.read(offset, size);
+            if (moov.length < size) return null;
+            break;
+        }
+        offset += size;
+    }
+    if (!moov) return null;
+
+    const root = mp4Boxes(moov, 0, moov.length)[0];
+    const mvhd = mp4Child(moov, root, 'mvhd');
+    if (!mvhd) return null;
+    let { timescale, duration } = mp4Times(moov, mvhd);
+    // Fragmented files carry the total in mvex/mehd; the init moov itself is empty
+    const mehd = mp4Path(moov, root, 'mvex', 'mehd');
+    if (mehd && !duration) duration = moov[mehd.start] === 1 ? readUint64(moov, mehd.start + 4) : moov.readUInt32BE(mehd.start + 4);
+    if (!timescale || !duration) return null;
+
+    const streams = [];
+    for (const trak of mp4Boxes(moov, root.start, root.end).filter(box => box.type === 'trak')) {
+        const stream = describeMp4Track(moov, trak);
+        if (!stream) return null;
+        streams.push(stream);
+    }
+    if (!streams.length) return null;
+    return describeFormat(MP4_FORMAT, streams, duration / timescale, reader.total, 0, majorBrand ? { major_brand: majorBrand } : null);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Matroska / WebM
+// ---------------------------------------------------------------------------------------------
+
+const EBML = {
+    HEADER: 0x1A45DFA3,
+    DOC_TYPE: 0x4282,
+    SEGMENT: 0x18538067,
+    SEEK_HEAD: 0x114D9B74,
+    SEEK: 0x4DBB,
+    SEEK_ID: 0x53AB,
+    SEEK_POSITION: 0x53AC,
+    INFO: 0x1549A966,
+    TIMESTAMP_SCALE: 0x2AD7B1,
+    DURATION: 0x4489,
+    TRACKS: 0x1654AE6B,
+    TRACK_ENTRY: 0xAE,
+    TRACK_TYPE: 0x83,
+    CODEC_ID: 0x86,
+    CODEC_PRIVATE: 0x63A2,
+    DEFAULT_DURATION: 0x23E383,
+    LANGUAGE: 0x22B59C,
+    VIDEO: 0xE0,
+    PIXEL_WIDTH: 0xB0,
+    PIXEL_HEIGHT: 0xBA,
+    AUDIO: 0xE1,
+    SAMPLING_FREQUENCY: 0xB5,
+    CHANNELS: 0x9F,
+    CLUSTER: 0x1F43B675
+};
+
+const MATROSKA_CODECS = {
+    V_VP8: 'vp8', V_VP9: 'vp9', V_AV1: 'av1', 'V_MPEG4/ISO/AVC': 'h264', 'V_MPEGH/ISO/HEVC': 'hevc', V_THEORA: 'theora',
+    A_OPUS: 'opus', A_VORBIS: 'vorbis', A_AAC: 'aac', 'A_MPEG/L3': 'mp3', A_AC3: 'ac3', A_EAC3: 'eac3', A_FLAC: 'flac',
+    'S_TEXT/UTF8': 'subrip', 'S_TEXT/WEBVTT': 'webvtt', 'S_TEXT/ASS': 'ass', 'S_TEXT/SSA': 'ssa'
+};
+const MATROSKA_TRACK_TYPES = { 1: 'video', 2: 'audio', 17: 'subtitle' };
+
+// EBML variable-length integer; IDs keep their length marker, sizes drop it
+function readVint(buffer, offset, keepMarker) {
+    const first = buffer[offset];
+    if (first === undefined) return null;
+    let length = 1;
+    let mask = 0x80;
+    while (length <= 8 && !(first & mask)) {
+        length += 1;
+        mask >>= 1;
+    }
+    if (length > 8 || offset + length > buffer.length) return null;
+    let value = keepMarker ? first : first & (mask - 1);
+    let unknown = (first & (mask - 1)) === mask - 1;
+    for (let index = 1; index < length; index += 1) {
+        value = value * 256 + buffer[offset + index];
+        if (buffer[offset + index] !== 0xFF) unknown = false;
+    }
+    return { value, length, unknown: !keepMarker && unknown };
+}
+
+function ebmlHeader(buffer, offset) {
+    const id = readVint(buffer, offset, true);
+    const size = id && readVint(buffer, offset + id.length, false);
+    if (!size) return null;
+    return { id: id.value, start: offset + id.length + size.length, size: size.unknown ? null : size.value };
+}
+
+// Children of buffer[start, end): [{ id, start, end }]
+function ebmlChildren(buffer, start, end) {
+    const children = [];
+    let offset = start;
+    while (offset < end) {
+        const element = ebmlHeader(buffer, offset);
+        if (!element || element.size === null || element.start + element.size > end) break;
+        children.push({ id: element.id, start: element.start, end: element.start + element.size });
+        offset = element.start + element.size;
+    }
+    return children;
+}
+
+function ebmlUint(buffer, element) {
+    let value = 0;
+    for (let offset = element.start; offset < element.end; offset += 1) value = value * 256 + buffer[offset];
+    return value;
+}
+
+function ebmlFloat(buffer, element) {
+    const size = element.end - element.start;
+    if (size === 4) return buffer.readFloatBE(element.start);
+    if (size === 8) return buffer.readDoubleBE(element.start);
+    return 0;
+}
+
+function ebmlString(buffer, element) {
+    return buffer.toString('utf8', element.start, element.end).replace(/\0+$/, '');
+}
+
+function ebmlFields(buffer, element) {
+    const fields = new Map();
+    for (const child of ebmlChildren(buffer, element.start, element.end)) {
+        if (!fields.has(child.id)) fields.set(child.id, child);
+    }
+    return fields;
+}
+
+function describeMatroskaTrack(buffer, entry) {
+    const fields = ebmlFields(buffer, entry);
+    const type = MATROSKA_TRACK_TYPES[fields.has(EBML.TRACK_TYPE) ? ebmlUint(buffer, fields.get(EBML.TRACK_TYPE)) : 0];
+    const codecId = fields.has(EBML.CODEC_ID) ? ebmlString(buffer, fields.get(EBML.CODEC_ID)) : '';
+    const codec = MATROSKA_CODECS[codecId] || MATROSKA_CODECS[codecId.split('/')[0]];
+    if (!type) return { codec_type: 'data' };
+    if (!codec) return null;
+
+    const stream = { codec_name: codec, codec_type: type, time_base: '1/1000', start_pts: 0, start_time: seconds(0) };
+    const language = fields.has(EBML.LANGUAGE) ? ebmlString(buffer, fields.get(EBML.LANGUAGE)) : null;
+    if (language && language !== 'und') stream.tags = { language };
+    const codecPrivate = fields.get(EBML.CODEC_PRIVATE);
+
+    if (type === 'video') {
+        const video = fields.has(EBML.VIDEO) ? ebmlFields(buffer, fields.get(EBML.VIDEO)) : new Map();
+        if (!video.has(EBML.PIXEL_WIDTH) || !video.has(EBML.PIXEL_HEIGHT)) return null;
+        stream.width = ebmlUint(buffer, video.get(EBML.PIXEL_WIDTH));
+        stream.height = ebmlUint(buffer, video.get(EBML.PIXEL_HEIGHT));
+        if (codec === 'h264' && codecPrivate && codecPrivate.end - codecPrivate.start >= 4) {
+            stream.profile = h264Profile(buffer[codecPrivate.start + 1], buffer[codecPrivate.start + 2]);
+            stream.level = buffer[codecPrivate.start + 3];
+        }
+        if (fields.has(EBML.DEFAULT_DURATION)) {
+            stream.r_frame_rate = frameRateFromNs(ebmlUint(buffer, fields.get(EBML.DEFAULT_DURATION)));
+            stream.avg_frame_rate = stream.r_frame_rate;
+        }
+        return stream;
+    }
+    if (type === 'audio') {
+        const audio = fields.has(EBML.AUDIO) ? ebmlFields(buffer, fields.get(EBML.AUDIO)) : new Map();
+        let sampleRate = audio.has(EBML.SAMPLING_FREQUENCY) ? Math.round(ebmlFloat(buffer, audio.get(EBML.SAMPLING_FREQUENCY))) : 8000;
+        const channels = audio.has(EBML.CHANNELS) ? ebmlUint(buffer, audio.get(EBML.CHANNELS)) : 1;
+        if (codec === 'aac' && codecPrivate) {
+            const asc = parseAudioSpecificConfig(buffer.subarray(codecPrivate.start, codecPrivate.end));
+            if (asc?.profile) stream.profile = asc.profile;
+        }
+        if (codec === 'opus') sampleRate = 48000;
+        return audioStream(stream, sampleRate, channels);
+    }
+    return stream;
+}
+
+async function sniffMatroska(reader, head) {
+    const header = ebmlHeader(head, 0);
+    if (!header || header.size === null || header.start + header.size > head.length) return null;
+    const docType = ebmlFields(head, { start: header.start, end: header.start + header.size }).get(EBML.DOC_TYPE);
+    if (!docType || !['webm', 'matroska'].includes(ebmlString(head, docType))) return null;
+
+    const segment = ebmlHeader(head, header.start + header.size);
+    if (!segment || segment.id !== EBML.SEGMENT) return null;
+    const segmentEnd = segment.size === null ? reader.total : segment.start + segment.size;
+
+    const elements = {};
+    const readElement = async (offset, expectedId) => {
+        const headerBytes = await reader.read(offset, 12);
+        const element = ebmlHeader(headerBytes, 0);
+        if (!element || element.size === null || element.size > MAX_BOX_BYTES) return null;
+        if (expectedId !== undefined && element.id !== expectedId) return null;
+        const body = await reader.read(offset + element.start, element.size);
+        return body.length === element.size ? { id: element.id, buffer: body } : null;
+    };
+
+    // Walk Segment children up to the first Cluster
+    let offset = segment.start;
+    while (segmentEnd === null || offset < segmentEnd) {
+        const headerBytes = await reader.read(offset, 12);
+        const element = ebmlHeader(headerBytes, 0);
+        if (!element || element.size === null || element.id === EBML.CLUSTER) break;
+        if ([EBML.SEEK_HEAD, EBML.INFO, EBML.TRACKS].includes(element.id) && !elements[element.id]) {
+            elements[element.id] = await readElement(offset);
+        }
+        if (elements[EBML.INFO] && elements[EBML.TRACKS]) break;
+        offset += element.start + element.size;
+    }
+
+    // Info/Tracks written after the Clusters are found through the SeekHead
+    const seekHead = elements[EBML.SEEK_HEAD];
+    if (seekHead && (!elements[EBML.INFO] || !elements[EBML.TRACKS])) {
+        for (const seek of ebmlChildren(seekHead.buffer, 0, seekHead.buffer.length).filter(child => child.id === EBML.SEEK)) {
+            const fields = ebmlFields(seekHead.buffer, seek);
+            if (!fields.has(EBML.SEEK_ID) || !fields.has(EBML.SEEK_POSITION)) continue;
+            const id = ebmlUint(seekHead.buffer, fields.get(EBML.SEEK_ID));
+            if ((id === EBML.INFO || id === EBML.TRACKS) && !elements[id]) {
+                elements[id] = await readElement(segment.start + ebmlUint(seekHead.buffer, fields.get(EBML.SEEK_POSITION)), id);
+            }
+        }
+    }
+    const info = elements[EBML.INFO];
+    const tracks = elements[EBML.TRACKS];
+    if (!info || !tracks) return null;
+
+    const infoFields = ebmlFields(info.buffer, { start: 0, end: info.buffer.length });
+    const scale = infoFields.has(EBML.TIMESTAMP_SCALE) ? ebmlUint(info.buffer, infoFields.get(EBML.TIMESTAMP_SCALE)) : 1000000;
+    const duration = infoFields.has(EBML.DURATION) ? ebmlFloat(info.buffer, infoFields.get(EBML.DURATION)) * scale / 1e9 : 0;
+    if (!duration) return null; // live WebM: ffprobe estimates from the clusters
+
+    const streams = [];
+    for (const entry of ebmlChildren(tracks.buffer, 0, tracks.buffer.length).filter(child => child.id === EBML.TRACK_ENTRY)) {
+        const stream = describeMatroskaTrack(tracks.buffer, entry);
+        if (!stream) return null;
+        streams.push(stream);
+    }
+    if (!streams.length) return null;
+    return describeFormat(MATROSKA_FORMAT, streams, duration, reader.total);
+}
+
+// ---------------------------------------------------------------------------------------------
+// MPEG-TS
+// ---------------------------------------------------------------------------------------------
+
+const TS_PACKET = 188;
+const PTS_WRAP = 2 ** 33;
+const TS_STREAM_TYPES = {
+    0x01: ['video', 'mpeg1video'], 0x02: ['video', 'mpeg2video'], 0x1B: ['video', 'h264'], 0x24: ['video', 'hevc'],
+    0x03: ['audio', 'mp2'], 0x04: ['audio', 'mp3'], 0x0F: ['audio', 'aac'], 0x11: ['audio', 'aac_latm'],
+    0x81: ['audio', 'ac3'], 0x87: ['audio', 'eac3'], 0x15: ['data', 'timed_id3']
+};
+// Registration / DVB descriptors that identify private (0x06) streams
+const TS_PRIVATE_DESCRIPTORS = { 0x6A: ['audio', 'ac3'], 0x7A: ['audio', 'eac3'], 0x59: ['subtitle', 'dvb_subtitle'] };
+const AC3_SAMPLE_RATES = [48000, 44100, 32000];
+const AC3_CHANNELS = [2, 1, 2, 3, 3, 4, 4, 5];
+
+function findSync(buffer) {
+    for (let offset = 0; offset + 2 * TS_PACKET < buffer.length && offset < TS_PACKET; offset += 1) {
+        if (buffer[offset] === 0x47 && buffer[offset + TS_PACKET] === 0x47 && buffer[offset + 2 * TS_PACKET] === 0x47) return offset;
+    }
+    return -1;
+}
+
+// Visit every packet's payload: visit(pid, unitStart, payload)
+function forEachTsPacket(buffer, visit) {
+    const sync = findSync(buffer);
+    if (sync < 0) return;
+    for (let offset = sync; offset + TS_PACKET <= buffer.length; offset += TS_PACKET) {
+        if (buffer[offset] !== 0x47) continue;
+        const pid = ((buffer[offset + 1] & 0x1F) << 8) | buffer[offset + 2];
+        const unitStart = Boolean(buffer[offset + 1] & 0x40);
+        const adaptation = (buffer[offset + 3] >> 4) & 3;
+        let payload = offset + 4;
+        if (adaptation === 2) continue;
+        if (adaptation === 3) payload += 1 + buffer[offset + 4];
+        if (payload >= offset + TS_PACKET) continue;
+        visit(pid, unitStart, buffer.subarray(payload, offset + TS_PACKET));
+    }
+}
+
+function readPts(pes) {
+    if (pes.length < 14 || pes[0] !== 0 || pes[1] !== 0 || pes[2] !== 1 || !(pes[7] & 0x80)) return null;
+    return (pes[9] & 0x0E) * 2 ** 29 + pes[10] * 2 ** 22 + (pes[11] & 0xFE) * 2 ** 14 + pes[12] * 2 ** 7 + (pes[13] >> 1);
+}
+
+function psiSection(payload) {
+    const pointer = payload[0];
+    const section = payload.subarray(1 + pointer);
+    if (section.length < 3) return null;
+    const length = ((section[1] & 0x0F) << 8) | section[2];
+    return section.length >= 3 + length ? section.subarray(0, 3 + length) : null;
+}
+
+function findNal(payload, type) {
+    for (let offset = 0; offset + 4 < payload.length; offset += 1) {
+        if (payload[offset] === 0 && payload[offset + 1] === 0 && payload[offset + 2] === 1 && (payload[offset + 3] & 0x1F) === type) {
+            let end = offset + 3;
+            while (end + 2 < payload.length && !(payload[end] === 0 && payload[end + 1] === 0 && payload[end + 2] <= 1)) end += 1;
+            return payload.subarray(offset + 3, end + 2 < payload.length ? end : payload.length);
+        }
+    }
+    return null;
+}
+
+// Codec details from the start of a stream's first PES payload
+function describeTsPayload(stream, payload) {
+    if (stream.codec_name === 'h264') {
+        const sps = findNal(payload, 7);
+        if (!sps) return false;
+        const { profile, level, width, height } = parseH264Sps(sps);
+        Object.assign(stream, { ...(profile ? { profile } : {}), level, width, height });
+        return true;
+    }
+    if (stream.codec_name === 'aac') {
+        const offset = payload.findIndex((byte, index) => byte === 0xFF && (payload[index + 1] & 0xF6) === 0xF0);
+        if (offset < 0 || offset + 4 > payload.length) return false;
+        const objectType = (payload[offset + 2] >> 6) + 1;
+        const sampleRate = AAC_SAMPLE_RATES[(payload[offset + 2] >> 2) & 0x0F];
+        const channels = ((payload[offset + 2] & 1) << 2) | (payload[offset + 3] >> 6);
+        Object.assign(stream, audioStream({ profile: AAC_PROFILES[objectType] }, sampleRate, channels));
+        return true;
+    }
+    if (stream.codec_name === 'ac3') {
+        const offset = payload.indexOf(Buffer.from([0x0B, 0x77]));
+        if (offset < 0 || offset + 8 > payload.length) return false;
+        const reader = new BitReader(payload.subarray(offset + 6));
+        const acmod = reader.u(3);
+        if ((acmod & 1) && acmod !== 1) reader.u(2);
+        if (acmod & 4) reader.u(2);
+        if (acmod === 2) reader.u(2);
+        const channels = AC3_CHANNELS[acmod] + reader.u(1);
+        Object.assign(stream, audioStream({}, AC3_SAMPLE_RATES[payload[offset + 4] >> 6], channels));
+        return true;
+    }
+    // No header parser: ffprobe is needed for the essentials of video, the rest is optional
+    return stream.codec_type !== 'video';
+}
+
+// Track the latest presentation time; B-frames reorder PTS, so keep the furthest from the start
+function notePts(state, pts) {
+    const offset = (pts - state.firstPts + PTS_WRAP) % PTS_WRAP;
+    if (state.lastPts === null || offset >= (state.lastPts - state.firstPts + PTS_WRAP) % PTS_WRAP) state.lastPts = pts;
+}
+
+async function sniffTs(reader, head) {
+    const programs = new Set();
+    const streams = new Map(); // pid -> { stream, firstPts, lastPts, frameTicks, payload, done }
+    let pmtSeen = false;
+
+    forEachTsPacket(head, (pid, unitStart, payload) => {
+        if (pid === 0 && unitStart && !programs.size) {
+            const section = psiSection(payload);
+            if (!section || section[0] !== 0x00) return;
+            for (let offset = 8; offset + 4 <= section.length - 4; offset += 4) {
+                const program = section.readUInt16BE(offset);
+                if (program !== 0) programs.add(section.readUInt16BE(offset + 2) & 0x1FFF);
+            }
+            return;
+        }
+        if (programs.has(pid) && unitStart && !pmtSeen) {
+            const section = psiSection(payload);
+            if (!section || section[0] !== 0x02) return;
+            pmtSeen = true;
+            const infoLength = section.readUInt16BE(10) & 0x0FFF;
+            for (let offset = 12 + infoLength; offset + 5 <= section.length - 4;) {
+                const streamType = section[offset];
+                const esPid = section.readUInt16BE(offset + 1) & 0x1FFF;
+                const esLength = section.readUInt16BE(offset + 3) & 0x0FFF;
+                let kind = TS_STREAM_TYPES[streamType];
+                for (let descriptor = offset + 5; !kind && descriptor + 2 <= offset + 5 + esLength; descriptor += 2 + section[descriptor + 1]) {
+                    kind = TS_PRIVATE_DESCRIPTORS[section[descriptor]];
+                }
+                const [codecType, codecName] = kind || ['data', 'bin_data'];
+                streams.set(esPid, {
+                    stream: { codec_name: codecName, codec_type: codecType, time_base: '1/90000' },
+                    firstPts: null, previousPts: null, lastPts: null, frameTicks: null, payload: [], done: false
+                });
+                offset += 5 + esLength;
+            }
+            return;
+        }
+        const state = streams.get(pid);
+        if (!state) return;
+        if (unitStart) {
+            const pts = readPts(payload);
+            if (pts !== null) {
+                if (state.firstPts === null) state.firstPts = pts;
+                // Smallest forward step between consecutive PES is one frame, reordering or not
+                const step = state.previousPts === null ? 0 : pts - state.previousPts;
+                if (step > 0 && (state.frameTicks === null || step < state.frameTicks)) state.frameTicks = step;
+                state.previousPts = pts;
+                notePts(state, pts);
+            }
+            if (state.payload.length) state.done = true;
+            if (!state.done) state.payload.push(payload.subarray(Math.min(payload.length, 9 + payload[8])));
+        } else if (state.payload.length && !state.done) {
+            state.payload.push(payload);
+        }
+    });
+    if (!streams.size) return null;
+
+    // Last PTS of each stream from the tail of the file
+    if (reader.total !== null && reader.total > head.length) {
+        const tailStart = Math.max(head.length, reader.total - TAIL_BYTES);
+        const tail = await reader.read(tailStart, reader.total - tailStart);
+        forEachTsPacket(tail, (pid, unitStart, payload) => {
+            const state = streams.get(pid);
+            const pts = unitStart && state && state.firstPts !== null ? readPts(payload) : null;
+            if (pts !== null) notePts(state, pts);
+        });
+    }
+
+    let start = Infinity;
+    let end = 0;
+    for (const state of streams.values()) {
+        if (state.firstPts === null) continue;
+        if (!describeTsPayload(state.stream, Buffer.concat(state.payload))) return null;
+        const frameTicks = state.stream.codec_type === 'video' ? state.frameTicks || 0 : 0;
+        const length = (state.lastPts - state.firstPts + PTS_WRAP) % PTS_WRAP + frameTicks;
+        Object.assign(state.stream, {
+            start_pts: state.firstPts,
+            start_time: seconds(state.firstPts / 90000),
+            duration_ts: length,
+            duration: seconds(length / 90000)
+        });
+        if (state.stream.codec_type === 'video' && frameTicks) {
+            state.stream.r_frame_rate = ratio(90000, frameTicks);
+            state.stream.avg_frame_rate = state.stream.r_frame_rate;
+        }
+        start = Math.min(start, state.firstPts);
+        end = Math.max(end, state.firstPts + length);
+    }
+    const described = [...streams.values()].filter(state => state.firstPts !== null).map(state => state.stream);
+    if (!described.length || end <= start) return null;
+    const result = describeFormat(TS_FORMAT, described, (end - start) / 90000, reader.total, start / 90000);
+    result.format.nb_programs = programs.size;
+    return result;
+}
+
+// ---------------------------------------------------------------------------------------------
+
+/**
+ * Probe a progressive media URL without ffprobe. Resolves to ffprobe's -show_format
+ * -show_streams JSON shape, or null when the container or its contents need ffprobe.
+ */
+export async function sniffMedia(url, headers) {
+    const reader = new RangeReader(url, headers);
+    try {
+        const head = await reader.read(0, HEAD_BYTES);
+        let result = null;
+        let container = null;
+        if (head.length >= 12 && MP4_TOP_LEVEL.has(head.toString('latin1', 4, 8))) {
+            container = 'mp4';
+            result = await sniffMp4(reader);
+        } else if (head.length >= 4 && head.readUInt32BE(0) === EBML.HEADER) {
+            container = 'matroska';
+            result = await sniffMatroska(reader, head);
+        } else if (findSync(head) === 0) {
+            container = 'mpegts';
+            result = await sniffTs(reader, head);
+        }
+        logDebug(`[Sniffer] ${container || 'unknown container'}: ${result ? 'described' : 'left to ffprobe'} after ${reader.requests} request(s)`);
+        if (result) result.format = { filename: url, ...result.format };
+        return result;
+    } catch (err) {
+        logDebug('[Sniffer] Failed, falling back to ffprobe:', err.message);
+        return null;
+    }
+}
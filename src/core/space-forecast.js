@@ -0,0 +1,151 @@
+import fs from 'fs';
+import { parseHlsMediaPlaylist, parseHlsMasterPlaylist, byteRangeLength } from '../utils/playlist';
+import { logDebug } from '../utils/utils';
+
+/**
+ * Space Forecast – Expected output size of a download, checked against free space up front
+ *
+ * Stream jobs are sized from their inline manifests before ffmpeg or the native assembler
+ * starts: HLS media playlists by their EXT-X-BYTERANGE sums (exact) or by a `bandwidth` hint
+ * on the input × duration, DASH by the highest @bandwidth per content type ×
+ * mediaPresentationDuration. An explicit `expectedSize` on the request wins. Direct downloads
+ * are checked once Content-Length arrives. Inputs that cannot be sized are left out, so a
+ * forecast is a lower bound and only fails jobs that cannot fit whatever the rest weighs.
+ * Forecasts of other running jobs on the same volume, minus what they already wrote, count
+ * as taken.
+ */
+
+// Bitrate estimates run high (peak BANDWIDTH, TS overhead dropped by remuxing); only fail
+// when this share of the estimate doesn't fit
+const ESTIMATE_REQUIRED_SHARE = 0.9;
+
+const commitments = new Map(); // downloadId -> { dev, bytes, outputPath }
+
+function parseIsoDuration(text) {
+    const match = /^P(?:(\d+(?:\.\d+)?)D)?(?:T(?:(\d+(?:\.\d+)?)H)?(?:(\d+(?:\.\d+)?)M)?(?:(\d+(?:\.\d+)?)S)?)?$/.exec(String(text || '').trim());
+    if (!match) return null;
+    const [, days = 0, hours = 0, minutes = 0, seconds = 0] = match;
+    const total = Number(days) * 86400 + Number(hours) * 3600 + Number(minutes) * 60 + Number(seconds);
+    return total > 0 ? total : null;
+}
+
+function readAttribute(tag, name) {
+    const match = new RegExp(`\\s${name}\\s*=\\s*["']([^"']*)["']`).exec(tag);
+    return match ? match[1] : null;
+}
+
+// Highest-bandwidth representation per content type; ffmpeg picks those by default
+function estimateDashBytes(content) {
+    if (/\btype\s*=\s*["']dynamic["']/.test(content)) return null;
+    const mpdTag = /<(?:\w+:)?MPD\b[^>]*>/.exec(content);
+    const duration = mpdTag ? parseIsoDuration(readAttribute(mpdTag[0], 'mediaPresentationDuration')) : null;
+    if (!duration) return null;
+
+    const best = new Map();
+    for (const [, setTag, body] of content.matchAll(/(<(?:\w+:)?AdaptationSet\b[^>]*>)([\s\S]*?)<\/(?:\w+:)?AdaptationSet>/g)) {
+        for (const [representationTag] of body.matchAll(/<(?:\w+:)?Representation\b[^>]*>/g)) {
+            const mimeType = readAttribute(representationTag, 'mimeType') || readAttribute(setTag, 'mimeType') || '';
+            const type = readAttribute(setTag, 'contentType') || mimeType.split('/')[0];
+            if (type !== 'video' && type !== 'audio') continue;
+            const bandwidth = Number(readAttribute(representationTag, 'bandwidth')) || 0;
+            best.set(type, Math.max(best.get(type) || 0, bandwidth));
+        }
+    }
+    const bitsPerSecond = [...best.values()].reduce((sum, value) => sum + value, 0);
+    return bitsPerSecond ? { bytes: Math.round(bitsPerSecond * duration / 8), exact: false } : null;
+}
+
+function estimateHlsBytes(content, baseUrl, bandwidth) {
+    if (parseHlsMasterPlaylist(content, baseUrl)) return null; // no duration without the media playlist
+    const playlist = parseHlsMediaPlaylist(content, baseUrl);
+    if (!playlist || !playlist.endList) return null;
+
+    const parts = [playlist.initSection, ...playlist.segments].filter(Boolean);
+    if (parts.every(part => byteRangeLength(part.range) !== null)) {
+        return { bytes: parts.reduce((total, part) => total + byteRangeLength(part.range), 0), exact: true };
+    }
+    return bandwidth > 0 ? { bytes: Math.round(bandwidth * playlist.duration / 8), exact: false } : null;
+}
+
+/**
+ * Forecast the output size of a download-v2 request: { bytes, exact, complete } or null.
+ * `complete` is false when some inputs could not be sized.
+ */
+export function estimateDownloadBytes(request) {
+    const expected = Number(request.expectedSize);
+    if (expected > 0) return { bytes: expected, exact: true, complete: true };
+    if (!Array.isArray(request.inlineInputs) || request.inlineInputs.length === 0) return null;
+
+    let bytes = 0;
+    let exact = true;
+    let complete = true;
+    for (const input of request.inlineInputs) {
+        const content = String(input?.content || '');
+        const estimate = input?.format === 'dash'
+            ? estimateDashBytes(content)
+            : input?.format === 'hls' ? estimateHlsBytes(content, input.baseUrl, Number(input.bandwidth) || 0) : null;
+        if (!estimate) {
+            complete = false;
+            continue;
+        }
+        bytes += estimate.bytes;
+        exact = exact && estimate.exact;
+    }
+    return bytes > 0 ? { bytes, exact, complete } : null;
+}
+
+function remainingBytes(commitment) {
+    let written = 0;
+    try { if (commitment.outputPath) written = fs.statSync(commitment.outputPath).size; } catch { /* not created yet */ }
+    return Math.max(0, commitment.bytes - written);
+}
+
+function formatSize(bytes) {
+    const units = ['B', 'KB', 'MB', 'GB', 'TB'];
+    let value = bytes;
+    let unit = 0;
+    while (value >= 1024 && unit < units.length - 1) {
+        value /= 1024;
+        unit += 1;
+    }
+    return `${value.toFixed(unit ? 1 : 0)} ${units[unit]}`;
+}
+
+/**
+ * Reserve `forecast.bytes` on the volume of `dir` for downloadId. `free` is the diskspace
+ * helper's answer for dir (null when unknown, which always passes). Returns null when the
+ * job fits, or the download-finished failure to send back.
+ */
+export function reserveDownloadSpace(downloadId, { dir, outputPath, forecast, free }) {
+    if (!forecast || free === null || free === undefined) return null;
+    let dev = null;
+    try { dev = fs.statSync(dir).dev; } catch { return null; }
+
+    let committed = 0;
+    for (const [otherId, commitment] of commitments) {
+        if (otherId !== downloadId && commitment.dev === dev) committed += remainingBytes(commitment);
+    }
+    const available = Math.max(0, free - committed);
+    const required = forecast.exact ? forecast.bytes : Math.round(forecast.bytes * ESTIMATE_REQUIRED_SHARE);
+    logDebug(`[SpaceForecast] ${downloadId}: ~${formatSize(forecast.bytes)} forecast${forecast.exact ? ' (exact)' : ''}${forecast.complete === false ? ' (partial)' : ''}, ${formatSize(free)} free, ${formatSize(committed)} committed`);
+
+    if (required > available) {
+        return {
+            command: 'download-finished',
+            downloadId,
+            success: false,
+            fileExists: false,
+            key: 'insufficientSpace',
+            error: `Not enough disk space: about ${formatSize(required)} needed, ${formatSize(available)} available`,
+            substitutions: [formatSize(required), formatSize(available)],
+            requiredBytes: required,
+            availableBytes: available
+        };
+    }
+    commitments.set(downloadId, { dev, bytes: forecast.bytes, outputPath });
+    return null;
+}
+
+export function releaseDownloadSpace(downloadId) {
+    commitments.delete(downloadId);
+}
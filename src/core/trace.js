@@ -0,0 +1,191 @@
+import fs from 'fs';
+import path from 'path';
+import { TRACE_DIR, TRACE_FLAG_FILE, TRACE_MAX_FILES, TRACE_FLUSH_MS } from '../utils/config';
+
+/**
+ * Trace – Fixed-size binary hot-path events for offline timing analysis
+ *
+ * File layout (little-endian), shared with tools/common/mvd_trace.h and tools/trace:
+ *   header  16 bytes: "MVDTRACE" | u32 version | u32 record size (32)
+ *   record  32 bytes: u64 ts_ns | u32 pid | u16 event | u8 phase | u8 flags | u32 scope | u32 aux | u64 value
+ *
+ * LABEL records carry a string in the following ceil(aux / 32) slots, so every write stays
+ * a whole number of records and helpers can append to the same file with O_APPEND.
+ * Timestamps come from the monotonic clock, which spawned helpers read too.
+ *
+ * Enabled by MVD_TRACE=1 or by the flag file toggled with `mvdcoapp --trace on|off`.
+ */
+
+export const TraceEvent = {
+    LABEL: 1,
+    PROCESS_START: 2,
+    REQUEST_RECEIVED: 3,
+    ROUTE_REQUEST: 4,
+    HANDLER: 5,
+    GET_FREE_DISK_SPACE: 6,
+    ENSURE_UNIQUE_FILENAME: 7,
+    STAGE_INLINE_INPUTS: 8,
+    SPAWN: 9,
+    FIRST_BYTE: 10,
+    PROGRESS_FLUSH: 11,
+    DOWNLOAD_FINISHED: 12,
+    PROCESS_EXIT: 13,
+    HELPER: 14
+};
+
+const TRACE_VERSION = 1;
+const RECORD_SIZE = 32;
+const BUFFER_RECORDS = 2048;
+const PHASE_BEGIN = 0x42; // 'B'
+const PHASE_END = 0x45;   // 'E'
+const PHASE_INSTANT = 0x69; // 'i'
+
+let enabled = false;
+let fd = null;
+let buffer = null;
+let offset = 0;
+let flushTimer = null;
+const labels = new Map();
+
+function pruneOldTraces() {
+    try {
+        const files = fs.readdirSync(TRACE_DIR)
+            .filter(name => name.endsWith('.mvdtrace'))
+            .sort();
+        for (const name of files.slice(0, Math.max(0, files.length - TRACE_MAX_FILES + 1))) {
+            fs.unlinkSync(path.join(TRACE_DIR, name));
+        }
+    } catch { /* ignore */ }
+}
+
+function writeHeader() {
+    const header = Buffer.alloc(16);
+    header.write('MVDTRACE', 0, 'ascii');
+    header.writeUInt32LE(TRACE_VERSION, 8);
+    header.writeUInt32LE(RECORD_SIZE, 12);
+    fs.writeSync(fd, header);
+}
+
+function scheduleFlush() {
+    if (flushTimer) return;
+    flushTimer = setTimeout(flushTrace, TRACE_FLUSH_MS);
+    flushTimer.unref?.();
+}
+
+function reserve(slots) {
+    if (offset + slots * RECORD_SIZE > buffer.length) flushTrace();
+    const at = offset;
+    offset += slots * RECORD_SIZE;
+    buffer.fill(0, at, offset);
+    scheduleFlush();
+    return at;
+}
+
+function writeRecord(event, phase, scope, aux, value, extraSlots = 0) {
+    const at = reserve(1 + extraSlots);
+    buffer.writeBigUInt64LE(process.hrtime.bigint(), at);
+    buffer.writeUInt32LE(process.pid, at + 8);
+    buffer.writeUInt16LE(event, at + 12);
+    buffer.writeUInt8(phase, at + 14);
+    buffer.writeUInt32LE(scope >>> 0, at + 16);
+    buffer.writeUInt32LE(aux >>> 0, at + 20);
+    buffer.writeBigUInt64LE(BigInt(Math.max(0, Math.floor(Number(value) || 0))), at + 24);
+    return at + RECORD_SIZE;
+}
+
+/**
+ * Open a per-session trace file when tracing is switched on.
+ * Exports MVD_TRACE_FILE so spawned helpers append to the same file.
+ */
+export function initTrace(processName = 'mvdcoapp') {
+    if (enabled) return;
+    if (process.env.MVD_TRACE !== '1' && !fs.existsSync(TRACE_FLAG_FILE)) return;
+
+    try {
+        fs.mkdirSync(TRACE_DIR, { recursive: true });
+        pruneOldTraces();
+        const stamp = new Date().toISOString().replace(/[:.]/g, '-');
+        const tracePath = path.join(TRACE_DIR, `trace-${stamp}-${process.pid}.mvdtrace`);
+        fd = fs.openSync(tracePath, 'a');
+        writeHeader();
+        buffer = Buffer.alloc(BUFFER_RECORDS * RECORD_SIZE);
+        enabled = true;
+        process.env.MVD_TRACE_FILE = tracePath;
+        process.on('exit', (code) => {
+            traceInstant(TraceEvent.PROCESS_EXIT, 0, code || 0);
+            flushTrace();
+        });
+        traceInstant(TraceEvent.PROCESS_START, 0, traceLabel(processName));
+    } catch {
+        enabled = false;
+        fd = null;
+    }
+}
+
+export function isTraceEnabled() {
+    return enabled;
+}
+
+export function flushTrace() {
+    if (flushTimer) {
+        clearTimeout(flushTimer);
+        flushTimer = null;
+    }
+    if (!enabled || offset === 0) return;
+    try {
+        fs.writeSync(fd, buffer, 0, offset);
+    } catch { /* ignore */ }
+    offset = 0;
+}
+
+/**
+ * Intern a string and return its label id (0 when tracing is off).
+ */
+export function traceLabel(text) {
+    if (!enabled) return 0;
+    const value = String(text ?? '');
+    const existing = labels.get(value);
+    if (existing) return existing;
+
+    const id = labels.size + 1;
+    labels.set(value, id);
+    const bytes = Buffer.from(value, 'utf8').subarray(0, 255);
+    const slots = Math.ceil(bytes.length / RECORD_SIZE);
+    // Label and payload are reserved together so one flush never splits them
+    bytes.copy(buffer, writeRecord(TraceEvent.LABEL, PHASE_INSTANT, id, bytes.length, 0, slots));
+    return id;
+}
+
+/**
+ * Map a correlation key (downloadId, request id) to a 32-bit scope (FNV-1a).
+ */
+export function traceScope(key) {
+    if (!enabled || key == null) return 0;
+    const text = String(key);
+    let hash = 0x811c9dc5;
+    for (let i = 0; i < text.length; i++) {
+        hash ^= text.charCodeAt(i);
+        hash = Math.imul(hash, 0x01000193);
+    }
+    return hash >>> 0;
+}
+
+export function traceBegin(event, scope = 0, aux = 0, value = 0) {
+    if (enabled) writeRecord(event, PHASE_BEGIN, scope, aux, value);
+}
+
+export function traceEnd(event, scope = 0, aux = 0, value = 0) {
+    if (enabled) writeRecord(event, PHASE_END, scope, aux, value);
+}
+
+export function traceInstant(event, scope = 0, aux = 0, value = 0) {
+    if (enabled) writeRecord(event, PHASE_INSTANT, scope, aux, value);
+}
+
+/**
+ * Toggle the persistent flag file (CLI: --trace on|off)
+ */
+export function setTraceFlag(on) {
+    if (on) fs.writeFileSync(TRACE_FLAG_FILE, '');
+    else if (fs.existsSync(TRACE_FLAG_FILE)) fs.unlinkSync(TRACE_FLAG_FILE);
+}
@@ -0,0 +1,233 @@
+import { spawn } from 'child_process';
+import crypto from 'crypto';
+import fs from 'fs';
+import { Transform } from 'stream';
+import { logDebug, getFullEnv, checkBinaries } from '../utils/utils';
+import { BINARIES, WRITER_DIRTY_BUDGET_MB } from '../utils/config';
+import { register } from './processes';
+import { traceInstant, traceLabel, TraceEvent } from './trace';
+
+/**
+ * Writer – Output sinks for direct downloads
+ *
+ * Prefers the mvd-writer helper (io_uring on Linux, pwrite thread pool elsewhere), which
+ * turns the response stream into large queued writes. Falls back to fs.createWriteStream
+ * when the helper is missing or unsupported on the platform.
+ *
+ * Sinks can digest the bytes as they are written (`hashes`: 'xxh3', 'sha256'); the results
+ * land in `sink.digests` once `done` settles.
+ *
+ * The helper keeps at most `dirtyBudgetMb` of the output in the page cache behind the write
+ * head (0 leaves caching to the kernel), so multi-GB downloads and long recordings don't
+ * push the user's working set out of memory. Outputs of known size can be preallocated
+ * (`preallocateBytes`, or `preallocate` for --fetch) on filesystems that support it.
+ */
+
+const HASH_ALGORITHMS = ['xxh3', 'sha256'];
+
+function parseHashList(value) {
+    const names = (Array.isArray(value) ? value : String(value || '').split(','))
+        .map(name => String(name).trim().toLowerCase())
+        .filter(Boolean);
+    return [...new Set(names)];
+}
+
+/**
+ * Supported digest names from a request's `hash` field ('xxh3,sha256' or ['sha256'])
+ */
+export function normalizeHashList(value) {
+    const names = parseHashList(value);
+    return HASH_ALGORITHMS.filter(name => names.includes(name));
+}
+
+/**
+ * Names from a request's `hash` field that `digests` has no value for: unknown algorithms,
+ * outputs no sink digests (ffmpeg muxing into mp4/mkv/webm, segmented recordings) and
+ * xxh3 on the fs fallback
+ */
+export function listUnavailableHashes(value, digests) {
+    return parseHashList(value).filter(name => !digests?.[name]);
+}
+
+/**
+ * Record an XXH3=/SHA256= line printed by the helpers; returns false for other lines
+ */
+export function readDigestLine(line, digests) {
+    const match = /^(XXH3|SHA256)=([0-9a-f]+)$/.exec(line.trim());
+    if (!match) return false;
+    digests[match[1].toLowerCase()] = match[2];
+    return true;
+}
+
+function createFileSink(filePath, hashes) {
+    const file = fs.createWriteStream(filePath);
+    // Node's crypto has no xxh3; that digest needs the native writer
+    const hasher = hashes.includes('sha256') ? crypto.createHash('sha256') : null;
+    const stream = hasher
+        ? new Transform({
+            transform(chunk, encoding, callback) {
+                hasher.update(chunk);
+                callback(null, chunk);
+            }
+        })
+        : file;
+    if (hasher) stream.pipe(file);
+
+    const sink = {
+        stream,
+        backend: 'fs',
+        digests: {},
+        destroy(error) {
+            stream.destroy(error);
+            if (stream !== file) file.destroy(error);
+        }
+    };
+    sink.done = new Promise((resolve, reject) => {
+        file.on('finish', () => {
+            if (hasher) sink.digests.sha256 = hasher.digest('hex');
+            resolve();
+        });
+        file.on('error', reject);
+        if (stream !== file) stream.on('error', reject);
+    });
+    return sink;
+}
+
+function createNativeSink(writerPath, filePath, traceId, hashes, dirtyBudgetMb, preallocateBytes) {
+    const args = ['--output', filePath];
+    if (hashes.length) args.push('--hash', hashes.join(','));
+    if (dirtyBudgetMb > 0) args.push('--dirty-mb', String(Math.round(dirtyBudgetMb)));
+    if (preallocateBytes > 0) args.push('--preallocate', String(preallocateBytes));
+    const child = spawn(writerPath, args, { env: getFullEnv() });
+    register(child);
+    traceInstant(TraceEvent.SPAWN, traceId, traceLabel('writer'), child.pid || 0);
+
+    let stdout = '';
+    let stderr = '';
+    child.stdout.on('data', (chunk) => { stdout += chunk.toString(); });
+    child.stderr.on('data', (chunk) => { stderr += chunk.toString(); });
+
+    const sink = {
+        stream: child.stdin,
+        backend: 'writer',
+        digests: {},
+        destroy() {
+            if (!child.killed) child.kill('SIGKILL');
+        }
+    };
+
+    sink.done = new Promise((resolve, reject) => {
+        // EPIPE on stdin only means the helper died first; its exit status carries the reason
+        child.stdin.on('error', () => {});
+        child.on('error', reject);
+        child.on('close', (code, signal) => {
+            const backend = /BACKEND=(\w+)/.exec(stdout);
+            if (backend) sink.backend = backend[1];
+            if (code === 0) {
+                stdout.split('\n').forEach(line => readDigestLine(line, sink.digests));
+                resolve();
+                return;
+            }
+            reject(new Error(stderr.trim() || `Writer exited with ${signal || `code ${code}`}`));
+        });
+    });
+    return sink;
+}
+
+/**
+ * Open a sink for filePath. `sink.stream` is the writable to pipe into,
+ * `sink.done` settles once every byte is on disk (or the write failed).
+ */
+export function createOutputSink(filePath, { traceId = 0, nativeWriter = true, hashes = [], dirtyBudgetMb = WRITER_DIRTY_BUDGET_MB, preallocateBytes = 0 } = {}) {
+    if (nativeWriter && BINARIES.writer) {
+        try {
+            return createNativeSink(checkBinaries('writer'), filePath, traceId, hashes, dirtyBudgetMb, preallocateBytes);
+        } catch (err) {
+            logDebug('[Writer] Native writer unavailable, using fs stream:', err.message);
+        }
+    }
+    return createFileSink(filePath, hashes);
+}
+
+const WRITER_EXIT_HTTP = 5;
+const WRITER_EXIT_UNSUPPORTED = 7;
+
+/**
+ * Download a plain-HTTP URL straight into filePath with the writer's --fetch mode, which
+ * splices socket data into the file on Linux. Returns null when the helper is unavailable.
+ * `job.done` resolves to true when finished, or false when the helper declined the URL
+ * (TLS redirect, chunked body) before writing anything, so the caller can use Node's stack.
+ * Requested `hashes` are filled into `job.digests`; hashing reads the socket instead of splicing.
+ */
+export function spliceHttpDownload(url, filePath, { headers = null, traceId = 0, onProgress = null, hashes = [], dirtyBudgetMb = WRITER_DIRTY_BUDGET_MB, preallocate = false } = {}) {
+    if (!BINARIES.writer || !url.startsWith('http:')) return null;
+    let writerPath;
+    try {
+        writerPath = checkBinaries('writer');
+    } catch {
+        return null;
+    }
+
+    const args = ['--output', filePath, '--fetch', url];
+    for (const [name, value] of Object.entries(headers || {})) {
+        if (/[\r\n]/.test(name) || /[\r\n]/.test(value)) continue;
+        args.push('--header', `${name}: ${value}`);
+    }
+    if (hashes.length) args.push('--hash', hashes.join(','));
+    if (dirtyBudgetMb > 0) args.push('--dirty-mb', String(Math.round(dirtyBudgetMb)));
+    if (preallocate) args.push('--preallocate', 'auto');
+
+    const child = spawn(writerPath, args, { env: getFullEnv() });
+    register(child);
+    traceInstant(TraceEvent.SPAWN, traceId, traceLabel('writer-fetch'), child.pid || 0);
+
+    let abortError = null;
+    let stdoutBuffer = '';
+    let stderr = '';
+    let status = 0;
+    let contentLength = null;
+    let backend = null;
+    const digests = {};
+
+    child.stdout.on('data', (chunk) => {
+        stdoutBuffer += chunk.toString();
+        const lines = stdoutBuffer.split('\n');
+        stdoutBuffer = lines.pop();
+        for (const line of lines) {
+            if (readDigestLine(line, digests)) continue;
+            const [key, value] = line.split('=');
+            if (key === 'STATUS') status = Number(value);
+            else if (key === 'CONTENT_LENGTH') contentLength = Number(value);
+            else if (key === 'BACKEND') backend = value;
+            else if ((key === 'PROGRESS' || key === 'BYTES') && onProgress) onProgress(Number(value), contentLength);
+        }
+    });
+    child.stderr.on('data', (chunk) => { stderr += chunk.toString(); });
+
+    const done = new Promise((resolve, reject) => {
+        child.on('error', reject);
+        child.on('close', (code) => {
+            if (abortError) {
+                reject(abortError);
+            } else if (code === 0) {
+                logDebug(`[Writer] Fetched ${url} via ${backend}`);
+                resolve(true);
+            } else if (code === WRITER_EXIT_UNSUPPORTED) {
+                resolve(false);
+            } else if (code === WRITER_EXIT_HTTP) {
+                reject(new Error(`Direct download failed with HTTP ${status}`));
+            } else {
+                reject(new Error(stderr.trim() || `Writer exited with code ${code}`));
+            }
+        });
+    });
+
+    return {
+        done,
+        digests,
+        kill(error) {
+            abortError = error || new Error('Download canceled');
+            if (!child.killed) child.kill('SIGKILL');
+        }
+    };
+}
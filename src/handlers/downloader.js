@@ -3,8 +3,18 @@ import path from 'path';
 import os from 'os';
 import http from 'http';
 import https from 'https';
-import { logDebug, getFreeDiskSpace, normalizeForFsWindows, sanitizeFilename, ensureUniqueFilename } from '../utils/utils';
-import { handleRunTool } from './tools';
+import { logDebug, getFreeDiskSpace, normalizeForFsWindows, sanitizeFilename, ensureUniqueFilename, getPartialOutputPath, finalizeOutput, normalizeDownloadHeaders } from '../utils/utils';
+import { handleRunTool, extractFfmpegHeaders } from './tools';
+import { createOutputSink, spliceHttpDownload, normalizeHashList, listUnavailableHashes } from '../core/writer';
+import { getNativeAssemblyPlan, assembleNatively } from '../core/assembler';
+import { registerBandwidthJob, isBandwidthLimited } from '../core/bandwidth';
+import { acquireDownloadSlot, releaseDownloadSlot, trackDownloadOutput, cancelQueuedDownload } from '../core/admission';
+import { estimateDownloadBytes, reserveDownloadSpace, releaseDownloadSpace } from '../core/space-forecast';
+import { probeDirectory } from '../core/dir-probe';
+import { getSegmentedRecording, getSegmentedOutputArgs, createSegmentedRecorder } from '../core/recorder';
+import { getDeferredFaststartArgs, relocateMoov } from '../core/faststart';
+import { traceBegin, traceEnd, traceInstant, traceScope, TraceEvent } from '../core/trace';
+import { BINARIES } from '../utils/config';
 
 const activeDownloads = new Map();
 
@@ -20,6 +30,13 @@ function resolveSaveDir(raw) {
     return path.resolve(expanded);
 }
 
+// A job's entry reserves its final name from resolution until the output is published;
+// `child` is whatever cancel-download-v2 should stop while a stage runs (null between stages)
+function setActiveChild(downloadId, child) {
+    const entry = activeDownloads.get(downloadId);
+    if (entry) entry.child = child;
+}
+
 function isPathInUse(fullPath) {
     for (const entry of activeDownloads.values()) {
         if (entry?.finalPath === fullPath) return true;
@@ -36,15 +53,67 @@ function buildUiPath(fullPath) {
     return fullPath;
 }
 
-function normalizeDownloadHeaders(headers) {
-    if (!headers || typeof headers !== 'object') return null;
+const PUBLISH_ATTEMPTS = 5;
 
-    const normalized = {};
-    for (const [name, value] of Object.entries(headers)) {
-        if (name === 'timestamp' || value == null) continue;
-        normalized[name] = String(value);
+// Publish a job's partial output under its final name; a failed move keeps the partial file.
+// Without allowOverwrite a file that took the name meanwhile is kept and the next free name used.
+// Requested digests the job couldn't compute are listed in `hashesUnavailable`.
+async function finalizeDownload(result, { downloadId, partialPath, finalPath, allowOverwrite, responder, hashRequest }) {
+    const unavailable = result.success ? listUnavailableHashes(hashRequest, result.hashes) : [];
+    if (unavailable.length) {
+        logDebug(`[Downloader] ${downloadId}: no ${unavailable.join('/')} digest for this output`);
+        result = { ...result, hashesUnavailable: unavailable };
     }
-    return Object.keys(normalized).length > 0 ? normalized : null;
+    if (!fs.existsSync(normalizeForFsWindows(partialPath))) return result;
+    let targetPath = finalPath;
+    try {
+        for (let attempt = 1; ; attempt++) {
+            try {
+                const method = await finalizeOutput(partialPath, targetPath, { overwrite: allowOverwrite });
+                logDebug(`[Downloader] Finalized ${targetPath} (${method})`);
+                return { ...result, path: targetPath, fileExists: true };
+            } catch (err) {
+                if (err.code !== 'EEXIST' || attempt >= PUBLISH_ATTEMPTS) throw err;
+            }
+            const dir = path.dirname(finalPath);
+            const filename = ensureUniqueFilename(dir, path.basename(finalPath), isPathInUse);
+            targetPath = path.join(dir, filename);
+            const entry = activeDownloads.get(downloadId);
+            if (entry) entry.finalPath = targetPath;
+            logDebug(`[Downloader] ${path.basename(finalPath)} was taken meanwhile, publishing as ${filename}`);
+            responder.send({ command: 'filename-resolved', downloadId, resolvedFilename: filename, path: buildUiPath(targetPath) });
+        }
+    } catch (err) {
+        logDebug(`[Downloader] Failed to finalize ${finalPath}:`, err.message);
+        return {
+            ...result,
+            success: false,
+            path: partialPath,
+            fileExists: true,
+            key: err.code || 'EIO',
+            error: `Failed to move output into place: ${err.message}`
+        };
+    }
+}
+
+// Live jobs get strict bandwidth priority; without an explicit flag, an open-ended inline manifest marks one
+function isLiveRequest(request) {
+    if (typeof request.isLive === 'boolean') return request.isLive;
+    return Array.isArray(request.inlineInputs) && request.inlineInputs.some((input) => {
+        const content = String(input?.content || '');
+        if (input?.format === 'hls') return content.includes('#EXTINF') && !content.includes('#EXT-X-ENDLIST');
+        if (input?.format === 'dash') return /\btype\s*=\s*["']dynamic["']/.test(content);
+        return false;
+    });
+}
+
+// MPEG-TS never seeks back into its output, so ffmpeg can stream it to stdout and the
+// writer digests it (or keeps a live recording out of the page cache) on the way to disk;
+// seeking muxers (mp4, mkv) keep writing the file
+function getStreamingOutputArgs(argsBeforeOutput, container) {
+    if (String(container || '').toLowerCase() !== 'ts') return null;
+    const outputArgs = argsBeforeOutput.slice(argsBeforeOutput.lastIndexOf('-i') + 2);
+    return [...argsBeforeOutput, ...(outputArgs.includes('-f') ? [] : ['-f', 'mpegts']), 'pipe:1'];
 }
 
 function isRedirectStatus(statusCode) {
@@ -53,15 +122,46 @@ function isRedirectStatus(statusCode) {
 
 async function startDirectDownload(request, responder, context) {
     const { downloadId, url, headers } = request;
-    const { finalPath, finalFilename } = context;
+    const { finalPath, finalFilename, partialPath, hashes } = context;
     const normalizedHeaders = normalizeDownloadHeaders(headers);
-    const writePath = normalizeForFsWindows(finalPath);
+    const writePath = normalizeForFsWindows(partialPath);
     let requestHandle = null;
     let responseHandle = null;
-    let writeStream = null;
+    let outputSink = null;
+    let spliceJob = null;
+    let digests = {};
     let downloadedBytes = 0;
     let totalBytes = null;
     let lastProgressAt = Date.now();
+    let spaceChecked = false;
+    let spaceFailure = null;
+
+    const sendProgress = () => {
+        if (!totalBytes) return;
+        const now = Date.now();
+        if ((now - lastProgressAt) < 500) return;
+        lastProgressAt = now;
+        traceInstant(TraceEvent.PROGRESS_FLUSH, context.traceId, 0, downloadedBytes);
+        responder.send({
+            command: 'download-progress',
+            downloadId,
+            downloadedBytes,
+            totalBytes,
+            progress: Math.min(99.999, Math.round((downloadedBytes / totalBytes) * 100000) / 1000),
+            elapsedTime: Math.round((now - context.startedAt) / 1000)
+        });
+    };
+
+    // Checked once the size is known; the few bytes written meanwhile are thrown away on failure
+    const checkSpace = (total) => {
+        if (spaceChecked || !total || !context.checkSpace) return;
+        spaceChecked = true;
+        context.checkSpace(total).then((failure) => {
+            if (!failure || controller.killed) return;
+            spaceFailure = failure;
+            controller.kill();
+        });
+    };
 
     const controller = {
         killed: false,
@@ -73,85 +173,110 @@ async function startDirectDownload(request, responder, context) {
             abortError.code = 'ABORT_ERR';
             requestHandle?.destroy(abortError);
             responseHandle?.destroy(abortError);
-            writeStream?.destroy(abortError);
+            outputSink?.destroy(abortError);
+            spliceJob?.kill(abortError);
             return true;
         }
     };
 
-    activeDownloads.set(downloadId, { child: controller, finalPath });
+    setActiveChild(downloadId, controller);
     logDebug('[Downloader] Starting direct download', { downloadId, url, finalPath });
 
     try {
-        await new Promise((resolve, reject) => {
-            const requestUrl = (currentUrl, redirectCount = 0) => {
-                let parsedUrl;
-                try {
-                    parsedUrl = new URL(currentUrl);
-                } catch {
-                    reject(new Error(`Invalid direct download URL: ${currentUrl}`));
-                    return;
+        // Plain-HTTP sources are spliced socket-to-file by the writer helper when possible.
+        // Those bytes never reach JS: a job is only spliced while no limit is set, and a limit
+        // set later can't slow it (set-bandwidth reports it as not shapeable)
+        let fetchedNatively = false;
+        const shaped = isBandwidthLimited() && context.shaper && !context.shaper.live;
+        if (request.nativeSplice !== false && !shaped) {
+            spliceJob = spliceHttpDownload(url, writePath, {
+                headers: normalizedHeaders,
+                traceId: context.traceId,
+                hashes,
+                dirtyBudgetMb: request.dirtyBudgetMb,
+                preallocate: context.preallocate,
+                onProgress: (bytes, total) => {
+                    downloadedBytes = bytes;
+                    if (total) totalBytes = total;
+                    checkSpace(total);
+                    sendProgress();
                 }
+            });
+            if (spliceJob && context.shaper) context.shaper.shapeable = false;
+            if (spliceJob) fetchedNatively = await spliceJob.done;
+            if (fetchedNatively) digests = spliceJob.digests;
+            else if (context.shaper) context.shaper.shapeable = true;
+        }
 
-                const transport = parsedUrl.protocol === 'https:' ? https : http;
-                requestHandle = transport.get(currentUrl, normalizedHeaders ? { headers: normalizedHeaders } : undefined, (response) => {
-                    responseHandle = response;
+        if (!fetchedNatively) {
+            await new Promise((resolve, reject) => {
+                const requestUrl = (currentUrl, redirectCount = 0) => {
+                    let parsedUrl;
+                    try {
+                        parsedUrl = new URL(currentUrl);
+                    } catch {
+                        reject(new Error(`Invalid direct download URL: ${currentUrl}`));
+                        return;
+                    }
 
-                    if (isRedirectStatus(response.statusCode) && response.headers.location) {
-                        response.resume();
-                        if (redirectCount >= 5) {
-                            reject(new Error('Direct download redirect limit exceeded'));
+                    const transport = parsedUrl.protocol === 'https:' ? https : http;
+                    requestHandle = transport.get(currentUrl, normalizedHeaders ? { headers: normalizedHeaders } : undefined, (response) => {
+                        responseHandle = response;
+
+                        if (isRedirectStatus(response.statusCode) && response.headers.location) {
+                            response.resume();
+                            if (redirectCount >= 5) {
+                                reject(new Error('Direct download redirect limit exceeded'));
+                                return;
+                            }
+
+                            if (controller.killed) {
+                                const abortError = new Error('Download canceled');
+                                abortError.code = 'ABORT_ERR';
+                                reject(abortError);
+                                return;
+                            }
+
+                            requestUrl(new URL(response.headers.location, currentUrl).toString(), redirectCount + 1);
                             return;
                         }
 
-                        if (controller.killed) {
-                            const abortError = new Error('Download canceled');
-                            abortError.code = 'ABORT_ERR';
-                            reject(abortError);
+                        if ((response.statusCode || 0) < 200 || (response.statusCode || 0) >= 300) {
+                            response.resume();
+                            reject(new Error(`Direct download failed with HTTP ${response.statusCode || 0}`));
                             return;
                         }
 
-                        requestUrl(new URL(response.headers.location, currentUrl).toString(), redirectCount + 1);
-                        return;
-                    }
-
-                    if ((response.statusCode || 0) < 200 || (response.statusCode || 0) >= 300) {
-                        response.resume();
-                        reject(new Error(`Direct download failed with HTTP ${response.statusCode || 0}`));
-                        return;
-                    }
+                        const parsedTotalBytes = Number(response.headers['content-length']);
+                        totalBytes = Number.isFinite(parsedTotalBytes) && parsedTotalBytes > 0 ? parsedTotalBytes : null;
+                        checkSpace(totalBytes);
+                        outputSink = createOutputSink(writePath, {
+                            traceId: context.traceId,
+                            nativeWriter: request.nativeWriter !== false,
+                            hashes,
+                            dirtyBudgetMb: request.dirtyBudgetMb,
+                            preallocateBytes: context.preallocate ? totalBytes : 0
+                        });
 
-                    const parsedTotalBytes = Number(response.headers['content-length']);
-                    totalBytes = Number.isFinite(parsedTotalBytes) && parsedTotalBytes > 0 ? parsedTotalBytes : null;
-                    writeStream = fs.createWriteStream(writePath);
-
-                    response.on('data', (chunk) => {
-                        downloadedBytes += chunk.length;
-                        if (!totalBytes) return;
-                        const now = Date.now();
-                        if ((now - lastProgressAt) < 500) return;
-                        lastProgressAt = now;
-                        responder.send({
-                            command: 'download-progress',
-                            downloadId,
-                            downloadedBytes,
-                            totalBytes,
-                            progress: Math.min(99.999, Math.round((downloadedBytes / totalBytes) * 100000) / 1000),
-                            elapsedTime: Math.round((now - context.startedAt) / 1000)
+                        response.on('data', (chunk) => {
+                            downloadedBytes += chunk.length;
+                            sendProgress();
                         });
-                    });
 
-                    response.on('error', reject);
-                    writeStream.on('error', reject);
-                    writeStream.on('finish', resolve);
-                    response.pipe(writeStream);
-                });
+                        response.on('error', reject);
+                        outputSink.done.then(resolve, reject);
+                        (context.shaper ? response.pipe(context.shaper.createThrottle()) : response).pipe(outputSink.stream);
+                    });
 
-                requestHandle.on('error', reject);
-            };
+                    requestHandle.on('error', reject);
+                };
 
-            requestUrl(url);
-        });
+                requestUrl(url);
+            });
+            digests = outputSink.digests;
+        }
 
+        traceInstant(TraceEvent.DOWNLOAD_FINISHED, context.traceId, 1, downloadedBytes);
         return {
             command: 'download-finished',
             downloadId,
@@ -159,12 +284,20 @@ async function startDirectDownload(request, responder, context) {
             path: finalPath,
             fileExists: true,
             filename: finalFilename,
-            totalBytes: downloadedBytes || totalBytes || 0
+            totalBytes: downloadedBytes || totalBytes || 0,
+            ...(Object.keys(digests).length ? { hashes: digests } : {})
         };
     } catch (error) {
         controller.killed = true;
+        outputSink?.destroy();
         try { if (fs.existsSync(writePath)) fs.unlinkSync(writePath); } catch { /* ignore best-effort cleanup */  }
+        if (spaceFailure) {
+            logDebug('[Downloader] Direct download stopped, not enough disk space', { downloadId, totalBytes });
+            traceInstant(TraceEvent.DOWNLOAD_FINISHED, context.traceId, 0, downloadedBytes);
+            return spaceFailure;
+        }
         logDebug('[Downloader] Direct download failed', { downloadId, url, finalPath, error: error?.message || String(error) });
+        traceInstant(TraceEvent.DOWNLOAD_FINISHED, context.traceId, 0, downloadedBytes);
         return {
             command: 'download-finished',
             downloadId,
@@ -174,7 +307,7 @@ async function startDirectDownload(request, responder, context) {
             error: error?.message || 'Direct download failed'
         };
     } finally {
-        activeDownloads.delete(downloadId);
+        setActiveChild(downloadId, null);
     }
 }
 
@@ -183,8 +316,12 @@ export async function handleDownload(request, responder) {
     const { command, downloadId } = request;
 
     if (command === 'cancel-download-v2') {
+        if (cancelQueuedDownload(downloadId)) {
+            logDebug(`[Downloader] Canceled queued download ${downloadId}`);
+            return { success: true, from: command, downloadId };
+        }
         const entry = activeDownloads.get(downloadId);
-        if (!entry) return { success: false, from: command, downloadId, error: 'Not found', key: 'ENOENT' };
+        if (!entry?.child) return { success: false, from: command, downloadId, error: 'Not found', key: 'ENOENT' };
 
         const gracefulStopWaitMs = request.gracefulStopWaitMs ?? 15000;
         const forceKillWaitMs = 35000;
@@ -197,12 +334,45 @@ export async function handleDownload(request, responder) {
         return { success: true, from: command, downloadId };
     }
 
-    return startDownload(request, responder);
+    const live = isLiveRequest(request);
+    // Stream downloads wait for a slot; direct downloads are a single socket-to-file copy
+    const queued = command === 'download-v2' && request.queue !== false;
+    if (queued) {
+        const admitted = await acquireDownloadSlot(downloadId, {
+            dir: resolveSaveDir(request.saveDir),
+            priority: request.priority,
+            live,
+            responder
+        });
+        if (!admitted) {
+            return {
+                command: 'download-finished',
+                downloadId,
+                success: false,
+                fileExists: false,
+                canceled: true,
+                key: 'USER_CANCELLED',
+                error: 'Download canceled'
+            };
+        }
+    }
+
+    const shaper = registerBandwidthJob(downloadId, { weight: request.weight, live });
+    try {
+        return await startDownload(request, responder, shaper);
+    } finally {
+        activeDownloads.delete(downloadId);
+        shaper.release();
+        releaseDownloadSpace(downloadId);
+        if (queued) releaseDownloadSlot(downloadId);
+    }
 }
 
-async function startDownload(params, responder) {
-    const { command, downloadId, argsBeforeOutput, inlineInputs, saveDir, filename, container, allowOverwrite = false } = params;
+async function startDownload(params, responder, shaper) {
+    const { command, downloadId, argsBeforeOutput, inlineInputs, segmentCache, headers, saveDir, filename, container, allowOverwrite = false } = params;
     logDebug(`[Downloader] Starting download ${downloadId} (name: ${filename}, dir: ${saveDir})`);
+    const traceId = traceScope(downloadId);
+    const hashes = normalizeHashList(params.hash);
     
     const resolvedDir = resolveSaveDir(saveDir);
     if (!resolvedDir) {
@@ -229,47 +399,164 @@ async function startDownload(params, responder) {
         };
     }
 
-    // Disk space report (once at start as per original)
-    getFreeDiskSpace(resolvedDir).then(free => {
+    // Disk space report (once at start as per original); the space forecast reuses the answer
+    const freeSpace = getFreeDiskSpace(resolvedDir, traceId);
+    freeSpace.then(free => {
         responder.send({ command: 'download-disk-space', downloadId, targetDir: resolvedDir, freeBytes: free });
     });
+    // Filesystem capabilities pick the write strategy (no file is created to learn them)
+    const capabilities = command === 'direct-download' ? probeDirectory(resolvedDir) : null;
 
     const sanitized = sanitizeFilename(filename, `download-${downloadId}`, container);
     
     // If filename already has the extension and we are in allowOverwrite mode (download-as),
     // we should trust the filename more strictly.
+    traceBegin(TraceEvent.ENSURE_UNIQUE_FILENAME, traceId);
     const finalFilename = (allowOverwrite && !isPathInUse(path.join(resolvedDir, filename))) 
         ? filename 
         : ensureUniqueFilename(resolvedDir, sanitized, isPathInUse);
+    traceEnd(TraceEvent.ENSURE_UNIQUE_FILENAME, traceId);
     
     const finalPath = path.resolve(resolvedDir, finalFilename);
-    const spawnPath = normalizeForFsWindows(finalPath);
+    // Reserved before anything else is awaited, so a concurrent job with the same name moves on
+    activeDownloads.set(downloadId, { child: null, finalPath });
+    // Jobs write to a hidden sibling and are renamed into place once finished
+    const partialPath = getPartialOutputPath(finalPath, downloadId);
+    const publish = { downloadId, partialPath, finalPath, allowOverwrite, responder, hashRequest: params.hash };
+    const spawnPath = normalizeForFsWindows(partialPath);
+    try { if (fs.existsSync(spawnPath)) fs.unlinkSync(spawnPath); } catch { /* ignore stale partial from a crashed session */ }
+
+    // Fail before fetching anything when the forecast output cannot fit (live jobs are unbounded)
+    const forecast = isLiveRequest(params) ? null : estimateDownloadBytes(params);
+    if (forecast) {
+        const spaceFailure = reserveDownloadSpace(downloadId, { dir: resolvedDir, outputPath: spawnPath, forecast, free: await freeSpace });
+        if (spaceFailure) {
+            logDebug(`[Downloader] ${downloadId}: ${spaceFailure.error}`);
+            return spaceFailure;
+        }
+    }
+    trackDownloadOutput(downloadId, spawnPath);
     const uiPath = buildUiPath(finalPath);
 
     logDebug(`[Downloader] Path resolved: ${finalPath}`);
     responder.send({ command: 'filename-resolved', downloadId, resolvedFilename: finalFilename, path: uiPath });
 
     if (command === 'direct-download') {
-        return startDirectDownload(params, responder, {
+        const directResult = await startDirectDownload(params, responder, {
             finalPath,
             finalFilename,
-            startedAt: Date.now()
+            partialPath,
+            startedAt: Date.now(),
+            traceId,
+            shaper,
+            hashes,
+            preallocate: (await capabilities)?.fallocate === true,
+            checkSpace: forecast ? null : async (bytes) => reserveDownloadSpace(downloadId, {
+                dir: resolvedDir,
+                outputPath: spawnPath,
+                forecast: { bytes, exact: true },
+                free: await freeSpace
+            })
         });
+        return finalizeDownload(directResult, publish);
     }
 
+    // Plain `-c copy` HLS jobs are assembled natively; ffmpeg stays the fallback
+    const nativePlan = getNativeAssemblyPlan(params);
+    if (nativePlan) {
+        const nativeResult = await assembleNatively(nativePlan, responder, {
+            downloadId,
+            finalPath,
+            finalFilename,
+            partialPath,
+            startedAt: Date.now(),
+            traceId,
+            headers: { ...(extractFfmpegHeaders(argsBeforeOutput) || {}), ...(normalizeDownloadHeaders(headers) || {}) },
+            shaper,
+            hashes,
+            onStart: (controller) => setActiveChild(downloadId, controller)
+        });
+        setActiveChild(downloadId, null);
+        if (nativeResult) return finalizeDownload(nativeResult, publish);
+    }
+
+    // Live recordings asked to come in parts are written as self-contained fragments instead
+    const segmented = isLiveRequest(params) ? getSegmentedRecording(params) : null;
+    let ffmpegChild = null;
+    let streamingArgs = null;
+    let outputSink = null;
+    if (segmented) {
+        streamingArgs = getSegmentedOutputArgs(argsBeforeOutput, segmented.format);
+        outputSink = createSegmentedRecorder(finalPath, {
+            ...segmented,
+            downloadId,
+            traceId,
+            onPart: (partPath) => trackDownloadOutput(downloadId, normalizeForFsWindows(partPath)),
+            onStop: () => {
+                const child = ffmpegChild;
+                try { if (child?.stdin?.writable) child.stdin.write('q\n'); } catch { /* ignore */ }
+                setTimeout(() => child && !child.killed && child.kill('SIGTERM'), 15000);
+            }
+        });
+    } else {
+        streamingArgs = (hashes.length || (isLiveRequest(params) && BINARIES.writer)) ? getStreamingOutputArgs(argsBeforeOutput, container) : null;
+        outputSink = streamingArgs ? createOutputSink(spawnPath, { traceId, hashes, dirtyBudgetMb: params.dirtyBudgetMb }) : null;
+    }
+    // ffmpeg's faststart pass rewrites the whole file; the moov is relocated after the mux instead
+    const deferredFaststartArgs = streamingArgs ? null : getDeferredFaststartArgs(argsBeforeOutput);
+    const startedAt = Date.now();
+    // A sink that dies stops draining ffmpeg's stdout; don't leave ffmpeg blocked on the pipe
+    outputSink?.done.catch(() => ffmpegChild?.kill('SIGKILL'));
+
     const spawnResult = await handleRunTool({
         tool: 'ffmpeg',
-        args: [...argsBeforeOutput, spawnPath],
+        args: streamingArgs || [...(deferredFaststartArgs || argsBeforeOutput), spawnPath],
         inlineInputs,
+        segmentCache,
+        headers,
         timeoutMs: 0,
         job: { kind: 'download', id: downloadId },
         progressCommand: 'download-progress'
     }, responder, {
-        onSpawn: (child) => activeDownloads.set(downloadId, { child, finalPath })
+        onSpawn: (child) => {
+            ffmpegChild = child;
+            setActiveChild(downloadId, child);
+        },
+        shaper,
+        stdoutSink: outputSink?.stream
     });
 
-    activeDownloads.delete(downloadId);
-    const fileExists = fs.existsSync(finalPath);
+    let digests = {};
+    if (outputSink) {
+        if (!outputSink.stream.writableEnded) outputSink.stream.end();
+        try {
+            await outputSink.done;
+            digests = outputSink.digests;
+        } catch (err) {
+            logDebug('[Downloader] Output sink failed', { downloadId, error: err.message });
+            if (spawnResult.success || spawnResult.key === 'USER_CANCELLED') {
+                Object.assign(spawnResult, { success: false, key: 'EIO', error: err.message });
+            }
+        }
+    }
+
+    setActiveChild(downloadId, null);
+    if (deferredFaststartArgs && spawnResult.success && fs.existsSync(spawnPath)) {
+        await relocateMoov(spawnPath, {
+            downloadId,
+            traceId,
+            responder,
+            startedAt,
+            onStart: (child) => setActiveChild(downloadId, child)
+        });
+        setActiveChild(downloadId, null);
+    }
+    // A recording stopped for lack of space keeps its parts but doesn't count as finished
+    if (segmented && outputSink.stopped) {
+        Object.assign(spawnResult, { success: false, ...outputSink.stopped });
+    }
+    const fileExists = segmented ? outputSink.parts.length > 0 : fs.existsSync(spawnPath);
+    traceInstant(TraceEvent.DOWNLOAD_FINISHED, traceId, spawnResult.success ? 1 : 0);
     const stderr = String(spawnResult.stderr || '').split(/\r?\n|\r(?!\n)/).filter(Boolean).slice(-50).join('\n');
 
     const finalResult = {
@@ -278,15 +565,17 @@ async function startDownload(params, responder) {
         success: spawnResult.success,
         ...(spawnResult.code !== undefined ? { code: spawnResult.code } : {}),
         ...(spawnResult.signal ? { signal: spawnResult.signal } : {}),
-        ...(fileExists ? { path: finalPath } : {}),
+        ...(fileExists ? { path: segmented ? outputSink.parts[0] : finalPath } : {}),
         fileExists,
+        ...(segmented && fileExists ? { segmented: true, parts: outputSink.parts, indexPath: outputSink.indexPath } : {}),
         timeout: !!spawnResult.timeout,
         ...(spawnResult.key ? { key: spawnResult.key } : {}),
         ...(spawnResult.error ? { error: spawnResult.error } : {}),
         ...(spawnResult.stdout ? { stdout: spawnResult.stdout } : {}),
         ...(stderr ? { stderr } : {}),
-        ...(Array.isArray(spawnResult.substitutions) && spawnResult.substitutions.length ? { substitutions: spawnResult.substitutions } : {})
+        ...(Array.isArray(spawnResult.substitutions) && spawnResult.substitutions.length ? { substitutions: spawnResult.substitutions } : {}),
+        ...(spawnResult.success && Object.keys(digests).length ? { hashes: digests } : {})
     };
 
-    return finalResult;
+    return finalizeDownload(finalResult, publish);
 }
@@ -3,13 +3,18 @@ import path from 'path';
 import os from 'os';
 import { spawn } from 'child_process';
 import { logDebug, normalizeForFsWindows, CoAppError, checkBinaries, sanitizeFilename, ensureUniqueFilename } from '../utils/utils';
+import { BINARIES } from '../utils/config';
 import { getLinuxDialog } from '../core/linux-dialog';
 import { register } from '../core/processes';
+import { probeDirectory } from '../core/dir-probe';
 
 const getPath = (p) => normalizeForFsWindows(p.path || p.filePath);
 
+// Below this many paths, libuv's stat pool answers faster than spawning the batch helper
+const NATIVE_STAT_MIN_PATHS = 32;
+
 const FS_HANDLERS = {
-    'exists': async (params) => ({ success: true, exists: fs.existsSync(getPath(params)) }),
+    'exists': async (params) => ({ success: true, exists: await fsp.access(getPath(params)).then(() => true, () => false) }),
     
     'mkdir': async (params) => {
         await fsp.mkdir(getPath(params), { recursive: true });
@@ -34,6 +39,8 @@ const FS_HANDLERS = {
         return { success: true };
     },
 
+    'statBatch': statBatch,
+    'probeDirectory': probeDirectoryOperation,
     'openFile': openFile,
     'showInFolder': showInFolder,
     'chooseDirectory': chooseDirectory,
@@ -49,6 +56,100 @@ export async function handleFileSystem(request, responder) {
     return handler(params, responder);
 }
 
+/**
+ * Existence, size and mtime of many paths in one round trip (history views check every
+ * previous download). Results follow the order of `params.paths`:
+ *   { exists: true, size, mtimeMs, type: 'file' | 'directory' | 'other' } | { exists: false[, error] }
+ */
+async function statBatch(params) {
+    const { paths } = params;
+    if (!Array.isArray(paths)) throw new CoAppError('paths array required', 'EINVAL');
+    const targets = paths.map(p => (typeof p === 'string' && p ? normalizeForFsWindows(p) : ''));
+
+    let results = null;
+    if (targets.length >= NATIVE_STAT_MIN_PATHS && BINARIES.fsutil && fs.existsSync(BINARIES.fsutil)) {
+        try {
+            results = await statNative(targets);
+        } catch (err) {
+            logDebug('[FS] statBatch helper failed, using fs.promises:', err.message);
+        }
+    }
+    if (!results) results = await Promise.all(targets.map(statOne));
+    return { success: true, operation: 'statBatch', results };
+}
+
+function describeStat(stats) {
+    const type = stats.isFile() ? 'file' : stats.isDirectory() ? 'directory' : 'other';
+    return { exists: true, size: stats.size, mtimeMs: Math.floor(stats.mtimeMs), type };
+}
+
+async function statOne(target) {
+    if (!target) return { exists: false };
+    try {
+        return describeStat(await fsp.stat(target));
+    } catch (err) {
+        return (err.code === 'ENOENT' || err.code === 'ENOTDIR') ? { exists: false } : { exists: false, error: err.code || 'EIO' };
+    }
+}
+
+const NATIVE_TYPES = { f: 'file', d: 'directory', o: 'other' };
+
+function statNative(targets) {
+    return new Promise((resolve, reject) => {
+        const child = spawn(BINARIES.fsutil, ['stat']);
+        register(child);
+        let stdout = '';
+        let stderr = '';
+        child.stdout.on('data', (chunk) => { stdout += chunk.toString(); });
+        child.stderr.on('data', (chunk) => { stderr += chunk.toString(); });
+        child.stdin.on('error', () => {}); // surfaces as the exit code below
+        child.on('error', reject);
+        child.on('close', (code) => {
+            if (code !== 0) {
+                reject(new Error(stderr.trim() || `mvd-fsutil exited with code ${code}`));
+                return;
+            }
+            const results = new Array(targets.length).fill(null);
+            for (const line of stdout.split('\n')) {
+                const [index, state, a, b, c] = line.split('\t');
+                if (!index || results[index] === undefined) continue;
+                if (state === '1') results[index] = { exists: true, size: Number(a), mtimeMs: Number(b), type: NATIVE_TYPES[c] || 'other' };
+                else if (state === '0') results[index] = { exists: false };
+                else results[index] = { exists: false, error: a || 'EIO' };
+            }
+            if (results.includes(null)) reject(new Error('Incomplete mvd-fsutil output'));
+            else resolve(results);
+        });
+        child.stdin.end(targets.join('\0'));
+    });
+}
+
+/**
+ * Writability and write-strategy support of a directory, without creating a file in it:
+ *   { writable, error, fsType, tmpfile, fallocate, sparse, reflink, atomicRename }
+ * Without the helper only `writable` (from access(2)) is known; the rest is null.
+ */
+async function probeDirectoryOperation(params) {
+    if (!params.path && !params.filePath) throw new CoAppError('path required', 'EINVAL');
+    const dir = getPath(params);
+    const capabilities = await probeDirectory(dir, { fresh: params.fresh === true });
+    if (capabilities) return { success: true, operation: 'probeDirectory', ...capabilities };
+
+    const error = await fsp.access(dir, fs.constants.W_OK).then(() => null, err => err.code || 'EACCES');
+    return {
+        success: true,
+        operation: 'probeDirectory',
+        writable: !error,
+        error,
+        fsType: null,
+        tmpfile: null,
+        fallocate: null,
+        sparse: null,
+        reflink: null,
+        atomicRename: null
+    };
+}
+
 async function openFile(params) {
     const { filePath } = params;
     if (!filePath) throw new CoAppError('File path required', 'EINVAL');
@@ -59,35 +160,42 @@ async function openFile(params) {
         throw new CoAppError('File not found', 'fileNotFound');
     }
 
-    const command = getOpenFileCommand(filePath);
-    await executeSimple(command.cmd, command.args);
+    await executeCommand(getOpenFileCommand(filePath));
     
     return { success: true, operation: 'openFile', filePath };
 }
 
+/**
+ * Reveal `filePath`, or every entry of `filePaths` at once (Linux and macOS select them all
+ * in one file manager window; Windows reveals them one by one).
+ */
 async function showInFolder(params) {
     const { filePath, openFolderOnly = false } = params;
-    if (!filePath) throw new CoAppError('File path required', 'EINVAL');
-    logDebug(`[FS] Request to reveal: ${filePath} (openFolderOnly=${openFolderOnly})`);
+    const filePaths = Array.isArray(params.filePaths) && params.filePaths.length ? params.filePaths : (filePath ? [filePath] : []);
+    if (!filePaths.length) throw new CoAppError('File path required', 'EINVAL');
+    logDebug(`[FS] Request to reveal: ${filePaths.join(', ')} (openFolderOnly=${openFolderOnly})`);
 
-    let command;
+    let commands;
     if (openFolderOnly) {
-        const folderPath = path.dirname(filePath);
+        const folderPath = path.dirname(filePaths[0]);
         if (!fs.existsSync(normalizeForFsWindows(folderPath))) {
             logDebug(`[FS] showInFolder fallback failed: Folder not found at ${folderPath}`);
             throw new CoAppError('Folder not found', 'folderNotFound');
         }
-        command = getOpenFolderCommand(folderPath);
+        commands = [getOpenFolderCommand(folderPath)];
     } else {
-        if (!fs.existsSync(normalizeForFsWindows(filePath))) {
-            logDebug(`[FS] showInFolder failed: File not found at ${filePath}`);
+        const missing = filePaths.find(p => !fs.existsSync(normalizeForFsWindows(p)));
+        if (missing) {
+            logDebug(`[FS] showInFolder failed: File not found at ${missing}`);
             throw new CoAppError('File not found', 'fileNotFound');
         }
-        command = getShowInFolderCommand(filePath);
+        commands = os.platform() === 'win32'
+            ? filePaths.map(p => getShowInFolderCommand([p]))
+            : [getShowInFolderCommand(filePaths)];
     }
 
-    await executeSimple(command.cmd, command.args);
-    return { success: true, operation: 'showInFolder', filePath };
+    for (const command of commands) await executeCommand(command);
+    return { success: true, operation: 'showInFolder', filePath: filePaths[0], ...(params.filePaths ? { filePaths } : {}) };
 }
 
 async function chooseDirectory(params) {
@@ -207,6 +315,16 @@ async function deleteFile(params) {
 
 // --- Platform Command Generators ---
 
+// Linux: mvd-fileui talks to FileManager1 / the OpenURI portal; xdg-open only when neither answers
+function getLinuxFileUiCommand(mode, paths, fallback) {
+    try {
+        const fileuiPath = checkBinaries('fileui');
+        return { cmd: fileuiPath, args: ['--mode', mode, ...paths.flatMap(p => ['--path', p])], fallback };
+    } catch {
+        return fallback;
+    }
+}
+
 function getOpenFileCommand(filePath) {
     if (os.platform() === 'darwin') return { cmd: 'open', args: [filePath] };
     if (os.platform() === 'win32') {
@@ -217,7 +335,7 @@ function getOpenFileCommand(filePath) {
             return { cmd: 'explorer', args: [filePath] };
         }
     }
-    return { cmd: 'xdg-open', args: [filePath] };
+    return getLinuxFileUiCommand('open-file', [filePath], { cmd: 'xdg-open', args: [filePath] });
 }
 
 function getOpenFolderCommand(folderPath) {
@@ -230,20 +348,20 @@ function getOpenFolderCommand(folderPath) {
             return { cmd: 'explorer', args: [folderPath] };
         }
     }
-    return { cmd: 'xdg-open', args: [folderPath] };
+    return getLinuxFileUiCommand('open-folder', [folderPath], { cmd: 'xdg-open', args: [folderPath] });
 }
 
-function getShowInFolderCommand(filePath) {
-    if (os.platform() === 'darwin') return { cmd: 'open', args: ['-R', filePath] };
+function getShowInFolderCommand(filePaths) {
+    if (os.platform() === 'darwin') return { cmd: 'open', args: ['-R', ...filePaths] };
     if (os.platform() === 'win32') {
         try {
             const fileuiPath = checkBinaries('fileui');
-            return { cmd: fileuiPath, args: ['--mode', 'reveal', '--path', filePath] };
+            return { cmd: fileuiPath, args: ['--mode', 'reveal', '--path', filePaths[0]] };
         } catch {
-            return { cmd: 'explorer', args: ['/select,', filePath] };
+            return { cmd: 'explorer', args: ['/select,', filePaths[0]] };
         }
     }
-    return { cmd: 'xdg-open', args: [path.dirname(filePath)] };
+    return getLinuxFileUiCommand('reveal', filePaths, { cmd: 'xdg-open', args: [path.dirname(filePaths[0])] });
 }
 
 async function getChooseDirectoryCommand(title, defaultPath) {
@@ -286,6 +404,17 @@ async function getChooseSaveLocationCommand(defaultName, title, defaultPath) {
 
 // --- Internal Helpers ---
 
+// Run a platform command, then its `fallback` (if any) when it fails
+async function executeCommand(command) {
+    try {
+        return await executeSimple(command.cmd, command.args);
+    } catch (err) {
+        if (!command.fallback) throw err;
+        logDebug(`[FS] ${path.basename(command.cmd)} failed (${String(err.message).trim()}), using ${command.fallback.cmd}`);
+        return executeSimple(command.fallback.cmd, command.fallback.args);
+    }
+}
+
 async function executeSimple(cmd, args, capture = false) {
     return new Promise((resolve, reject) => {
         logDebug(`[FS] Executing: ${cmd} ${args.join(' ')}`);
@@ -314,6 +443,14 @@ async function executeSimple(cmd, args, capture = false) {
 }
 
 async function testWritePermissions(dir) {
+    const capabilities = await probeDirectory(dir, { fresh: true });
+    if (capabilities) {
+        if (capabilities.writable) return;
+        logDebug(`[FS] testWritePermissions failed for ${dir}: ${capabilities.error}`);
+        throw new CoAppError(`Write failed: ${capabilities.error}`, capabilities.error || 'EACCES');
+    }
+
+    // No probe helper: write and remove a real file
     const testFile = path.join(dir, `maxvd_test_${Math.random().toString(36).slice(7)}.tmp`);
     const norm = normalizeForFsWindows(testFile);
     try {
@@ -1,14 +1,17 @@
 import { spawn } from 'child_process';
-import http from 'http';
 import fs, { promises as fsp } from 'fs';
 import path from 'path';
-import { logDebug, getFullEnv, CoAppError, checkBinaries } from '../utils/utils';
+import { logDebug, getFullEnv, CoAppError, checkBinaries, normalizeDownloadHeaders } from '../utils/utils';
 import { TEMP_DIR, DEFAULT_TOOL_TIMEOUT, PREVIEW_TOOL_TIMEOUT } from '../utils/config';
 import { register } from '../core/processes';
+import { traceBegin, traceEnd, traceInstant, traceLabel, traceScope, TraceEvent } from '../core/trace';
+import { openLoopbackSession } from '../core/loopback';
+import { isBandwidthLimited } from '../core/bandwidth';
+import { probeCacheKey, lookupProbe, storeProbe } from '../core/probe-cache';
+import { sniffMedia } from '../core/sniffer';
 
 const MAX_HEAD_TAIL = 128 * 1024; // 128KB
 const STDERR_PROGRESS_FLUSH_MS = 500;
-const LOOPBACK_HOST = '127.0.0.1';
 
 const quoteForShell = (arg) => {
     const s = String(arg);
@@ -26,62 +29,30 @@ const truncateOutput = (output, prefix) => {
     return { [prefix]: head + marker + tail, [prefix + 'Truncated']: truncated, [prefix + 'TotalSize']: totalBytes };
 };
 
-async function closeServer(server) {
-    if (!server) return;
-    server.closeAllConnections?.();
-    await new Promise(resolve => server.close(() => resolve()));
-}
-
-async function startManifestLoopbackServer(manifestEntries) {
-    return new Promise((resolve, reject) => {
-        const entryByPath = new Map(manifestEntries.map(entry => [entry.routePath, entry]));
-        const server = http.createServer((req, res) => {
-            let requestPath = '/';
-            try {
-                requestPath = new URL(req.url || '/', `http://${LOOPBACK_HOST}`).pathname;
-            } catch {
-                res.writeHead(400);
-                res.end();
-                return;
-            }
-            const entry = entryByPath.get(requestPath);
-
-            if (!entry || (req.method !== 'GET' && req.method !== 'HEAD')) {
-                res.writeHead(404);
-                res.end();
-                return;
-            }
-
-            res.writeHead(200, {
-                'Content-Type': entry.mimeType,
-                'Content-Length': entry.byteLength,
-                'Cache-Control': 'no-store'
-            });
-
-            if (req.method === 'HEAD') {
-                res.end();
-                return;
-            }
-
-            res.end(entry.content);
-        });
-        server.keepAliveTimeout = 0;
-        server.headersTimeout = 5000;
-
-        server.once('error', reject);
-        server.listen(0, LOOPBACK_HOST, () => {
-            server.removeListener('error', reject);
-            const address = server.address();
-            if (!address || typeof address === 'string') {
-                server.close(() => reject(new Error('Failed to resolve manifest loopback port')));
-                return;
+/**
+ * Collect the HTTP headers ffmpeg was told to send (-headers, -user_agent, -referer)
+ * so host-side fetches look identical to ffmpeg's own requests.
+ */
+export function extractFfmpegHeaders(args) {
+    const headers = {};
+    for (let index = 0; index < args.length - 1; index += 1) {
+        const flag = args[index];
+        const value = String(args[index + 1]);
+        if (flag === '-headers') {
+            for (const line of value.split(/\r?\n/)) {
+                const colon = line.indexOf(':');
+                if (colon > 0) headers[line.slice(0, colon).trim()] = line.slice(colon + 1).trim();
             }
-            resolve({ server, port: address.port });
-        });
-    });
+        } else if (flag === '-user_agent') {
+            headers['User-Agent'] = value;
+        } else if (flag === '-referer') {
+            headers.Referer = value;
+        }
+    }
+    return Object.keys(headers).length > 0 ? headers : null;
 }
 
-async function stageInlineManifestInputs(args, inlineInputs = []) {
+async function stageInlineManifestInputs(args, inlineInputs = [], options = {}) {
     const stagedArgs = [...args];
 
     if (!Array.isArray(inlineInputs) || inlineInputs.length === 0) {
@@ -91,8 +62,10 @@ async function stageInlineManifestInputs(args, inlineInputs = []) {
         };
     }
 
-    const manifestEntries = [];
-    let manifestServer = null;
+    // With proxying on, segment, playlist and key URIs are swapped for loopback routes that
+    // fetch with the job's headers over pooled connections (and read through the segment
+    // cache when the job asked for it)
+    let session = null;
 
     try {
         for (const inlineInput of inlineInputs) {
@@ -108,58 +81,66 @@ async function stageInlineManifestInputs(args, inlineInputs = []) {
                 throw new Error(`Inline input ${inlineInput?.token || 'unknown'} is missing text content`);
             }
 
-            let extension = null;
             let mimeType = inlineInput?.mimeType || null;
             if (inlineInput?.format === 'dash') {
-                extension = 'mpd';
                 mimeType ||= 'application/dash+xml';
             } else if (inlineInput?.format === 'hls') {
-                extension = 'm3u8';
                 mimeType ||= 'application/vnd.apple.mpegurl';
             } else {
                 throw new Error(`Unsupported inline input format: ${inlineInput?.format || 'unknown'}`);
             }
 
-            const inlineId = `${Date.now()}-${Math.random().toString(36).slice(2)}`;
-            manifestEntries.push({
-                argIndexes,
-                routePath: `/manifest-${inlineId}.${extension}`,
-                mimeType,
+            session ||= await openLoopbackSession({ headers: options.headers, shaper: options.shaper, proxy: options.proxy, cache: options.cache });
+            const servedUrl = session.addManifest(inlineInput.content, {
                 format: inlineInput.format,
-                content: inlineInput.content,
-                byteLength: Buffer.byteLength(inlineInput.content, 'utf8')
+                mimeType,
+                baseUrl: inlineInput.baseUrl
             });
+            for (const argIndex of argIndexes) {
+                stagedArgs[argIndex] = servedUrl;
+            }
+            logDebug(`[Tools] Serving inline ${inlineInput.format} manifest via ${servedUrl}`);
         }
 
-        if (manifestEntries.length > 0) {
-            manifestServer = await startManifestLoopbackServer(manifestEntries);
-            for (const entry of manifestEntries) {
-                const servedUrl = `http://${LOOPBACK_HOST}:${manifestServer.port}${entry.routePath}`;
-                for (const argIndex of entry.argIndexes) {
-                    stagedArgs[argIndex] = servedUrl;
-                }
-                logDebug(`[Tools] Serving inline ${entry.format} manifest via ${servedUrl}`);
-            }
+        if (session?.targets.size || session?.origins.length) {
+            logDebug(`[Tools] Proxying ${session.segmentCount} segments, ${session.targets.size - session.segmentCount} playlists/keys and ${session.origins.length} origins through the loopback server`);
         }
     } catch (error) {
-        await closeServer(manifestServer?.server).catch(() => {});
+        await session?.close().catch(() => {});
         throw error;
     }
 
     return {
         args: stagedArgs,
         async cleanup() {
-            await closeServer(manifestServer?.server).catch(() => {});
+            await session?.close().catch(() => {});
         }
     };
 }
 
+// ffprobe options whose output the sniffer cannot reproduce
+const UNSNIFFABLE_PROBE_FLAGS = new Set(['-show_frames', '-show_packets', '-count_frames', '-count_packets', '-read_intervals', '-select_streams', '-show_entries', '-show_chapters', '-show_programs']);
+
+/**
+ * The http(s) input of a plain `ffprobe -print_format json -show_format/-show_streams URL`
+ * call, or null when the sniffer cannot stand in for it.
+ */
+function sniffableProbeInput(args) {
+    const format = args.findIndex(arg => arg === '-print_format' || arg === '-of');
+    if (format === -1 || !String(args[format + 1]).startsWith('json')) return null;
+    if (!args.includes('-show_format') && !args.includes('-show_streams')) return null;
+    if (args.some(arg => UNSNIFFABLE_PROBE_FLAGS.has(arg))) return null;
+    const inputIndex = args.indexOf('-i');
+    const input = String(inputIndex !== -1 ? args[inputIndex + 1] : args[args.length - 1]);
+    return /^https?:\/\//i.test(input) ? input : null;
+}
+
 /**
  * Universal Tool Handler
  */
 export async function handleRunTool(params, responder, hooks = {}) {
-    const { tool, args, timeoutMs, job, progressCommand, inlineInputs } = params;
-    const { onSpawn, onStderr } = hooks;
+    const { tool, args, timeoutMs, job, progressCommand, inlineInputs, segmentCache = false, headers } = params;
+    const { onSpawn, onStderr, shaper, stdoutSink } = hooks;
     
     try {
         if (!tool || !['ffprobe', 'ffmpeg'].includes(tool)) {
@@ -168,6 +149,30 @@ export async function handleRunTool(params, responder, hooks = {}) {
 
         const toolPath = checkBinaries(tool);
 
+        // Repeat probes of a stream (page reloads, variant lists) are answered without a spawn
+        const probeKey = tool === 'ffprobe' && params.probeCache !== false ? probeCacheKey(params) : null;
+        const cachedProbe = probeKey ? lookupProbe(probeKey) : null;
+        if (cachedProbe) {
+            logDebug(`[Tools] ffprobe result served from cache${job ? ` (${job.kind})` : ''}`);
+            return { ...cachedProbe, cached: true };
+        }
+
+        // Progressive MP4/WebM/TS metadata comes from a range read or two instead of a spawn
+        const sniffInput = tool === 'ffprobe' && params.sniff ? sniffableProbeInput(args) : null;
+        if (sniffInput) {
+            const sniffHeaders = { ...(extractFfmpegHeaders(args) || {}), ...(normalizeDownloadHeaders(headers) || {}) };
+            const sniffed = await sniffMedia(sniffInput, sniffHeaders);
+            if (sniffed) {
+                const output = {
+                    ...(args.includes('-show_streams') ? { streams: sniffed.streams } : {}),
+                    ...(args.includes('-show_format') ? { format: sniffed.format } : {})
+                };
+                const result = { success: true, code: 0, signal: null, ...truncateOutput(JSON.stringify(output, null, 4), 'stdout'), ...truncateOutput('', 'stderr') };
+                if (probeKey) storeProbe(probeKey, result);
+                return { ...result, sniffed: true };
+            }
+        }
+
         let finalArgs = [...args];
         let outputPath = null;
 
@@ -177,7 +182,24 @@ export async function handleRunTool(params, responder, hooks = {}) {
             finalArgs.push('-y', outputPath);
         }
 
-        const stagedInputs = await stageInlineManifestInputs(finalArgs, inlineInputs);
+        const traceId = traceScope(job?.id);
+        traceBegin(TraceEvent.STAGE_INLINE_INPUTS, traceId);
+        // ffmpeg's traffic can only be shaped when it goes through the loopback proxy. Non-live
+        // jobs always take it, so a limit set later still reaches them (throttles pass
+        // everything through while there is none)
+        const proxy = segmentCache || Boolean(shaper && (!shaper.live || isBandwidthLimited()));
+        if (shaper) shaper.shapeable = proxy && Array.isArray(inlineInputs) && inlineInputs.length > 0;
+        // Explicit request headers win over the ones ffmpeg was given, which only reach the loopback server
+        const proxyHeaders = proxy
+            ? { ...(extractFfmpegHeaders(finalArgs) || {}), ...(normalizeDownloadHeaders(headers) || {}) }
+            : null;
+        const stagedInputs = await stageInlineManifestInputs(finalArgs, inlineInputs, {
+            proxy,
+            cache: segmentCache,
+            shaper,
+            headers: proxyHeaders && Object.keys(proxyHeaders).length > 0 ? proxyHeaders : null
+        });
+        traceEnd(TraceEvent.STAGE_INLINE_INPUTS, traceId, 0, Array.isArray(inlineInputs) ? inlineInputs.length : 0);
         finalArgs = stagedInputs.args;
 
         const fallbackTimeout = job?.kind === 'preview' ? PREVIEW_TOOL_TIMEOUT : DEFAULT_TOOL_TIMEOUT;
@@ -203,6 +225,7 @@ export async function handleRunTool(params, responder, hooks = {}) {
             };
             const child = spawn(toolPath, finalArgs, { env: getFullEnv() });
             register(child, job?.kind !== 'download' ? { type: 'processing' } : {});
+            traceInstant(TraceEvent.SPAWN, traceId, traceLabel(tool), child.pid || 0);
             if (onSpawn) onSpawn(child);
 
             let stdout = '';
@@ -222,6 +245,7 @@ export async function handleRunTool(params, responder, hooks = {}) {
                     const marker = `\n...[progress truncated ${buffer.length - 64 * 1024} bytes]...\n`;
                     chunkToSend = head + marker + tail;
                 }
+                traceInstant(TraceEvent.PROGRESS_FLUSH, traceId, 0, bufferBytes);
                 responder.send({ command: progressCommand, downloadId: job?.id, chunk: chunkToSend });
                 stderrBuffer = '';
                 if (stderrTimer) { clearTimeout(stderrTimer); stderrTimer = null; }
@@ -237,8 +261,11 @@ export async function handleRunTool(params, responder, hooks = {}) {
                 }, effectiveTimeout);
             }
 
-            child.stdout?.on('data', d => stdout += d.toString());
+            // Jobs that stream their output to stdout hand it to a sink instead of collecting it
+            if (stdoutSink) child.stdout?.pipe(stdoutSink);
+            else child.stdout?.on('data', d => stdout += d.toString());
             child.stderr?.on('data', d => {
+                if (!stderr) traceInstant(TraceEvent.FIRST_BYTE, traceId, traceLabel(tool), d.length);
                 const chunk = d.toString();
                 stderr += chunk;
                 if (onStderr) onStderr(d);
@@ -262,6 +289,7 @@ export async function handleRunTool(params, responder, hooks = {}) {
                 } else if (!result.success && !result.key) {
                     result.key = 'EIO';
                 }
+                if (probeKey && result.success && !result.key && !result.stdoutTruncated) storeProbe(probeKey, result);
 
                 if (job?.kind === 'preview' && outputPath && fs.existsSync(outputPath)) {
                     try {
@@ -36,6 +36,11 @@ try {
 
 export const TEMP_DIR = tempDir;
 export const LOG_FILE = path.join(TEMP_DIR, 'mvdcoapp.log');
+export const TRACE_DIR = path.join(TEMP_DIR, 'traces');
+export const TRACE_FLAG_FILE = path.join(TEMP_DIR, 'trace.on');
+export const SEGMENT_CACHE_DIR = path.join(TEMP_DIR, 'segments');
+export const PROBE_CACHE_FILE = path.join(TEMP_DIR, 'probe-cache.tsv');
+export const FRONTEND_HANDSHAKE_FILE = path.join(TEMP_DIR, 'frontend-handshake.txt');
 
 // 3. Timeouts & Limits
 export const IDLE_TIMEOUT = 30000;
@@ -43,6 +48,18 @@ export const DEFAULT_TOOL_TIMEOUT = 30000;
 export const PREVIEW_TOOL_TIMEOUT = 40000;
 export const LOG_MAX_SIZE = 10 * 1024 * 1024; // 10MB
 export const LOG_KEEP_SIZE = 5 * 1024 * 1024; // 5MB
+export const TRACE_MAX_FILES = 10;
+export const TRACE_FLUSH_MS = 1000;
+export const SEGMENT_CACHE_MAX_BYTES = 1024 * 1024 * 1024; // 1GB LRU budget
+export const SEGMENT_FETCH_TIMEOUT = 30000;
+export const PROBE_CACHE_MAX_BYTES = 8 * 1024 * 1024;
+export const PROBE_CACHE_TTL_MS = 60 * 60 * 1000; // stream properties outlive most page sessions
+export const ORIGIN_MAX_SOCKETS = 8; // per origin, shared by every job's host-side fetches
+export const ORIGIN_KEEPALIVE_MS = 15000;
+export const WRITER_DIRTY_BUDGET_MB = 64; // page cache a download may keep behind its write head
+export const LIVE_PART_MAX_BYTES = 2 * 1024 * 1024 * 1024; // segmented recordings: parts stay under FAT32's 4GB limit
+export const LIVE_PART_MAX_SECONDS = 60 * 60;
+export const LIVE_PART_SYNC_MS = 1000; // fdatasync at most this often, always at a fragment boundary
 
 // 4. Binaries
 const BIN_DIR = IS_PKG ? path.dirname(process.execPath) : path.dirname(__dirname);
@@ -51,8 +68,13 @@ const EXE_EXT = IS_WINDOWS ? '.exe' : '';
 export const BINARIES = {
     ffmpeg: path.join(BIN_DIR, `ffmpeg${EXE_EXT}`),
     ffprobe: path.join(BIN_DIR, `ffprobe${EXE_EXT}`),
-    fileui: IS_WINDOWS ? path.join(BIN_DIR, `mvd-fileui${EXE_EXT}`) : null,
-    diskspace: path.join(BIN_DIR, `mvd-diskspace${EXE_EXT}`)
+    fileui: (IS_WINDOWS || IS_LINUX) ? path.join(BIN_DIR, `mvd-fileui${EXE_EXT}`) : null,
+    diskspace: path.join(BIN_DIR, `mvd-diskspace${EXE_EXT}`),
+    tsconcat: path.join(BIN_DIR, `mvd-tsconcat${EXE_EXT}`),
+    fmp4: path.join(BIN_DIR, `mvd-fmp4${EXE_EXT}`),
+    faststart: path.join(BIN_DIR, `mvd-faststart${EXE_EXT}`),
+    writer: IS_WINDOWS ? null : path.join(BIN_DIR, `mvd-writer${EXE_EXT}`),
+    fsutil: path.join(BIN_DIR, `mvd-fsutil${EXE_EXT}`)
 };
 
 // 5. Constants
@@ -63,7 +85,7 @@ export const ALLOWED_IDS = [
     'max-video-downloader@rostislav.dev'
 ];
 
-export const KNOWN_COMMANDS = ['-h', '--help', '-v', '--version', '--info', '-i', '--install', '-u', '--uninstall'];
+export const KNOWN_COMMANDS = ['-h', '--help', '-v', '--version', '--info', '-i', '--install', '-u', '--uninstall', '--trace'];
 
 export const INVALID_FILENAME_CHARS = /[<>:"/\\|?*\x00-\x1F]/g; // eslint-disable-line no-control-regex
 export const WINDOWS_RESERVED_NAMES = new Set([
@@ -77,5 +99,7 @@ export const VALIDATION_SCHEMA = {
     'direct-download': ['downloadId', 'url', 'saveDir', 'filename'],
     'cancel-download-v2': ['downloadId'],
     'fileSystem': ['operation'],
-    'runTool': ['tool', 'args']
+    'runTool': ['tool', 'args'],
+    'set-download-priority': ['downloadId', 'priority'],
+    'analyze-hls': ['url']
 };
@@ -0,0 +1,175 @@
+/**
+ * Playlist – Minimal HLS playlist parsing for host-side segment fetching and analysis
+ */
+
+/**
+ * Turn an EXT-X-BYTERANGE spec (`<length>[@<offset>]`) into an HTTP Range header value.
+ * An omitted offset continues from the previous sub-range of the same URI.
+ */
+export function parseByteRange(spec, nextOffsets, uri) {
+    const match = /^(\d+)(?:@(\d+))?$/.exec(String(spec).trim());
+    if (!match) return null;
+    const length = Number(match[1]);
+    const offset = match[2] !== undefined ? Number(match[2]) : (nextOffsets.get(uri) || 0);
+    nextOffsets.set(uri, offset + length);
+    return `bytes=${offset}-${offset + length - 1}`;
+}
+
+/**
+ * Split an attribute list (`NAME=value,NAME="quoted, value"`) into an object
+ */
+export function parseAttributeList(text) {
+    const attributes = {};
+    for (const [, name, value] of String(text).matchAll(/([A-Z0-9-]+)=("[^"]*"|[^,]*)/g)) {
+        attributes[name] = value.startsWith('"') ? value.slice(1, -1) : value;
+    }
+    return attributes;
+}
+
+/**
+ * Byte count of an HTTP Range value produced by parseByteRange, or null
+ */
+export function byteRangeLength(range) {
+    const match = /^bytes=(\d+)-(\d+)$/.exec(range || '');
+    return match ? Number(match[2]) - Number(match[1]) + 1 : null;
+}
+
+function resolveHttpUri(uri, baseUrl) {
+    try {
+        const absolute = new URL(uri, baseUrl || undefined);
+        return (absolute.protocol === 'http:' || absolute.protocol === 'https:') ? absolute.toString() : null;
+    } catch {
+        return null;
+    }
+}
+
+/**
+ * Parse an HLS media playlist into absolute segment URLs.
+ * Returns null for master playlists or when a segment URI cannot be resolved.
+ */
+export function parseHlsMediaPlaylist(content, baseUrl) {
+    if (typeof content !== 'string' || !content.includes('#EXTINF')) return null;
+
+    const result = {
+        segments: [],
+        initSection: null,
+        encrypted: false,
+        encryption: null,
+        endList: false,
+        playlistType: null,
+        targetDuration: null,
+        mediaSequence: 0,
+        discontinuities: 0,
+        duration: 0
+    };
+    const nextOffsets = new Map();
+    let pendingRange = null;
+    let pendingDuration = 0;
+    let durationUs = 0; // summed in whole microseconds so long playlists don't drift
+
+    for (const line of content.split(/\r?\n/)) {
+        const trimmed = line.trim();
+        if (!trimmed) continue;
+
+        if (trimmed.startsWith('#EXTINF:')) {
+            pendingDuration = parseFloat(trimmed.slice('#EXTINF:'.length)) || 0;
+        } else if (trimmed.startsWith('#EXT-X-BYTERANGE:')) {
+            pendingRange = trimmed.slice('#EXT-X-BYTERANGE:'.length);
+        } else if (trimmed.startsWith('#EXT-X-KEY:')) {
+            const method = parseAttributeList(trimmed.slice('#EXT-X-KEY:'.length)).METHOD;
+            if (method && method !== 'NONE') {
+                result.encrypted = true;
+                result.encryption = result.encryption || method;
+            }
+        } else if (trimmed.startsWith('#EXT-X-TARGETDURATION:')) {
+            result.targetDuration = Number(trimmed.slice('#EXT-X-TARGETDURATION:'.length)) || null;
+        } else if (trimmed.startsWith('#EXT-X-MEDIA-SEQUENCE:')) {
+            result.mediaSequence = Number(trimmed.slice('#EXT-X-MEDIA-SEQUENCE:'.length)) || 0;
+        } else if (trimmed.startsWith('#EXT-X-PLAYLIST-TYPE:')) {
+            result.playlistType = trimmed.slice('#EXT-X-PLAYLIST-TYPE:'.length).trim();
+        } else if (trimmed.startsWith('#EXT-X-MAP:')) {
+            const uriMatch = /URI="([^"]+)"/.exec(trimmed);
+            const url = uriMatch ? resolveHttpUri(uriMatch[1], baseUrl) : null;
+            if (!url) return null;
+            const rangeMatch = /BYTERANGE="([^"]+)"/.exec(trimmed);
+            result.initSection = { url, range: rangeMatch ? parseByteRange(rangeMatch[1], nextOffsets, url) : null };
+        } else if (trimmed.startsWith('#EXT-X-DISCONTINUITY') && !trimmed.startsWith('#EXT-X-DISCONTINUITY-SEQUENCE')) {
+            result.discontinuities += 1;
+        } else if (trimmed === '#EXT-X-ENDLIST') {
+            result.endList = true;
+        } else if (!trimmed.startsWith('#')) {
+            const url = resolveHttpUri(trimmed, baseUrl);
+            if (!url) return null;
+            const range = pendingRange ? parseByteRange(pendingRange, nextOffsets, url) : null;
+            result.segments.push({ url, range, duration: pendingDuration });
+            durationUs += Math.round(pendingDuration * 1e6);
+            result.duration = durationUs / 1e6;
+            pendingRange = null;
+            pendingDuration = 0;
+        }
+    }
+
+    return result.segments.length > 0 ? result : null;
+}
+
+function describeVariant(attributes) {
+    const [width, height] = String(attributes.RESOLUTION || '').split('x').map(Number);
+    const closedCaptions = attributes['CLOSED-CAPTIONS'];
+    return {
+        bandwidth: Number(attributes.BANDWIDTH) || 0,
+        averageBandwidth: Number(attributes['AVERAGE-BANDWIDTH']) || null,
+        width: width || null,
+        height: height || null,
+        frameRate: Number(attributes['FRAME-RATE']) || null,
+        codecs: attributes.CODECS ? attributes.CODECS.split(',').map(codec => codec.trim()).filter(Boolean) : [],
+        videoRange: attributes['VIDEO-RANGE'] || null,
+        audio: attributes.AUDIO || null,
+        video: attributes.VIDEO || null,
+        subtitles: attributes.SUBTITLES || null,
+        closedCaptions: closedCaptions && closedCaptions !== 'NONE' ? closedCaptions : null
+    };
+}
+
+/**
+ * Parse an HLS master playlist into variants (EXT-X-STREAM-INF), I-frame variants and
+ * renditions (EXT-X-MEDIA) with absolute URLs. Returns null for media playlists.
+ */
+export function parseHlsMasterPlaylist(content, baseUrl) {
+    if (typeof content !== 'string' || !content.includes('#EXT-X-STREAM-INF')) return null;
+
+    const result = { variants: [], iFrameVariants: [], media: [] };
+    let pendingVariant = null;
+
+    for (const line of content.split(/\r?\n/)) {
+        const trimmed = line.trim();
+        if (!trimmed) continue;
+
+        if (trimmed.startsWith('#EXT-X-STREAM-INF:')) {
+            pendingVariant = describeVariant(parseAttributeList(trimmed.slice('#EXT-X-STREAM-INF:'.length)));
+        } else if (trimmed.startsWith('#EXT-X-I-FRAME-STREAM-INF:')) {
+            const attributes = parseAttributeList(trimmed.slice('#EXT-X-I-FRAME-STREAM-INF:'.length));
+            const url = attributes.URI ? resolveHttpUri(attributes.URI, baseUrl) : null;
+            if (url) result.iFrameVariants.push({ url, ...describeVariant(attributes) });
+        } else if (trimmed.startsWith('#EXT-X-MEDIA:')) {
+            const attributes = parseAttributeList(trimmed.slice('#EXT-X-MEDIA:'.length));
+            result.media.push({
+                type: attributes.TYPE || null,
+                groupId: attributes['GROUP-ID'] || null,
+                name: attributes.NAME || null,
+                language: attributes.LANGUAGE || null,
+                default: attributes.DEFAULT === 'YES',
+                autoselect: attributes.AUTOSELECT === 'YES',
+                forced: attributes.FORCED === 'YES',
+                channels: attributes.CHANNELS || null,
+                instreamId: attributes['INSTREAM-ID'] || null,
+                url: attributes.URI ? resolveHttpUri(attributes.URI, baseUrl) : null
+            });
+        } else if (!trimmed.startsWith('#') && pendingVariant) {
+            const url = resolveHttpUri(trimmed, baseUrl);
+            if (url) result.variants.push({ url, ...pendingVariant });
+            pendingVariant = null;
+        }
+    }
+
+    return result.variants.length > 0 ? result : null;
+}
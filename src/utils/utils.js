@@ -6,6 +6,7 @@ import {
     TEMP_DIR, LOG_FILE, BINARIES, IS_WINDOWS, LOG_MAX_SIZE, LOG_KEEP_SIZE,
     INVALID_FILENAME_CHARS, WINDOWS_RESERVED_NAMES, APP_VERSION 
 } from './config';
+import { traceBegin, traceEnd, TraceEvent } from '../core/trace';
 
 export { TEMP_DIR, LOG_FILE };
 
@@ -115,7 +116,7 @@ export function getConnectionInfo() {
         logsFolder: TEMP_DIR,
         logFile: LOG_FILE,
         logFileSize,
-        capabilities: ['download-v2', 'direct-download', 'cancel-download-v2', 'fileSystem', 'kill-processing', 'runTool', 'get-disk-space']
+        capabilities: ['download-v2', 'direct-download', 'cancel-download-v2', 'fileSystem', 'kill-processing', 'runTool', 'get-disk-space', 'segment-cache', 'native-ts-assembly', 'native-fmp4-assembly', 'probe-cache', 'media-sniff', 'analyze-hls', 'space-forecast', 'fs-stat-batch', 'fs-probe-directory', 'set-bandwidth', 'set-download-priority', 'download-queue', 'download-hash', 'segmented-recording']
     };
 }
 
@@ -162,12 +163,20 @@ export function normalizeForFsWindows(filePath) {
 /**
  * Get free disk space for a specific path using native helper
  */
-export function getFreeDiskSpace(targetPath) {
+export function getFreeDiskSpace(targetPath, traceId = 0) {
+    traceBegin(TraceEvent.GET_FREE_DISK_SPACE, traceId);
     return new Promise((resolve) => {
         try {
             const diskspacePath = checkBinaries('diskspace');
             
-            let pathToCheck = path.parse(path.resolve(targetPath)).root;
+            // statvfs answers for the filesystem holding the path, so POSIX checks the nearest
+            // existing folder: a target on another mount reports that mount, not /
+            let pathToCheck = path.resolve(targetPath);
+            if (IS_WINDOWS) {
+                pathToCheck = path.parse(pathToCheck).root;
+            } else {
+                while (!fs.existsSync(pathToCheck) && path.dirname(pathToCheck) !== pathToCheck) pathToCheck = path.dirname(pathToCheck);
+            }
             if (IS_WINDOWS && !pathToCheck.startsWith('\\\\')) {
                 // Keep as is
             } else {
@@ -182,6 +191,9 @@ export function getFreeDiskSpace(targetPath) {
         } catch (error) {
             resolve(null);
         }
+    }).then((free) => {
+        traceEnd(TraceEvent.GET_FREE_DISK_SPACE, traceId, 0, free || 0);
+        return free;
     });
 }
 
@@ -247,3 +259,62 @@ export function ensureUniqueFilename(dir, candidate, isPathInUseCallback) {
     }
     return candidateName;
 }
+
+/**
+ * Turn an extension-supplied header map into plain string headers for host-side requests.
+ * Drops the extension's bookkeeping `timestamp` field and empty values.
+ */
+export function normalizeDownloadHeaders(headers) {
+    if (!headers || typeof headers !== 'object') return null;
+
+    const normalized = {};
+    for (const [name, value] of Object.entries(headers)) {
+        if (name === 'timestamp' || value == null) continue;
+        normalized[name] = String(value);
+    }
+    return Object.keys(normalized).length > 0 ? normalized : null;
+}
+
+/**
+ * Hidden sibling a job writes to until finalizeOutput moves it into place. The job id keeps
+ * two jobs heading for the same name apart; the extension stays last so ffmpeg still picks
+ * the muxer from the output name.
+ */
+export function getPartialOutputPath(finalPath, jobId = '') {
+    const ext = path.extname(finalPath);
+    const tag = String(jobId).replace(/[^A-Za-z0-9_-]/g, '').slice(0, 32);
+    return path.join(path.dirname(finalPath), `.${path.basename(finalPath, ext)}${tag ? `.${tag}` : ''}.mvdpart${ext}`);
+}
+
+// Filesystems without hard links (FAT, exFAT, some network shares)
+const NO_HARDLINK_CODES = new Set(['EPERM', 'ENOTSUP', 'EOPNOTSUPP', 'ENOSYS', 'EMLINK']);
+
+/**
+ * Atomically publish a finished output. The partial always sits next to finalPath, so this
+ * is a same-filesystem rename (there is no cross-device case). Unless `overwrite` is set,
+ * the name is claimed with link() + unlink(), which fails with EEXIST instead of replacing
+ * a file that appeared since the name was chosen; filesystems without hard links fall back
+ * to an existence check before the rename.
+ */
+export async function finalizeOutput(partialPath, finalPath, { overwrite = false } = {}) {
+    const source = normalizeForFsWindows(partialPath);
+    const target = normalizeForFsWindows(finalPath);
+    if (overwrite) {
+        await fs.promises.rename(source, target);
+        return 'rename';
+    }
+    try {
+        await fs.promises.link(source, target);
+    } catch (err) {
+        if (!NO_HARDLINK_CODES.has(err.code)) throw err;
+        if (fs.existsSync(target)) {
+            const exists = new Error(`${finalPath} already exists`);
+            exists.code = 'EEXIST';
+            throw exists;
+        }
+        await fs.promises.rename(source, target);
+        return 'rename';
+    }
+    await fs.promises.unlink(source).catch(() => {});
+    return 'link';
+}
@@ -0,0 +1,586 @@
+// Native messaging load generator for the host (developer tool, POSIX only).
+// Launches the host the way a browser does (extension origin in argv, stdin/stdout pipes),
+// waits for the handshake, then sends length-prefixed JSON requests at a fixed rate or as
+// fast as the in-flight limit allows and matches responses by id.
+//
+// Usage:
+//   mvd-nmload --host PATH [--extension-id ID] [--mix NAME:WEIGHT,...] [--rate MSG/S]
+//              [--burst N] [--inflight N] [--duration SEC | --count N] [--size BYTES]
+//              [--url URL] [--dir DIR] [--timeout SEC] [--json]
+//
+// Mix entries (default: disk:2,exists:2,noop:2,priority:1,hls:1):
+//   disk       get-disk-space
+//   exists     fileSystem exists on --dir
+//   noop       unknown command, answered by the router with ENOSYS (framing + routing only)
+//   priority   set-download-priority for an unknown download (validation + handler)
+//   hls        analyze-hls with an inline media playlist of about --size bytes (no network)
+//   download   direct-download of --url into --dir; the host streams download-progress back
+//
+// --size pads every other request with an ignored string field to about that many bytes, so
+// large frames reach Protocol.parse in many stdin chunks. --burst writes N frames with one
+// write() per tick. With --rate, latency is measured from each request's scheduled send time,
+// so a host that stalls its stdin is charged for the queueing it causes. .js/.mjs hosts run
+// under `node` from PATH. Host RSS is sampled every 50 ms (the host process only, not the
+// ffmpeg or helper children).
+//
+// Stdout: a per-command latency table (ms) with throughput, unsolicited message counts and
+// host RSS, or the same as one JSON object with --json.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <libproc.h>
+#endif
+
+enum ExitCode {
+    SUCCESS = 0,
+    ERR_ARGS = 2,
+    ERR_SPAWN = 3,
+    ERR_HOST = 4,     // no handshake, or the host exited during the run
+    ERR_TIMEOUT = 5   // responses still missing after --timeout
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* DEFAULT_EXTENSION_ID = "bkblnddclhmmgjlmbofhakhhbklkcofd";
+static const char* DEFAULT_MIX = "disk:2,exists:2,noop:2,priority:1,hls:1";
+static const char* KIND_NAMES[] = { "disk", "exists", "noop", "priority", "hls", "download" };
+static const char* KIND_COMMANDS[] = {
+    "get-disk-space", "fileSystem", "nmload-noop", "set-download-priority", "analyze-hls", "direct-download"
+};
+enum Kind { KIND_DISK, KIND_EXISTS, KIND_NOOP, KIND_PRIORITY, KIND_HLS, KIND_DOWNLOAD, KIND_COUNT };
+
+struct Options {
+    std::string host;
+    std::string extensionId = DEFAULT_EXTENSION_ID;
+    std::string mix = DEFAULT_MIX;
+    std::string url;
+    std::string dir = "/tmp";
+    double rate = 0;          // requests per second, 0 = closed loop
+    int burst = 1;
+    int inflight = 64;
+    double duration = 10;
+    long count = 0;           // overrides duration when set
+    std::size_t size = 0;
+    double timeout = 30;
+    bool json = false;
+};
+
+struct Pending {
+    int kind;
+    Clock::time_point sentAt;
+};
+
+struct Stats {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::unordered_map<uint64_t, Pending> pending;
+    std::vector<std::vector<double> > latencies{KIND_COUNT}; // ms
+    std::vector<long> errors = std::vector<long>(KIND_COUNT, 0);
+    std::map<std::string, long> unsolicited;
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    bool handshake = false;
+    bool frontEnd = false;
+    double handshakeMs = 0;
+    std::string downloadPaths;
+    bool hostExited = false;
+};
+
+static Stats g_stats;
+
+// ============================================================================
+// Frame helpers
+// ============================================================================
+
+static std::string json_escape(const std::string& text) {
+    std::string out;
+    out.reserve(text.size() + 2);
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '"' || c == '\\') { out += '\\'; out += static_cast<char>(c); }
+        else if (c == '\n') out += "\\n";
+        else if (c < 0x20) { char buf[8]; std::snprintf(buf, sizeof(buf), "\\u%04x", c); out += buf; }
+        else out += static_cast<char>(c);
+    }
+    return out;
+}
+
+static void append_frame(std::string& out, const std::string& body) {
+    const uint32_t length = static_cast<uint32_t>(body.size());
+    const char header[4] = {
+        static_cast<char>(length & 0xFF), static_cast<char>((length >> 8) & 0xFF),
+        static_cast<char>((length >> 16) & 0xFF), static_cast<char>((length >> 24) & 0xFF)
+    };
+    out.append(header, 4);
+    out.append(body);
+}
+
+// Value of a top-level string field; the host appends `id` last, so search from the end
+static bool string_field(const std::string& body, const char* name, std::string& value, bool fromEnd) {
+    const std::string key = std::string("\"") + name + "\":\"";
+    const std::size_t at = fromEnd ? body.rfind(key) : body.find(key);
+    if (at == std::string::npos) return false;
+    const std::size_t start = at + key.size();
+    const std::size_t end = body.find('"', start);
+    if (end == std::string::npos) return false;
+    value = body.substr(start, end - start);
+    return true;
+}
+
+// Inline media playlist of roughly `size` bytes
+static std::string make_playlist(std::size_t size) {
+    std::string text = "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:4\n#EXT-X-MEDIA-SEQUENCE:0\n";
+    char line[96];
+    for (int n = 0; text.size() < size || n == 0; ++n) {
+        std::snprintf(line, sizeof(line), "#EXTINF:4.000,\nsegment-%08d.ts\n", n);
+        text += line;
+    }
+    text += "#EXT-X-ENDLIST\n";
+    return text;
+}
+
+static std::string build_request(int kind, uint64_t seq, const Options& options, const std::string& playlist) {
+    std::ostringstream body;
+    body << "{\"command\":\"" << KIND_COMMANDS[kind] << "\"";
+    switch (kind) {
+        case KIND_DISK:
+            body << ",\"path\":\"" << json_escape(options.dir) << "\"";
+            break;
+        case KIND_EXISTS:
+            body << ",\"operation\":\"exists\",\"params\":{\"path\":\"" << json_escape(options.dir) << "\"}";
+            break;
+        case KIND_PRIORITY:
+            body << ",\"downloadId\":\"nmload-missing\",\"priority\":1";
+            break;
+        case KIND_HLS:
+            body << ",\"url\":\"http://127.0.0.1/nmload/index.m3u8\",\"content\":\"" << json_escape(playlist) << "\"";
+            break;
+        case KIND_DOWNLOAD:
+            body << ",\"downloadId\":\"nmload-" << seq << "\",\"url\":\"" << json_escape(options.url)
+                 << "\",\"saveDir\":\"" << json_escape(options.dir) << "\",\"filename\":\"nmload-" << seq
+                 << ".bin\",\"allowOverwrite\":true";
+            break;
+        default:
+            break;
+    }
+    const std::size_t tail = 32; // ,"id":"nm-<seq>"}
+    const std::size_t current = static_cast<std::size_t>(body.tellp());
+    if (kind != KIND_HLS && options.size > current + tail + 10) {
+        body << ",\"pad\":\"" << std::string(options.size - current - tail - 10, 'x') << "\"";
+    }
+    body << ",\"id\":\"nm-" << seq << "\"}";
+    return body.str();
+}
+
+// ============================================================================
+// Host process
+// ============================================================================
+
+static bool ends_with(const std::string& text, const char* suffix) {
+    const std::size_t n = std::strlen(suffix);
+    return text.size() >= n && text.compare(text.size() - n, n, suffix) == 0;
+}
+
+static pid_t spawn_host(const Options& options, int& toHost, int& fromHost) {
+    int in[2], out[2];
+    if (pipe(in) != 0 || pipe(out) != 0) return -1;
+
+    // Chrome passes the caller origin; Firefox passes the manifest path and the add-on ID
+    std::vector<std::string> args;
+    if (ends_with(options.host, ".js") || ends_with(options.host, ".mjs")) args.push_back("node");
+    args.push_back(options.host);
+    if (options.extensionId.find('@') != std::string::npos) {
+        args.push_back("/dev/null");
+        args.push_back(options.extensionId);
+    } else {
+        args.push_back("chrome-extension://" + options.extensionId + "/");
+    }
+
+    const pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        close(in[0]); close(in[1]); close(out[0]); close(out[1]);
+        std::vector<char*> argv;
+        for (std::size_t i = 0; i < args.size(); ++i) argv.push_back(const_cast<char*>(args[i].c_str()));
+        argv.push_back(NULL);
+        execvp(argv[0], argv.data());
+        std::fprintf(stderr, "[nmload] exec %s failed: %s\n", argv[0], std::strerror(errno));
+        _exit(127);
+    }
+    close(in[0]);
+    close(out[1]);
+    toHost = in[1];
+    fromHost = out[0];
+    return pid;
+}
+
+static double rss_mb(pid_t pid) {
+#ifdef __APPLE__
+    struct proc_taskinfo info;
+    if (proc_pidinfo(pid, PROC_PIDTASKINFO, 0, &info, sizeof(info)) != static_cast<int>(sizeof(info))) return 0;
+    return static_cast<double>(info.pti_resident_size) / (1024.0 * 1024.0);
+#else
+    char path[64];
+    std::snprintf(path, sizeof(path), "/proc/%d/status", static_cast<int>(pid));
+    FILE* file = std::fopen(path, "r");
+    if (!file) return 0;
+    char line[256];
+    double kb = 0;
+    while (std::fgets(line, sizeof(line), file)) {
+        if (std::strncmp(line, "VmRSS:", 6) == 0) { kb = std::atof(line + 6); break; }
+    }
+    std::fclose(file);
+    return kb / 1024.0;
+#endif
+}
+
+static bool write_all(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        const ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+static void handle_message(const std::string& body, Clock::time_point start) {
+    const Clock::time_point now = Clock::now();
+    std::string id, command;
+    std::lock_guard<std::mutex> guard(g_stats.lock);
+    g_stats.bytesIn += body.size() + 4;
+
+    if (string_field(body, "id", id, true) && id.compare(0, 3, "nm-") == 0) {
+        const uint64_t seq = std::strtoull(id.c_str() + 3, NULL, 10);
+        std::unordered_map<uint64_t, Pending>::iterator it = g_stats.pending.find(seq);
+        if (it != g_stats.pending.end()) {
+            const int kind = it->second.kind;
+            g_stats.latencies[kind].push_back(std::chrono::duration<double, std::milli>(now - it->second.sentAt).count());
+            // noop is expected to fail with ENOSYS, priority with ENOENT
+            const bool failed = body.find("\"success\":false") != std::string::npos
+                || (body.compare(0, 9, "{\"error\":") == 0 && kind != KIND_NOOP);
+            if (failed && kind != KIND_PRIORITY) g_stats.errors[kind]++;
+            std::string path;
+            if (kind == KIND_DOWNLOAD && string_field(body, "path", path, false)) g_stats.downloadPaths += path + '\n';
+            g_stats.pending.erase(it);
+            g_stats.changed.notify_all();
+            return;
+        }
+    }
+
+    if (!string_field(body, "command", command, false)) command = "(no command)";
+    if (!g_stats.handshake && command == "validateConnection") {
+        g_stats.handshake = true;
+        g_stats.frontEnd = body.find("\"frontEnd\":true") != std::string::npos;
+        g_stats.handshakeMs = std::chrono::duration<double, std::milli>(now - start).count();
+        g_stats.changed.notify_all();
+    }
+    g_stats.unsolicited[command]++;
+}
+
+// Frames are consumed from an offset and the buffer compacted once it is mostly read,
+// so a burst of small messages costs one copy per read rather than one per message
+static void reader_thread(int fd, Clock::time_point start) {
+    std::vector<char> buffer;
+    std::size_t offset = 0;
+    char chunk[65536];
+    for (;;) {
+        const ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        buffer.insert(buffer.end(), chunk, chunk + n);
+        while (buffer.size() - offset >= 4) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(&buffer[offset]);
+            const uint32_t length = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+            if (buffer.size() - offset < 4 + static_cast<std::size_t>(length)) break;
+            handle_message(std::string(&buffer[offset + 4], length), start);
+            offset += 4 + length;
+        }
+        if (offset > 0 && offset * 2 >= buffer.size()) {
+            buffer.erase(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(offset));
+            offset = 0;
+        }
+    }
+    std::lock_guard<std::mutex> guard(g_stats.lock);
+    g_stats.hostExited = true;
+    g_stats.changed.notify_all();
+}
+
+// ============================================================================
+// Reporting
+// ============================================================================
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    const std::size_t index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+struct Summary {
+    long sent;
+    long received;
+    double seconds;
+    double rssStart;
+    double rssPeak;
+    double rssEnd;
+};
+
+static void report(const Options& options, const Summary& summary) {
+    std::vector<double> all;
+    long errors = 0;
+    for (int kind = 0; kind < KIND_COUNT; ++kind) {
+        std::sort(g_stats.latencies[kind].begin(), g_stats.latencies[kind].end());
+        all.insert(all.end(), g_stats.latencies[kind].begin(), g_stats.latencies[kind].end());
+        errors += g_stats.errors[kind];
+    }
+    std::sort(all.begin(), all.end());
+    const double throughput = summary.seconds > 0 ? summary.received / summary.seconds : 0;
+    const double mbIn = summary.seconds > 0 ? g_stats.bytesIn / summary.seconds / 1e6 : 0;
+    const double mbOut = summary.seconds > 0 ? g_stats.bytesOut / summary.seconds / 1e6 : 0;
+
+    if (options.json) {
+        std::printf("{\"handshakeMs\":%.2f,\"frontEnd\":%s,\"sent\":%ld,\"received\":%ld,\"errors\":%ld,"
+                    "\"seconds\":%.3f,\"messagesPerSec\":%.1f,\"mbPerSecIn\":%.3f,\"mbPerSecOut\":%.3f,"
+                    "\"rssMb\":{\"start\":%.1f,\"peak\":%.1f,\"end\":%.1f},\"commands\":{",
+                    g_stats.handshakeMs, g_stats.frontEnd ? "true" : "false", summary.sent, summary.received, errors,
+                    summary.seconds, throughput, mbIn, mbOut, summary.rssStart, summary.rssPeak, summary.rssEnd);
+        bool first = true;
+        for (int kind = 0; kind < KIND_COUNT; ++kind) {
+            const std::vector<double>& lat = g_stats.latencies[kind];
+            if (lat.empty()) continue;
+            std::printf("%s\"%s\":{\"count\":%zu,\"errors\":%ld,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+                        first ? "" : ",", KIND_NAMES[kind], lat.size(), g_stats.errors[kind],
+                        percentile(lat, 0.5), percentile(lat, 0.9), percentile(lat, 0.99), lat.back());
+            first = false;
+        }
+        std::printf("},\"unsolicited\":{");
+        first = true;
+        for (std::map<std::string, long>::const_iterator it = g_stats.unsolicited.begin(); it != g_stats.unsolicited.end(); ++it) {
+            std::printf("%s\"%s\":%ld", first ? "" : ",", json_escape(it->first).c_str(), it->second);
+            first = false;
+        }
+        std::printf("}}\n");
+        return;
+    }
+
+    std::printf("handshake %.1f ms%s\n\n", g_stats.handshakeMs, g_stats.frontEnd ? " (front end)" : "");
+    std::printf("%-10s %8s %7s %9s %9s %9s %9s\n", "command", "count", "errors", "p50", "p90", "p99", "max");
+    for (int kind = 0; kind < KIND_COUNT; ++kind) {
+        const std::vector<double>& lat = g_stats.latencies[kind];
+        if (lat.empty()) continue;
+        std::printf("%-10s %8zu %7ld %9.2f %9.2f %9.2f %9.2f\n", KIND_NAMES[kind], lat.size(), g_stats.errors[kind],
+                    percentile(lat, 0.5), percentile(lat, 0.9), percentile(lat, 0.99), lat.back());
+    }
+    std::printf("%-10s %8zu %7ld %9.2f %9.2f %9.2f %9.2f\n\n", "all", all.size(), errors,
+                percentile(all, 0.5), percentile(all, 0.9), percentile(all, 0.99), all.empty() ? 0 : all.back());
+    std::printf("sent %ld, received %ld in %.2f s: %.0f msg/s, %.2f MB/s to host, %.2f MB/s from host\n",
+                summary.sent, summary.received, summary.seconds, throughput, mbOut, mbIn);
+    for (std::map<std::string, long>::const_iterator it = g_stats.unsolicited.begin(); it != g_stats.unsolicited.end(); ++it) {
+        std::printf("unsolicited %s: %ld\n", it->first.c_str(), it->second);
+    }
+    std::printf("host RSS: start %.1f MB, peak %.1f MB, end %.1f MB\n", summary.rssStart, summary.rssPeak, summary.rssEnd);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static bool parse_mix(const std::string& spec, std::vector<int>& wheel) {
+    std::stringstream stream(spec);
+    std::string entry;
+    while (std::getline(stream, entry, ',')) {
+        const std::size_t colon = entry.find(':');
+        const std::string name = entry.substr(0, colon);
+        const int weight = colon == std::string::npos ? 1 : std::atoi(entry.c_str() + colon + 1);
+        int kind = -1;
+        for (int k = 0; k < KIND_COUNT; ++k) {
+            if (name == KIND_NAMES[k]) kind = k;
+        }
+        if (kind < 0 || weight < 0) return false;
+        for (int i = 0; i < weight; ++i) wheel.push_back(kind);
+    }
+    return !wheel.empty();
+}
+
+static void usage() {
+    std::fprintf(stderr,
+        "Usage: mvd-nmload --host PATH [--extension-id ID] [--mix NAME:WEIGHT,...] [--rate MSG/S]\n"
+        "                  [--burst N] [--inflight N] [--duration SEC | --count N] [--size BYTES]\n"
+        "                  [--url URL] [--dir DIR] [--timeout SEC] [--json]\n"
+        "Mix names: disk exists noop priority hls download (default %s)\n", DEFAULT_MIX);
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--host" && hasValue) options.host = argv[++i];
+        else if (arg == "--extension-id" && hasValue) options.extensionId = argv[++i];
+        else if (arg == "--mix" && hasValue) options.mix = argv[++i];
+        else if (arg == "--url" && hasValue) options.url = argv[++i];
+        else if (arg == "--dir" && hasValue) options.dir = argv[++i];
+        else if (arg == "--rate" && hasValue) options.rate = std::atof(argv[++i]);
+        else if (arg == "--burst" && hasValue) options.burst = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--inflight" && hasValue) options.inflight = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--duration" && hasValue) options.duration = std::atof(argv[++i]);
+        else if (arg == "--count" && hasValue) options.count = std::atol(argv[++i]);
+        else if (arg == "--size" && hasValue) options.size = static_cast<std::size_t>(std::atol(argv[++i]));
+        else if (arg == "--timeout" && hasValue) options.timeout = std::atof(argv[++i]);
+        else if (arg == "--json") options.json = true;
+        else { usage(); return ERR_ARGS; }
+    }
+
+    std::vector<int> wheel;
+    if (options.host.empty() || !parse_mix(options.mix, wheel)) { usage(); return ERR_ARGS; }
+    if (options.rate <= 0) options.burst = std::min(options.burst, options.inflight);
+    if (options.url.empty() && std::find(wheel.begin(), wheel.end(), static_cast<int>(KIND_DOWNLOAD)) != wheel.end()) {
+        std::fprintf(stderr, "[nmload] the download mix entry needs --url\n");
+        return ERR_ARGS;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    const std::string playlist = make_playlist(options.size);
+    const Clock::time_point spawnedAt = Clock::now();
+    int toHost = -1, fromHost = -1;
+    const pid_t pid = spawn_host(options, toHost, fromHost);
+    if (pid < 0) {
+        std::fprintf(stderr, "[nmload] failed to start %s: %s\n", options.host.c_str(), std::strerror(errno));
+        return ERR_SPAWN;
+    }
+    std::thread reader(reader_thread, fromHost, spawnedAt);
+
+    {
+        std::unique_lock<std::mutex> guard(g_stats.lock);
+        g_stats.changed.wait_for(guard, std::chrono::seconds(30), [] { return g_stats.handshake || g_stats.hostExited; });
+        if (!g_stats.handshake) {
+            guard.unlock();
+            std::fprintf(stderr, "[nmload] no handshake from host\n");
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+            reader.join();
+            return ERR_HOST;
+        }
+    }
+
+    // RSS sampler
+    std::atomic<bool> sampling(true);
+    std::atomic<long> rssPeakKb(0);
+    const double rssStart = rss_mb(pid);
+    std::thread sampler([&] {
+        while (sampling) {
+            const long kb = static_cast<long>(rss_mb(pid) * 1024);
+            if (kb > rssPeakKb) rssPeakKb = kb;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    });
+
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point deadline = start + std::chrono::microseconds(static_cast<long long>(options.duration * 1e6));
+    const double tickSeconds = options.rate > 0 ? options.burst / options.rate : 0;
+    long sent = 0;
+    uint64_t seq = 0;
+    bool hostGone = false;
+    std::string batch;
+
+    for (long tick = 0; !hostGone; ++tick) {
+        if (options.count > 0 ? sent >= options.count : Clock::now() >= deadline) break;
+
+        Clock::time_point scheduled = Clock::now();
+        if (tickSeconds > 0) {
+            scheduled = start + std::chrono::microseconds(static_cast<long long>(tick * tickSeconds * 1e6));
+            std::this_thread::sleep_until(scheduled);
+        }
+
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> guard(g_stats.lock);
+            if (tickSeconds == 0) {
+                g_stats.changed.wait(guard, [&] {
+                    return g_stats.hostExited || g_stats.pending.size() + options.burst <= static_cast<std::size_t>(options.inflight);
+                });
+                scheduled = Clock::now();
+            }
+            hostGone = g_stats.hostExited;
+            for (int i = 0; i < options.burst && !hostGone; ++i) {
+                if (options.count > 0 && sent >= options.count) break;
+                const int kind = wheel[seq % wheel.size()];
+                append_frame(batch, build_request(kind, seq, options, playlist));
+                Pending pending = { kind, scheduled };
+                g_stats.pending[seq++] = pending;
+                ++sent;
+            }
+            g_stats.bytesOut += batch.size();
+        }
+        if (!batch.empty() && !write_all(toHost, batch.data(), batch.size())) hostGone = true;
+    }
+
+    bool complete;
+    {
+        std::unique_lock<std::mutex> guard(g_stats.lock);
+        complete = g_stats.changed.wait_for(guard, std::chrono::microseconds(static_cast<long long>(options.timeout * 1e6)),
+                                            [] { return g_stats.pending.empty() || g_stats.hostExited; })
+                   && g_stats.pending.empty();
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    const double rssEnd = rss_mb(pid);
+    sampling = false;
+    sampler.join();
+
+    close(toHost);
+    int status = 0;
+    for (int waited = 0; waited < 50 && waitpid(pid, &status, WNOHANG) == 0; ++waited) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    if (kill(pid, 0) == 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+    }
+    reader.join();
+    close(fromHost);
+
+    std::lock_guard<std::mutex> guard(g_stats.lock);
+    std::stringstream paths(g_stats.downloadPaths);
+    std::string path;
+    while (std::getline(paths, path)) unlink(path.c_str());
+
+    Summary summary = { sent, sent - static_cast<long>(g_stats.pending.size()), seconds,
+                        rssStart, std::max(rssStart, rssPeakKb / 1024.0), rssEnd };
+    report(options, summary);
+    if (hostGone) {
+        std::fprintf(stderr, "[nmload] host exited during the run\n");
+        return ERR_HOST;
+    }
+    if (!complete) {
+        std::fprintf(stderr, "[nmload] %zu response(s) missing after %.0f s\n", g_stats.pending.size(), options.timeout);
+        return ERR_TIMEOUT;
+    }
+    return SUCCESS;
+}
@@ -0,0 +1,1275 @@
+// Synthetic HLS/DASH origin for end-to-end download benchmarks (developer tool, POSIX only).
+// Streams are generated on the fly and are byte-for-byte repeatable: H.264 video made of
+// 16x16 I_PCM IDR frames, padded with filler NAL units up to the requested bitrate, so
+// ffmpeg `-c copy` and the native assemblers accept them like real media.
+//
+// Usage:
+//   mvd-origin [--port N] [--bind ADDR] [--latency-ms N] [--jitter-ms N] [--rate BYTES/S]
+//              [--error-rate PCT] [--truncate-rate PCT] [--seed N] [--quiet]
+//
+// URLs (<spec> is a dash-separated token list, any token may be omitted):
+//   /v/<spec>/ts.m3u8             HLS, MPEG-TS segments (<n>.ts)
+//   /v/<spec>/fmp4.m3u8           HLS, fMP4 segments (init.mp4 + <n>.m4s)
+//   /v/<spec>/manifest.mpd        DASH SegmentTemplate ($Number$), or SegmentTimeline ($Time$) with `tl`
+//   /v/<spec>/progressive.mp4     whole stream as one MP4 with moov after mdat (faststart.mp4: moov first)
+//   /v/<spec>/progressive.ts      whole stream as one MPEG-TS file
+//   /v/<spec>/file-<size>.bin     plain file for direct downloads, with Range support (size: 512K, 64M, 2G)
+//   /file-<size>.bin              same, with the command-line impairments only
+//
+// Spec tokens:
+//   b<bits/s>  bitrate (b8M)      d<sec> duration (d120)     s<sec> segment length (s4)
+//   f<fps>     frame rate (f25)   aes    AES-128 HLS segments  tl     DASH SegmentTimeline
+//   l<ms> latency  j<ms> jitter  r<bytes/s> per-response cap  e<pct> 503 rate  t<pct> truncation rate
+//   n<id>      ignored; makes URLs unique so host-side caches start cold
+// Example: /v/b8M-d60-s2-aes-l40-j10-r4M/ts.m3u8
+//
+// Stdout:
+//   PORT=<port>                             once listening
+//   REQUESTS=<n> BYTES=<n> ERRORS=<n>       on SIGINT/SIGTERM
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+enum ExitCode {
+    SUCCESS = 0,
+    ERR_ARGS = 2,
+    ERR_LISTEN = 3
+};
+
+typedef std::vector<std::uint8_t> Bytes;
+
+static const std::uint32_t VIDEO_TIMESCALE = 90000;
+static const std::uint16_t TS_PID_PMT = 0x1000;
+static const std::uint16_t TS_PID_VIDEO = 0x100;
+static const std::size_t SEND_CHUNK = 64 * 1024;
+
+struct Impairments {
+    int latencyMs = 0;
+    int jitterMs = 0;
+    double rate = 0;          // bytes/s per response, 0 = unlimited
+    double errorPct = 0;      // respond 503
+    double truncatePct = 0;   // close mid-body
+};
+
+struct StreamSpec {
+    double bitrate = 4e6;
+    double duration = 60;
+    double segment = 4;
+    int fps = 25;
+    bool aes = false;
+    bool timeline = false;
+    Impairments impair;
+};
+
+static Impairments g_defaults;
+static std::uint64_t g_seed = 1;
+static bool g_quiet = false;
+static std::atomic<std::uint64_t> g_requests(0);
+static std::atomic<std::uint64_t> g_bytes(0);
+static std::atomic<std::uint64_t> g_errors(0);
+static volatile std::sig_atomic_t g_stop = 0;
+
+// --- Small helpers ---
+
+static bool parse_size(const std::string& text, double& out) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || value < 0) return false;
+    std::string suffix(end);
+    if (suffix == "K" || suffix == "k") value *= 1e3;
+    else if (suffix == "M" || suffix == "m") value *= 1e6;
+    else if (suffix == "G" || suffix == "g") value *= 1e9;
+    else if (!suffix.empty()) return false;
+    out = value;
+    return true;
+}
+
+static std::uint64_t splitmix64(std::uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static void put16(Bytes& out, std::uint32_t v) {
+    out.push_back(static_cast<std::uint8_t>(v >> 8));
+    out.push_back(static_cast<std::uint8_t>(v));
+}
+
+static void put32(Bytes& out, std::uint32_t v) {
+    put16(out, v >> 16);
+    put16(out, v & 0xFFFF);
+}
+
+static void put64(Bytes& out, std::uint64_t v) {
+    put32(out, static_cast<std::uint32_t>(v >> 32));
+    put32(out, static_cast<std::uint32_t>(v));
+}
+
+static void patch32(Bytes& out, std::size_t at, std::uint32_t v) {
+    out[at] = static_cast<std::uint8_t>(v >> 24);
+    out[at + 1] = static_cast<std::uint8_t>(v >> 16);
+    out[at + 2] = static_cast<std::uint8_t>(v >> 8);
+    out[at + 3] = static_cast<std::uint8_t>(v);
+}
+
+// --- H.264 elementary stream ---
+
+class BitWriter {
+public:
+    void bit(int b) {
+        current_ = static_cast<std::uint8_t>((current_ << 1) | (b & 1));
+        if (++count_ == 8) {
+            bytes_.push_back(current_);
+            current_ = 0;
+            count_ = 0;
+        }
+    }
+    void bits(std::uint32_t value, int n) {
+        for (int i = n - 1; i >= 0; --i) bit(static_cast<int>((value >> i) & 1));
+    }
+    void ue(std::uint32_t value) {
+        std::uint32_t x = value + 1;
+        int len = 0;
+        for (std::uint32_t t = x; t > 1; t >>= 1) ++len;
+        bits(0, len);
+        bits(x, len + 1);
+    }
+    void se(int value) { ue(value <= 0 ? static_cast<std::uint32_t>(-2 * value) : static_cast<std::uint32_t>(2 * value - 1)); }
+    void align_zero() { while (count_) bit(0); }
+    void trailing() { bit(1); align_zero(); }
+    bool aligned() const { return count_ == 0; }
+    Bytes& bytes() { return bytes_; }
+
+private:
+    Bytes bytes_;
+    std::uint8_t current_ = 0;
+    int count_ = 0;
+};
+
+// NAL unit (header byte + escaped RBSP), without start code or length prefix
+static Bytes make_nal(std::uint8_t header, const Bytes& rbsp) {
+    Bytes nal(1, header);
+    int zeros = 0;
+    for (std::uint8_t b : rbsp) {
+        if (zeros >= 2 && b <= 3) {
+            nal.push_back(3);
+            zeros = 0;
+        }
+        nal.push_back(b);
+        zeros = b == 0 ? zeros + 1 : 0;
+    }
+    return nal;
+}
+
+static Bytes make_sps() {
+    BitWriter w;
+    w.bits(66, 8);    // Baseline
+    w.bits(0xC0, 8);  // constraint_set0/1
+    w.bits(10, 8);    // level 1.0
+    w.ue(0);          // seq_parameter_set_id
+    w.ue(0);          // log2_max_frame_num_minus4
+    w.ue(2);          // pic_order_cnt_type
+    w.ue(0);          // max_num_ref_frames
+    w.bit(0);         // gaps_in_frame_num_value_allowed_flag
+    w.ue(0);          // pic_width_in_mbs_minus1 (16px)
+    w.ue(0);          // pic_height_in_map_units_minus1 (16px)
+    w.bit(1);         // frame_mbs_only_flag
+    w.bit(1);         // direct_8x8_inference_flag
+    w.bit(0);         // frame_cropping_flag
+    w.bit(0);         // vui_parameters_present_flag
+    w.trailing();
+    return make_nal(0x67, w.bytes());
+}
+
+static Bytes make_pps() {
+    BitWriter w;
+    w.ue(0);   // pic_parameter_set_id
+    w.ue(0);   // seq_parameter_set_id
+    w.bit(0);  // entropy_coding_mode_flag (CAVLC)
+    w.bit(0);  // bottom_field_pic_order_in_frame_present_flag
+    w.ue(0);   // num_slice_groups_minus1
+    w.ue(0);   // num_ref_idx_l0_default_active_minus1
+    w.ue(0);   // num_ref_idx_l1_default_active_minus1
+    w.bit(0);  // weighted_pred_flag
+    w.bits(0, 2);
+    w.se(0);   // pic_init_qp_minus26
+    w.se(0);   // pic_init_qs_minus26
+    w.se(0);   // chroma_qp_index_offset
+    w.bit(1);  // deblocking_filter_control_present_flag
+    w.bit(0);  // constrained_intra_pred_flag
+    w.bit(0);  // redundant_pic_cnt_present_flag
+    w.trailing();
+    return make_nal(0x68, w.bytes());
+}
+
+// One IDR slice holding a single I_PCM macroblock. idr_pic_id alternates 1/2 (same ue
+// length) so consecutive IDRs differ while every frame keeps the same size.
+static Bytes make_idr(std::uint32_t frame) {
+    BitWriter w;
+    w.ue(0);                        // first_mb_in_slice
+    w.ue(7);                        // slice_type: I (all slices)
+    w.ue(0);                        // pic_parameter_set_id
+    w.bits(0, 4);                   // frame_num
+    w.ue(1 + (frame & 1));          // idr_pic_id
+    w.bit(0);                       // no_output_of_prior_pics_flag
+    w.bit(0);                       // long_term_reference_flag
+    w.se(0);                        // slice_qp_delta
+    w.ue(1);                        // disable_deblocking_filter_idc
+    w.ue(25);                       // mb_type: I_PCM
+    w.align_zero();                 // pcm_alignment_zero_bit
+    const std::uint8_t shade = static_cast<std::uint8_t>(16 + (frame * 7) % 224);
+    for (int i = 0; i < 256; ++i) w.bits(shade, 8);
+    for (int i = 0; i < 128; ++i) w.bits(128, 8);
+    w.trailing();
+    return make_nal(0x65, w.bytes());
+}
+
+static Bytes make_filler(std::size_t payload) {
+    Bytes nal(1, 0x0C);
+    nal.insert(nal.end(), payload, 0xFF);
+    nal.push_back(0x80);
+    return nal;
+}
+
+struct VideoLayout {
+    std::uint32_t frameDuration;      // in 90 kHz ticks
+    std::uint32_t framesPerSegment;
+    std::uint32_t segmentCount;
+    std::size_t fillerPayload;        // filler bytes per frame to reach the bitrate
+};
+
+static const Bytes& sps_nal() { static const Bytes nal = make_sps(); return nal; }
+static const Bytes& pps_nal() { static const Bytes nal = make_pps(); return nal; }
+
+static VideoLayout layout_for(const StreamSpec& spec) {
+    VideoLayout layout;
+    layout.frameDuration = VIDEO_TIMESCALE / static_cast<std::uint32_t>(spec.fps);
+    layout.framesPerSegment = std::max<std::uint32_t>(1, static_cast<std::uint32_t>(std::lround(spec.segment * spec.fps)));
+    layout.segmentCount = std::max<std::uint32_t>(1, static_cast<std::uint32_t>(std::ceil(spec.duration * spec.fps / layout.framesPerSegment)));
+    const double frameBytes = spec.bitrate / 8.0 / spec.fps;
+    const double base = 4.0 + make_idr(0).size();
+    layout.fillerPayload = frameBytes > base + 6 ? static_cast<std::size_t>(frameBytes - base - 6) : 0;
+    return layout;
+}
+
+// --- MPEG-TS ---
+
+static std::uint32_t crc32_mpeg(const std::uint8_t* data, std::size_t len) {
+    std::uint32_t crc = 0xFFFFFFFF;
+    for (std::size_t i = 0; i < len; ++i) {
+        crc ^= static_cast<std::uint32_t>(data[i]) << 24;
+        for (int b = 0; b < 8; ++b) crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+    }
+    return crc;
+}
+
+static void ts_section_packet(Bytes& out, std::uint16_t pid, std::uint8_t cc, const Bytes& section) {
+    const std::size_t start = out.size();
+    out.push_back(0x47);
+    out.push_back(static_cast<std::uint8_t>(0x40 | (pid >> 8)));
+    out.push_back(static_cast<std::uint8_t>(pid));
+    out.push_back(static_cast<std::uint8_t>(0x10 | (cc & 0x0F)));
+    out.push_back(0);  // pointer_field
+    out.insert(out.end(), section.begin(), section.end());
+    const std::uint32_t crc = crc32_mpeg(&section[0], section.size());
+    put32(out, crc);
+    out.resize(start + 188, 0xFF);
+}
+
+static void ts_psi(Bytes& out, std::uint8_t cc) {
+    Bytes pat = { 0x00, 0xB0, 13, 0x00, 0x01, 0xC1, 0x00, 0x00, 0x00, 0x01,
+                  static_cast<std::uint8_t>(0xE0 | (TS_PID_PMT >> 8)), static_cast<std::uint8_t>(TS_PID_PMT & 0xFF) };
+    ts_section_packet(out, 0, cc, pat);
+    Bytes pmt = { 0x02, 0xB0, 18, 0x00, 0x01, 0xC1, 0x00, 0x00,
+                  static_cast<std::uint8_t>(0xE0 | (TS_PID_VIDEO >> 8)), static_cast<std::uint8_t>(TS_PID_VIDEO & 0xFF), 0xF0, 0x00,
+                  0x1B, static_cast<std::uint8_t>(0xE0 | (TS_PID_VIDEO >> 8)), static_cast<std::uint8_t>(TS_PID_VIDEO & 0xFF), 0xF0, 0x00 };
+    ts_section_packet(out, TS_PID_PMT, cc, pmt);
+}
+
+static void put_timestamp(Bytes& out, std::uint8_t prefix, std::uint64_t ts) {
+    out.push_back(static_cast<std::uint8_t>((prefix << 4) | (((ts >> 30) & 0x07) << 1) | 1));
+    put16(out, static_cast<std::uint32_t>((((ts >> 15) & 0x7FFF) << 1) | 1));
+    put16(out, static_cast<std::uint32_t>(((ts & 0x7FFF) << 1) | 1));
+}
+
+static Bytes annexb_frame(std::uint32_t frame, std::size_t fillerPayload) {
+    static const std::uint8_t startCode[] = { 0, 0, 0, 1 };
+    static const std::uint8_t aud[] = { 0x09, 0xF0 };
+    Bytes es;
+    auto append = [&](const std::uint8_t* data, std::size_t len) {
+        es.insert(es.end(), startCode, startCode + 4);
+        es.insert(es.end(), data, data + len);
+    };
+    append(aud, sizeof(aud));
+    append(&sps_nal()[0], sps_nal().size());
+    append(&pps_nal()[0], pps_nal().size());
+    const Bytes idr = make_idr(frame);
+    append(&idr[0], idr.size());
+    if (fillerPayload) {
+        const Bytes filler = make_filler(fillerPayload);
+        append(&filler[0], filler.size());
+    }
+    return es;
+}
+
+static std::size_t ts_packets_for(std::size_t pesBytes) {
+    // First packet carries an 8-byte adaptation field with the PCR
+    if (pesBytes <= 176) return 1;
+    return 1 + (pesBytes - 176 + 183) / 184;
+}
+
+static Bytes ts_segment(const VideoLayout& layout, std::uint32_t index) {
+    const std::uint32_t firstFrame = index * layout.framesPerSegment;
+    const std::size_t pesBytes = 14 + annexb_frame(0, layout.fillerPayload).size();
+    std::uint8_t cc = static_cast<std::uint8_t>((static_cast<std::uint64_t>(firstFrame) * ts_packets_for(pesBytes)) & 0x0F);
+
+    Bytes out;
+    out.reserve((2 + layout.framesPerSegment * ts_packets_for(pesBytes)) * 188);
+    ts_psi(out, static_cast<std::uint8_t>(index & 0x0F));
+
+    for (std::uint32_t f = 0; f < layout.framesPerSegment; ++f) {
+        const std::uint32_t frame = firstFrame + f;
+        const std::uint64_t pts = 126000 + static_cast<std::uint64_t>(frame) * layout.frameDuration;
+        const std::uint64_t pcr = pts - 63000;
+
+        Bytes pes = { 0x00, 0x00, 0x01, 0xE0, 0x00, 0x00, 0x80, 0x80, 0x05 };
+        put_timestamp(pes, 0x2, pts);
+        const Bytes es = annexb_frame(frame, layout.fillerPayload);
+        pes.insert(pes.end(), es.begin(), es.end());
+
+        std::size_t offset = 0;
+        bool first = true;
+        while (offset < pes.size()) {
+            const std::size_t remaining = pes.size() - offset;
+            const std::size_t afMin = first ? 8 : 0;
+            const std::size_t capacity = 184 - afMin;
+            const std::size_t payload = std::min(remaining, capacity);
+            std::size_t afLength = afMin;
+            if (payload < capacity || (!first && remaining < 184)) afLength = 184 - payload;
+
+            out.push_back(0x47);
+            out.push_back(static_cast<std::uint8_t>((first ? 0x40 : 0x00) | (TS_PID_VIDEO >> 8)));
+            out.push_back(static_cast<std::uint8_t>(TS_PID_VIDEO & 0xFF));
+            out.push_back(static_cast<std::uint8_t>((afLength ? 0x30 : 0x10) | (cc & 0x0F)));
+            cc = static_cast<std::uint8_t>((cc + 1) & 0x0F);
+
+            if (afLength) {
+                out.push_back(static_cast<std::uint8_t>(afLength - 1));
+                std::size_t written = 0;
+                if (afLength > 1) {
+                    out.push_back(first ? 0x10 : 0x00);
+                    written = 1;
+                    if (first) {
+                        const std::uint64_t base = pcr;
+                        out.push_back(static_cast<std::uint8_t>(base >> 25));
+                        out.push_back(static_cast<std::uint8_t>(base >> 17));
+                        out.push_back(static_cast<std::uint8_t>(base >> 9));
+                        out.push_back(static_cast<std::uint8_t>(base >> 1));
+                        out.push_back(static_cast<std::uint8_t>(((base & 1) << 7) | 0x7E));
+                        out.push_back(0x00);
+                        written += 6;
+                    }
+                }
+                out.insert(out.end(), afLength - 1 - written, 0xFF);
+            }
+            out.insert(out.end(), pes.begin() + static_cast<std::ptrdiff_t>(offset), pes.begin() + static_cast<std::ptrdiff_t>(offset + payload));
+            offset += payload;
+            first = false;
+        }
+    }
+    return out;
+}
+
+// --- Fragmented MP4 ---
+
+class BoxWriter {
+public:
+    explicit BoxWriter(Bytes& out) : out_(out) {}
+    void open(const char* type, int version = -1, std::uint32_t flags = 0) {
+        starts_.push_back(out_.size());
+        put32(out_, 0);
+        out_.insert(out_.end(), type, type + 4);
+        if (version >= 0) put32(out_, (static_cast<std::uint32_t>(version) << 24) | flags);
+    }
+    void close() {
+        const std::size_t start = starts_.back();
+        starts_.pop_back();
+        patch32(out_, start, static_cast<std::uint32_t>(out_.size() - start));
+    }
+
+private:
+    Bytes& out_;
+    std::vector<std::size_t> starts_;
+};
+
+static void put_matrix(Bytes& out) {
+    const std::uint32_t matrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+    for (std::uint32_t v : matrix) put32(out, v);
+}
+
+static void put_avc1_stsd(Bytes& out) {
+    BoxWriter box(out);
+    box.open("stsd", 0);
+    put32(out, 1);
+    box.open("avc1");
+    out.insert(out.end(), 6, 0);
+    put16(out, 1);                       // data_reference_index
+    out.insert(out.end(), 16, 0);
+    put16(out, 16); put16(out, 16);
+    put32(out, 0x00480000); put32(out, 0x00480000);
+    put32(out, 0);
+    put16(out, 1);                       // frame_count
+    out.insert(out.end(), 32, 0);        // compressorname
+    put16(out, 0x0018); put16(out, 0xFFFF);
+    box.open("avcC");
+    out.push_back(1);
+    out.push_back(sps_nal()[1]); out.push_back(sps_nal()[2]); out.push_back(sps_nal()[3]);
+    out.push_back(0xFF);                 // 4-byte NAL lengths
+    out.push_back(0xE1);
+    put16(out, static_cast<std::uint32_t>(sps_nal().size()));
+    out.insert(out.end(), sps_nal().begin(), sps_nal().end());
+    out.push_back(1);
+    put16(out, static_cast<std::uint32_t>(pps_nal().size()));
+    out.insert(out.end(), pps_nal().begin(), pps_nal().end());
+    box.close();
+    box.close();
+    box.close();
+}
+
+// Length-prefixed access unit: the IDR slice plus its filler NAL
+static Bytes avcc_sample(std::uint32_t frame, std::size_t fillerPayload) {
+    Bytes sample;
+    const Bytes idr = make_idr(frame);
+    put32(sample, static_cast<std::uint32_t>(idr.size()));
+    sample.insert(sample.end(), idr.begin(), idr.end());
+    if (fillerPayload) {
+        const Bytes filler = make_filler(fillerPayload);
+        put32(sample, static_cast<std::uint32_t>(filler.size()));
+        sample.insert(sample.end(), filler.begin(), filler.end());
+    }
+    return sample;
+}
+
+static Bytes fmp4_init() {
+    Bytes out;
+    BoxWriter box(out);
+    box.open("ftyp");
+    out.insert(out.end(), { 'i', 's', 'o', '6' });
+    put32(out, 0);
+    for (const char* brand : { "iso6", "isom", "avc1", "dash", "cmfc" }) out.insert(out.end(), brand, brand + 4);
+    box.close();
+
+    box.open("moov");
+    box.open("mvhd", 0);
+    put32(out, 0); put32(out, 0); put32(out, 1000); put32(out, 0);
+    put32(out, 0x00010000); put16(out, 0x0100); put16(out, 0); put32(out, 0); put32(out, 0);
+    put_matrix(out);
+    for (int i = 0; i < 6; ++i) put32(out, 0);
+    put32(out, 2);
+    box.close();
+
+    box.open("trak");
+    box.open("tkhd", 0, 3);
+    put32(out, 0); put32(out, 0); put32(out, 1); put32(out, 0); put32(out, 0);
+    put32(out, 0); put32(out, 0); put16(out, 0); put16(out, 0); put16(out, 0); put16(out, 0);
+    put_matrix(out);
+    put32(out, 16 << 16); put32(out, 16 << 16);
+    box.close();
+
+    box.open("mdia");
+    box.open("mdhd", 0);
+    put32(out, 0); put32(out, 0); put32(out, VIDEO_TIMESCALE); put32(out, 0);
+    put16(out, 0x55C4); put16(out, 0);  // 'und'
+    box.close();
+    box.open("hdlr", 0);
+    put32(out, 0);
+    out.insert(out.end(), { 'v', 'i', 'd', 'e' });
+    put32(out, 0); put32(out, 0); put32(out, 0);
+    static const char handlerName[] = "VideoHandler";
+    out.insert(out.end(), handlerName, handlerName + sizeof(handlerName));
+    box.close();
+
+    box.open("minf");
+    box.open("vmhd", 0, 1);
+    put16(out, 0); put16(out, 0); put16(out, 0); put16(out, 0);
+    box.close();
+    box.open("dinf");
+    box.open("dref", 0);
+    put32(out, 1);
+    box.open("url ", 0, 1);
+    box.close();
+    box.close();
+    box.close();
+
+    box.open("stbl");
+    put_avc1_stsd(out);
+    for (const char* empty : { "stts", "stsc", "stco" }) {
+        box.open(empty, 0);
+        put32(out, 0);
+        box.close();
+    }
+    box.open("stsz", 0);
+    put32(out, 0); put32(out, 0);
+    box.close();
+    box.close();  // stbl
+    box.close();  // minf
+    box.close();  // mdia
+    box.close();  // trak
+
+    box.open("mvex");
+    box.open("trex", 0);
+    put32(out, 1); put32(out, 1); put32(out, 0); put32(out, 0); put32(out, 0);
+    box.close();
+    box.close();
+    box.close();  // moov
+    return out;
+}
+
+static Bytes fmp4_segment(const VideoLayout& layout, std::uint32_t index) {
+    const std::uint32_t firstFrame = index * layout.framesPerSegment;
+    std::vector<Bytes> samples;
+    samples.reserve(layout.framesPerSegment);
+    for (std::uint32_t f = 0; f < layout.framesPerSegment; ++f) samples.push_back(avcc_sample(firstFrame + f, layout.fillerPayload));
+
+    Bytes out;
+    BoxWriter box(out);
+    box.open("styp");
+    out.insert(out.end(), { 'm', 's', 'd', 'h' });
+    put32(out, 0);
+    out.insert(out.end(), { 'm', 's', 'd', 'h', 'm', 's', 'i', 'x' });
+    box.close();
+
+    const std::size_t moofStart = out.size();
+    box.open("moof");
+    box.open("mfhd", 0);
+    put32(out, index + 1);
+    box.close();
+    box.open("traf");
+    box.open("tfhd", 0, 0x020000 | 0x000008 | 0x000020);  // default-base-is-moof, duration, flags
+    put32(out, 1);
+    put32(out, layout.frameDuration);
+    put32(out, 0x02000000);  // every sample is a sync sample
+    box.close();
+    box.open("tfdt", 1);
+    put64(out, static_cast<std::uint64_t>(firstFrame) * layout.frameDuration);
+    box.close();
+    box.open("trun", 0, 0x000001 | 0x000200);  // data offset, sample sizes
+    put32(out, static_cast<std::uint32_t>(samples.size()));
+    const std::size_t dataOffsetAt = out.size();
+    put32(out, 0);
+    for (const Bytes& sample : samples) put32(out, static_cast<std::uint32_t>(sample.size()));
+    box.close();
+    box.close();  // traf
+    box.close();  // moof
+    patch32(out, dataOffsetAt, static_cast<std::uint32_t>(out.size() - moofStart + 8));
+
+    box.open("mdat");
+    for (const Bytes& sample : samples) out.insert(out.end(), sample.begin(), sample.end());
+    box.close();
+    return out;
+}
+
+// --- Progressive MP4 ---
+
+// One chunk per segment-length run of frames; chunk offsets switch to co64 past 4 GiB
+static Bytes progressive_moov(const VideoLayout& layout, const std::vector<std::uint64_t>& chunkOffsets) {
+    const std::uint32_t frames = layout.segmentCount * layout.framesPerSegment;
+    const std::uint64_t ticks = static_cast<std::uint64_t>(frames) * layout.frameDuration;
+    const std::uint32_t durationMs = static_cast<std::uint32_t>(ticks / (VIDEO_TIMESCALE / 1000));
+    const std::uint32_t sampleSize = static_cast<std::uint32_t>(avcc_sample(0, layout.fillerPayload).size());
+    const bool wide = !chunkOffsets.empty() && chunkOffsets.back() > 0xFFFFFFFFULL;
+
+    Bytes out;
+    BoxWriter box(out);
+    box.open("moov");
+    box.open("mvhd", 0);
+    put32(out, 0); put32(out, 0); put32(out, 1000); put32(out, durationMs);
+    put32(out, 0x00010000); put16(out, 0x0100); put16(out, 0); put32(out, 0); put32(out, 0);
+    put_matrix(out);
+    for (int i = 0; i < 6; ++i) put32(out, 0);
+    put32(out, 2);
+    box.close();
+
+    box.open("trak");
+    box.open("tkhd", 0, 3);
+    put32(out, 0); put32(out, 0); put32(out, 1); put32(out, 0); put32(out, durationMs);
+    put32(out, 0); put32(out, 0); put16(out, 0); put16(out, 0); put16(out, 0); put16(out, 0);
+    put_matrix(out);
+    put32(out, 16 << 16); put32(out, 16 << 16);
+    box.close();
+
+    box.open("mdia");
+    box.open("mdhd", 1);
+    put64(out, 0); put64(out, 0); put32(out, VIDEO_TIMESCALE); put64(out, ticks);
+    put16(out, 0x55C4); put16(out, 0);  // 'und'
+    box.close();
+    box.open("hdlr", 0);
+    put32(out, 0);
+    out.insert(out.end(), { 'v', 'i', 'd', 'e' });
+    put32(out, 0); put32(out, 0); put32(out, 0);
+    static const char handlerName[] = "VideoHandler";
+    out.insert(out.end(), handlerName, handlerName + sizeof(handlerName));
+    box.close();
+
+    box.open("minf");
+    box.open("vmhd", 0, 1);
+    put16(out, 0); put16(out, 0); put16(out, 0); put16(out, 0);
+    box.close();
+    box.open("dinf");
+    box.open("dref", 0);
+    put32(out, 1);
+    box.open("url ", 0, 1);
+    box.close();
+    box.close();
+    box.close();
+
+    box.open("stbl");
+    put_avc1_stsd(out);
+    box.open("stts", 0);
+    put32(out, 1); put32(out, frames); put32(out, layout.frameDuration);
+    box.close();
+    box.open("stsc", 0);
+    put32(out, 1); put32(out, 1); put32(out, layout.framesPerSegment); put32(out, 1);
+    box.close();
+    box.open("stsz", 0);
+    put32(out, sampleSize); put32(out, frames);
+    box.close();
+    box.open(wide ? "co64" : "stco", 0);
+    put32(out, static_cast<std::uint32_t>(chunkOffsets.size()));
+    for (std::uint64_t offset : chunkOffsets) {
+        if (wide) put64(out, offset);
+        else put32(out, static_cast<std::uint32_t>(offset));
+    }
+    box.close();
+    box.close();  // stbl
+    box.close();  // minf
+    box.close();  // mdia
+    box.close();  // trak
+    box.close();  // moov
+    return out;
+}
+
+static Bytes progressive_mp4(const VideoLayout& layout, bool faststart) {
+    Bytes out;
+    BoxWriter box(out);
+    box.open("ftyp");
+    out.insert(out.end(), { 'i', 's', 'o', 'm' });
+    put32(out, 0x200);
+    for (const char* brand : { "isom", "iso2", "avc1", "mp41" }) out.insert(out.end(), brand, brand + 4);
+    box.close();
+
+    const std::uint32_t frames = layout.segmentCount * layout.framesPerSegment;
+    const std::uint64_t sampleSize = avcc_sample(0, layout.fillerPayload).size();
+    const std::uint64_t payload = sampleSize * frames;
+    const bool largeMdat = payload + 8 > 0xFFFFFFFFULL;
+    const std::uint64_t mdatHeader = largeMdat ? 16 : 8;
+
+    // moov's size does not depend on the offsets' values, so lay it out once to measure it
+    std::vector<std::uint64_t> offsets(layout.segmentCount, largeMdat ? 0x100000000ULL : 0);
+    const std::uint64_t moovSize = faststart ? progressive_moov(layout, offsets).size() : 0;
+    const std::uint64_t dataStart = out.size() + moovSize + mdatHeader;
+    for (std::uint32_t i = 0; i < layout.segmentCount; ++i) offsets[i] = dataStart + i * sampleSize * layout.framesPerSegment;
+
+    if (faststart) {
+        const Bytes moov = progressive_moov(layout, offsets);
+        out.insert(out.end(), moov.begin(), moov.end());
+    }
+    if (largeMdat) {
+        put32(out, 1);
+        out.insert(out.end(), { 'm', 'd', 'a', 't' });
+        put64(out, payload + 16);
+    } else {
+        put32(out, static_cast<std::uint32_t>(payload + 8));
+        out.insert(out.end(), { 'm', 'd', 'a', 't' });
+    }
+    out.reserve(out.size() + static_cast<std::size_t>(payload) + 4096);
+    for (std::uint32_t f = 0; f < frames; ++f) {
+        const Bytes sample = avcc_sample(f, layout.fillerPayload);
+        out.insert(out.end(), sample.begin(), sample.end());
+    }
+    if (!faststart) {
+        const Bytes moov = progressive_moov(layout, offsets);
+        out.insert(out.end(), moov.begin(), moov.end());
+    }
+    return out;
+}
+
+// --- AES-128-CBC (HLS full-segment encryption) ---
+
+static const std::uint8_t SBOX[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+class Aes128 {
+public:
+    explicit Aes128(const std::uint8_t key[16]) {
+        static const std::uint8_t rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+        std::memcpy(roundKeys_, key, 16);
+        for (int i = 4; i < 44; ++i) {
+            std::uint8_t t[4];
+            std::memcpy(t, roundKeys_ + (i - 1) * 4, 4);
+            if (i % 4 == 0) {
+                const std::uint8_t first = t[0];
+                t[0] = static_cast<std::uint8_t>(SBOX[t[1]] ^ rcon[i / 4 - 1]);
+                t[1] = SBOX[t[2]];
+                t[2] = SBOX[t[3]];
+                t[3] = SBOX[first];
+            }
+            for (int j = 0; j < 4; ++j) roundKeys_[i * 4 + j] = static_cast<std::uint8_t>(roundKeys_[(i - 4) * 4 + j] ^ t[j]);
+        }
+    }
+
+    void encrypt_block(std::uint8_t s[16]) const {
+        add_round_key(s, 0);
+        for (int round = 1; round <= 10; ++round) {
+            for (int i = 0; i < 16; ++i) s[i] = SBOX[s[i]];
+            shift_rows(s);
+            if (round != 10) mix_columns(s);
+            add_round_key(s, round);
+        }
+    }
+
+private:
+    static std::uint8_t xtime(std::uint8_t x) { return static_cast<std::uint8_t>((x << 1) ^ ((x & 0x80) ? 0x1b : 0)); }
+
+    void add_round_key(std::uint8_t s[16], int round) const {
+        for (int i = 0; i < 16; ++i) s[i] ^= roundKeys_[round * 16 + i];
+    }
+
+    static void shift_rows(std::uint8_t s[16]) {
+        std::uint8_t t[16];
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r) t[c * 4 + r] = s[((c + r) % 4) * 4 + r];
+        std::memcpy(s, t, 16);
+    }
+
+    static void mix_columns(std::uint8_t s[16]) {
+        for (int c = 0; c < 4; ++c) {
+            std::uint8_t* col = s + c * 4;
+            const std::uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+            const std::uint8_t all = static_cast<std::uint8_t>(a0 ^ a1 ^ a2 ^ a3);
+            col[0] = static_cast<std::uint8_t>(a0 ^ all ^ xtime(static_cast<std::uint8_t>(a0 ^ a1)));
+            col[1] = static_cast<std::uint8_t>(a1 ^ all ^ xtime(static_cast<std::uint8_t>(a1 ^ a2)));
+            col[2] = static_cast<std::uint8_t>(a2 ^ all ^ xtime(static_cast<std::uint8_t>(a2 ^ a3)));
+            col[3] = static_cast<std::uint8_t>(a3 ^ all ^ xtime(static_cast<std::uint8_t>(a3 ^ a0)));
+        }
+    }
+
+    std::uint8_t roundKeys_[176];
+};
+
+static void stream_key(std::uint8_t key[16]) {
+    const std::uint64_t a = splitmix64(g_seed ^ 0x6B6579ULL);
+    const std::uint64_t b = splitmix64(a);
+    for (int i = 0; i < 8; ++i) {
+        key[i] = static_cast<std::uint8_t>(a >> (i * 8));
+        key[8 + i] = static_cast<std::uint8_t>(b >> (i * 8));
+    }
+}
+
+// Without an IV attribute, HLS uses the media sequence number as the IV
+static void encrypt_segment(Bytes& data, std::uint32_t sequence) {
+    std::uint8_t key[16];
+    stream_key(key);
+    const Aes128 aes(key);
+    const std::size_t pad = 16 - (data.size() % 16);
+    data.insert(data.end(), pad, static_cast<std::uint8_t>(pad));
+    std::uint8_t iv[16] = { 0 };
+    for (int i = 0; i < 4; ++i) iv[15 - i] = static_cast<std::uint8_t>(sequence >> (i * 8));
+    for (std::size_t offset = 0; offset < data.size(); offset += 16) {
+        for (int i = 0; i < 16; ++i) data[offset + i] ^= iv[i];
+        aes.encrypt_block(&data[offset]);
+        std::memcpy(iv, &data[offset], 16);
+    }
+}
+
+// --- Manifests ---
+
+static std::string hls_playlist(const StreamSpec& spec, const VideoLayout& layout, bool fmp4) {
+    std::ostringstream out;
+    const double segmentSeconds = static_cast<double>(layout.framesPerSegment) * layout.frameDuration / VIDEO_TIMESCALE;
+    out << "#EXTM3U\n#EXT-X-VERSION:" << (fmp4 ? 7 : 3) << "\n";
+    out << "#EXT-X-TARGETDURATION:" << static_cast<int>(std::ceil(segmentSeconds)) << "\n";
+    out << "#EXT-X-MEDIA-SEQUENCE:0\n#EXT-X-PLAYLIST-TYPE:VOD\n";
+    if (fmp4) out << "#EXT-X-MAP:URI=\"init.mp4\"\n";
+    if (spec.aes) out << "#EXT-X-KEY:METHOD=AES-128,URI=\"key.bin\"\n";
+    char duration[32];
+    std::snprintf(duration, sizeof(duration), "%.3f", segmentSeconds);
+    for (std::uint32_t i = 0; i < layout.segmentCount; ++i) {
+        out << "#EXTINF:" << duration << ",\n" << i << (fmp4 ? ".m4s" : ".ts") << "\n";
+    }
+    out << "#EXT-X-ENDLIST\n";
+    return out.str();
+}
+
+static std::string dash_manifest(const StreamSpec& spec, const VideoLayout& layout) {
+    const std::uint64_t segmentTicks = static_cast<std::uint64_t>(layout.framesPerSegment) * layout.frameDuration;
+    const double total = static_cast<double>(segmentTicks) * layout.segmentCount / VIDEO_TIMESCALE;
+    char durationText[32];
+    std::snprintf(durationText, sizeof(durationText), "PT%.3fS", total);
+
+    std::ostringstream out;
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" profiles=\"urn:mpeg:dash:profile:isoff-live:2011\" type=\"static\""
+        << " mediaPresentationDuration=\"" << durationText << "\" minBufferTime=\"PT2S\">\n"
+        << "  <Period id=\"0\" start=\"PT0S\">\n"
+        << "    <AdaptationSet mimeType=\"video/mp4\" segmentAlignment=\"true\" startWithSAP=\"1\">\n"
+        << "      <Representation id=\"v0\" codecs=\"avc1.42C00A\" width=\"16\" height=\"16\" frameRate=\"" << spec.fps
+        << "\" bandwidth=\"" << static_cast<std::uint64_t>(spec.bitrate) << "\">\n";
+    if (spec.timeline) {
+        out << "        <SegmentTemplate timescale=\"" << VIDEO_TIMESCALE << "\" initialization=\"init.mp4\" media=\"seg-t$Time$.m4s\">\n"
+            << "          <SegmentTimeline><S t=\"0\" d=\"" << segmentTicks << "\" r=\"" << (layout.segmentCount - 1) << "\"/></SegmentTimeline>\n"
+            << "        </SegmentTemplate>\n";
+    } else {
+        out << "        <SegmentTemplate timescale=\"" << VIDEO_TIMESCALE << "\" duration=\"" << segmentTicks
+            << "\" startNumber=\"0\" initialization=\"init.mp4\" media=\"seg-$Number$.m4s\"/>\n";
+    }
+    out << "      </Representation>\n    </AdaptationSet>\n  </Period>\n</MPD>\n";
+    return out.str();
+}
+
+// --- Request routing ---
+
+static bool parse_spec(const std::string& text, StreamSpec& spec) {
+    spec.impair = g_defaults;
+    std::stringstream tokens(text);
+    std::string token;
+    while (std::getline(tokens, token, '-')) {
+        if (token.empty()) continue;
+        if (token == "aes") { spec.aes = true; continue; }
+        if (token == "tl") { spec.timeline = true; continue; }
+        const char kind = token[0];
+        double value = 0;
+        if (!parse_size(token.substr(1), value)) return false;
+        switch (kind) {
+            case 'b': spec.bitrate = std::max(8000.0, value); break;
+            case 'd': spec.duration = std::max(0.1, value); break;
+            case 's': spec.segment = std::max(0.04, value); break;
+            case 'f': spec.fps = std::max(1, std::min(120, static_cast<int>(value))); break;
+            case 'l': spec.impair.latencyMs = static_cast<int>(value); break;
+            case 'j': spec.impair.jitterMs = static_cast<int>(value); break;
+            case 'r': spec.impair.rate = value; break;
+            case 'e': spec.impair.errorPct = value; break;
+            case 't': spec.impair.truncatePct = value; break;
+            case 'n': break;
+            default: return false;
+        }
+    }
+    return true;
+}
+
+struct Response {
+    int status = 200;
+    std::string contentType = "application/octet-stream";
+    Bytes body;
+    // Plain files are generated while sending instead of being buffered
+    bool patterned = false;
+    bool ranged = false;              // Range requests are honoured (patterned or whole-file bodies)
+    std::uint64_t fileSize = 0;
+    std::uint64_t rangeStart = 0;
+    std::uint64_t rangeEnd = 0;
+    Impairments impair;
+};
+
+static void set_text(Response& response, const std::string& type, const std::string& text) {
+    response.contentType = type;
+    response.body.assign(text.begin(), text.end());
+}
+
+// Serve a byte range of a buffered whole-file body
+static void apply_range(Response& response, const std::string& rangeHeader) {
+    response.ranged = true;
+    response.fileSize = response.body.size();
+    unsigned long long first = 0, last = 0;
+    if (rangeHeader.empty() || response.body.empty()) return;
+    const int fields = std::sscanf(rangeHeader.c_str(), "bytes=%llu-%llu", &first, &last);
+    if (fields < 1) return;
+    if (first >= response.fileSize) {
+        response.status = 416;
+        response.body.clear();
+        return;
+    }
+    if (fields < 2 || last >= response.fileSize) last = response.fileSize - 1;
+    response.status = 206;
+    response.rangeStart = first;
+    response.rangeEnd = last;
+    response.body = Bytes(response.body.begin() + static_cast<std::ptrdiff_t>(first), response.body.begin() + static_cast<std::ptrdiff_t>(last + 1));
+}
+
+static bool parse_uint(const std::string& text, std::uint64_t& out) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+    out = std::strtoull(text.c_str(), nullptr, 10);
+    return true;
+}
+
+static void route(const std::string& path, const std::string& rangeHeader, Response& response) {
+    response.impair = g_defaults;
+    // Plain files are also served unimpaired-by-spec at the root: /file-<size>.bin
+    const bool rootFile = path.compare(0, 6, "/file-") == 0;
+    if (!rootFile && path.compare(0, 3, "/v/") != 0) {
+        response.status = 404;
+        set_text(response, "text/plain", "Use /v/<spec>/{ts.m3u8,fmp4.m3u8,manifest.mpd,file-<size>.bin}\n");
+        return;
+    }
+    const std::size_t slash = rootFile ? 0 : path.find('/', 3);
+    StreamSpec spec;
+    if (slash == std::string::npos || !parse_spec(rootFile ? std::string() : path.substr(3, slash - 3), spec)) {
+        response.status = 400;
+        set_text(response, "text/plain", "Bad stream spec\n");
+        return;
+    }
+    response.impair = spec.impair;
+    const std::string name = path.substr(slash + 1);
+    const VideoLayout layout = layout_for(spec);
+    std::uint64_t index = 0;
+
+    if (name == "ts.m3u8" || name == "fmp4.m3u8") {
+        set_text(response, "application/vnd.apple.mpegurl", hls_playlist(spec, layout, name == "fmp4.m3u8"));
+    } else if (name == "manifest.mpd") {
+        set_text(response, "application/dash+xml", dash_manifest(spec, layout));
+    } else if (name == "key.bin") {
+        std::uint8_t key[16];
+        stream_key(key);
+        response.body.assign(key, key + 16);
+    } else if (name == "progressive.mp4" || name == "faststart.mp4") {
+        response.contentType = "video/mp4";
+        response.body = progressive_mp4(layout, name == "faststart.mp4");
+        apply_range(response, rangeHeader);
+    } else if (name == "progressive.ts") {
+        response.contentType = "video/mp2t";
+        for (std::uint32_t i = 0; i < layout.segmentCount; ++i) {
+            const Bytes segment = ts_segment(layout, i);
+            response.body.insert(response.body.end(), segment.begin(), segment.end());
+        }
+        apply_range(response, rangeHeader);
+    } else if (name == "init.mp4") {
+        response.contentType = "video/mp4";
+        response.body = fmp4_init();
+    } else if (name.size() > 3 && name.compare(name.size() - 3, 3, ".ts") == 0 && parse_uint(name.substr(0, name.size() - 3), index) && index < layout.segmentCount) {
+        response.contentType = "video/mp2t";
+        response.body = ts_segment(layout, static_cast<std::uint32_t>(index));
+        if (spec.aes) encrypt_segment(response.body, static_cast<std::uint32_t>(index));
+    } else if (name.size() > 4 && name.compare(name.size() - 4, 4, ".m4s") == 0) {
+        const std::string stem = name.substr(0, name.size() - 4);
+        bool found = false;
+        if (stem.compare(0, 5, "seg-t") == 0 && parse_uint(stem.substr(5), index)) {
+            const std::uint64_t ticks = static_cast<std::uint64_t>(layout.framesPerSegment) * layout.frameDuration;
+            found = index % ticks == 0;
+            index /= ticks;
+        } else if (stem.compare(0, 4, "seg-") == 0) {
+            found = parse_uint(stem.substr(4), index);
+        } else {
+            found = parse_uint(stem, index);
+        }
+        if (found && index < layout.segmentCount) {
+            response.contentType = "video/iso.segment";
+            response.body = fmp4_segment(layout, static_cast<std::uint32_t>(index));
+            if (spec.aes && stem.compare(0, 3, "seg") != 0) encrypt_segment(response.body, static_cast<std::uint32_t>(index));
+        } else {
+            response.status = 404;
+        }
+    } else if (name.compare(0, 5, "file-") == 0 && name.size() > 9 && name.compare(name.size() - 4, 4, ".bin") == 0) {
+        double size = 0;
+        if (!parse_size(name.substr(5, name.size() - 9), size)) {
+            response.status = 400;
+            return;
+        }
+        response.patterned = true;
+        response.ranged = true;
+        response.fileSize = static_cast<std::uint64_t>(size);
+        response.rangeStart = 0;
+        response.rangeEnd = response.fileSize ? response.fileSize - 1 : 0;
+        unsigned long long first = 0, last = 0;
+        if (!rangeHeader.empty() && response.fileSize) {
+            const int fields = std::sscanf(rangeHeader.c_str(), "bytes=%llu-%llu", &first, &last);
+            if (fields >= 1 && first < response.fileSize) {
+                response.status = 206;
+                response.rangeStart = first;
+                if (fields == 2 && last < response.fileSize) response.rangeEnd = last;
+            } else if (fields >= 1) {
+                response.status = 416;
+                response.patterned = false;
+            }
+        }
+    } else {
+        response.status = 404;
+    }
+}
+
+// --- HTTP server ---
+
+static bool send_all(int fd, const std::uint8_t* data, std::size_t length) {
+    while (length > 0) {
+        const ssize_t sent = ::send(fd, data, length, 0);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += sent;
+        length -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+class Pacer {
+public:
+    explicit Pacer(double rate) : rate_(rate), start_(std::chrono::steady_clock::now()) {}
+    void account(std::size_t bytes) {
+        if (rate_ <= 0) return;
+        sent_ += bytes;
+        const auto due = start_ + std::chrono::microseconds(static_cast<long long>(sent_ / rate_ * 1e6));
+        std::this_thread::sleep_until(due);
+    }
+
+private:
+    double rate_;
+    double sent_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
+
+static void fill_pattern(std::uint8_t* out, std::uint64_t offset, std::size_t length) {
+    for (std::size_t i = 0; i < length; ++i) {
+        const std::uint64_t position = offset + i;
+        out[i] = static_cast<std::uint8_t>(splitmix64(g_seed ^ (position >> 3)) >> ((position & 7) * 8));
+    }
+}
+
+static const char* status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 206: return "Partial Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 416: return "Range Not Satisfiable";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+    }
+}
+
+static std::string header_value(const std::string& head, const char* name) {
+    std::string lower(head);
+    for (char& c : lower) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    const std::string key = std::string("\r\n") + name + ":";
+    const std::size_t at = lower.find(key);
+    if (at == std::string::npos) return std::string();
+    std::size_t start = at + key.size();
+    const std::size_t end = head.find("\r\n", start);
+    while (start < end && head[start] == ' ') ++start;
+    return head.substr(start, end - start);
+}
+
+// Returns false when the connection must be closed
+static bool serve_request(int fd, const std::string& head, std::mt19937_64& rng) {
+    const std::size_t lineEnd = head.find("\r\n");
+    std::istringstream requestLine(head.substr(0, lineEnd));
+    std::string method, target, version;
+    requestLine >> method >> target >> version;
+    const std::string path = target.substr(0, target.find('?'));
+    const std::string connection = header_value(head, "connection");
+    bool keepAlive = version == "HTTP/1.1" ? connection != "close" : connection == "keep-alive";
+    g_requests++;
+
+    Response response;
+    if (method != "GET" && method != "HEAD") response.status = 405;
+    else route(path, header_value(head, "range"), response);
+
+    const Impairments& impair = response.impair;
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    int delayMs = impair.latencyMs;
+    if (impair.jitterMs > 0) delayMs += static_cast<int>((unit(rng) * 2.0 - 1.0) * impair.jitterMs);
+    if (delayMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+
+    if (response.status < 400 && impair.errorPct > 0 && unit(rng) * 100.0 < impair.errorPct) {
+        response = Response();
+        response.status = 503;
+        g_errors++;
+    }
+    const bool truncate = response.status < 400 && impair.truncatePct > 0 && unit(rng) * 100.0 < impair.truncatePct;
+
+    const std::uint64_t length = response.patterned ? response.rangeEnd - response.rangeStart + 1 : response.body.size();
+    std::ostringstream headers;
+    headers << "HTTP/1.1 " << response.status << " " << status_text(response.status) << "\r\n"
+            << "Content-Type: " << response.contentType << "\r\n"
+            << "Content-Length: " << (response.patterned && response.fileSize == 0 ? 0 : length) << "\r\n"
+            << "Cache-Control: no-store\r\n"
+            << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n";
+    if (response.ranged) headers << "Accept-Ranges: bytes\r\n";
+    if (response.status == 206) headers << "Content-Range: bytes " << response.rangeStart << "-" << response.rangeEnd << "/" << response.fileSize << "\r\n";
+    if (response.status == 503) headers << "Retry-After: 1\r\n";
+    headers << "\r\n";
+    const std::string headerText = headers.str();
+    if (!send_all(fd, reinterpret_cast<const std::uint8_t*>(headerText.data()), headerText.size())) return false;
+    if (method == "HEAD") return keepAlive;
+
+    const std::uint64_t limit = truncate ? length / 2 : length;
+    Pacer pacer(impair.rate);
+    std::uint64_t sent = 0;
+    std::vector<std::uint8_t> chunk(response.patterned ? SEND_CHUNK : 0);
+    while (sent < limit && !(response.patterned && response.fileSize == 0)) {
+        const std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(SEND_CHUNK, limit - sent));
+        const std::uint8_t* data = nullptr;
+        if (response.patterned) {
+            fill_pattern(&chunk[0], response.rangeStart + sent, n);
+            data = &chunk[0];
+        } else {
+            data = &response.body[static_cast<std::size_t>(sent)];
+        }
+        if (!send_all(fd, data, n)) return false;
+        sent += n;
+        g_bytes += n;
+        pacer.account(n);
+    }
+    if (truncate) {
+        g_errors++;
+        return false;
+    }
+    if (!g_quiet) std::cerr << method << " " << target << " " << response.status << " " << sent << std::endl;
+    return keepAlive;
+}
+
+static void serve_connection(int fd, std::uint64_t connectionId) {
+    std::mt19937_64 rng(splitmix64(g_seed + connectionId));
+    std::string buffer;
+    char chunk[8192];
+    for (;;) {
+        std::size_t headEnd;
+        while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (buffer.size() > 64 * 1024) {
+                ::close(fd);
+                return;
+            }
+            const ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                ::close(fd);
+                return;
+            }
+            buffer.append(chunk, static_cast<std::size_t>(n));
+        }
+        const std::string head = buffer.substr(0, headEnd + 2);
+        buffer.erase(0, headEnd + 4);
+        if (!serve_request(fd, head, rng)) break;
+    }
+    ::close(fd);
+}
+
+static void on_signal(int) {
+    g_stop = 1;
+}
+
+static void usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [--port N] [--bind ADDR] [--latency-ms N] [--jitter-ms N] [--rate BYTES/S]"
+              << " [--error-rate PCT] [--truncate-rate PCT] [--seed N] [--quiet]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int port = 0;
+    std::string bindAddress = "127.0.0.1";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        double value = 0;
+        if (arg == "--quiet") {
+            g_quiet = true;
+        } else if (!hasValue) {
+            usage(argv[0]);
+            return ERR_ARGS;
+        } else if (arg == "--bind") {
+            bindAddress = argv[++i];
+        } else if (parse_size(argv[i + 1], value)) {
+            ++i;
+            if (arg == "--port") port = static_cast<int>(value);
+            else if (arg == "--latency-ms") g_defaults.latencyMs = static_cast<int>(value);
+            else if (arg == "--jitter-ms") g_defaults.jitterMs = static_cast<int>(value);
+            else if (arg == "--rate") g_defaults.rate = value;
+            else if (arg == "--error-rate") g_defaults.errorPct = value;
+            else if (arg == "--truncate-rate") g_defaults.truncatePct = value;
+            else if (arg == "--seed") g_seed = static_cast<std::uint64_t>(value);
+            else {
+                usage(argv[0]);
+                return ERR_ARGS;
+            }
+        } else {
+            usage(argv[0]);
+            return ERR_ARGS;
+        }
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    const int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<std::uint16_t>(port));
+    if (::inet_pton(AF_INET, bindAddress.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "Invalid bind address: " << bindAddress << std::endl;
+        return ERR_ARGS;
+    }
+    if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 128) != 0) {
+        std::cerr << "Cannot listen on " << bindAddress << ":" << port << ": " << std::strerror(errno) << std::endl;
+        return ERR_LISTEN;
+    }
+    socklen_t addressLength = sizeof(address);
+    ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressLength);
+    std::cout << "PORT=" << ntohs(address.sin_port) << std::endl;
+
+    std::uint64_t connections = 0;
+    while (!g_stop) {
+        pollfd pfd = { listener, POLLIN, 0 };
+        if (::poll(&pfd, 1, 200) <= 0) continue;
+        const int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) continue;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::thread(serve_connection, fd, ++connections).detach();
+    }
+
+    ::close(listener);
+    std::cout << "REQUESTS=" << g_requests.load() << " BYTES=" << g_bytes.load() << " ERRORS=" << g_errors.load() << std::endl;
+    return SUCCESS;
+}
@@ -0,0 +1,610 @@
+// Streaming output digests for the helpers that write downloads (--hash xxh3,sha256).
+// XXH3-64 (seed 0, default secret; same value as XXH3_64bits) accumulates with AVX2 or SSE2
+// on x86 and portable 64-bit code elsewhere. SHA-256 uses the SHA-NI instructions when the
+// CPU has them. Kernels are picked once at runtime, so one binary serves every x86 CPU.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MVD_HASH_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace mvd_hash {
+
+namespace detail {
+
+inline std::uint64_t read64(const std::uint8_t* p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+inline std::uint32_t read32(const std::uint8_t* p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+inline std::uint64_t rotl64(std::uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+inline std::uint64_t mul128_fold64(std::uint64_t a, std::uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+#else
+    const std::uint64_t lo_lo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    const std::uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFF);
+    const std::uint64_t lo_hi = (a & 0xFFFFFFFF) * (b >> 32);
+    const std::uint64_t hi_hi = (a >> 32) * (b >> 32);
+    const std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    const std::uint64_t upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    const std::uint64_t lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+#ifdef MVD_HASH_X86
+struct CpuFeatures {
+    bool avx2 = false;
+    bool sha = false;
+
+    CpuFeatures() {
+        unsigned a, b, c, d;
+        if (!__get_cpuid(1, &a, &b, &c, &d)) return;
+        const bool osxsave = (c >> 27) & 1;
+        const bool avx = (c >> 28) & 1;
+        const bool sse41 = (c >> 19) & 1;
+        const bool ssse3 = (c >> 9) & 1;
+        bool ymmEnabled = false;
+        if (osxsave && avx) {
+            unsigned lo, hi;
+            __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            ymmEnabled = (lo & 6) == 6;
+        }
+        if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return;
+        avx2 = ymmEnabled && ((b >> 5) & 1);
+        sha = ((b >> 29) & 1) && sse41 && ssse3;
+    }
+};
+
+inline const CpuFeatures& cpu() {
+    static const CpuFeatures features;
+    return features;
+}
+#endif
+
+// --- XXH3 ------------------------------------------------------------------
+
+const std::uint32_t PRIME32_1 = 0x9E3779B1U;
+const std::uint32_t PRIME32_2 = 0x85EBCA77U;
+const std::uint32_t PRIME32_3 = 0xC2B2AE3DU;
+const std::uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+const std::uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+const std::uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+const std::uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+const std::uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+const std::uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+const std::uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+const std::size_t STRIPE_LEN = 64;
+const std::size_t SECRET_SIZE = 192;
+const std::size_t STRIPES_PER_BLOCK = (SECRET_SIZE - STRIPE_LEN) / 8;
+const std::size_t SECRET_LASTACC_START = 7;
+const std::size_t SECRET_MERGEACCS_START = 11;
+const std::size_t MIDSIZE_MAX = 240;
+
+alignas(64) const std::uint8_t XXH3_SECRET[SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+inline std::uint64_t xxh64_avalanche(std::uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    return h ^ (h >> 32);
+}
+
+inline std::uint64_t xxh3_avalanche(std::uint64_t h) {
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    return h ^ (h >> 32);
+}
+
+inline std::uint64_t xxh3_rrmxmx(std::uint64_t h, std::uint64_t len) {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+inline std::uint64_t xxh3_mix16(const std::uint8_t* in, const std::uint8_t* secret) {
+    return mul128_fold64(read64(in) ^ read64(secret), read64(in + 8) ^ read64(secret + 8));
+}
+
+// Whole-input hash for inputs up to MIDSIZE_MAX bytes
+inline std::uint64_t xxh3_short(const std::uint8_t* in, std::size_t len) {
+    const std::uint8_t* secret = XXH3_SECRET;
+    if (len == 0) return xxh64_avalanche(read64(secret + 56) ^ read64(secret + 64));
+    if (len <= 3) {
+        const std::uint32_t combined = (static_cast<std::uint32_t>(in[0]) << 16) | (static_cast<std::uint32_t>(in[len >> 1]) << 24) |
+                                       static_cast<std::uint32_t>(in[len - 1]) | (static_cast<std::uint32_t>(len) << 8);
+        const std::uint64_t bitflip = read32(secret) ^ read32(secret + 4);
+        return xxh64_avalanche(combined ^ bitflip);
+    }
+    if (len <= 8) {
+        const std::uint64_t bitflip = read64(secret + 8) ^ read64(secret + 16);
+        const std::uint64_t input64 = read32(in + len - 4) + (static_cast<std::uint64_t>(read32(in)) << 32);
+        return xxh3_rrmxmx(input64 ^ bitflip, len);
+    }
+    if (len <= 16) {
+        const std::uint64_t lo = read64(in) ^ (read64(secret + 24) ^ read64(secret + 32));
+        const std::uint64_t hi = read64(in + len - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+        return xxh3_avalanche(len + __builtin_bswap64(lo) + hi + mul128_fold64(lo, hi));
+    }
+    std::uint64_t acc = len * PRIME64_1;
+    if (len <= 128) {
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += xxh3_mix16(in + 48, secret + 96);
+                    acc += xxh3_mix16(in + len - 64, secret + 112);
+                }
+                acc += xxh3_mix16(in + 32, secret + 64);
+                acc += xxh3_mix16(in + len - 48, secret + 80);
+            }
+            acc += xxh3_mix16(in + 16, secret + 32);
+            acc += xxh3_mix16(in + len - 32, secret + 48);
+        }
+        acc += xxh3_mix16(in, secret);
+        acc += xxh3_mix16(in + len - 16, secret + 16);
+        return xxh3_avalanche(acc);
+    }
+    const std::size_t rounds = len / 16;
+    for (std::size_t i = 0; i < 8; ++i) acc += xxh3_mix16(in + 16 * i, secret + 16 * i);
+    acc = xxh3_avalanche(acc);
+    for (std::size_t i = 8; i < rounds; ++i) acc += xxh3_mix16(in + 16 * i, secret + 16 * (i - 8) + 3);
+    acc += xxh3_mix16(in + len - 16, secret + 136 - 17);
+    return xxh3_avalanche(acc);
+}
+
+// Long-input kernels: accumulate `stripes` 64-byte stripes (secret advancing 8 bytes per
+// stripe), and scramble the accumulators at the end of a block
+inline void accumulate_scalar(std::uint64_t* acc, const std::uint8_t* in, const std::uint8_t* secret, std::size_t stripes) {
+    for (std::size_t s = 0; s < stripes; ++s, in += STRIPE_LEN, secret += 8) {
+        for (int i = 0; i < 8; ++i) {
+            const std::uint64_t data = read64(in + 8 * i);
+            const std::uint64_t key = data ^ read64(secret + 8 * i);
+            acc[i ^ 1] += data;
+            acc[i] += (key & 0xFFFFFFFF) * (key >> 32);
+        }
+    }
+}
+
+inline void scramble_scalar(std::uint64_t* acc, const std::uint8_t* secret) {
+    for (int i = 0; i < 8; ++i) {
+        std::uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= read64(secret + 8 * i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+#ifdef MVD_HASH_X86
+__attribute__((target("sse2")))
+inline void accumulate_sse2(std::uint64_t* acc, const std::uint8_t* in, const std::uint8_t* secret, std::size_t stripes) {
+    __m128i a[4];
+    for (int i = 0; i < 4; ++i) a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc) + i);
+    for (std::size_t s = 0; s < stripes; ++s, in += STRIPE_LEN, secret += 8) {
+        for (int i = 0; i < 4; ++i) {
+            const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in) + i);
+            const __m128i key = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+            const __m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+            const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            a[i] = _mm_add_epi64(product, _mm_add_epi64(a[i], swapped));
+        }
+    }
+    for (int i = 0; i < 4; ++i) _mm_storeu_si128(reinterpret_cast<__m128i*>(acc) + i, a[i]);
+}
+
+__attribute__((target("sse2")))
+inline void scramble_sse2(std::uint64_t* acc, const std::uint8_t* secret) {
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+    for (int i = 0; i < 4; ++i) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc) + i);
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+        const __m128i lo = _mm_mul_epu32(a, prime);
+        const __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc) + i, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+    }
+}
+
+__attribute__((target("avx2")))
+inline void accumulate_avx2(std::uint64_t* acc, const std::uint8_t* in, const std::uint8_t* secret, std::size_t stripes) {
+    __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc));
+    __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc) + 1);
+    for (std::size_t s = 0; s < stripes; ++s, in += STRIPE_LEN, secret += 8) {
+        const __m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+        const __m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in) + 1);
+        const __m256i k0 = _mm256_xor_si256(d0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret)));
+        const __m256i k1 = _mm256_xor_si256(d1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret) + 1));
+        const __m256i p0 = _mm256_mul_epu32(k0, _mm256_shuffle_epi32(k0, _MM_SHUFFLE(0, 3, 0, 1)));
+        const __m256i p1 = _mm256_mul_epu32(k1, _mm256_shuffle_epi32(k1, _MM_SHUFFLE(0, 3, 0, 1)));
+        a0 = _mm256_add_epi64(p0, _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+        a1 = _mm256_add_epi64(p1, _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), a0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc) + 1, a1);
+}
+#endif
+
+typedef void (*AccumulateFn)(std::uint64_t*, const std::uint8_t*, const std::uint8_t*, std::size_t);
+typedef void (*ScrambleFn)(std::uint64_t*, const std::uint8_t*);
+
+struct Xxh3Kernels {
+    AccumulateFn accumulate = accumulate_scalar;
+    ScrambleFn scramble = scramble_scalar;
+    const char* name = "scalar";
+
+    Xxh3Kernels() {
+#ifdef MVD_HASH_X86
+        // SSE2 is part of every x86-64 CPU; scrambling is once per KiB, so AVX2 only accumulates
+        accumulate = cpu().avx2 ? accumulate_avx2 : accumulate_sse2;
+        scramble = scramble_sse2;
+        name = cpu().avx2 ? "avx2" : "sse2";
+#endif
+    }
+};
+
+inline const Xxh3Kernels& xxh3_kernels() {
+    static const Xxh3Kernels kernels;
+    return kernels;
+}
+
+// --- SHA-256 ---------------------------------------------------------------
+
+alignas(16) const std::uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline std::uint32_t rotr32(std::uint32_t v, int r) { return (v >> r) | (v << (32 - r)); }
+
+inline void sha256_blocks_scalar(std::uint32_t* state, const std::uint8_t* data, std::size_t blocks) {
+    for (; blocks > 0; --blocks, data += 64) {
+        std::uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (static_cast<std::uint32_t>(data[4 * i]) << 24) | (static_cast<std::uint32_t>(data[4 * i + 1]) << 16) |
+                   (static_cast<std::uint32_t>(data[4 * i + 2]) << 8) | data[4 * i + 3];
+        }
+        for (int i = 16; i < 64; ++i) {
+            const std::uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const std::uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        std::uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            const std::uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+            const std::uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#ifdef MVD_HASH_X86
+// Two rounds per sha256rnds2; the message schedule for group g+1 is finished while group g runs
+__attribute__((target("sha,sse4.1,ssse3")))
+inline void sha256_blocks_shani(std::uint32_t* state, const std::uint8_t* data, std::size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state) + 1), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);   // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);       // CDGH
+
+    for (; blocks > 0; --blocks, data += 64) {
+        const __m128i saved0 = state0;
+        const __m128i saved1 = state1;
+        __m128i w[4];
+#pragma GCC unroll 16
+        for (int g = 0; g < 16; ++g) {
+            __m128i& cur = w[g & 3];
+            if (g < 4) cur = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + g), byteSwap);
+            __m128i msg = _mm_add_epi32(cur, _mm_load_si128(reinterpret_cast<const __m128i*>(SHA256_K) + g));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (g >= 3 && g < 15) {
+                __m128i& next = w[(g + 1) & 3];
+                next = _mm_add_epi32(next, _mm_alignr_epi8(cur, w[(g + 3) & 3], 4));
+                next = _mm_sha256msg2_epu32(next, cur);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (g >= 1 && g <= 12) {
+                __m128i& prev = w[(g + 3) & 3];
+                prev = _mm_sha256msg1_epu32(prev, cur);
+            }
+        }
+        state0 = _mm_add_epi32(state0, saved0);
+        state1 = _mm_add_epi32(state1, saved1);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);       // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);    // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0); // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);    // HGFE
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state) + 1, state1);
+}
+#endif
+
+typedef void (*Sha256BlocksFn)(std::uint32_t*, const std::uint8_t*, std::size_t);
+
+struct Sha256Kernel {
+    Sha256BlocksFn blocks = sha256_blocks_scalar;
+    const char* name = "scalar";
+
+    Sha256Kernel() {
+#ifdef MVD_HASH_X86
+        if (cpu().sha) {
+            blocks = sha256_blocks_shani;
+            name = "sha-ni";
+        }
+#endif
+    }
+};
+
+inline const Sha256Kernel& sha256_kernel() {
+    static const Sha256Kernel kernel;
+    return kernel;
+}
+
+inline void append_hex(std::string& out, const std::uint8_t* bytes, std::size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    for (std::size_t i = 0; i < len; ++i) {
+        out.push_back(digits[bytes[i] >> 4]);
+        out.push_back(digits[bytes[i] & 15]);
+    }
+}
+
+} // namespace detail
+
+// Streaming XXH3-64. Input is held back until more arrives so the final stripe can be
+// processed the way the one-shot function does it.
+class Xxh3 {
+public:
+    Xxh3() {
+        static const std::uint64_t init[8] = {
+            detail::PRIME32_3, detail::PRIME64_1, detail::PRIME64_2, detail::PRIME64_3,
+            detail::PRIME64_4, detail::PRIME32_2, detail::PRIME64_5, detail::PRIME32_1
+        };
+        std::memcpy(acc_, init, sizeof(acc_));
+    }
+
+    void update(const void* data, std::size_t len) {
+        const std::uint8_t* in = static_cast<const std::uint8_t*>(data);
+        total_ += len;
+        if (len <= BUFFER_SIZE - buffered_) {
+            std::memcpy(buffer_ + buffered_, in, len);
+            buffered_ += len;
+            return;
+        }
+        if (buffered_ > 0) {
+            const std::size_t fill = BUFFER_SIZE - buffered_;
+            std::memcpy(buffer_ + buffered_, in, fill);
+            consume(acc_, stripesInBlock_, buffer_, BUFFER_SIZE / detail::STRIPE_LEN);
+            std::memcpy(lastStripe_, buffer_ + BUFFER_SIZE - detail::STRIPE_LEN, detail::STRIPE_LEN);
+            in += fill;
+            len -= fill;
+            buffered_ = 0;
+        }
+        if (len > BUFFER_SIZE) {
+            // Keep 1..BUFFER_SIZE bytes back for the final stripe
+            const std::size_t stripes = (len - 1) / detail::STRIPE_LEN;
+            const std::size_t bulk = stripes * detail::STRIPE_LEN;
+            consume(acc_, stripesInBlock_, in, stripes);
+            std::memcpy(lastStripe_, in + bulk - detail::STRIPE_LEN, detail::STRIPE_LEN);
+            in += bulk;
+            len -= bulk;
+        }
+        std::memcpy(buffer_, in, len);
+        buffered_ = len;
+    }
+
+    std::uint64_t digest() const {
+        if (total_ <= detail::MIDSIZE_MAX) return detail::xxh3_short(buffer_, static_cast<std::size_t>(total_));
+
+        std::uint64_t acc[8];
+        std::memcpy(acc, acc_, sizeof(acc));
+        std::size_t stripesInBlock = stripesInBlock_;
+        std::uint8_t last[detail::STRIPE_LEN];
+        if (buffered_ >= detail::STRIPE_LEN) {
+            consume(acc, stripesInBlock, buffer_, (buffered_ - 1) / detail::STRIPE_LEN);
+            std::memcpy(last, buffer_ + buffered_ - detail::STRIPE_LEN, detail::STRIPE_LEN);
+        } else {
+            const std::size_t carry = detail::STRIPE_LEN - buffered_;
+            std::memcpy(last, lastStripe_ + detail::STRIPE_LEN - carry, carry);
+            std::memcpy(last + carry, buffer_, buffered_);
+        }
+        detail::xxh3_kernels().accumulate(acc, last, detail::XXH3_SECRET + detail::SECRET_SIZE - detail::STRIPE_LEN - detail::SECRET_LASTACC_START, 1);
+
+        std::uint64_t result = total_ * detail::PRIME64_1;
+        const std::uint8_t* secret = detail::XXH3_SECRET + detail::SECRET_MERGEACCS_START;
+        for (int i = 0; i < 4; ++i) {
+            result += detail::mul128_fold64(acc[2 * i] ^ detail::read64(secret + 16 * i), acc[2 * i + 1] ^ detail::read64(secret + 16 * i + 8));
+        }
+        return detail::xxh3_avalanche(result);
+    }
+
+    std::string hex() const {
+        const std::uint64_t value = digest();
+        std::uint8_t bytes[8];
+        for (int i = 0; i < 8; ++i) bytes[i] = static_cast<std::uint8_t>(value >> (56 - 8 * i));
+        std::string out;
+        detail::append_hex(out, bytes, 8);
+        return out;
+    }
+
+private:
+    static const std::size_t BUFFER_SIZE = 256;
+
+    static void consume(std::uint64_t* acc, std::size_t& stripesInBlock, const std::uint8_t* in, std::size_t stripes) {
+        const detail::Xxh3Kernels& k = detail::xxh3_kernels();
+        while (stripes > 0) {
+            const std::size_t room = detail::STRIPES_PER_BLOCK - stripesInBlock;
+            const std::size_t n = stripes < room ? stripes : room;
+            k.accumulate(acc, in, detail::XXH3_SECRET + stripesInBlock * 8, n);
+            in += n * detail::STRIPE_LEN;
+            stripes -= n;
+            stripesInBlock += n;
+            if (stripesInBlock == detail::STRIPES_PER_BLOCK) {
+                k.scramble(acc, detail::XXH3_SECRET + detail::SECRET_SIZE - detail::STRIPE_LEN);
+                stripesInBlock = 0;
+            }
+        }
+    }
+
+    std::uint64_t acc_[8];
+    std::uint8_t buffer_[BUFFER_SIZE];
+    std::uint8_t lastStripe_[detail::STRIPE_LEN] = {};
+    std::size_t buffered_ = 0;
+    std::size_t stripesInBlock_ = 0;
+    std::uint64_t total_ = 0;
+};
+
+class Sha256 {
+public:
+    Sha256() {
+        static const std::uint32_t init[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        std::memcpy(state_, init, sizeof(state_));
+    }
+
+    void update(const void* data, std::size_t len) {
+        const std::uint8_t* in = static_cast<const std::uint8_t*>(data);
+        total_ += len;
+        if (buffered_ > 0) {
+            const std::size_t fill = len < 64 - buffered_ ? len : 64 - buffered_;
+            std::memcpy(buffer_ + buffered_, in, fill);
+            buffered_ += fill;
+            in += fill;
+            len -= fill;
+            if (buffered_ < 64) return;
+            detail::sha256_kernel().blocks(state_, buffer_, 1);
+            buffered_ = 0;
+        }
+        if (len >= 64) {
+            detail::sha256_kernel().blocks(state_, in, len / 64);
+            in += len & ~static_cast<std::size_t>(63);
+            len &= 63;
+        }
+        std::memcpy(buffer_, in, len);
+        buffered_ = len;
+    }
+
+    std::string hex() const {
+        std::uint32_t state[8];
+        std::memcpy(state, state_, sizeof(state));
+        std::uint8_t tail[128] = {};
+        std::memcpy(tail, buffer_, buffered_);
+        tail[buffered_] = 0x80;
+        const std::size_t tailLen = buffered_ < 56 ? 64 : 128;
+        const std::uint64_t bits = total_ * 8;
+        for (int i = 0; i < 8; ++i) tail[tailLen - 1 - i] = static_cast<std::uint8_t>(bits >> (8 * i));
+        detail::sha256_kernel().blocks(state, tail, tailLen / 64);
+
+        std::uint8_t bytes[32];
+        for (int i = 0; i < 8; ++i) {
+            bytes[4 * i] = static_cast<std::uint8_t>(state[i] >> 24);
+            bytes[4 * i + 1] = static_cast<std::uint8_t>(state[i] >> 16);
+            bytes[4 * i + 2] = static_cast<std::uint8_t>(state[i] >> 8);
+            bytes[4 * i + 3] = static_cast<std::uint8_t>(state[i]);
+        }
+        std::string out;
+        detail::append_hex(out, bytes, 32);
+        return out;
+    }
+
+private:
+    std::uint32_t state_[8];
+    std::uint8_t buffer_[64];
+    std::size_t buffered_ = 0;
+    std::uint64_t total_ = 0;
+};
+
+// The set of digests a helper was asked for; update() is a no-op when none were
+class Digests {
+public:
+    // Accepts a comma-separated list of xxh3 / sha256; returns false on unknown names
+    bool configure(const std::string& list) {
+        std::size_t start = 0;
+        while (start <= list.size()) {
+            std::size_t end = list.find(',', start);
+            if (end == std::string::npos) end = list.size();
+            const std::string name = list.substr(start, end - start);
+            if (name == "xxh3") xxh3_ = true;
+            else if (name == "sha256") sha256_ = true;
+            else if (!name.empty()) return false;
+            start = end + 1;
+        }
+        return true;
+    }
+
+    bool active() const { return xxh3_ || sha256_; }
+
+    void update(const void* data, std::size_t len) {
+        if (xxh3_) xxh3State_.update(data, len);
+        if (sha256_) sha256State_.update(data, len);
+    }
+
+    // XXH3=<16 hex> / SHA256=<64 hex> lines for the host
+    void print(std::ostream& out) const {
+        if (xxh3_) out << "XXH3=" << xxh3State_.hex() << "\n";
+        if (sha256_) out << "SHA256=" << sha256State_.hex() << "\n";
+        out.flush();
+    }
+
+private:
+    bool xxh3_ = false;
+    bool sha256_ = false;
+    Xxh3 xxh3State_;
+    Sha256 sha256State_;
+};
+
+} // namespace mvd_hash
@@ -0,0 +1,180 @@
+// Append-only writer for the CoApp binary trace format (layout documented in src/core/trace.js).
+// Active only when the host exports MVD_TRACE_FILE; every call is a cheap no-op otherwise.
+// Records are appended with O_APPEND (FILE_APPEND_DATA on Windows) so helpers share the host's file.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+#endif
+
+namespace mvd_trace {
+
+enum Event {
+    EV_LABEL = 1,
+    EV_PROCESS_START = 2,
+    EV_PROCESS_EXIT = 13,
+    EV_HELPER = 14
+};
+
+enum Phase {
+    PH_BEGIN = 'B',
+    PH_END = 'E',
+    PH_INSTANT = 'i'
+};
+
+struct Record {
+    std::uint64_t ts;
+    std::uint32_t pid;
+    std::uint16_t event;
+    std::uint8_t phase;
+    std::uint8_t flags;
+    std::uint32_t scope;
+    std::uint32_t aux;
+    std::uint64_t value;
+};
+
+static_assert(sizeof(Record) == 32, "trace record must stay 32 bytes");
+
+// Same clock source as libuv's uv_hrtime(), which backs process.hrtime.bigint() in the host
+inline std::uint64_t now_ns() {
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return static_cast<std::uint64_t>(static_cast<double>(counter.QuadPart) * (1e9 / static_cast<double>(freq.QuadPart)));
+#elif defined(__APPLE__)
+    static mach_timebase_info_data_t tb;
+    if (tb.denom == 0) mach_timebase_info(&tb);
+    return mach_absolute_time() * tb.numer / tb.denom;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<std::uint64_t>(ts.tv_nsec);
+#endif
+}
+
+struct State {
+#ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    bool checked = false;
+    std::uint32_t pid = 0;
+    std::uint32_t nextLabel = 0x80000000u; // helper labels never collide with host ids
+};
+
+inline State& state() {
+    static State s;
+    return s;
+}
+
+inline bool enabled() {
+    State& s = state();
+    if (!s.checked) {
+        s.checked = true;
+#ifdef _WIN32
+        const wchar_t* path = _wgetenv(L"MVD_TRACE_FILE");
+        if (path && *path) {
+            s.handle = CreateFileW(path, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                   nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        }
+        s.pid = static_cast<std::uint32_t>(GetCurrentProcessId());
+#else
+        const char* path = std::getenv("MVD_TRACE_FILE");
+        if (path && *path) s.fd = open(path, O_WRONLY | O_APPEND | O_CLOEXEC);
+        s.pid = static_cast<std::uint32_t>(getpid());
+#endif
+    }
+#ifdef _WIN32
+    return s.handle != INVALID_HANDLE_VALUE;
+#else
+    return s.fd >= 0;
+#endif
+}
+
+inline void write_raw(const void* data, std::size_t len) {
+    State& s = state();
+#ifdef _WIN32
+    DWORD written = 0;
+    WriteFile(s.handle, data, static_cast<DWORD>(len), &written, nullptr);
+#else
+    ssize_t rc = write(s.fd, data, len);
+    (void)rc;
+#endif
+}
+
+inline Record make_record(std::uint16_t event, std::uint8_t phase, std::uint32_t scope, std::uint32_t aux, std::uint64_t value) {
+    Record r;
+    std::memset(&r, 0, sizeof(r));
+    r.ts = now_ns();
+    r.pid = state().pid;
+    r.event = event;
+    r.phase = phase;
+    r.scope = scope;
+    r.aux = aux;
+    r.value = value;
+    return r;
+}
+
+inline void emit(std::uint16_t event, std::uint8_t phase, std::uint32_t scope = 0, std::uint32_t aux = 0, std::uint64_t value = 0) {
+    if (!enabled()) return;
+    Record r = make_record(event, phase, scope, aux, value);
+    write_raw(&r, sizeof(r));
+}
+
+// Label record plus its payload slots go out in a single append
+inline std::uint32_t label(const char* text) {
+    if (!enabled() || !text) return 0;
+    std::size_t len = std::strlen(text);
+    if (len > 255) len = 255;
+    std::uint32_t id = state().nextLabel++;
+    unsigned char buf[sizeof(Record) * 9];
+    std::memset(buf, 0, sizeof(buf));
+    Record r = make_record(EV_LABEL, PH_INSTANT, id, static_cast<std::uint32_t>(len), 0);
+    std::memcpy(buf, &r, sizeof(r));
+    std::memcpy(buf + sizeof(r), text, len);
+    std::size_t slots = (len + sizeof(Record) - 1) / sizeof(Record);
+    write_raw(buf, sizeof(Record) * (1 + slots));
+    return id;
+}
+
+inline void begin(std::uint16_t event, std::uint32_t scope = 0, std::uint32_t aux = 0, std::uint64_t value = 0) {
+    emit(event, PH_BEGIN, scope, aux, value);
+}
+
+inline void end(std::uint16_t event, std::uint32_t scope = 0, std::uint32_t aux = 0, std::uint64_t value = 0) {
+    emit(event, PH_END, scope, aux, value);
+}
+
+inline void instant(std::uint16_t event, std::uint32_t scope = 0, std::uint32_t aux = 0, std::uint64_t value = 0) {
+    emit(event, PH_INSTANT, scope, aux, value);
+}
+
+// Marks the helper's whole run as one span named after the helper
+struct HelperSpan {
+    std::uint32_t name;
+    explicit HelperSpan(const char* helperName) : name(0) {
+        if (!enabled()) return;
+        name = label(helperName);
+        instant(EV_PROCESS_START, 0, name);
+        begin(EV_HELPER, 0, name);
+    }
+    ~HelperSpan() {
+        if (name) end(EV_HELPER, 0, name);
+    }
+};
+
+} // namespace mvd_trace
@@ -9,6 +9,8 @@
 #include <sys/statvfs.h>
 #endif
 
+#include "../../common/mvd_trace.h"
+
 // Error codes
 enum ExitCode {
     SUCCESS = 0,
@@ -18,6 +20,8 @@ enum ExitCode {
 };
 
 int main(int argc, char* argv[]) {
+    mvd_trace::HelperSpan traceSpan("mvd-diskspace");
+
     if (argc < 2) {
         std::cerr << "Usage: " << argv[0] << " <path>" << std::endl;
         return ERR_ARGS;
@@ -0,0 +1,734 @@
+// MP4 faststart relocation: moves a trailing moov in front of mdat after the mux, instead of
+// ffmpeg's `-movflags +faststart`, which reads and rewrites the whole file a second time
+// before the download can finish.
+//
+// The moov is rebuilt in memory with its stco/co64 chunk offsets (and saio auxiliary info
+// offsets) moved by the shift; stco tables are widened to co64 when an offset would pass
+// 4 GB. The shift is rounded up to the filesystem block size so that on Linux the payload
+// moves with fallocate(FALLOC_FL_INSERT_RANGE): the filesystem splices a hole into the
+// extent map and no media byte is read or written (ext4, xfs). A `free` box fills the
+// padding. Elsewhere, or when the filesystem refuses, the file is rebuilt into a hidden
+// sibling with copy_file_range (reflink-capable on btrfs/xfs) or 8 MB block copies, and
+// renamed over the original once complete. Either way the file is left whole: untouched, or
+// fully relocated.
+//
+// --low-priority drops CPU and disk priority to idle/background so the relocation does
+// not compete with downloads still running.
+//
+// Usage:
+//   mvd-faststart [--low-priority] [--no-insert] <file.mp4>
+//
+// Stdout:
+//   STATUS=already                        moov already precedes mdat; nothing was changed
+//   PROGRESS=<bytes copied>/<total>       while the copy fallback runs
+//   STATUS=moved METHOD=<insert|copy> SHIFT=<bytes> MOOV=<bytes>
+//
+// Stdin: a `q` line (what cancel-download-v2 sends every stage) or SIGTERM stops the copy
+// fallback between blocks; an in-place move, once started, is finished first.
+//
+// Exit codes: 0 done (moved or already), 2 bad arguments, 3 read failure, 4 write failure,
+// 5 layout not supported (fragmented, moov not last, damaged boxes), 6 stopped on request;
+// nothing was changed.
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../common/mvd_trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+// glibc 2.17 has no wrapper and older kernel headers no number
+#ifndef __NR_copy_file_range
+#if defined(__x86_64__)
+#define __NR_copy_file_range 326
+#elif defined(__aarch64__)
+#define __NR_copy_file_range 285
+#elif defined(__i386__)
+#define __NR_copy_file_range 377
+#elif defined(__arm__)
+#define __NR_copy_file_range 391
+#endif
+#endif
+#ifndef FALLOC_FL_COLLAPSE_RANGE
+#define FALLOC_FL_COLLAPSE_RANGE 0x08
+#endif
+#ifndef FALLOC_FL_INSERT_RANGE
+#define FALLOC_FL_INSERT_RANGE 0x20
+#endif
+#endif
+#ifdef __APPLE__
+#include <sys/mount.h>
+#include <sys/param.h>
+#include <sys/resource.h>
+#endif
+#endif
+
+enum ExitCode {
+    SUCCESS = 0,
+    ERR_ARGS = 2,
+    ERR_INPUT = 3,
+    ERR_OUTPUT = 4,
+    ERR_FORMAT = 5,
+    ERR_STOPPED = 6
+};
+
+static const std::size_t COPY_CHUNK = 8 * 1024 * 1024;
+static const std::uint64_t MAX_MOOV_SIZE = 256 * 1024 * 1024;
+static const std::uint64_t DEFAULT_BLOCK = 4096;
+static const std::uint64_t PROGRESS_STEP = 64 * 1024 * 1024;
+
+// --- Low-level file access -------------------------------------------------
+
+#ifdef _WIN32
+static std::wstring to_wide(const std::string& path) {
+    int len = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    if (len == 0) return std::wstring();
+    std::wstring wpath(len, 0);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wpath[0], len);
+    return wpath;
+}
+
+static int open_existing(const std::string& path) {
+    return _wopen(to_wide(path).c_str(), _O_RDWR | _O_BINARY);
+}
+
+static int create_exclusive(const std::string& path) {
+    return _wopen(to_wide(path).c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+static bool file_size(int fd, std::uint64_t& size) {
+    struct _stat64 st;
+    if (_fstat64(fd, &st) != 0) return false;
+    size = static_cast<std::uint64_t>(st.st_size);
+    return true;
+}
+
+static long long read_at(int fd, void* buf, std::size_t len, std::uint64_t offset) {
+    if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) return -1;
+    return _read(fd, buf, static_cast<unsigned int>(len));
+}
+
+static long long write_at(int fd, const void* buf, std::size_t len, std::uint64_t offset) {
+    if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) return -1;
+    return _write(fd, buf, static_cast<unsigned int>(len));
+}
+
+static bool sync_file(int fd) { return _commit(fd) == 0; }
+static int close_file(int fd) { return _close(fd); }
+static void remove_file(const std::string& path) { _wunlink(to_wide(path).c_str()); }
+
+static bool replace_file(const std::string& from, const std::string& to) {
+    return MoveFileExW(to_wide(from).c_str(), to_wide(to).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+#else
+static int open_existing(const std::string& path) {
+    return open(path.c_str(), O_RDWR | O_CLOEXEC);
+}
+
+static int create_exclusive(const std::string& path) {
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+}
+
+static bool file_size(int fd, std::uint64_t& size) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    size = static_cast<std::uint64_t>(st.st_size);
+    return true;
+}
+
+static long long read_at(int fd, void* buf, std::size_t len, std::uint64_t offset) {
+    return pread(fd, buf, len, static_cast<off_t>(offset));
+}
+
+static long long write_at(int fd, const void* buf, std::size_t len, std::uint64_t offset) {
+    return pwrite(fd, buf, len, static_cast<off_t>(offset));
+}
+
+static bool sync_file(int fd) {
+#ifdef __APPLE__
+    return fsync(fd) == 0;
+#else
+    return fdatasync(fd) == 0;
+#endif
+}
+
+static int close_file(int fd) { return close(fd); }
+static void remove_file(const std::string& path) { unlink(path.c_str()); }
+
+static bool replace_file(const std::string& from, const std::string& to) {
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+#endif
+
+static bool read_exact(int fd, void* buf, std::size_t len, std::uint64_t offset) {
+    std::uint8_t* p = static_cast<std::uint8_t*>(buf);
+    while (len > 0) {
+        long long n = read_at(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= static_cast<std::size_t>(n);
+        offset += static_cast<std::uint64_t>(n);
+    }
+    return true;
+}
+
+static bool write_exact(int fd, const void* buf, std::size_t len, std::uint64_t offset) {
+    const std::uint8_t* p = static_cast<const std::uint8_t*>(buf);
+    while (len > 0) {
+        long long n = write_at(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= static_cast<std::size_t>(n);
+        offset += static_cast<std::uint64_t>(n);
+    }
+    return true;
+}
+
+// Block size of the filesystem holding fd; insert ranges must be multiples of it
+static std::uint64_t block_size(int fd) {
+#ifdef __linux__
+    struct statfs sfs;
+    if (fstatfs(fd, &sfs) == 0 && sfs.f_bsize > 0) return static_cast<std::uint64_t>(sfs.f_bsize);
+#else
+    (void)fd;
+#endif
+    return DEFAULT_BLOCK;
+}
+
+static void lower_priority() {
+#ifdef _WIN32
+    // Background mode lowers CPU, disk and memory priority together
+    SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN);
+#else
+    setpriority(PRIO_PROCESS, 0, 19);
+#if defined(__linux__) && defined(__NR_ioprio_set)
+    const int IOPRIO_WHO_PROCESS = 1;
+    const int IOPRIO_CLASS_IDLE = 3;
+    syscall(__NR_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << 13);
+#elif defined(__APPLE__)
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_PROCESS, IOPOL_THROTTLE);
+#endif
+#endif
+}
+
+// --- Big-endian helpers ----------------------------------------------------
+
+static std::uint32_t be32(const std::uint8_t* p) {
+    return (static_cast<std::uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static std::uint64_t be64(const std::uint8_t* p) {
+    return (static_cast<std::uint64_t>(be32(p)) << 32) | be32(p + 4);
+}
+
+static void put32(std::uint8_t* p, std::uint32_t v) {
+    p[0] = static_cast<std::uint8_t>(v >> 24);
+    p[1] = static_cast<std::uint8_t>(v >> 16);
+    p[2] = static_cast<std::uint8_t>(v >> 8);
+    p[3] = static_cast<std::uint8_t>(v);
+}
+
+static void put64(std::uint8_t* p, std::uint64_t v) {
+    put32(p, static_cast<std::uint32_t>(v >> 32));
+    put32(p + 4, static_cast<std::uint32_t>(v));
+}
+
+static void append32(std::vector<std::uint8_t>& out, std::uint32_t v) {
+    std::uint8_t b[4];
+    put32(b, v);
+    out.insert(out.end(), b, b + 4);
+}
+
+static void append64(std::vector<std::uint8_t>& out, std::uint64_t v) {
+    std::uint8_t b[8];
+    put64(b, v);
+    out.insert(out.end(), b, b + 8);
+}
+
+static std::uint32_t fourcc(const char* s) {
+    return be32(reinterpret_cast<const std::uint8_t*>(s));
+}
+
+struct Box {
+    std::uint32_t type = 0;
+    std::uint64_t offset = 0;  // start of the box header
+    std::uint64_t size = 0;    // whole box including header
+    std::uint64_t header = 0;
+};
+
+// Parse a box header from memory; size 0 means "to the end of the container"
+static bool parse_box(const std::uint8_t* data, std::uint64_t avail, std::uint64_t offset, Box& box) {
+    if (avail < 8) return false;
+    std::uint64_t size = be32(data);
+    box.type = be32(data + 4);
+    box.offset = offset;
+    box.header = 8;
+    if (size == 1) {
+        if (avail < 16) return false;
+        size = be64(data + 8);
+        box.header = 16;
+    } else if (size == 0) {
+        size = avail;
+    }
+    if (size < box.header || size > avail) return false;
+    box.size = size;
+    return true;
+}
+
+// --- moov rewriting --------------------------------------------------------
+
+// Rebuilds moov with every absolute file offset at or past `from` moved by `shift`
+class MoovRewriter {
+public:
+    MoovRewriter(const std::vector<std::uint8_t>& moov, std::uint64_t from) : moov_(moov), from_(from) {}
+
+    // Returns false on damaged boxes. `wide` turns stco into co64.
+    bool rebuild(std::uint64_t shift, bool wide, std::vector<std::uint8_t>& out) {
+        shift_ = shift;
+        wide_ = wide;
+        overflow_ = false;
+        out.clear();
+        out.reserve(moov_.size() + 1024);
+        return copy_boxes(0, moov_.size(), out);
+    }
+
+    // An stco entry no longer fits 32 bits after the last rebuild
+    bool overflow() const { return overflow_; }
+
+private:
+    const std::vector<std::uint8_t>& moov_;
+    std::uint64_t from_;
+    std::uint64_t shift_ = 0;
+    bool wide_ = false;
+    bool overflow_ = false;
+
+    static bool is_container(std::uint32_t type) {
+        return type == fourcc("moov") || type == fourcc("trak") || type == fourcc("mdia") ||
+               type == fourcc("minf") || type == fourcc("stbl");
+    }
+
+    std::uint64_t moved(std::uint64_t offset) const {
+        return offset >= from_ ? offset + shift_ : offset;
+    }
+
+    bool copy_boxes(std::uint64_t begin, std::uint64_t end, std::vector<std::uint8_t>& out) {
+        std::uint64_t pos = begin;
+        while (pos < end) {
+            Box box;
+            if (!parse_box(&moov_[pos], end - pos, pos, box)) return false;
+            const std::uint8_t* body = &moov_[pos + box.header];
+            const std::uint64_t bodySize = box.size - box.header;
+            const std::size_t start = out.size();
+            if (is_container(box.type)) {
+                out.insert(out.end(), &moov_[pos], &moov_[pos] + box.header);
+                if (!copy_boxes(pos + box.header, pos + box.size, out)) return false;
+                set_size(out, start, box.header);
+            } else if (box.type == fourcc("stco") || box.type == fourcc("co64")) {
+                if (!rewrite_chunk_offsets(box, body, bodySize, out)) return false;
+            } else if (box.type == fourcc("saio")) {
+                if (!rewrite_aux_offsets(box, body, bodySize, out)) return false;
+            } else {
+                out.insert(out.end(), &moov_[pos], &moov_[pos] + box.size);
+            }
+            pos += box.size;
+        }
+        return true;
+    }
+
+    static void set_size(std::vector<std::uint8_t>& out, std::size_t start, std::uint64_t header) {
+        const std::uint64_t size = out.size() - start;
+        if (header == 16) put64(&out[start + 8], size);
+        else put32(&out[start], static_cast<std::uint32_t>(size));
+    }
+
+    bool rewrite_chunk_offsets(const Box& box, const std::uint8_t* body, std::uint64_t bodySize, std::vector<std::uint8_t>& out) {
+        if (bodySize < 8) return false;
+        const bool is64 = box.type == fourcc("co64");
+        const std::uint32_t count = be32(body + 4);
+        const std::uint64_t entrySize = is64 ? 8 : 4;
+        if (count > (bodySize - 8) / entrySize) return false;
+        const bool write64 = is64 || wide_;
+
+        const std::size_t start = out.size();
+        append32(out, 0);
+        out.insert(out.end(), write64 ? "co64" : "stco", (write64 ? "co64" : "stco") + 4);
+        out.insert(out.end(), body, body + 8); // version/flags, entry count
+        for (std::uint32_t i = 0; i < count; ++i) {
+            const std::uint8_t* entry = body + 8 + i * entrySize;
+            const std::uint64_t offset = moved(is64 ? be64(entry) : be32(entry));
+            if (write64) {
+                append64(out, offset);
+            } else {
+                if (offset > 0xFFFFFFFFULL) overflow_ = true;
+                append32(out, static_cast<std::uint32_t>(offset));
+            }
+        }
+        put32(&out[start], static_cast<std::uint32_t>(out.size() - start));
+        return true;
+    }
+
+    // Sample auxiliary info (CENC) offsets are absolute in unfragmented files
+    bool rewrite_aux_offsets(const Box& box, const std::uint8_t* body, std::uint64_t bodySize, std::vector<std::uint8_t>& out) {
+        const std::size_t start = out.size();
+        out.insert(out.end(), &moov_[box.offset], &moov_[box.offset] + box.size);
+        if (bodySize < 4) return false;
+        const std::uint8_t version = body[0];
+        const std::uint32_t flags = be32(body) & 0xFFFFFF;
+        std::uint64_t pos = 4 + ((flags & 1) ? 8 : 0);
+        if (pos + 4 > bodySize) return false;
+        const std::uint32_t count = be32(body + pos);
+        pos += 4;
+        const std::uint64_t entrySize = version == 0 ? 4 : 8;
+        if (count > (bodySize - pos) / entrySize) return false;
+        std::uint8_t* entries = &out[start + box.header + pos];
+        for (std::uint32_t i = 0; i < count; ++i) {
+            std::uint8_t* entry = entries + i * entrySize;
+            if (version == 0) {
+                const std::uint64_t offset = moved(be32(entry));
+                if (offset > 0xFFFFFFFFULL) return false;
+                put32(entry, static_cast<std::uint32_t>(offset));
+            } else {
+                put64(entry, moved(be64(entry)));
+            }
+        }
+        return true;
+    }
+};
+
+// --- Relocation ------------------------------------------------------------
+
+struct Layout {
+    std::uint64_t fileSize = 0;
+    std::uint64_t mdatOffset = 0; // where the moov goes
+    std::uint64_t moovOffset = 0;
+    std::uint64_t moovSize = 0;
+    bool moovFirst = false;
+};
+
+static int scan_layout(int fd, Layout& layout, std::string& error) {
+    if (!file_size(fd, layout.fileSize)) {
+        error = "cannot stat file";
+        return ERR_INPUT;
+    }
+    bool haveMdat = false;
+    bool haveMoov = false;
+    std::uint64_t pos = 0;
+    while (pos < layout.fileSize) {
+        std::uint8_t header[16];
+        const std::uint64_t avail = layout.fileSize - pos;
+        if (!read_exact(fd, header, static_cast<std::size_t>(avail < 16 ? avail : 16), pos)) {
+            error = "read failed";
+            return ERR_INPUT;
+        }
+        Box box;
+        if (!parse_box(header, avail, pos, box)) {
+            error = "damaged box at offset " + std::to_string(pos);
+            return ERR_FORMAT;
+        }
+        if (box.type == fourcc("moof")) {
+            // Fragmented files carry their moov up front already
+            if (haveMoov && layout.moovFirst) return SUCCESS;
+            error = "fragmented file";
+            return ERR_FORMAT;
+        }
+        if (box.type == fourcc("mdat") && !haveMdat) {
+            haveMdat = true;
+            layout.mdatOffset = pos;
+        } else if (box.type == fourcc("moov")) {
+            if (haveMoov) {
+                error = "more than one moov";
+                return ERR_FORMAT;
+            }
+            haveMoov = true;
+            layout.moovOffset = pos;
+            layout.moovSize = box.size;
+            layout.moovFirst = !haveMdat;
+        }
+        pos += box.size;
+    }
+    if (!haveMoov || !haveMdat) {
+        error = "no moov or mdat";
+        return ERR_FORMAT;
+    }
+    if (!layout.moovFirst && layout.moovOffset + layout.moovSize != layout.fileSize) {
+        error = "moov is not the last box";
+        return ERR_FORMAT;
+    }
+    if (layout.moovSize > MAX_MOOV_SIZE) {
+        error = "moov too large";
+        return ERR_FORMAT;
+    }
+    return SUCCESS;
+}
+
+// The file from `alignedStart` on moves by `shift` (a whole number of blocks); `head` is
+// what goes at alignedStart: the bytes before mdat that shared its block, the new moov and
+// a `free` box reaching to where the moved mdat now starts.
+struct Plan {
+    std::uint64_t alignedStart = 0;
+    std::uint64_t shift = 0;
+    std::vector<std::uint8_t> head;
+    std::uint64_t moovSize = 0;
+};
+
+static int make_plan(int fd, const Layout& layout, std::uint64_t block, Plan& plan, std::string& error) {
+    std::vector<std::uint8_t> moov(static_cast<std::size_t>(layout.moovSize));
+    if (!read_exact(fd, moov.data(), moov.size(), layout.moovOffset)) {
+        error = "cannot read moov";
+        return ERR_INPUT;
+    }
+
+    plan.alignedStart = layout.mdatOffset / block * block;
+    const std::uint64_t lead = layout.mdatOffset - plan.alignedStart;
+    MoovRewriter rewriter(moov, layout.mdatOffset);
+    std::vector<std::uint8_t> rebuilt;
+    bool wide = false;
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        // The moov's size doesn't depend on the shift, only on whether stco is widened
+        if (!rewriter.rebuild(0, wide, rebuilt)) {
+            error = "damaged moov";
+            return ERR_FORMAT;
+        }
+        plan.shift = (lead + rebuilt.size() + 8 + block - 1) / block * block;
+        rewriter.rebuild(plan.shift, wide, rebuilt);
+        if (!rewriter.overflow()) break;
+        wide = true;
+    }
+    if (rewriter.overflow()) {
+        error = "chunk offsets overflow";
+        return ERR_FORMAT;
+    }
+
+    plan.moovSize = rebuilt.size();
+    plan.head.resize(static_cast<std::size_t>(lead));
+    if (lead && !read_exact(fd, plan.head.data(), plan.head.size(), plan.alignedStart)) {
+        error = "read failed";
+        return ERR_INPUT;
+    }
+    plan.head.insert(plan.head.end(), rebuilt.begin(), rebuilt.end());
+    append32(plan.head, static_cast<std::uint32_t>(plan.shift - rebuilt.size()));
+    append32(plan.head, fourcc("free"));
+    return SUCCESS;
+}
+
+static std::atomic<bool> g_stop(false);
+static volatile std::sig_atomic_t g_signaled = 0;
+
+static void on_stop_signal(int) { g_signaled = 1; }
+
+static bool stop_requested() { return g_stop.load() || g_signaled != 0; }
+
+// The relocation runs as a download stage, so it answers the same stop request as ffmpeg
+static void watch_for_stop() {
+    std::signal(SIGTERM, on_stop_signal);
+    std::signal(SIGINT, on_stop_signal);
+    std::thread([]() {
+        char c;
+        while (std::cin.get(c)) {
+            if (c == 'q') {
+                g_stop = true;
+                return;
+            }
+        }
+    }).detach();
+}
+
+#ifdef __linux__
+// Splice a hole into the extent map and fill it; on a failed write the hole is taken out again
+static int relocate_in_place(int fd, const Layout& layout, const Plan& plan, bool& unsupported) {
+    unsupported = false;
+    if (stop_requested()) return ERR_STOPPED;
+    if (fallocate(fd, FALLOC_FL_INSERT_RANGE, static_cast<off_t>(plan.alignedStart), static_cast<off_t>(plan.shift)) != 0) {
+        unsupported = errno == EOPNOTSUPP || errno == EINVAL || errno == ENOSYS || errno == EPERM;
+        return ERR_OUTPUT;
+    }
+    if (!write_exact(fd, plan.head.data(), plan.head.size(), plan.alignedStart) || !sync_file(fd)) {
+        const int err = errno;
+        fallocate(fd, FALLOC_FL_COLLAPSE_RANGE, static_cast<off_t>(plan.alignedStart), static_cast<off_t>(plan.shift));
+        errno = err;
+        return ERR_OUTPUT;
+    }
+    // The old moov now ends the file; cutting it off completes the move
+    if (ftruncate(fd, static_cast<off_t>(layout.moovOffset + plan.shift)) != 0 || fsync(fd) != 0) return ERR_OUTPUT;
+    return SUCCESS;
+}
+#endif
+
+static bool copy_range(int in, int out, std::uint64_t from, std::uint64_t to, std::uint64_t len, std::uint64_t total, std::uint64_t& copied) {
+    std::uint64_t nextReport = copied + PROGRESS_STEP;
+#ifdef __NR_copy_file_range
+    bool kernelCopy = true;
+#endif
+    std::vector<std::uint8_t> buffer;
+    while (len > 0) {
+        if (stop_requested()) {
+            errno = 0;
+            return false;
+        }
+        std::uint64_t step = len < COPY_CHUNK ? len : COPY_CHUNK;
+#ifdef __NR_copy_file_range
+        if (kernelCopy) {
+            loff_t inOff = static_cast<loff_t>(from);
+            loff_t outOff = static_cast<loff_t>(to);
+            long n = syscall(__NR_copy_file_range, in, &inOff, out, &outOff, static_cast<std::size_t>(step), 0u);
+            if (n > 0) {
+                step = static_cast<std::uint64_t>(n);
+                goto advance;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            // ENOSYS, EXDEV, EINVAL on filesystems without support: buffered from here on
+            kernelCopy = false;
+            if (n == 0) return false;
+        }
+#endif
+        if (buffer.empty()) buffer.resize(COPY_CHUNK);
+        if (!read_exact(in, buffer.data(), static_cast<std::size_t>(step), from)) return false;
+        if (!write_exact(out, buffer.data(), static_cast<std::size_t>(step), to)) return false;
+#ifdef __NR_copy_file_range
+    advance:
+#endif
+        from += step;
+        to += step;
+        len -= step;
+        copied += step;
+        if (copied >= nextReport) {
+            std::cout << "PROGRESS=" << copied << "/" << total << std::endl;
+            nextReport = copied + PROGRESS_STEP;
+        }
+    }
+    return true;
+}
+
+static std::string sibling_path(const std::string& path) {
+    std::size_t slash = path.find_last_of("/\\");
+    std::string dir = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    return dir + "." + name + ".faststart";
+}
+
+// Same layout as the in-place move, written to a hidden sibling and renamed over the file
+static int relocate_by_copy(int& fd, const std::string& path, const Layout& layout, const Plan& plan) {
+    const std::string tmpPath = sibling_path(path);
+    remove_file(tmpPath); // left over from an interrupted run
+    int out = create_exclusive(tmpPath);
+    if (out < 0) return ERR_OUTPUT;
+
+    const std::uint64_t moved = layout.moovOffset - plan.alignedStart;
+    const std::uint64_t total = plan.alignedStart + moved;
+    std::uint64_t copied = 0;
+    bool ok = copy_range(fd, out, 0, 0, plan.alignedStart, total, copied) &&
+              write_exact(out, plan.head.data(), plan.head.size(), plan.alignedStart) &&
+              copy_range(fd, out, plan.alignedStart, plan.alignedStart + plan.shift, moved, total, copied);
+#ifndef _WIN32
+    struct stat st;
+    if (ok && fstat(fd, &st) == 0) fchmod(out, st.st_mode & 07777);
+#endif
+    ok = ok && sync_file(out);
+    const int err = errno;
+    ok = close_file(out) == 0 && ok;
+    if (!ok) {
+        remove_file(tmpPath);
+        errno = err;
+        return stop_requested() ? ERR_STOPPED : ERR_OUTPUT;
+    }
+
+    // Windows can't replace a file that is still open
+    close_file(fd);
+    fd = -1;
+    if (!replace_file(tmpPath, path)) {
+        remove_file(tmpPath);
+        return ERR_OUTPUT;
+    }
+    return SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    mvd_trace::HelperSpan traceSpan("mvd-faststart");
+
+    std::string path;
+    bool lowPriority = false;
+    bool allowInsert = true;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--low-priority") lowPriority = true;
+        else if (arg == "--no-insert") allowInsert = false;
+        else if (path.empty() && !arg.empty() && arg[0] != '-') path = arg;
+        else {
+            path.clear();
+            break;
+        }
+    }
+    if (path.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--low-priority] [--no-insert] <file.mp4>" << std::endl;
+        return ERR_ARGS;
+    }
+    if (lowPriority) lower_priority();
+    watch_for_stop();
+
+    int fd = open_existing(path);
+    if (fd < 0) {
+        std::perror("Error opening file");
+        return ERR_INPUT;
+    }
+
+    Layout layout;
+    std::string error;
+    int rc = scan_layout(fd, layout, error);
+    if (rc == SUCCESS && layout.moovFirst) {
+        close_file(fd);
+        std::cout << "STATUS=already" << std::endl;
+        return SUCCESS;
+    }
+
+    Plan plan;
+    if (rc == SUCCESS) rc = make_plan(fd, layout, block_size(fd), plan, error);
+    if (rc != SUCCESS) {
+        close_file(fd);
+        std::cerr << "Cannot relocate moov: " << error << std::endl;
+        return rc;
+    }
+
+    const char* method = "copy";
+    rc = ERR_OUTPUT;
+#ifdef __linux__
+    bool unsupported = true;
+    if (allowInsert) {
+        rc = relocate_in_place(fd, layout, plan, unsupported);
+        if (rc == SUCCESS) method = "insert";
+        else if (rc == ERR_STOPPED) unsupported = false;
+        else if (!unsupported) std::perror("Error moving payload in place");
+    }
+    if (rc != SUCCESS && unsupported) rc = relocate_by_copy(fd, path, layout, plan);
+#else
+    (void)allowInsert;
+    rc = relocate_by_copy(fd, path, layout, plan);
+#endif
+    if (rc == ERR_STOPPED) std::cerr << "Stopped on request; file left as it was" << std::endl;
+    else if (rc != SUCCESS && errno) std::perror("Error relocating moov");
+    if (fd >= 0) close_file(fd);
+    if (rc != SUCCESS) return rc;
+
+    std::cout << "STATUS=moved METHOD=" << method << " SHIFT=" << plan.shift << " MOOV=" << plan.moovSize << std::endl;
+    return SUCCESS;
+}
@@ -7,6 +7,7 @@
 //   mvd-fileui.exe --mode reveal --path "C:\path\to\file.txt"
 //   mvd-fileui.exe --mode open-folder --path "C:\path\to\folder"
 //   mvd-fileui.exe --mode open-file --path "C:\path\to\file.txt"
+//   mvd-fileui --mode reveal --path /a/one.mp4 [--path /a/two.mp4]...   (Linux: several at once)
 //
 // Backward compatibility:
 //   mvd-fileui.exe                -> defaults to --mode pick-folder
@@ -18,16 +19,40 @@
 // - Windows Vista+ API; tested Win 8/8.1/10/11.
 // - Build for x64 now; arm64 later (same source).
 // - Long path (> 260 chars) support via SHParseDisplayName + SHOpenFolderAndSelectItems (no MAX_PATH limit).
+//
+// Linux:
+// - pick-folder and save-file go to org.freedesktop.portal.FileChooser on the session bus
+//   (same flags, same stdout contract), so sandboxed and Wayland desktops get their native
+//   dialog without the host loading a JS D-Bus stack.
+// - libdbus-1 is dlopen'ed and its two structs are declared locally: no build dependency,
+//   and a system without it just reports the portal as unavailable.
+// - reveal and open-folder ask org.freedesktop.FileManager1 (ShowItems / ShowFolders) in one
+//   call for every --path given, so the file manager selects the files like Explorer does;
+//   without it they use the portal's OpenURI (OpenDirectory / OpenFile with an fd).
+//   open-file goes to OpenURI.OpenFile.
+// - Exit 2 when nothing answers (no session bus, no FileChooser or OpenURI, folder picking
+//   needs portal version 3); the host then falls back to zenity/kdialog or xdg-open.
+// - DBUS_SESSION_BUS_ADDRESS selects the bus, so a stand-in portal on a private bus
+//   (dbus-run-session) can answer in tests.
 
+#ifdef _WIN32
 #define NOMINMAX
 #include <windows.h>
 #include <shobjidl.h>      // IFileDialog, SHOpenFolderAndSelectItems
 #include <shlobj.h>        // SIGDN_*, SHParseDisplayName
 #include <shellapi.h>      // CommandLineToArgvW
+#else
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <string>
+#include <vector>
 
 enum DialogMode {
     MODE_PICK_FOLDER,
@@ -37,6 +62,7 @@ enum DialogMode {
     MODE_OPEN_FILE      // Open file with default application (long-path safe)
 };
 
+#ifdef _WIN32
 static int write_utf8_stdout(const wchar_t* wstr) {
     if (!wstr) return 1;
     // Get size needed for UTF-8 conversion (includes NUL terminator)
@@ -375,4 +401,493 @@ cleanup:
     CoUninitialize();
     LocalFree(argv);
     return rc == 0 ? 0 : 1;
-}
\ No newline at end of file
+}
+#else
+// --- Linux: XDG desktop portal over libdbus ----------------------------------
+
+static const int EXIT_UNAVAILABLE = 2;
+static const int CALL_TIMEOUT_MS = 5000;
+static const int ACTIVATION_TIMEOUT_MS = 25000; // a file manager started by D-Bus activation can be slow
+static const int DIALOG_TIMEOUT_S = 600;
+
+// Local copies of the two libdbus structs callers allocate (ABI-stable since 1.0)
+struct DBusError {
+    const char* name;
+    const char* message;
+    unsigned int dummy;
+    void* padding1;
+};
+
+struct DBusMessageIter {
+    void* dummy1;
+    void* dummy2;
+    unsigned int dummy3;
+    int dummy4, dummy5, dummy6, dummy7, dummy8, dummy9, dummy10, dummy11;
+    int pad1;
+    void* pad2;
+    void* pad3;
+};
+
+struct DBusConnection;
+struct DBusMessage;
+
+enum {
+    DBUS_BUS_SESSION = 0,
+    TYPE_INVALID = 0,
+    TYPE_BYTE = 'y',
+    TYPE_BOOLEAN = 'b',
+    TYPE_UINT32 = 'u',
+    TYPE_UNIX_FD = 'h',
+    TYPE_STRING = 's',
+    TYPE_OBJECT_PATH = 'o',
+    TYPE_ARRAY = 'a',
+    TYPE_VARIANT = 'v',
+    TYPE_DICT_ENTRY = 'e'
+};
+
+struct DBusLib {
+    void (*error_init)(DBusError*);
+    void (*error_free)(DBusError*);
+    DBusConnection* (*bus_get_private)(int, DBusError*);
+    const char* (*bus_get_unique_name)(DBusConnection*);
+    void (*bus_add_match)(DBusConnection*, const char*, DBusError*);
+    void (*connection_set_exit_on_disconnect)(DBusConnection*, unsigned int);
+    unsigned int (*connection_read_write)(DBusConnection*, int);
+    DBusMessage* (*connection_pop_message)(DBusConnection*);
+    DBusMessage* (*connection_send_with_reply_and_block)(DBusConnection*, DBusMessage*, int, DBusError*);
+    void (*connection_close)(DBusConnection*);
+    void (*connection_unref)(DBusConnection*);
+    DBusMessage* (*message_new_method_call)(const char*, const char*, const char*, const char*);
+    unsigned int (*message_is_signal)(DBusMessage*, const char*, const char*);
+    const char* (*message_get_path)(DBusMessage*);
+    void (*message_unref)(DBusMessage*);
+    void (*iter_init_append)(DBusMessage*, DBusMessageIter*);
+    unsigned int (*iter_append_basic)(DBusMessageIter*, int, const void*);
+    unsigned int (*iter_append_fixed_array)(DBusMessageIter*, int, const void*, int);
+    unsigned int (*iter_open_container)(DBusMessageIter*, int, const char*, DBusMessageIter*);
+    unsigned int (*iter_close_container)(DBusMessageIter*, DBusMessageIter*);
+    unsigned int (*iter_init)(DBusMessage*, DBusMessageIter*);
+    int (*iter_get_arg_type)(DBusMessageIter*);
+    void (*iter_get_basic)(DBusMessageIter*, void*);
+    unsigned int (*iter_next)(DBusMessageIter*);
+    void (*iter_recurse)(DBusMessageIter*, DBusMessageIter*);
+};
+
+static DBusLib g_dbus;
+
+template <typename Fn>
+static bool resolve(void* lib, const char* name, Fn& fn) {
+    fn = reinterpret_cast<Fn>(dlsym(lib, name));
+    return fn != nullptr;
+}
+
+static bool load_dbus() {
+    void* lib = dlopen("libdbus-1.so.3", RTLD_NOW | RTLD_LOCAL);
+    if (!lib) return false;
+    DBusLib& d = g_dbus;
+    return resolve(lib, "dbus_error_init", d.error_init) &&
+           resolve(lib, "dbus_error_free", d.error_free) &&
+           resolve(lib, "dbus_bus_get_private", d.bus_get_private) &&
+           resolve(lib, "dbus_bus_get_unique_name", d.bus_get_unique_name) &&
+           resolve(lib, "dbus_bus_add_match", d.bus_add_match) &&
+           resolve(lib, "dbus_connection_set_exit_on_disconnect", d.connection_set_exit_on_disconnect) &&
+           resolve(lib, "dbus_connection_read_write", d.connection_read_write) &&
+           resolve(lib, "dbus_connection_pop_message", d.connection_pop_message) &&
+           resolve(lib, "dbus_connection_send_with_reply_and_block", d.connection_send_with_reply_and_block) &&
+           resolve(lib, "dbus_connection_close", d.connection_close) &&
+           resolve(lib, "dbus_connection_unref", d.connection_unref) &&
+           resolve(lib, "dbus_message_new_method_call", d.message_new_method_call) &&
+           resolve(lib, "dbus_message_is_signal", d.message_is_signal) &&
+           resolve(lib, "dbus_message_get_path", d.message_get_path) &&
+           resolve(lib, "dbus_message_unref", d.message_unref) &&
+           resolve(lib, "dbus_message_iter_init_append", d.iter_init_append) &&
+           resolve(lib, "dbus_message_iter_append_basic", d.iter_append_basic) &&
+           resolve(lib, "dbus_message_iter_append_fixed_array", d.iter_append_fixed_array) &&
+           resolve(lib, "dbus_message_iter_open_container", d.iter_open_container) &&
+           resolve(lib, "dbus_message_iter_close_container", d.iter_close_container) &&
+           resolve(lib, "dbus_message_iter_init", d.iter_init) &&
+           resolve(lib, "dbus_message_iter_get_arg_type", d.iter_get_arg_type) &&
+           resolve(lib, "dbus_message_iter_get_basic", d.iter_get_basic) &&
+           resolve(lib, "dbus_message_iter_next", d.iter_next) &&
+           resolve(lib, "dbus_message_iter_recurse", d.iter_recurse);
+}
+
+// Blocking method call; returns the reply (caller unrefs) or null with the error on stderr
+static DBusMessage* call(DBusConnection* conn, DBusMessage* msg, const char* what, int timeoutMs = CALL_TIMEOUT_MS) {
+    DBusError err;
+    g_dbus.error_init(&err);
+    DBusMessage* reply = g_dbus.connection_send_with_reply_and_block(conn, msg, timeoutMs, &err);
+    g_dbus.message_unref(msg);
+    if (!reply) {
+        fprintf(stderr, "%s: %s\n", what, err.message ? err.message : "no reply");
+        g_dbus.error_free(&err);
+    }
+    return reply;
+}
+
+// --- a{sv} option builders ---
+
+static void append_option(DBusMessageIter* dict, const char* key, int type, const char* signature, const void* value) {
+    DBusMessageIter entry, variant;
+    g_dbus.iter_open_container(dict, TYPE_DICT_ENTRY, nullptr, &entry);
+    g_dbus.iter_append_basic(&entry, TYPE_STRING, &key);
+    g_dbus.iter_open_container(&entry, TYPE_VARIANT, signature, &variant);
+    g_dbus.iter_append_basic(&variant, type, value);
+    g_dbus.iter_close_container(&entry, &variant);
+    g_dbus.iter_close_container(dict, &entry);
+}
+
+static void append_string_option(DBusMessageIter* dict, const char* key, const char* value) {
+    append_option(dict, key, TYPE_STRING, "s", &value);
+}
+
+static void append_bool_option(DBusMessageIter* dict, const char* key, bool value) {
+    unsigned int flag = value ? 1 : 0;
+    append_option(dict, key, TYPE_BOOLEAN, "b", &flag);
+}
+
+// Portal paths are NUL-terminated byte arrays, not strings (they need not be UTF-8)
+static void append_path_option(DBusMessageIter* dict, const char* key, const char* path) {
+    DBusMessageIter entry, variant, bytes;
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(path);
+    g_dbus.iter_open_container(dict, TYPE_DICT_ENTRY, nullptr, &entry);
+    g_dbus.iter_append_basic(&entry, TYPE_STRING, &key);
+    g_dbus.iter_open_container(&entry, TYPE_VARIANT, "ay", &variant);
+    g_dbus.iter_open_container(&variant, TYPE_ARRAY, "y", &bytes);
+    g_dbus.iter_append_fixed_array(&bytes, TYPE_BYTE, &data, static_cast<int>(strlen(path) + 1));
+    g_dbus.iter_close_container(&variant, &bytes);
+    g_dbus.iter_close_container(&entry, &variant);
+    g_dbus.iter_close_container(dict, &entry);
+}
+
+// --- Portal helpers ---
+
+static const char* PORTAL_NAME = "org.freedesktop.portal.Desktop";
+static const char* PORTAL_PATH = "/org/freedesktop/portal/desktop";
+static const char* FILE_CHOOSER = "org.freedesktop.portal.FileChooser";
+static const char* REQUEST_IFACE = "org.freedesktop.portal.Request";
+
+static unsigned int portal_version(DBusConnection* conn, const char* iface) {
+    DBusMessage* msg = g_dbus.message_new_method_call(PORTAL_NAME, PORTAL_PATH, "org.freedesktop.DBus.Properties", "Get");
+    DBusMessageIter args;
+    const char* property = "version";
+    g_dbus.iter_init_append(msg, &args);
+    g_dbus.iter_append_basic(&args, TYPE_STRING, &iface);
+    g_dbus.iter_append_basic(&args, TYPE_STRING, &property);
+    DBusMessage* reply = call(conn, msg, iface);
+    if (!reply) return 0;
+
+    unsigned int version = 0;
+    DBusMessageIter it, value;
+    if (g_dbus.iter_init(reply, &it) && g_dbus.iter_get_arg_type(&it) == TYPE_VARIANT) {
+        g_dbus.iter_recurse(&it, &value);
+        if (g_dbus.iter_get_arg_type(&value) == TYPE_UINT32) g_dbus.iter_get_basic(&value, &version);
+    }
+    g_dbus.message_unref(reply);
+    return version;
+}
+
+// Request objects live at .../request/<sender with ':' dropped and '.' as '_'>/<token>
+static std::string request_path(DBusConnection* conn, const std::string& token) {
+    std::string sender = g_dbus.bus_get_unique_name(conn);
+    if (!sender.empty() && sender[0] == ':') sender.erase(0, 1);
+    for (char& c : sender) if (c == '.') c = '_';
+    return std::string(PORTAL_PATH) + "/request/" + sender + "/" + token;
+}
+
+static void watch_request(DBusConnection* conn, const std::string& path) {
+    std::string rule = "type='signal',interface='" + std::string(REQUEST_IFACE) + "',member='Response',path='" + path + "'";
+    g_dbus.bus_add_match(conn, rule.c_str(), nullptr);
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// file:///home/u/My%20Videos -> /home/u/My Videos (empty for non-file URIs)
+static std::string path_from_uri(const char* uri) {
+    if (strncmp(uri, "file://", 7) != 0) return std::string();
+    const char* p = strchr(uri + 7, '/');
+    if (!p) return std::string();
+    std::string out;
+    for (; *p; ++p) {
+        int hi, lo;
+        if (*p == '%' && (hi = hex_value(p[1])) >= 0 && (lo = hex_value(p[2])) >= 0) {
+            out += static_cast<char>(hi * 16 + lo);
+            p += 2;
+        } else {
+            out += *p;
+        }
+    }
+    return out;
+}
+
+// First entry of results["uris"] in a Response(u, a{sv}) signal
+static std::string first_uri(DBusMessage* signal, unsigned int& response) {
+    DBusMessageIter it, dict, entry, variant, uris;
+    response = 2;
+    if (!g_dbus.iter_init(signal, &it) || g_dbus.iter_get_arg_type(&it) != TYPE_UINT32) return std::string();
+    g_dbus.iter_get_basic(&it, &response);
+    if (!g_dbus.iter_next(&it) || g_dbus.iter_get_arg_type(&it) != TYPE_ARRAY) return std::string();
+
+    for (g_dbus.iter_recurse(&it, &dict); g_dbus.iter_get_arg_type(&dict) == TYPE_DICT_ENTRY; g_dbus.iter_next(&dict)) {
+        const char* key = nullptr;
+        g_dbus.iter_recurse(&dict, &entry);
+        g_dbus.iter_get_basic(&entry, &key);
+        if (!key || strcmp(key, "uris") != 0 || !g_dbus.iter_next(&entry)) continue;
+        g_dbus.iter_recurse(&entry, &variant);
+        if (g_dbus.iter_get_arg_type(&variant) != TYPE_ARRAY) break;
+        g_dbus.iter_recurse(&variant, &uris);
+        if (g_dbus.iter_get_arg_type(&uris) != TYPE_STRING) break;
+        const char* uri = nullptr;
+        g_dbus.iter_get_basic(&uris, &uri);
+        return uri ? path_from_uri(uri) : std::string();
+    }
+    return std::string();
+}
+
+static bool is_directory(const char* path) {
+    struct stat st;
+    return path && *path && stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static int portal_dialog(DBusConnection* conn, DialogMode mode, const char* title, const char* initial, const char* filename) {
+    if (mode == MODE_PICK_FOLDER && portal_version(conn, FILE_CHOOSER) < 3) {
+        fprintf(stderr, "FileChooser portal missing or too old for folders\n");
+        return EXIT_UNAVAILABLE;
+    }
+
+    char token[32];
+    snprintf(token, sizeof(token), "mvd_%ld_%ld", static_cast<long>(getpid()), static_cast<long>(time(nullptr)));
+    // Subscribe before calling, or a fast portal's Response can arrive unseen
+    std::string expected = request_path(conn, token);
+    watch_request(conn, expected);
+
+    DBusMessage* msg = g_dbus.message_new_method_call(PORTAL_NAME, PORTAL_PATH, FILE_CHOOSER,
+                                                      mode == MODE_PICK_FOLDER ? "OpenFile" : "SaveFile");
+    DBusMessageIter args, dict;
+    const char* parent = "";
+    const char* tokenPtr = token;
+    g_dbus.iter_init_append(msg, &args);
+    g_dbus.iter_append_basic(&args, TYPE_STRING, &parent);
+    g_dbus.iter_append_basic(&args, TYPE_STRING, &title);
+    g_dbus.iter_open_container(&args, TYPE_ARRAY, "{sv}", &dict);
+    append_string_option(&dict, "handle_token", tokenPtr);
+    append_bool_option(&dict, "modal", true);
+    if (mode == MODE_PICK_FOLDER) {
+        append_bool_option(&dict, "directory", true);
+        append_bool_option(&dict, "multiple", false);
+    } else if (filename && *filename) {
+        append_string_option(&dict, "current_name", filename);
+    }
+    if (is_directory(initial)) append_path_option(&dict, "current_folder", initial);
+    g_dbus.iter_close_container(&args, &dict);
+
+    DBusMessage* reply = call(conn, msg, FILE_CHOOSER);
+    if (!reply) return EXIT_UNAVAILABLE;
+    // Portals before 0.9 ignore handle_token and return some other path
+    const char* handle = nullptr;
+    DBusMessageIter it;
+    if (g_dbus.iter_init(reply, &it) && g_dbus.iter_get_arg_type(&it) == TYPE_OBJECT_PATH) g_dbus.iter_get_basic(&it, &handle);
+    if (handle && expected != handle) {
+        expected = handle;
+        watch_request(conn, expected);
+    }
+    g_dbus.message_unref(reply);
+
+    // The Response may already be queued behind the method reply; drain before blocking
+    const time_t deadline = time(nullptr) + DIALOG_TIMEOUT_S;
+    while (time(nullptr) < deadline) {
+        DBusMessage* signal = g_dbus.connection_pop_message(conn);
+        if (!signal) {
+            if (!g_dbus.connection_read_write(conn, 1000)) {
+                fprintf(stderr, "Session bus disconnected\n");
+                return EXIT_UNAVAILABLE;
+            }
+            continue;
+        }
+        const char* path = g_dbus.message_get_path(signal);
+        if (!g_dbus.message_is_signal(signal, REQUEST_IFACE, "Response") || !path || expected != path) {
+            g_dbus.message_unref(signal);
+            continue;
+        }
+        unsigned int response = 2;
+        std::string selected = first_uri(signal, response);
+        g_dbus.message_unref(signal);
+        if (response == 1) return 1; // cancelled by the user
+        if (response != 0) {
+            fprintf(stderr, "FileChooser failed (response %u)\n", response);
+            return EXIT_UNAVAILABLE;
+        }
+        if (selected.empty()) {
+            fprintf(stderr, "FileChooser returned no local path\n");
+            return 1;
+        }
+        size_t written = fwrite(selected.data(), 1, selected.size(), stdout);
+        fflush(stdout);
+        return written == selected.size() ? 0 : 1;
+    }
+    fprintf(stderr, "FileChooser timed out\n");
+    return 1;
+}
+
+// --- reveal / open-folder / open-file ---
+
+static const char* FILE_MANAGER_NAME = "org.freedesktop.FileManager1";
+static const char* FILE_MANAGER_PATH = "/org/freedesktop/FileManager1";
+static const char* OPEN_URI = "org.freedesktop.portal.OpenURI";
+
+// /home/u/My Videos -> file:///home/u/My%20Videos (RFC 3986 unreserved and '/' kept)
+static std::string uri_from_path(const std::string& path) {
+    static const char* HEX = "0123456789ABCDEF";
+    std::string out = "file://";
+    for (unsigned char c : path) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+            c == '/' || c == '-' || c == '.' || c == '_' || c == '~') {
+            out += static_cast<char>(c);
+        } else {
+            out += '%';
+            out += HEX[c >> 4];
+            out += HEX[c & 15];
+        }
+    }
+    return out;
+}
+
+// ShowItems/ShowFolders(as uris, s startup_id): every path in one round trip
+static bool file_manager_show(DBusConnection* conn, const char* method, const std::vector<std::string>& paths) {
+    DBusMessage* msg = g_dbus.message_new_method_call(FILE_MANAGER_NAME, FILE_MANAGER_PATH, FILE_MANAGER_NAME, method);
+    DBusMessageIter args, uris;
+    const char* startupId = "";
+    g_dbus.iter_init_append(msg, &args);
+    g_dbus.iter_open_container(&args, TYPE_ARRAY, "s", &uris);
+    for (const std::string& path : paths) {
+        std::string uri = uri_from_path(path);
+        const char* value = uri.c_str();
+        g_dbus.iter_append_basic(&uris, TYPE_STRING, &value);
+    }
+    g_dbus.iter_close_container(&args, &uris);
+    g_dbus.iter_append_basic(&args, TYPE_STRING, &startupId);
+
+    DBusMessage* reply = call(conn, msg, FILE_MANAGER_NAME, ACTIVATION_TIMEOUT_MS);
+    if (!reply) return false;
+    g_dbus.message_unref(reply);
+    return true;
+}
+
+// OpenURI.OpenFile / OpenDirectory(s parent_window, h fd, a{sv} options). The portal takes
+// an fd rather than a file:// URI so sandboxed callers can only name files they can open.
+static bool portal_open(DBusConnection* conn, const char* method, const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "%s: cannot open %s\n", method, path.c_str());
+        return false;
+    }
+    DBusMessage* msg = g_dbus.message_new_method_call(PORTAL_NAME, PORTAL_PATH, OPEN_URI, method);
+    DBusMessageIter args, dict;
+    const char* parent = "";
+    g_dbus.iter_init_append(msg, &args);
+    g_dbus.iter_append_basic(&args, TYPE_STRING, &parent);
+    g_dbus.iter_append_basic(&args, TYPE_UNIX_FD, &fd); // libdbus sends a dup
+    g_dbus.iter_open_container(&args, TYPE_ARRAY, "{sv}", &dict);
+    g_dbus.iter_close_container(&args, &dict);
+    DBusMessage* reply = call(conn, msg, OPEN_URI);
+    close(fd);
+    if (!reply) return false;
+    g_dbus.message_unref(reply);
+    return true;
+}
+
+static bool portal_open_all(DBusConnection* conn, const char* method, const std::vector<std::string>& paths) {
+    for (const std::string& path : paths) {
+        if (!portal_open(conn, method, path)) return false;
+    }
+    return true;
+}
+
+static int shell_operation(DBusConnection* conn, DialogMode mode, const std::vector<std::string>& paths) {
+    if (paths.empty()) {
+        fprintf(stderr, "%s: invalid-path\n", mode == MODE_REVEAL ? "reveal" : mode == MODE_OPEN_FOLDER ? "open-folder" : "open-file");
+        return 1;
+    }
+    bool done = false;
+    if (mode == MODE_REVEAL) {
+        done = file_manager_show(conn, "ShowItems", paths) ||
+               (portal_version(conn, OPEN_URI) >= 3 && portal_open_all(conn, "OpenDirectory", paths));
+    } else if (mode == MODE_OPEN_FOLDER) {
+        done = file_manager_show(conn, "ShowFolders", paths) || portal_open_all(conn, "OpenFile", paths);
+    } else {
+        done = portal_open_all(conn, "OpenFile", paths);
+    }
+    return done ? 0 : EXIT_UNAVAILABLE;
+}
+
+static bool parse_args(int argc, char** argv, DialogMode& mode, const char*& title, const char*& initial, const char*& filename,
+                       std::vector<std::string>& paths) {
+    mode = MODE_PICK_FOLDER;
+    title = nullptr;
+    initial = nullptr;
+    filename = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "pick-folder") == 0) mode = MODE_PICK_FOLDER;
+            else if (strcmp(value, "save-file") == 0) mode = MODE_SAVE_FILE;
+            else if (strcmp(value, "reveal") == 0) mode = MODE_REVEAL;
+            else if (strcmp(value, "open-folder") == 0) mode = MODE_OPEN_FOLDER;
+            else if (strcmp(value, "open-file") == 0) mode = MODE_OPEN_FILE;
+            else return false;
+        } else if (strcmp(argv[i], "--title") == 0 && i + 1 < argc) {
+            title = argv[++i];
+        } else if (strcmp(argv[i], "--initial") == 0 && i + 1 < argc) {
+            initial = argv[++i];
+        } else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) {
+            initial = argv[++i];
+            paths.push_back(initial);
+        } else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            filename = argv[++i];
+        } else if (i == 1) {
+            title = argv[i];
+        } else if (i == 2) {
+            initial = argv[i];
+        }
+    }
+    if (!title) title = mode == MODE_SAVE_FILE ? "Save As" : "Choose Folder";
+    return true;
+}
+
+int main(int argc, char** argv) {
+    DialogMode mode;
+    const char* title;
+    const char* initial;
+    const char* filename;
+    std::vector<std::string> paths;
+    if (!parse_args(argc, argv, mode, title, initial, filename, paths)) return 1;
+
+    if (!getenv("DBUS_SESSION_BUS_ADDRESS") || !load_dbus()) {
+        fprintf(stderr, "No session bus or libdbus\n");
+        return EXIT_UNAVAILABLE;
+    }
+
+    DBusError err;
+    g_dbus.error_init(&err);
+    DBusConnection* conn = g_dbus.bus_get_private(DBUS_BUS_SESSION, &err);
+    if (!conn) {
+        fprintf(stderr, "Session bus: %s\n", err.message ? err.message : "unavailable");
+        g_dbus.error_free(&err);
+        return EXIT_UNAVAILABLE;
+    }
+    g_dbus.connection_set_exit_on_disconnect(conn, 0);
+
+    int rc = (mode == MODE_PICK_FOLDER || mode == MODE_SAVE_FILE)
+        ? portal_dialog(conn, mode, title, initial, filename)
+        : shell_operation(conn, mode, paths);
+    g_dbus.connection_close(conn);
+    g_dbus.connection_unref(conn);
+    return rc;
+}
+#endif
@@ -0,0 +1,623 @@
+// Native fragmented MP4 assembly for fMP4/CMAF HLS `-c copy` outputs.
+// Writes the init segment's ftyp/moov once, then appends each segment's moof/mdat pairs.
+// mdat payloads are copied file-to-file (copy_file_range on Linux, buffered elsewhere) and
+// only moof is read into memory: mfhd sequence numbers are renumbered, tfhd base_data_offset
+// is moved to the new file position and tfdt is rebased when a segment jumps in time.
+// Per-segment indexes (styp/sidx/ssix/mfra) are dropped since their offsets no longer hold.
+// With --hash the mdat payloads take the buffered path so every output byte is digested.
+//
+// Usage:
+//   mvd-fmp4 --output out.mp4 [--no-rebase] [--hash xxh3,sha256] init.mp4 seg1.m4s seg2.m4s ...
+//   mvd-fmp4 --output out.mp4 [--no-rebase] [--hash xxh3,sha256] --stdin-list   (init path first, then one segment per line)
+//
+// Stdout:
+//   SEGMENT=<index> BYTES=<output bytes so far>    after each input (the init segment is index 0)
+//   REPORT=<json>                                   health report at the end
+//   XXH3=<hex> SHA256=<hex>                         digests of the output file (--hash), on success
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../../common/mvd_hash.h"
+#include "../../common/mvd_trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+// glibc 2.17 has no wrapper and older kernel headers no number
+#ifndef __NR_copy_file_range
+#if defined(__x86_64__)
+#define __NR_copy_file_range 326
+#elif defined(__aarch64__)
+#define __NR_copy_file_range 285
+#elif defined(__i386__)
+#define __NR_copy_file_range 377
+#elif defined(__arm__)
+#define __NR_copy_file_range 391
+#endif
+#endif
+#endif
+#endif
+
+enum ExitCode {
+    SUCCESS = 0,
+    ERR_ARGS = 2,
+    ERR_INPUT = 3,
+    ERR_OUTPUT = 4,
+    ERR_FORMAT = 5
+};
+
+static const std::size_t COPY_CHUNK = 4 * 1024 * 1024;
+static const std::uint64_t MAX_MOOF_SIZE = 64 * 1024 * 1024;
+static const std::uint64_t DEFAULT_TIMESCALE = 90000;
+static const std::uint64_t TFDT_JUMP_LIMIT_SEC = 10; // same threshold as mvd-tsconcat
+
+// --- Low-level file access -------------------------------------------------
+
+#ifdef _WIN32
+static std::wstring to_wide(const std::string& path) {
+    int len = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    if (len == 0) return std::wstring();
+    std::wstring wpath(len, 0);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wpath[0], len);
+    return wpath;
+}
+
+static int open_input(const std::string& path) {
+    return _wopen(to_wide(path).c_str(), _O_RDONLY | _O_BINARY);
+}
+
+static int open_output(const std::string& path) {
+    return _wopen(to_wide(path).c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+static bool file_size(int fd, std::uint64_t& size) {
+    struct _stat64 st;
+    if (_fstat64(fd, &st) != 0) return false;
+    size = static_cast<std::uint64_t>(st.st_size);
+    return true;
+}
+
+static long long read_at(int fd, void* buf, std::size_t len, std::uint64_t offset) {
+    if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) return -1;
+    return _read(fd, buf, static_cast<unsigned int>(len));
+}
+
+static long long write_some(int fd, const void* buf, std::size_t len) {
+    return _write(fd, buf, static_cast<unsigned int>(len));
+}
+
+static int close_file(int fd) { return _close(fd); }
+#else
+static int open_input(const std::string& path) {
+    return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+static int open_output(const std::string& path) {
+    return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+static bool file_size(int fd, std::uint64_t& size) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return false;
+    size = static_cast<std::uint64_t>(st.st_size);
+    return true;
+}
+
+static long long read_at(int fd, void* buf, std::size_t len, std::uint64_t offset) {
+    return pread(fd, buf, len, static_cast<off_t>(offset));
+}
+
+static long long write_some(int fd, const void* buf, std::size_t len) {
+    return write(fd, buf, len);
+}
+
+static int close_file(int fd) { return close(fd); }
+#endif
+
+static bool read_exact(int fd, void* buf, std::size_t len, std::uint64_t offset) {
+    std::uint8_t* p = static_cast<std::uint8_t*>(buf);
+    while (len > 0) {
+        long long n = read_at(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= static_cast<std::size_t>(n);
+        offset += static_cast<std::uint64_t>(n);
+    }
+    return true;
+}
+
+// --- Big-endian helpers ----------------------------------------------------
+
+static std::uint32_t be32(const std::uint8_t* p) {
+    return (static_cast<std::uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static std::uint64_t be64(const std::uint8_t* p) {
+    return (static_cast<std::uint64_t>(be32(p)) << 32) | be32(p + 4);
+}
+
+static void put32(std::uint8_t* p, std::uint32_t v) {
+    p[0] = static_cast<std::uint8_t>(v >> 24);
+    p[1] = static_cast<std::uint8_t>(v >> 16);
+    p[2] = static_cast<std::uint8_t>(v >> 8);
+    p[3] = static_cast<std::uint8_t>(v);
+}
+
+static void put64(std::uint8_t* p, std::uint64_t v) {
+    put32(p, static_cast<std::uint32_t>(v >> 32));
+    put32(p + 4, static_cast<std::uint32_t>(v));
+}
+
+static std::uint32_t fourcc(const char* s) {
+    return be32(reinterpret_cast<const std::uint8_t*>(s));
+}
+
+struct Box {
+    std::uint32_t type = 0;
+    std::uint64_t offset = 0;  // start of the box header
+    std::uint64_t size = 0;    // whole box including header
+    std::uint64_t header = 0;
+};
+
+// Parse a box header from memory; size 0 means "to the end of the container"
+static bool parse_box(const std::uint8_t* data, std::uint64_t avail, std::uint64_t offset, Box& box) {
+    if (avail < 8) return false;
+    std::uint64_t size = be32(data);
+    box.type = be32(data + 4);
+    box.offset = offset;
+    box.header = 8;
+    if (size == 1) {
+        if (avail < 16) return false;
+        size = be64(data + 8);
+        box.header = 16;
+    } else if (size == 0) {
+        size = avail;
+    }
+    if (size < box.header || size > avail) return false;
+    box.size = size;
+    return true;
+}
+
+// Children of a container box held in memory
+static std::vector<Box> children(const std::uint8_t* data, std::uint64_t begin, std::uint64_t end) {
+    std::vector<Box> out;
+    std::uint64_t pos = begin;
+    while (pos + 8 <= end) {
+        Box box;
+        if (!parse_box(data + pos, end - pos, pos, box)) break;
+        out.push_back(box);
+        pos += box.size;
+    }
+    return out;
+}
+
+// --- Output ----------------------------------------------------------------
+
+class Output {
+public:
+    Output(int fd, mvd_hash::Digests& digests)
+        : fd_(fd), buffer_(COPY_CHUNK), digests_(digests), kernelCopy_(!digests.active()) {}
+
+    std::uint64_t written() const { return written_; }
+    std::uint64_t zeroCopyBytes() const { return zeroCopy_; }
+
+    bool write(const std::uint8_t* data, std::size_t len) {
+        digests_.update(data, len);
+        while (len > 0) {
+            long long n = write_some(fd_, data, len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            len -= static_cast<std::size_t>(n);
+            written_ += static_cast<std::uint64_t>(n);
+        }
+        return true;
+    }
+
+    // Append len bytes of in starting at offset; stays in the kernel where the platform allows it
+    bool copy_from(int in, std::uint64_t offset, std::uint64_t len) {
+#if defined(__linux__) && defined(__NR_copy_file_range)
+        while (len > 0 && kernelCopy_) {
+            loff_t inOffset = static_cast<loff_t>(offset);
+            std::size_t want = len > (1ULL << 30) ? (1U << 30) : static_cast<std::size_t>(len);
+            long n = syscall(__NR_copy_file_range, in, &inOffset, fd_, NULL, want, 0u);
+            if (n > 0) {
+                offset += static_cast<std::uint64_t>(n);
+                len -= static_cast<std::uint64_t>(n);
+                written_ += static_cast<std::uint64_t>(n);
+                zeroCopy_ += static_cast<std::uint64_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n == 0 || errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP || errno == EBADF || errno == EPERM) {
+                // Unsupported here (or short source); the buffered path decides which
+                kernelCopy_ = false;
+                break;
+            }
+            return false;
+        }
+#endif
+        while (len > 0) {
+            std::size_t want = len > buffer_.size() ? buffer_.size() : static_cast<std::size_t>(len);
+            if (!read_exact(in, &buffer_[0], want, offset)) return false;
+            if (!write(&buffer_[0], want)) return false;
+            offset += want;
+            len -= want;
+        }
+        return true;
+    }
+
+private:
+    int fd_;
+    std::vector<std::uint8_t> buffer_;
+    mvd_hash::Digests& digests_;
+    std::uint64_t written_ = 0;
+    std::uint64_t zeroCopy_ = 0;
+    bool kernelCopy_;
+};
+
+// --- Assembly --------------------------------------------------------------
+
+struct Track {
+    std::uint32_t timescale = 0;
+    std::uint32_t trexDuration = 0;
+    bool haveNext = false;
+    std::uint64_t nextDecodeTime = 0;
+    std::int64_t shift = 0;
+    std::uint64_t fragments = 0;
+    std::uint64_t rebases = 0;
+};
+
+struct Report {
+    std::uint64_t segments = 0;
+    std::uint64_t fragments = 0;
+    std::uint64_t bytesIn = 0;
+    std::uint64_t droppedBoxes = 0;
+    std::uint64_t tfdtRebases = 0;
+    std::uint64_t tfdtOverflows = 0;
+    std::uint64_t missingTfdt = 0;
+    std::uint64_t baseOffsetFixes = 0;
+};
+
+class Assembler {
+public:
+    Assembler(Output& out, bool rebase) : out_(out), rebase_(rebase) {}
+
+    const Report& report() const { return report_; }
+    const std::map<std::uint32_t, Track>& tracks() const { return tracks_; }
+    bool initialized() const { return haveMoov_; }
+    std::string error() const { return error_; }
+
+    // Returns ERR_* on failure, SUCCESS otherwise
+    int add_file(const std::string& path) {
+        int fd = open_input(path);
+        if (fd < 0) return fail(ERR_INPUT, "cannot open " + path);
+        int rc = add_fd(fd);
+        close_file(fd);
+        return rc;
+    }
+
+private:
+    int fail(int code, const std::string& message) {
+        error_ = message;
+        return code;
+    }
+
+    int add_fd(int fd) {
+        std::uint64_t size = 0;
+        if (!file_size(fd, size)) return fail(ERR_INPUT, "cannot stat input");
+        report_.segments++;
+        report_.bytesIn += size;
+
+        std::uint64_t pos = 0;
+        std::uint8_t head[16];
+        while (pos + 8 <= size) {
+            std::uint64_t avail = size - pos;
+            std::size_t headLen = avail < sizeof(head) ? static_cast<std::size_t>(avail) : sizeof(head);
+            if (!read_exact(fd, head, headLen, pos)) return fail(ERR_INPUT, "short read");
+            Box box;
+            if (!parse_box(head, avail, pos, box)) return fail(ERR_FORMAT, "malformed box");
+
+            int rc = SUCCESS;
+            if (box.type == fourcc("ftyp") || box.type == fourcc("moov")) {
+                rc = init_box(fd, box);
+            } else if (box.type == fourcc("moof")) {
+                rc = moof_box(fd, box);
+            } else if (box.type == fourcc("mdat")) {
+                if (!haveMoov_) return fail(ERR_FORMAT, "media data before the init segment");
+                if (!out_.copy_from(fd, box.offset, box.size)) return fail(ERR_OUTPUT, "write failed");
+            } else if (box.type == fourcc("styp") || box.type == fourcc("sidx") || box.type == fourcc("ssix") ||
+                       box.type == fourcc("mfra") || box.type == fourcc("free") || box.type == fourcc("skip")) {
+                report_.droppedBoxes++;
+            } else if (!out_.copy_from(fd, box.offset, box.size)) {
+                rc = fail(ERR_OUTPUT, "write failed");
+            }
+            if (rc != SUCCESS) return rc;
+            pos += box.size;
+        }
+        return SUCCESS;
+    }
+
+    bool load(int fd, const Box& box, std::vector<std::uint8_t>& data) {
+        if (box.size > MAX_MOOF_SIZE) return false;
+        data.resize(static_cast<std::size_t>(box.size));
+        return read_exact(fd, &data[0], data.size(), box.offset);
+    }
+
+    int init_box(int fd, const Box& box) {
+        bool isMoov = box.type == fourcc("moov");
+        // Repeated init data in later segments is dropped; the first copy wins
+        if ((isMoov && haveMoov_) || (!isMoov && (haveFtyp_ || haveMoov_))) {
+            report_.droppedBoxes++;
+            return SUCCESS;
+        }
+        std::vector<std::uint8_t> data;
+        if (!load(fd, box, data)) return fail(ERR_INPUT, "cannot read init box");
+        if (isMoov) {
+            parse_moov(data, box.header);
+            haveMoov_ = true;
+        } else {
+            haveFtyp_ = true;
+        }
+        if (!out_.write(&data[0], data.size())) return fail(ERR_OUTPUT, "write failed");
+        return SUCCESS;
+    }
+
+    void parse_moov(const std::vector<std::uint8_t>& moov, std::uint64_t header) {
+        const std::uint8_t* d = &moov[0];
+        for (const Box& child : children(d, header, moov.size())) {
+            if (child.type == fourcc("trak")) {
+                std::uint32_t trackId = 0, timescale = 0;
+                for (const Box& t : children(d, child.offset + child.header, child.offset + child.size)) {
+                    if (t.type == fourcc("tkhd") && t.size >= t.header + 24) {
+                        const std::uint8_t* p = d + t.offset + t.header;
+                        trackId = be32(p + (p[0] == 1 ? 20 : 12));
+                    } else if (t.type == fourcc("mdia")) {
+                        for (const Box& m : children(d, t.offset + t.header, t.offset + t.size)) {
+                            if (m.type != fourcc("mdhd") || m.size < m.header + 24) continue;
+                            const std::uint8_t* p = d + m.offset + m.header;
+                            timescale = be32(p + (p[0] == 1 ? 20 : 12));
+                        }
+                    }
+                }
+                if (trackId) tracks_[trackId].timescale = timescale;
+            } else if (child.type == fourcc("mvex")) {
+                for (const Box& t : children(d, child.offset + child.header, child.offset + child.size)) {
+                    if (t.type != fourcc("trex") || t.size < t.header + 16) continue;
+                    const std::uint8_t* p = d + t.offset + t.header;
+                    tracks_[be32(p + 4)].trexDuration = be32(p + 12);
+                }
+            }
+        }
+    }
+
+    int moof_box(int fd, const Box& box) {
+        if (!haveMoov_) return fail(ERR_FORMAT, "fragment before the init segment");
+        std::vector<std::uint8_t> data;
+        if (!load(fd, box, data)) return fail(ERR_FORMAT, "oversized or unreadable moof");
+
+        std::uint8_t* d = &data[0];
+        // Absolute base offsets pointed into the source file; shift them to where this moof lands
+        std::int64_t relocation = static_cast<std::int64_t>(out_.written()) - static_cast<std::int64_t>(box.offset);
+
+        for (const Box& child : children(d, box.header, data.size())) {
+            if (child.type == fourcc("mfhd") && child.size >= child.header + 8) {
+                put32(d + child.offset + child.header + 4, ++sequence_);
+            } else if (child.type == fourcc("traf")) {
+                patch_traf(d, child, relocation);
+            }
+        }
+
+        report_.fragments++;
+        if (!out_.write(d, data.size())) return fail(ERR_OUTPUT, "write failed");
+        return SUCCESS;
+    }
+
+    void patch_traf(std::uint8_t* d, const Box& traf, std::int64_t relocation) {
+        std::uint32_t trackId = 0;
+        std::uint32_t defaultDuration = 0;
+        bool haveDefault = false;
+        std::uint8_t* tfdt = nullptr;
+        std::uint64_t duration = 0;
+
+        for (const Box& b : children(d, traf.offset + traf.header, traf.offset + traf.size)) {
+            std::uint8_t* p = d + b.offset + b.header;
+            std::uint64_t len = b.size - b.header;
+            if (b.type == fourcc("tfhd") && len >= 8) {
+                std::uint32_t flags = be32(p) & 0xFFFFFF;
+                trackId = be32(p + 4);
+                std::uint64_t at = 8;
+                if ((flags & 0x01) && len >= at + 8) {
+                    put64(p + at, static_cast<std::uint64_t>(static_cast<std::int64_t>(be64(p + at)) + relocation));
+                    if (relocation != 0) report_.baseOffsetFixes++;
+                    at += 8;
+                }
+                if (flags & 0x02) at += 4;
+                if ((flags & 0x08) && len >= at + 4) {
+                    defaultDuration = be32(p + at);
+                    haveDefault = true;
+                }
+            } else if (b.type == fourcc("tfdt") && len >= 8) {
+                tfdt = p;
+            } else if (b.type == fourcc("trun") && len >= 8) {
+                duration += trun_duration(p, len, haveDefault ? defaultDuration : tracks_[trackId].trexDuration);
+            }
+        }
+
+        Track& track = tracks_[trackId];
+        track.fragments++;
+        if (!tfdt) {
+            report_.missingTfdt++;
+            if (track.haveNext) track.nextDecodeTime += duration;
+            return;
+        }
+
+        bool wide = tfdt[0] == 1;
+        std::uint64_t original = wide ? be64(tfdt + 4) : be32(tfdt + 4);
+        std::int64_t decode = static_cast<std::int64_t>(original) + track.shift;
+
+        if (rebase_ && track.haveNext) {
+            std::uint64_t timescale = track.timescale ? track.timescale : DEFAULT_TIMESCALE;
+            std::int64_t gap = decode - static_cast<std::int64_t>(track.nextDecodeTime);
+            if (gap < 0 || gap > static_cast<std::int64_t>(TFDT_JUMP_LIMIT_SEC * timescale)) {
+                track.shift = static_cast<std::int64_t>(track.nextDecodeTime) - static_cast<std::int64_t>(original);
+                decode = static_cast<std::int64_t>(track.nextDecodeTime);
+                track.rebases++;
+                report_.tfdtRebases++;
+            }
+        }
+
+        if (decode < 0) decode = 0;
+        if (static_cast<std::uint64_t>(decode) != original) {
+            if (wide) {
+                put64(tfdt + 4, static_cast<std::uint64_t>(decode));
+            } else if (static_cast<std::uint64_t>(decode) <= 0xFFFFFFFFULL) {
+                put32(tfdt + 4, static_cast<std::uint32_t>(decode));
+            } else {
+                // A version 0 tfdt cannot grow in place; keep the source time
+                report_.tfdtOverflows++;
+                decode = static_cast<std::int64_t>(original);
+            }
+        }
+
+        track.haveNext = true;
+        track.nextDecodeTime = static_cast<std::uint64_t>(decode) + duration;
+    }
+
+    static std::uint64_t trun_duration(const std::uint8_t* p, std::uint64_t len, std::uint32_t defaultDuration) {
+        std::uint32_t flags = be32(p) & 0xFFFFFF;
+        std::uint32_t count = be32(p + 4);
+        if (!(flags & 0x100)) return static_cast<std::uint64_t>(count) * defaultDuration;
+
+        std::uint64_t at = 8;
+        if (flags & 0x01) at += 4;
+        if (flags & 0x04) at += 4;
+        std::uint64_t stride = 4;
+        if (flags & 0x200) stride += 4;
+        if (flags & 0x400) stride += 4;
+        if (flags & 0x800) stride += 4;
+
+        std::uint64_t total = 0;
+        for (std::uint32_t i = 0; i < count && at + 4 <= len; ++i, at += stride) total += be32(p + at);
+        return total;
+    }
+
+    Output& out_;
+    bool rebase_;
+    bool haveFtyp_ = false;
+    bool haveMoov_ = false;
+    std::uint32_t sequence_ = 0;
+    std::map<std::uint32_t, Track> tracks_;
+    Report report_;
+    std::string error_;
+};
+
+static void print_report(const Assembler& assembler, const Output& out) {
+    const Report& r = assembler.report();
+    std::cout << "REPORT={\"segments\":" << r.segments
+              << ",\"fragments\":" << r.fragments
+              << ",\"bytesIn\":" << r.bytesIn
+              << ",\"bytesOut\":" << out.written()
+              << ",\"zeroCopyBytes\":" << out.zeroCopyBytes()
+              << ",\"droppedBoxes\":" << r.droppedBoxes
+              << ",\"tfdtRebases\":" << r.tfdtRebases
+              << ",\"tfdtOverflows\":" << r.tfdtOverflows
+              << ",\"missingTfdt\":" << r.missingTfdt
+              << ",\"baseOffsetFixes\":" << r.baseOffsetFixes
+              << ",\"tracks\":[";
+    bool first = true;
+    for (const auto& kv : assembler.tracks()) {
+        std::cout << (first ? "" : ",") << "{\"trackId\":" << kv.first << ",\"timescale\":" << kv.second.timescale
+                  << ",\"fragments\":" << kv.second.fragments << ",\"rebases\":" << kv.second.rebases << "}";
+        first = false;
+    }
+    std::cout << "]}" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    mvd_trace::HelperSpan traceSpan("mvd-fmp4");
+
+    std::string outputPath;
+    bool stdinList = false;
+    bool rebase = true;
+    mvd_hash::Digests digests;
+    bool hashOk = true;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "--stdin-list") {
+            stdinList = true;
+        } else if (arg == "--no-rebase") {
+            rebase = false;
+        } else if (arg == "--hash" && i + 1 < argc) {
+            hashOk = digests.configure(argv[++i]);
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (outputPath.empty() || (!stdinList && inputs.empty()) || !hashOk) {
+        std::cerr << "Usage: " << argv[0] << " --output <out.mp4> [--no-rebase] [--hash xxh3,sha256] (--stdin-list | <init> <segment>...)" << std::endl;
+        return ERR_ARGS;
+    }
+
+    int fd = open_output(outputPath);
+    if (fd < 0) {
+        std::perror("Error opening output");
+        return ERR_OUTPUT;
+    }
+
+    Output out(fd, digests);
+    Assembler assembler(out, rebase);
+    std::size_t index = 0;
+    int rc = SUCCESS;
+
+    auto handle = [&](const std::string& path) -> bool {
+        rc = assembler.add_file(path);
+        if (rc != SUCCESS) {
+            std::cerr << "Error in input " << index << " (" << path << "): " << assembler.error() << std::endl;
+            return false;
+        }
+        std::cout << "SEGMENT=" << index++ << " BYTES=" << out.written() << std::endl;
+        return true;
+    };
+
+    if (stdinList) {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            if (!handle(line)) break;
+        }
+    } else {
+        for (const std::string& path : inputs) {
+            if (!handle(path)) break;
+        }
+    }
+
+    if (close_file(fd) != 0 && rc == SUCCESS) rc = ERR_OUTPUT;
+
+    print_report(assembler, out);
+    if (rc == SUCCESS && (!assembler.initialized() || assembler.report().fragments == 0)) rc = ERR_FORMAT;
+    if (rc == SUCCESS) digests.print(std::cout);
+    return rc;
+}
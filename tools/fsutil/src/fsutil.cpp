@@ -0,0 +1,588 @@
+// Filesystem batch helper: answers many path queries in one process so the host does not
+// pay a native-messaging round trip, or block its event loop, per path.
+//
+// Commands:
+//   stat    Paths arrive on stdin, NUL-separated (UTF-8). Each is looked up on a small
+//           thread pool: statx with AT_STATX_DONT_SYNC on Linux (network mounts answer from
+//           cached attributes), stat elsewhere, GetFileAttributesExW on Windows.
+//           Raw syscalls and a local ABI struct keep the linux-x64 build on glibc 2.17.
+//   probe   Whether a directory is writable and which write strategies its filesystem
+//           supports, without leaving anything visible behind: faccessat(AT_EACCESS) for
+//           the permission check, then an O_TMPFILE scratch inode (Linux) or a hidden name
+//           unlinked right after creation to try fallocate, a sparse write and FICLONE.
+//           Windows opens the directory for FILE_ADD_FILE and reads the volume flags; it
+//           creates no scratch file at all. The directory arrives on stdin like stat's
+//           paths, so non-ASCII names survive the Windows ANSI argv.
+//
+// Usage:
+//   mvd-fsutil stat [--threads N] < paths
+//   mvd-fsutil probe < directory
+//
+// Stdout, stat (one line per input path, in input order):
+//   <index>\t1\t<size>\t<mtime ms>\t<f|d|o>   exists (file, directory, other)
+//   <index>\t0                                  does not exist
+//   <index>\tE\t<error name>                    lookup failed (EACCES, ELOOP, ...)
+//
+// Stdout, probe:
+//   WRITABLE=<0|1>        new files can be created in the directory
+//   ERROR=<error name>    why not (ENOENT, ENOTDIR, EACCES, EROFS, ...)
+//   FSTYPE=<name>         filesystem (ext4, btrfs, apfs, NTFS, vfat, ...)
+//   TMPFILE=<0|1>         unnamed scratch files work (O_TMPFILE)
+//   FALLOCATE=<0|1>       space can be reserved up front without writing zeros
+//   SPARSE=<0|1>          holes take no space
+//   REFLINK=<0|1>         files can be cloned (copy-on-write)
+//   ATOMIC_RENAME=<0|1>   rename over an existing file replaces it atomically
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#endif
+
+#ifdef __APPLE__
+#include <sys/mount.h>
+#include <sys/param.h>
+#endif
+
+#include "../../common/mvd_trace.h"
+
+enum ExitCode {
+    SUCCESS = 0,
+    ERR_ARGS = 2,
+    ERR_INPUT = 3
+};
+
+static const unsigned DEFAULT_THREADS = 16;
+static const std::size_t PATHS_PER_THREAD = 32; // below this, extra threads cost more than they save
+
+struct StatResult {
+    int state = 0; // 1 exists, 0 missing, -1 error
+    std::uint64_t size = 0;
+    std::int64_t mtimeMs = 0;
+    char type = 'o';
+    const char* error = "";
+};
+
+// --- Linux statx ------------------------------------------------------------
+
+#ifdef __linux__
+#ifndef __NR_statx
+#if defined(__x86_64__)
+#define __NR_statx 332
+#elif defined(__aarch64__)
+#define __NR_statx 291
+#endif
+#endif
+
+namespace kstatx {
+
+struct Timestamp {
+    std::int64_t tv_sec;
+    std::uint32_t tv_nsec;
+    std::int32_t reserved;
+};
+
+struct Statx {
+    std::uint32_t stx_mask;
+    std::uint32_t stx_blksize;
+    std::uint64_t stx_attributes;
+    std::uint32_t stx_nlink;
+    std::uint32_t stx_uid;
+    std::uint32_t stx_gid;
+    std::uint16_t stx_mode;
+    std::uint16_t spare0;
+    std::uint64_t stx_ino;
+    std::uint64_t stx_size;
+    std::uint64_t stx_blocks;
+    std::uint64_t stx_attributes_mask;
+    Timestamp stx_atime;
+    Timestamp stx_btime;
+    Timestamp stx_ctime;
+    Timestamp stx_mtime;
+    std::uint32_t stx_rdev_major;
+    std::uint32_t stx_rdev_minor;
+    std::uint32_t stx_dev_major;
+    std::uint32_t stx_dev_minor;
+    std::uint64_t spare2[14];
+};
+
+enum {
+    MASK_TYPE = 0x0001,
+    MASK_MTIME = 0x0040,
+    MASK_SIZE = 0x0200,
+    DONT_SYNC = 0x4000
+};
+
+} // namespace kstatx
+
+static std::atomic<bool> g_statxMissing(false);
+
+// Returns false when the kernel has no statx (pre-4.11); the caller falls back to stat
+static bool lookup_statx(const std::string& path, StatResult& out, int& err) {
+#ifdef __NR_statx
+    if (g_statxMissing) return false;
+    kstatx::Statx stx;
+    std::memset(&stx, 0, sizeof(stx));
+    long rc = syscall(__NR_statx, AT_FDCWD, path.c_str(), kstatx::DONT_SYNC,
+                      kstatx::MASK_TYPE | kstatx::MASK_SIZE | kstatx::MASK_MTIME, &stx);
+    if (rc != 0) {
+        if (errno == ENOSYS) {
+            g_statxMissing = true;
+            return false;
+        }
+        err = errno;
+        out.state = -1;
+        return true;
+    }
+    out.state = 1;
+    out.size = stx.stx_size;
+    out.mtimeMs = stx.stx_mtime.tv_sec * 1000 + stx.stx_mtime.tv_nsec / 1000000;
+    out.type = S_ISREG(stx.stx_mode) ? 'f' : S_ISDIR(stx.stx_mode) ? 'd' : 'o';
+    err = 0;
+    return true;
+#else
+    (void)path; (void)out; (void)err;
+    return false;
+#endif
+}
+#endif
+
+// --- Lookup -----------------------------------------------------------------
+
+static const char* error_name(int err) {
+    switch (err) {
+        case EACCES: return "EACCES";
+        case EPERM: return "EPERM";
+        case ELOOP: return "ELOOP";
+        case ENAMETOOLONG: return "ENAMETOOLONG";
+        case EIO: return "EIO";
+        case EINVAL: return "EINVAL";
+        case ENOENT: return "ENOENT";
+        case ENOTDIR: return "ENOTDIR";
+        case EROFS: return "EROFS";
+        case ENOSPC: return "ENOSPC";
+#ifdef EDQUOT
+        case EDQUOT: return "EDQUOT";
+#endif
+        default: return "EIO";
+    }
+}
+
+#ifdef _WIN32
+static std::wstring widen(const std::string& text) {
+    int len = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), NULL, 0);
+    std::wstring out(static_cast<std::size_t>(len), L'\0');
+    if (len > 0) MultiByteToWideChar(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), &out[0], len);
+    return out;
+}
+
+static void lookup(const std::string& path, StatResult& out) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(widen(path).c_str(), GetFileExInfoStandard, &data)) {
+        DWORD code = GetLastError();
+        if (code == ERROR_FILE_NOT_FOUND || code == ERROR_PATH_NOT_FOUND || code == ERROR_INVALID_NAME) {
+            out.state = 0;
+        } else {
+            out.state = -1;
+            out.error = code == ERROR_ACCESS_DENIED ? "EACCES" : code == ERROR_FILENAME_EXCED_RANGE ? "ENAMETOOLONG" : "EIO";
+        }
+        return;
+    }
+    // FILETIME counts 100 ns intervals since 1601
+    const std::uint64_t ticks = (static_cast<std::uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+    out.state = 1;
+    out.size = (static_cast<std::uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    out.mtimeMs = static_cast<std::int64_t>((ticks - 116444736000000000ULL) / 10000);
+    out.type = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? 'd' : 'f';
+}
+#else
+static void lookup(const std::string& path, StatResult& out) {
+    int err = 0;
+#ifdef __linux__
+    if (!lookup_statx(path, out, err))
+#endif
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            out.state = 1;
+            out.size = static_cast<std::uint64_t>(st.st_size);
+#ifdef __APPLE__
+            out.mtimeMs = static_cast<std::int64_t>(st.st_mtimespec.tv_sec) * 1000 + st.st_mtimespec.tv_nsec / 1000000;
+#else
+            out.mtimeMs = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+#endif
+            out.type = S_ISREG(st.st_mode) ? 'f' : S_ISDIR(st.st_mode) ? 'd' : 'o';
+            return;
+        }
+        err = errno;
+        out.state = -1;
+    }
+    if (out.state == -1) {
+        if (err == ENOENT || err == ENOTDIR) out.state = 0;
+        else out.error = error_name(err);
+    }
+}
+#endif
+
+// --- stat command -----------------------------------------------------------
+
+static bool read_paths(std::vector<std::string>& paths) {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    std::string input;
+    char buf[65536];
+    std::size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), stdin)) > 0) input.append(buf, n);
+    if (std::ferror(stdin)) return false;
+
+    std::size_t start = 0;
+    while (start < input.size()) {
+        std::size_t end = input.find('\0', start);
+        if (end == std::string::npos) end = input.size();
+        paths.push_back(input.substr(start, end - start));
+        start = end + 1;
+    }
+    return true;
+}
+
+static int run_stat(unsigned maxThreads) {
+    std::vector<std::string> paths;
+    if (!read_paths(paths)) {
+        std::perror("Error reading paths");
+        return ERR_INPUT;
+    }
+
+    std::vector<StatResult> results(paths.size());
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]() {
+        for (std::size_t i = next++; i < paths.size(); i = next++) {
+            if (paths[i].empty()) continue; // reported as missing
+            lookup(paths[i], results[i]);
+        }
+    };
+
+    const std::size_t wanted = paths.size() / PATHS_PER_THREAD + 1;
+    const unsigned threads = static_cast<unsigned>(std::min<std::size_t>(maxThreads, wanted));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.push_back(std::thread(worker));
+    worker();
+    for (std::thread& thread : pool) thread.join();
+
+    std::string out;
+    out.reserve(paths.size() * 40);
+    char line[96];
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const StatResult& r = results[i];
+        if (r.state == 1) {
+            std::snprintf(line, sizeof(line), "%zu\t1\t%llu\t%lld\t%c\n", i,
+                          static_cast<unsigned long long>(r.size), static_cast<long long>(r.mtimeMs), r.type);
+        } else if (r.state == 0) {
+            std::snprintf(line, sizeof(line), "%zu\t0\n", i);
+        } else {
+            std::snprintf(line, sizeof(line), "%zu\tE\t%s\n", i, r.error);
+        }
+        out += line;
+    }
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    std::fflush(stdout);
+    return SUCCESS;
+}
+
+// --- probe command ----------------------------------------------------------
+
+struct ProbeResult {
+    bool writable = false;
+    const char* error = "";
+    std::string fsType = "unknown";
+    bool tmpfile = false;
+    bool fallocate = false;
+    bool sparse = false;
+    bool reflink = false;
+    bool atomicRename = false;
+};
+
+#ifdef _WIN32
+#ifndef FILE_SUPPORTS_POSIX_UNLINK_RENAME
+#define FILE_SUPPORTS_POSIX_UNLINK_RENAME 0x00000400
+#endif
+#ifndef FILE_SUPPORTS_BLOCK_REFCOUNTING
+#define FILE_SUPPORTS_BLOCK_REFCOUNTING 0x08000000
+#endif
+
+static std::string narrow(const wchar_t* text) {
+    int len = WideCharToMultiByte(CP_UTF8, 0, text, -1, NULL, 0, NULL, NULL);
+    std::string out(len > 0 ? static_cast<std::size_t>(len - 1) : 0, '\0');
+    if (len > 1) WideCharToMultiByte(CP_UTF8, 0, text, -1, &out[0], len, NULL, NULL);
+    return out;
+}
+
+// FILE_ADD_FILE on the directory handle is exactly the right checked against the ACL when
+// a file is created in it; the volume flags answer the rest without a scratch file
+static void probe_directory(const std::string& dir, ProbeResult& out) {
+    HANDLE handle = CreateFileW(widen(dir).c_str(), FILE_ADD_FILE | FILE_READ_ATTRIBUTES,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        DWORD code = GetLastError();
+        out.error = (code == ERROR_FILE_NOT_FOUND || code == ERROR_PATH_NOT_FOUND || code == ERROR_INVALID_NAME) ? "ENOENT"
+                  : code == ERROR_ACCESS_DENIED ? "EACCES"
+                  : code == ERROR_WRITE_PROTECT ? "EROFS" : "EIO";
+        return;
+    }
+
+    BY_HANDLE_FILE_INFORMATION info;
+    if (GetFileInformationByHandle(handle, &info) && !(info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        out.error = "ENOTDIR";
+        CloseHandle(handle);
+        return;
+    }
+
+    DWORD flags = 0;
+    wchar_t fsName[MAX_PATH + 1] = L"";
+    if (GetVolumeInformationByHandleW(handle, NULL, 0, NULL, NULL, &flags, fsName, MAX_PATH + 1)) {
+        out.fsType = narrow(fsName);
+        const bool ntfsLike = out.fsType == "NTFS" || out.fsType == "ReFS";
+        out.writable = !(flags & FILE_READ_ONLY_VOLUME);
+        if (!out.writable) out.error = "EROFS";
+        out.sparse = (flags & FILE_SUPPORTS_SPARSE_FILES) != 0;
+        out.reflink = (flags & FILE_SUPPORTS_BLOCK_REFCOUNTING) != 0;
+        // SetFileInformationByHandle(FileAllocationInfo) reserves clusters without zeroing on these
+        out.fallocate = ntfsLike;
+        out.atomicRename = ntfsLike || (flags & FILE_SUPPORTS_POSIX_UNLINK_RENAME) != 0;
+    } else {
+        out.writable = true;
+    }
+    CloseHandle(handle);
+}
+#else
+#ifdef __linux__
+#ifndef O_TMPFILE
+#define O_TMPFILE (020000000 | O_DIRECTORY)
+#endif
+#ifndef FICLONE
+#define FICLONE 0x40049409 // _IOW(0x94, 9, int)
+#endif
+
+struct FsMagic {
+    unsigned long magic;
+    const char* name;
+    bool atomicRename;
+};
+
+// Filesystems whose rename is emulated (FUSE drivers, FAT) or goes over the wire without a
+// replace-in-one-step guarantee report ATOMIC_RENAME=0
+static const FsMagic FS_MAGICS[] = {
+    { 0xEF53, "ext4", true },
+    { 0x58465342, "xfs", true },
+    { 0x9123683E, "btrfs", true },
+    { 0x2FC12FC1, "zfs", true },
+    { 0xF2F52010, "f2fs", true },
+    { 0x01021994, "tmpfs", true },
+    { 0x794C7630, "overlay", true },
+    { 0x6969, "nfs", true },
+    { 0x4D44, "vfat", false },
+    { 0x2011BAB0, "exfat", false },
+    { 0x7366746E, "ntfs3", false },
+    { 0x5346544E, "ntfs", false },
+    { 0x65735546, "fuse", false },
+    { 0xFF534D42, "cifs", false },
+    { 0xFE534D42, "smb2", false },
+    { 0x01161970, "gfs2", true }
+};
+#endif
+
+static void describe_filesystem(const std::string& dir, ProbeResult& out) {
+#ifdef __linux__
+    struct statfs sfs;
+    out.atomicRename = true;
+    if (statfs(dir.c_str(), &sfs) != 0) return;
+    const unsigned long magic = static_cast<unsigned long>(sfs.f_type) & 0xFFFFFFFFUL;
+    for (const FsMagic& entry : FS_MAGICS) {
+        if (entry.magic == magic) {
+            out.fsType = entry.name;
+            out.atomicRename = entry.atomicRename;
+            return;
+        }
+    }
+    char hex[16];
+    std::snprintf(hex, sizeof(hex), "0x%lx", magic);
+    out.fsType = hex;
+#elif defined(__APPLE__)
+    struct statfs sfs;
+    out.atomicRename = true;
+    if (statfs(dir.c_str(), &sfs) != 0) return;
+    out.fsType = sfs.f_fstypename;
+    out.atomicRename = out.fsType != "msdos" && out.fsType != "exfat" && out.fsType != "smbfs" &&
+                       out.fsType != "webdav" && out.fsType.compare(0, 5, "macfu") != 0;
+    out.reflink = out.fsType == "apfs"; // clonefile(2) is APFS-only
+#else
+    (void)dir;
+    out.atomicRename = true;
+#endif
+}
+
+static bool no_holes(const ProbeResult& fs) {
+    return fs.fsType == "vfat" || fs.fsType == "exfat" || fs.fsType == "msdos" || fs.fsType == "hfs";
+}
+
+// Unnamed where the kernel allows it; otherwise a hidden name that is gone again before the
+// first byte is written, so sync clients and scanners see at most a create/delete pair
+static int open_scratch(const std::string& dir, bool& unnamed, int& err) {
+    static unsigned counter = 0;
+#ifdef __linux__
+    int fd = open(dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd >= 0) {
+        unnamed = true;
+        return fd;
+    }
+    // EISDIR/EOPNOTSUPP/EINVAL: kernel or filesystem without O_TMPFILE
+    if (errno == EACCES || errno == EPERM || errno == EROFS || errno == ENOSPC || errno == EDQUOT) {
+        err = errno;
+        return -1;
+    }
+#endif
+    unnamed = false;
+    char name[64];
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        std::snprintf(name, sizeof(name), "/.mvd-probe-%ld-%u", static_cast<long>(getpid()), counter++);
+        const std::string scratch = dir + name;
+        int fd = open(scratch.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+        if (fd >= 0) {
+            unlink(scratch.c_str());
+            return fd;
+        }
+        if (errno != EEXIST) break;
+    }
+    err = errno;
+    return -1;
+}
+
+static bool try_fallocate(int fd, off_t len) {
+#ifdef __linux__
+    return ::fallocate(fd, 0, 0, len) == 0;
+#elif defined(__APPLE__)
+    fstore_t store;
+    std::memset(&store, 0, sizeof(store));
+    store.fst_flags = F_ALLOCATEALL;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_length = len;
+    return fcntl(fd, F_PREALLOCATE, &store) != -1;
+#else
+    (void)fd; (void)len;
+    return false; // posix_fallocate may fall back to writing zeros, which is what we want to avoid
+#endif
+}
+
+static void probe_directory(const std::string& dir, ProbeResult& out) {
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0) {
+        out.error = error_name(errno);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        out.error = "ENOTDIR";
+        return;
+    }
+    describe_filesystem(dir, out);
+    // Effective IDs, as the kernel checks them on create; read-only mounts answer EROFS
+    if (faccessat(AT_FDCWD, dir.c_str(), W_OK | X_OK, AT_EACCESS) != 0) {
+        out.error = error_name(errno);
+        return;
+    }
+
+    int err = 0;
+    int fd = open_scratch(dir, out.tmpfile, err);
+    if (fd < 0) {
+        out.error = error_name(err);
+        return;
+    }
+    out.writable = true;
+
+    const off_t block = 64 * 1024;
+    out.fallocate = try_fallocate(fd, block);
+
+    // One byte far past the allocation: a sparse file stays well under the hole it skipped.
+    // Filesystems known to zero-fill holes are not made to write 8 MB just to prove it.
+    const off_t holeEnd = 8 * 1024 * 1024;
+    if (!no_holes(out) && pwrite(fd, "", 1, holeEnd) == 1 && fstat(fd, &st) == 0) {
+        out.sparse = static_cast<off_t>(st.st_blocks) * 512 < holeEnd / 2;
+    }
+
+#ifdef __linux__
+    bool cloneUnnamed = false;
+    int clone = open_scratch(dir, cloneUnnamed, err);
+    if (clone >= 0) {
+        out.reflink = ioctl(clone, FICLONE, fd) == 0;
+        close(clone);
+    }
+#endif
+    close(fd);
+}
+#endif
+
+static int run_probe() {
+    std::vector<std::string> paths;
+    if (!read_paths(paths) || paths.empty() || paths[0].empty()) {
+        std::cerr << "Expected a directory on stdin" << std::endl;
+        return ERR_INPUT;
+    }
+
+    ProbeResult result;
+    probe_directory(paths[0], result);
+    std::printf("WRITABLE=%d\n", result.writable ? 1 : 0);
+    if (*result.error) std::printf("ERROR=%s\n", result.error);
+    std::printf("FSTYPE=%s\nTMPFILE=%d\nFALLOCATE=%d\nSPARSE=%d\nREFLINK=%d\nATOMIC_RENAME=%d\n",
+                result.fsType.c_str(), result.tmpfile ? 1 : 0, result.fallocate ? 1 : 0,
+                result.sparse ? 1 : 0, result.reflink ? 1 : 0, result.atomicRename ? 1 : 0);
+    std::fflush(stdout);
+    return SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    mvd_trace::HelperSpan traceSpan("mvd-fsutil");
+
+    std::string command = argc > 1 ? argv[1] : "";
+    if (command == "probe" && argc == 2) return run_probe();
+
+    unsigned threads = DEFAULT_THREADS;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            command.clear();
+            break;
+        }
+    }
+
+    if (command != "stat" || threads == 0 || threads > 64) {
+        std::cerr << "Usage: " << argv[0] << " stat [--threads 1-64] < NUL-separated paths\n"
+                  << "       " << argv[0] << " probe < directory" << std::endl;
+        return ERR_ARGS;
+    }
+    return run_stat(threads);
+}
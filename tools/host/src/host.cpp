@@ -0,0 +1,867 @@
+// Native-messaging front end. The browser manifest points here instead of at the pkg-bundled
+// Node engine (mvdcoapp), so a (re)connect is answered in about a millisecond instead of after
+// a full Node boot. Browsers reconnect every time the engine idles out, which is often.
+//
+// Served without Node:
+//   handshake                    validateConnection, from the engine's last boot (see below)
+//   get-disk-space               same volume lookup as the engine (root on Windows,
+//                                nearest existing folder on POSIX)
+//   fileSystem exists / mkdir    success paths only; failures are left to the engine's errors
+//   kill-processing, quit        nothing runs before the engine exists
+// Every other command hands the connection to the engine. On POSIX the front end exec()s it,
+// so it keeps the pid and the browser's pipes. On Windows it starts the engine with the
+// inherited std handles and waits for it. Bytes already read from stdin (the triggering
+// message and anything after it) go to the engine through a spill file named by
+// MVD_HANDOFF_INPUT. MVD_HANDOFF_HANDSHAKE tells it the handshake was already sent.
+//
+// The handshake comes from <TEMP_DIR>/frontend-handshake.txt, written by the engine on every
+// messaging boot (src/core/frontend.js):
+//   location=<engine path>   allowed=<extension id>...   binary=<helper path>...
+//   info=<validateConnection JSON without pid, lastValidation and logFileSize>
+// When that file is missing or older than the engine, names another engine, the caller is
+// not an allowed extension, or a bundled binary is missing, the front end execs the engine
+// straight away. The engine then does everything itself, as before.
+//
+// Usage (from the browser manifest):
+//   mvd-host <extension origin> [parent window]
+// Anything else (installer CLI, double-click) is passed to the engine unchanged.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+#endif
+
+// Error codes
+enum ExitCode {
+    SUCCESS = 0,
+    ERR_STARTUP = 1,
+    ERR_ENGINE = 3
+};
+
+static const int IDLE_TIMEOUT_MS = 30000;    // src/utils/config.js IDLE_TIMEOUT
+static const std::uint32_t MAX_MESSAGE = 64u * 1024u * 1024u;
+static const std::size_t WINDOWS_LONG_PATH = 240; // normalizeForFsWindows threshold
+
+#ifdef _WIN32
+static const char SEP = '\\';
+static const char* ENGINE_NAME = "mvdcoapp.exe";
+#else
+static const char SEP = '/';
+static const char* ENGINE_NAME = "mvdcoapp";
+#endif
+
+// ---------------------------------------------------------------------------------------------
+// Platform helpers
+// ---------------------------------------------------------------------------------------------
+
+#ifdef _WIN32
+static std::wstring widen(const std::string& s) {
+    if (s.empty()) return std::wstring();
+    int len = MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), NULL, 0);
+    std::wstring out(len, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), &out[0], len);
+    return out;
+}
+
+static std::string narrow(const std::wstring& s) {
+    if (s.empty()) return std::string();
+    int len = WideCharToMultiByte(CP_UTF8, 0, s.data(), (int)s.size(), NULL, 0, NULL, NULL);
+    std::string out(len, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, s.data(), (int)s.size(), &out[0], len, NULL, NULL);
+    return out;
+}
+
+static std::string get_env(const char* name) {
+    const wchar_t* value = _wgetenv(widen(name).c_str());
+    return value ? narrow(value) : std::string();
+}
+#else
+static std::string get_env(const char* name) {
+    const char* value = std::getenv(name);
+    return value ? std::string(value) : std::string();
+}
+#endif
+
+static std::string dirname_of(const std::string& path) {
+    std::size_t pos = path.find_last_of("/\\");
+    return pos == std::string::npos ? std::string(".") : path.substr(0, pos);
+}
+
+static std::string join_path(const std::string& dir, const std::string& name) {
+    return dir + SEP + name;
+}
+
+static std::string real_path(const std::string& path) {
+#ifdef _WIN32
+    wchar_t buffer[MAX_PATH * 4];
+    DWORD len = GetFullPathNameW(widen(path).c_str(), MAX_PATH * 4, buffer, NULL);
+    return len > 0 && len < MAX_PATH * 4 ? narrow(std::wstring(buffer, len)) : path;
+#else
+    char* resolved = realpath(path.c_str(), NULL);
+    if (!resolved) return path;
+    std::string out(resolved);
+    free(resolved);
+    return out;
+#endif
+}
+
+static std::string executable_path() {
+#ifdef _WIN32
+    wchar_t buffer[MAX_PATH * 4];
+    DWORD len = GetModuleFileNameW(NULL, buffer, MAX_PATH * 4);
+    return narrow(std::wstring(buffer, len));
+#elif defined(__APPLE__)
+    char buffer[4096];
+    std::uint32_t size = sizeof(buffer);
+    if (_NSGetExecutablePath(buffer, &size) != 0) return std::string();
+    return real_path(buffer);
+#else
+    return real_path("/proc/self/exe");
+#endif
+}
+
+// Modification time in ms, or -1 when the file does not exist
+static std::int64_t file_mtime_ms(const std::string& path, std::int64_t* size = NULL) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(widen(path).c_str(), GetFileExInfoStandard, &data)) return -1;
+    if (size) *size = ((std::int64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    std::int64_t ticks = ((std::int64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    return ticks / 10000 - 11644473600000LL;
+#else
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return -1;
+    if (size) *size = (std::int64_t)st.st_size;
+#ifdef __APPLE__
+    return (std::int64_t)st.st_mtimespec.tv_sec * 1000 + st.st_mtimespec.tv_nsec / 1000000;
+#else
+    return (std::int64_t)st.st_mtim.tv_sec * 1000 + st.st_mtim.tv_nsec / 1000000;
+#endif
+#endif
+}
+
+static std::int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static std::string home_dir() {
+#ifdef _WIN32
+    return get_env("USERPROFILE");
+#else
+    std::string home = get_env("HOME");
+    if (home.empty()) {
+        struct passwd* pw = getpwuid(getuid());
+        if (pw && pw->pw_dir) home = pw->pw_dir;
+    }
+    return home;
+#endif
+}
+
+// os.tmpdir()
+static std::string os_tmpdir() {
+#ifdef _WIN32
+    std::string dir = get_env("TEMP");
+    if (dir.empty()) dir = get_env("TMP");
+    if (dir.empty()) {
+        std::string root = get_env("SystemRoot");
+        if (root.empty()) root = get_env("windir");
+        dir = root + "\\temp";
+    }
+    if (dir.size() > 1 && dir[dir.size() - 1] == '\\' && dir[dir.size() - 2] != ':') dir.erase(dir.size() - 1);
+#else
+    std::string dir = get_env("TMPDIR");
+    if (dir.empty()) dir = get_env("TMP");
+    if (dir.empty()) dir = get_env("TEMP");
+    if (dir.empty()) dir = "/tmp";
+    if (dir.size() > 1 && dir[dir.size() - 1] == '/') dir.erase(dir.size() - 1);
+#endif
+    return dir;
+}
+
+// TEMP_DIR from src/utils/config.js
+static std::string temp_dir() {
+    std::string tmp = os_tmpdir();
+    bool snap = !get_env("SNAP").empty() || !get_env("SNAP_REVISION").empty() || tmp.find("snap") != std::string::npos;
+    std::string base = get_env("XDG_CACHE_HOME");
+    if (base.empty()) base = join_path(home_dir(), ".cache");
+    return real_path(join_path(snap ? base : tmp, "mvdcoapp"));
+}
+
+static bool read_file(const std::string& path, std::string& out) {
+#ifdef _WIN32
+    FILE* f = _wfopen(widen(path).c_str(), L"rb");
+#else
+    FILE* f = std::fopen(path.c_str(), "rb");
+#endif
+    if (!f) return false;
+    char buffer[16384];
+    std::size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), f)) > 0) out.append(buffer, n);
+    std::fclose(f);
+    return true;
+}
+
+static bool write_file(const std::string& path, const std::string& data) {
+#ifdef _WIN32
+    FILE* f = _wfopen(widen(path).c_str(), L"wb");
+#else
+    FILE* f = std::fopen(path.c_str(), "wb");
+#endif
+    if (!f) return false;
+    bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+    return std::fclose(f) == 0 && ok;
+}
+
+static std::string g_log_file;
+
+// Same line format as logDebug in src/utils/utils.js
+static void log_line(const std::string& message) {
+    if (g_log_file.empty()) return;
+    std::int64_t ms = now_ms();
+    std::time_t seconds = (std::time_t)(ms / 1000);
+    std::tm tm_utc;
+#ifdef _WIN32
+    gmtime_s(&tm_utc, &seconds);
+    FILE* f = _wfopen(widen(g_log_file).c_str(), L"ab");
+#else
+    gmtime_r(&seconds, &tm_utc);
+    FILE* f = std::fopen(g_log_file.c_str(), "ab");
+#endif
+    if (!f) return;
+    char stamp[80];
+    std::snprintf(stamp, sizeof(stamp), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                  tm_utc.tm_year + 1900, tm_utc.tm_mon + 1, tm_utc.tm_mday,
+                  tm_utc.tm_hour, tm_utc.tm_min, tm_utc.tm_sec, (int)(ms % 1000));
+    std::fprintf(f, "%s - [FrontEnd] %s\n", stamp, message.c_str());
+    std::fclose(f);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Minimal JSON reader for requests (replies are assembled as text)
+// ---------------------------------------------------------------------------------------------
+
+struct Json {
+    enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT } type;
+    bool boolean;
+    std::string text; // STRING: decoded value
+    std::string raw;  // source text of the value, for echoing ids
+    std::vector<std::pair<std::string, Json> > members;
+    std::vector<Json> items;
+
+    Json() : type(NUL), boolean(false) {}
+
+    const Json* get(const char* key) const {
+        for (std::size_t i = 0; i < members.size(); ++i) {
+            if (members[i].first == key) return &members[i].second;
+        }
+        return NULL;
+    }
+
+    std::string string_or(const char* key, const std::string& fallback) const {
+        const Json* value = get(key);
+        return value && value->type == STRING ? value->text : fallback;
+    }
+};
+
+class JsonParser {
+public:
+    JsonParser(const char* data, std::size_t size) : p_(data), end_(data + size), depth_(0) {}
+
+    bool parse(Json& out) {
+        if (!value(out)) return false;
+        skip_ws();
+        return p_ == end_;
+    }
+
+private:
+    const char* p_;
+    const char* end_;
+    int depth_;
+
+    void skip_ws() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) ++p_;
+    }
+
+    bool literal(const char* word) {
+        std::size_t n = std::strlen(word);
+        if ((std::size_t)(end_ - p_) < n || std::memcmp(p_, word, n) != 0) return false;
+        p_ += n;
+        return true;
+    }
+
+    static void append_utf8(std::string& out, std::uint32_t cp) {
+        if (cp < 0x80) {
+            out += (char)cp;
+        } else if (cp < 0x800) {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool hex4(std::uint32_t& out) {
+        if (end_ - p_ < 4) return false;
+        out = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = *p_++;
+            out <<= 4;
+            if (c >= '0' && c <= '9') out |= (std::uint32_t)(c - '0');
+            else if (c >= 'a' && c <= 'f') out |= (std::uint32_t)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') out |= (std::uint32_t)(c - 'A' + 10);
+            else return false;
+        }
+        return true;
+    }
+
+    bool string(std::string& out) {
+        ++p_; // opening quote
+        while (p_ < end_) {
+            char c = *p_++;
+            if (c == '"') return true;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (p_ >= end_) return false;
+            char e = *p_++;
+            switch (e) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    std::uint32_t cp;
+                    if (!hex4(cp)) return false;
+                    if (cp >= 0xD800 && cp < 0xDC00 && end_ - p_ >= 6 && p_[0] == '\\' && p_[1] == 'u') {
+                        p_ += 2;
+                        std::uint32_t low;
+                        if (!hex4(low)) return false;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    append_utf8(out, cp);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return false;
+    }
+
+    bool value(Json& out) {
+        skip_ws();
+        if (p_ >= end_ || ++depth_ > 64) return false;
+        const char* start = p_;
+        bool ok = true;
+        char c = *p_;
+        if (c == '{') {
+            out.type = Json::OBJECT;
+            ++p_;
+            skip_ws();
+            if (p_ < end_ && *p_ == '}') {
+                ++p_;
+            } else {
+                for (;;) {
+                    skip_ws();
+                    std::string key;
+                    if (p_ >= end_ || *p_ != '"' || !string(key)) { ok = false; break; }
+                    skip_ws();
+                    if (p_ >= end_ || *p_++ != ':') { ok = false; break; }
+                    out.members.push_back(std::make_pair(key, Json()));
+                    if (!value(out.members.back().second)) { ok = false; break; }
+                    skip_ws();
+                    if (p_ < end_ && *p_ == ',') { ++p_; continue; }
+                    if (p_ < end_ && *p_ == '}') { ++p_; break; }
+                    ok = false;
+                    break;
+                }
+            }
+        } else if (c == '[') {
+            out.type = Json::ARRAY;
+            ++p_;
+            skip_ws();
+            if (p_ < end_ && *p_ == ']') {
+                ++p_;
+            } else {
+                for (;;) {
+                    out.items.push_back(Json());
+                    if (!value(out.items.back())) { ok = false; break; }
+                    skip_ws();
+                    if (p_ < end_ && *p_ == ',') { ++p_; continue; }
+                    if (p_ < end_ && *p_ == ']') { ++p_; break; }
+                    ok = false;
+                    break;
+                }
+            }
+        } else if (c == '"') {
+            out.type = Json::STRING;
+            ok = string(out.text);
+        } else if (literal("true")) {
+            out.type = Json::BOOL;
+            out.boolean = true;
+        } else if (literal("false")) {
+            out.type = Json::BOOL;
+        } else if (literal("null")) {
+            out.type = Json::NUL;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            out.type = Json::NUMBER;
+            while (p_ < end_ && (std::strchr("+-.eE", *p_) || (*p_ >= '0' && *p_ <= '9'))) ++p_;
+        } else {
+            ok = false;
+        }
+        --depth_;
+        if (ok) out.raw.assign(start, p_ - start);
+        return ok;
+    }
+};
+
+// ---------------------------------------------------------------------------------------------
+// Native messaging I/O
+// ---------------------------------------------------------------------------------------------
+
+static std::mutex g_output_lock;
+
+static bool write_all(const char* data, std::size_t size) {
+#ifdef _WIN32
+    HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+    while (size > 0) {
+        DWORD written = 0;
+        if (!WriteFile(out, data, (DWORD)size, &written, NULL) || written == 0) return false;
+        data += written;
+        size -= written;
+    }
+#else
+    while (size > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        size -= (std::size_t)written;
+    }
+#endif
+    return true;
+}
+
+// Send one message; `id` is the raw JSON of the request id (empty when there was none)
+static void send_message(std::string body, const std::string& id = std::string()) {
+    if (!id.empty()) body.insert(body.size() - 1, ",\"id\":" + id);
+    std::uint32_t length = (std::uint32_t)body.size();
+    unsigned char header[4] = {
+        (unsigned char)(length & 0xFF), (unsigned char)((length >> 8) & 0xFF),
+        (unsigned char)((length >> 16) & 0xFF), (unsigned char)((length >> 24) & 0xFF)
+    };
+    std::lock_guard<std::mutex> guard(g_output_lock);
+    write_all((const char*)header, 4);
+    write_all(body.data(), body.size());
+}
+
+static long read_some(char* buffer, std::size_t size) {
+#ifdef _WIN32
+    DWORD got = 0;
+    if (!ReadFile(GetStdHandle(STD_INPUT_HANDLE), buffer, (DWORD)size, &got, NULL)) return 0;
+    return (long)got;
+#else
+    for (;;) {
+        ssize_t got = read(STDIN_FILENO, buffer, size);
+        if (got < 0 && errno == EINTR) continue;
+        return got < 0 ? 0 : (long)got;
+    }
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------
+// Engine hand-off
+// ---------------------------------------------------------------------------------------------
+
+struct Session {
+    std::string exePath;
+    std::string enginePath;
+    std::string tempDir;
+    std::string handshakeInfo; // validateConnection JSON without the per-process fields
+    std::vector<std::string> allowed;
+    std::vector<std::string> binaries;
+    int argc;
+    char** argv;
+};
+
+static std::atomic<bool> g_handed_off(false);
+
+// Replace this process with the engine (POSIX) or run it on our std handles (Windows).
+// `pending` holds stdin bytes already consumed; `handshakeSent` skips the engine's own.
+static int hand_off(const Session& session, const std::string& pending, bool handshakeSent) {
+    g_handed_off = true;
+    std::lock_guard<std::mutex> guard(g_output_lock); // no front-end writes past this point
+
+    if (!pending.empty()) {
+        char name[64];
+#ifdef _WIN32
+        std::snprintf(name, sizeof(name), "handoff-%lu.bin", (unsigned long)GetCurrentProcessId());
+#else
+        std::snprintf(name, sizeof(name), "handoff-%ld.bin", (long)getpid());
+#endif
+        std::string spill = join_path(session.tempDir, name);
+        if (write_file(spill, pending)) {
+#ifdef _WIN32
+            SetEnvironmentVariableW(L"MVD_HANDOFF_INPUT", widen(spill).c_str());
+#else
+            setenv("MVD_HANDOFF_INPUT", spill.c_str(), 1);
+#endif
+        } else {
+            log_line("Failed to spill pending input to " + spill);
+            return ERR_ENGINE;
+        }
+    }
+    if (handshakeSent) {
+#ifdef _WIN32
+        SetEnvironmentVariableW(L"MVD_HANDOFF_HANDSHAKE", L"1");
+#else
+        setenv("MVD_HANDOFF_HANDSHAKE", "1", 1);
+#endif
+    }
+
+#ifdef _WIN32
+    // Engine command line: our own with the program name swapped for the engine
+    std::wstring commandLine = GetCommandLineW();
+    std::size_t rest = 0;
+    if (!commandLine.empty() && commandLine[0] == L'"') {
+        rest = commandLine.find(L'"', 1);
+        rest = rest == std::wstring::npos ? commandLine.size() : rest + 1;
+    } else {
+        while (rest < commandLine.size() && commandLine[rest] != L' ' && commandLine[rest] != L'\t') ++rest;
+    }
+    std::wstring engine = widen(session.enginePath);
+    std::wstring line = L"\"" + engine + L"\"" + commandLine.substr(rest);
+
+    HANDLE handles[3] = { GetStdHandle(STD_INPUT_HANDLE), GetStdHandle(STD_OUTPUT_HANDLE), GetStdHandle(STD_ERROR_HANDLE) };
+    for (int i = 0; i < 3; ++i) {
+        if (handles[i] && handles[i] != INVALID_HANDLE_VALUE) SetHandleInformation(handles[i], HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT);
+    }
+    STARTUPINFOW si;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = handles[0];
+    si.hStdOutput = handles[1];
+    si.hStdError = handles[2];
+    PROCESS_INFORMATION pi;
+    if (!CreateProcessW(engine.c_str(), &line[0], NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi)) {
+        log_line("Failed to start engine: error " + std::to_string((unsigned long)GetLastError()));
+        return ERR_ENGINE;
+    }
+    CloseHandle(pi.hThread);
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    DWORD code = ERR_ENGINE;
+    GetExitCodeProcess(pi.hProcess, &code);
+    CloseHandle(pi.hProcess);
+    return (int)code;
+#else
+    std::vector<char*> args;
+    args.push_back(const_cast<char*>(session.enginePath.c_str()));
+    for (int i = 1; i < session.argc; ++i) args.push_back(session.argv[i]);
+    args.push_back(NULL);
+    execv(session.enginePath.c_str(), &args[0]);
+    log_line(std::string("Failed to exec engine: ") + std::strerror(errno));
+    return ERR_ENGINE;
+#endif
+}
+
+// ---------------------------------------------------------------------------------------------
+// Handshake cache
+// ---------------------------------------------------------------------------------------------
+
+static bool load_handshake(Session& session) {
+    std::string path = join_path(session.tempDir, "frontend-handshake.txt");
+    std::string content;
+    std::int64_t cacheTime = file_mtime_ms(path);
+    std::int64_t engineTime = file_mtime_ms(session.enginePath);
+    if (cacheTime < 0 || engineTime < 0 || engineTime > cacheTime || !read_file(path, content)) return false;
+
+    std::string location;
+    std::size_t start = 0;
+    while (start < content.size()) {
+        std::size_t end = content.find('\n', start);
+        if (end == std::string::npos) end = content.size();
+        std::string line = content.substr(start, end - start);
+        start = end + 1;
+        std::size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+        std::string key = line.substr(0, eq);
+        std::string value = line.substr(eq + 1);
+        if (key == "location") location = value;
+        else if (key == "allowed") session.allowed.push_back(value);
+        else if (key == "binary") session.binaries.push_back(value);
+        else if (key == "info") session.handshakeInfo = value;
+    }
+    if (location.empty() || real_path(location) != real_path(session.enginePath)) return false;
+    if (session.handshakeInfo.size() < 2 || session.handshakeInfo[session.handshakeInfo.size() - 1] != '}') return false;
+    for (std::size_t i = 0; i < session.binaries.size(); ++i) {
+        if (file_mtime_ms(session.binaries[i]) < 0) return false; // the engine reports what is missing
+    }
+    return !session.allowed.empty();
+}
+
+static void send_handshake(const Session& session) {
+    std::int64_t logSize = 0;
+    file_mtime_ms(g_log_file, &logSize);
+    std::string info = session.handshakeInfo;
+    unsigned long pid;
+#ifdef _WIN32
+    pid = (unsigned long)GetCurrentProcessId();
+#else
+    pid = (unsigned long)getpid();
+#endif
+    info.insert(info.size() - 1, ",\"pid\":" + std::to_string(pid) +
+                                 ",\"lastValidation\":" + std::to_string((long long)now_ms()) +
+                                 ",\"logFileSize\":" + std::to_string((long long)logSize) +
+                                 ",\"frontEnd\":true");
+    send_message(info);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Cheap commands
+// ---------------------------------------------------------------------------------------------
+
+// Free bytes on the volume holding `path` (getFreeDiskSpace in src/utils/utils.js): the root
+// of the path on Windows, the nearest existing folder on POSIX so other mounts report their own
+static std::string free_disk_space(const std::string& path) {
+#ifdef _WIN32
+    wchar_t full[MAX_PATH * 4];
+    DWORD len = GetFullPathNameW(widen(path).c_str(), MAX_PATH * 4, full, NULL);
+    if (len == 0 || len >= MAX_PATH * 4) return "null";
+    std::wstring resolved(full, len);
+    std::wstring root;
+    if (resolved.size() >= 2 && resolved[1] == L':') {
+        root = resolved.substr(0, 2) + L"\\";
+    } else if (resolved.compare(0, 2, L"\\\\") == 0) {
+        std::size_t server = resolved.find(L'\\', 2);
+        std::size_t share = server == std::wstring::npos ? server : resolved.find(L'\\', server + 1);
+        root = share == std::wstring::npos ? resolved + L"\\" : resolved.substr(0, share + 1);
+    } else {
+        return "null";
+    }
+    ULARGE_INTEGER available, total, totalFree;
+    if (!GetDiskFreeSpaceExW(root.c_str(), &available, &total, &totalFree)) return "null";
+    return std::to_string((unsigned long long)available.QuadPart);
+#else
+    std::string dir = path;
+    if (dir.empty() || dir[0] != '/') {
+        char cwd[4096];
+        if (!getcwd(cwd, sizeof(cwd))) return "null";
+        dir = std::string(cwd) + (dir.empty() ? "" : "/" + dir);
+    }
+    struct stat info;
+    while (dir.size() > 1 && stat(dir.c_str(), &info) != 0) {
+        std::size_t slash = dir.find_last_not_of('/');
+        slash = slash == std::string::npos ? 0 : dir.rfind('/', slash);
+        dir = slash == 0 || slash == std::string::npos ? "/" : dir.substr(0, slash);
+    }
+    struct statvfs st;
+    if (statvfs(dir.c_str(), &st) != 0) return "null";
+    return std::to_string((unsigned long long)st.f_bavail * (unsigned long long)st.f_frsize);
+#endif
+}
+
+static bool path_exists(const std::string& path) {
+#ifdef _WIN32
+    return GetFileAttributesW(widen(path).c_str()) != INVALID_FILE_ATTRIBUTES;
+#else
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+#endif
+}
+
+static bool is_directory(const std::string& path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesW(widen(path).c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+// mkdir -p; false on any failure so the engine can report it with its own error
+static bool make_directories(const std::string& path) {
+    if (path.empty()) return false;
+    for (std::size_t pos = 1; pos <= path.size(); ++pos) {
+        if (pos != path.size() && path[pos] != '/' && path[pos] != SEP) continue;
+        std::string prefix = path.substr(0, pos);
+        if (prefix.empty() || (prefix.size() == 2 && prefix[1] == ':') || is_directory(prefix)) continue;
+#ifdef _WIN32
+        if (!CreateDirectoryW(widen(prefix).c_str(), NULL) && !is_directory(prefix)) return false;
+#else
+        if (mkdir(prefix.c_str(), 0777) != 0 && !is_directory(prefix)) return false;
+#endif
+    }
+    return is_directory(path);
+}
+
+// Answer `request` if it is cheap; false means the engine has to take over
+static bool serve(const Json& request) {
+    std::string command = request.string_or("command", "");
+    const Json* idValue = request.get("id");
+    std::string id = idValue ? idValue->raw : std::string();
+
+    if (command == "get-disk-space") {
+        std::string path = request.string_or("path", "");
+        if (path.empty()) path = home_dir();
+        send_message("{\"success\":true,\"freeDiskSpace\":" + free_disk_space(path) + "}", id);
+        return true;
+    }
+    if (command == "kill-processing") {
+        send_message("{\"success\":true,\"from\":\"kill-processing\",\"killedCount\":0}", id);
+        return true;
+    }
+    if (command == "quit") {
+        send_message("{\"command\":\"shutdown\",\"reason\":\"quit_command\"}");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::exit(SUCCESS);
+    }
+    if (command == "fileSystem") {
+        std::string operation = request.string_or("operation", "");
+        const Json* params = request.get("params");
+        if (!params || params->type != Json::OBJECT) return false;
+        std::string path = params->string_or("path", params->string_or("filePath", ""));
+#ifdef _WIN32
+        if (path.size() > WINDOWS_LONG_PATH) return false; // \\?\ handling stays in the engine
+#endif
+        if (path.empty()) return false;
+        if (operation == "exists") {
+            send_message(std::string("{\"success\":true,\"exists\":") + (path_exists(path) ? "true" : "false") + "}", id);
+            return true;
+        }
+        if (operation == "mkdir" && make_directories(path)) {
+            send_message("{\"success\":true}", id);
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------------------------
+
+static bool is_messaging_call(const Session& session) {
+    for (int i = 1; i < session.argc; ++i) {
+        for (std::size_t j = 0; j < session.allowed.size(); ++j) {
+            if (std::strstr(session.argv[i], session.allowed[j].c_str())) return true;
+        }
+    }
+    return false;
+}
+
+static bool stdin_is_tty() {
+#ifdef _WIN32
+    DWORD mode;
+    return GetConsoleMode(GetStdHandle(STD_INPUT_HANDLE), &mode) != 0;
+#else
+    return isatty(STDIN_FILENO) != 0;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    Session session;
+    session.argc = argc;
+    session.argv = argv;
+    session.exePath = executable_path();
+    session.enginePath = join_path(dirname_of(session.exePath), ENGINE_NAME);
+    session.tempDir = temp_dir();
+    g_log_file = join_path(session.tempDir, "mvdcoapp.log");
+
+    // Installer CLI, double-click, stale cache or an unknown caller: the engine does it all
+    if (argc < 2 || stdin_is_tty() || !load_handshake(session) || !is_messaging_call(session)) {
+        return hand_off(session, std::string(), false);
+    }
+
+    log_line("PID: " + std::to_string((long long)
+#ifdef _WIN32
+        GetCurrentProcessId()
+#else
+        getpid()
+#endif
+    ) + " | handshake served, engine deferred");
+    send_handshake(session);
+
+    std::atomic<std::int64_t> lastActivity(now_ms());
+    std::thread([&lastActivity]() {
+        for (;;) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            if (g_handed_off) return;
+            if (now_ms() - lastActivity.load() < IDLE_TIMEOUT_MS) continue;
+            std::lock_guard<std::mutex> guard(g_output_lock);
+            if (g_handed_off) return;
+            log_line("Idle timeout reached - exiting");
+            static const char shutdown[] = "{\"command\":\"shutdown\",\"reason\":\"idle_timeout\"}";
+            unsigned char header[4] = { (unsigned char)(sizeof(shutdown) - 1), 0, 0, 0 };
+            write_all((const char*)header, 4);
+            write_all(shutdown, sizeof(shutdown) - 1);
+            std::_Exit(SUCCESS);
+        }
+    }).detach();
+
+    std::string buffer;
+    char chunk[65536];
+    for (;;) {
+        long got = read_some(chunk, sizeof(chunk));
+        if (got <= 0) {
+            log_line("STDIN ended - exiting");
+            return SUCCESS;
+        }
+        lastActivity = now_ms();
+        buffer.append(chunk, (std::size_t)got);
+
+        std::size_t offset = 0;
+        while (buffer.size() - offset >= 4) {
+            const unsigned char* header = (const unsigned char*)buffer.data() + offset;
+            std::uint32_t length = header[0] | (header[1] << 8) | (header[2] << 16) | ((std::uint32_t)header[3] << 24);
+            if (length > MAX_MESSAGE) {
+                return hand_off(session, buffer.substr(offset), true); // let the engine deal with it
+            }
+            if (buffer.size() - offset - 4 < length) break;
+
+            Json request;
+            JsonParser parser(buffer.data() + offset + 4, length);
+            if (!parser.parse(request) || request.type != Json::OBJECT || !serve(request)) {
+                log_line("Handing off to engine for " + request.string_or("command", "unparsed message"));
+                return hand_off(session, buffer.substr(offset), true);
+            }
+            offset += 4 + length;
+            lastActivity = now_ms();
+        }
+        buffer.erase(0, offset);
+    }
+}
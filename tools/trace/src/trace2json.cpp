@@ -0,0 +1,228 @@
+// Converts a CoApp binary trace (.mvdtrace) into Chrome trace JSON for chrome://tracing or Perfetto.
+// Record layout is documented in src/core/trace.js and tools/common/mvd_trace.h.
+//
+// Usage:
+//   mvd-trace <trace.mvdtrace> [-o trace.json]
+//
+// Spans become async begin/end pairs keyed by their scope (download or request id), so the
+// time between routeRequest, getFreeDiskSpace, ensureUniqueFilename, stageInlineManifestInputs,
+// spawn and ffmpeg's first byte reads directly off one row per download.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../../common/mvd_trace.h"
+
+enum ExitCode {
+    SUCCESS = 0,
+    ERR_ARGS = 2,
+    ERR_READ = 3,
+    ERR_FORMAT = 4,
+    ERR_WRITE = 5
+};
+
+struct EventInfo {
+    const char* name;
+    bool auxIsLabel;      // aux references a LABEL record
+    const char* auxName;  // argument name for aux when it is a plain number
+    const char* valueName;
+};
+
+static EventInfo event_info(std::uint16_t event) {
+    switch (event) {
+        case 2: return { "process_start", true, nullptr, nullptr };
+        case 3: return { "request_received", true, nullptr, nullptr };
+        case 4: return { "routeRequest", true, nullptr, nullptr };
+        case 5: return { "handler", true, nullptr, nullptr };
+        case 6: return { "getFreeDiskSpace", false, nullptr, "freeBytes" };
+        case 7: return { "ensureUniqueFilename", false, nullptr, nullptr };
+        case 8: return { "stageInlineManifestInputs", false, nullptr, "inputs" };
+        case 9: return { "spawn", true, nullptr, "pid" };
+        case 10: return { "first_byte", true, nullptr, "bytes" };
+        case 11: return { "progress_flush", false, nullptr, "bytes" };
+        case 12: return { "download_finished", false, "success", "bytes" };
+        case 13: return { "process_exit", false, "code", nullptr };
+        case 14: return { "helper", true, nullptr, nullptr };
+        default: return { nullptr, false, "aux", "value" };
+    }
+}
+
+static std::string json_escape(const std::string& in) {
+    std::string out;
+    out.reserve(in.size() + 8);
+    for (unsigned char c : in) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    return out;
+}
+
+static bool read_file(const char* path, std::vector<char>& data) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    in.seekg(0, std::ios::end);
+    std::streamoff size = in.tellg();
+    if (size < 0) return false;
+    in.seekg(0, std::ios::beg);
+    data.resize(static_cast<std::size_t>(size));
+    if (size > 0) in.read(&data[0], size);
+    return static_cast<bool>(in);
+}
+
+int main(int argc, char* argv[]) {
+    const char* inputPath = nullptr;
+    const char* outputPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (!inputPath) {
+            inputPath = argv[i];
+        } else {
+            inputPath = nullptr;
+            break;
+        }
+    }
+    if (!inputPath) {
+        std::cerr << "Usage: " << argv[0] << " <trace.mvdtrace> [-o trace.json]" << std::endl;
+        return ERR_ARGS;
+    }
+
+    std::vector<char> data;
+    if (!read_file(inputPath, data)) {
+        std::cerr << "Error reading " << inputPath << std::endl;
+        return ERR_READ;
+    }
+
+    const std::size_t recordSize = sizeof(mvd_trace::Record);
+    std::uint32_t version = 0, headerRecordSize = 0;
+    if (data.size() < 16 || std::memcmp(&data[0], "MVDTRACE", 8) != 0) {
+        std::cerr << "Not a CoApp trace file" << std::endl;
+        return ERR_FORMAT;
+    }
+    std::memcpy(&version, &data[8], 4);
+    std::memcpy(&headerRecordSize, &data[12], 4);
+    if (version != 1 || headerRecordSize != recordSize) {
+        std::cerr << "Unsupported trace version " << version << " (record size " << headerRecordSize << ")" << std::endl;
+        return ERR_FORMAT;
+    }
+
+    // Pass 1: labels and time origin. A torn tail from a crashed writer is ignored.
+    std::vector<mvd_trace::Record> records;
+    std::map<std::pair<std::uint32_t, std::uint32_t>, std::string> labels;
+    std::uint64_t origin = UINT64_MAX;
+    std::size_t count = (data.size() - 16) / recordSize;
+    for (std::size_t i = 0; i < count; ++i) {
+        mvd_trace::Record r;
+        std::memcpy(&r, &data[16 + i * recordSize], recordSize);
+        if (r.event == mvd_trace::EV_LABEL) {
+            std::size_t slots = (r.aux + recordSize - 1) / recordSize;
+            if (i + slots >= count) break;
+            const char* text = &data[16 + (i + 1) * recordSize];
+            labels[std::make_pair(r.pid, r.scope)] = std::string(text, r.aux);
+            i += slots;
+            continue;
+        }
+        if (r.ts < origin) origin = r.ts;
+        records.push_back(r);
+    }
+
+    std::ofstream file;
+    if (outputPath) {
+        file.open(outputPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Error opening " << outputPath << std::endl;
+            return ERR_WRITE;
+        }
+    }
+    std::ostream& out = outputPath ? static_cast<std::ostream&>(file) : std::cout;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::set<std::uint32_t> namedPids;
+
+    for (const mvd_trace::Record& r : records) {
+        EventInfo info = event_info(r.event);
+        std::string label;
+        if (info.auxIsLabel) {
+            auto it = labels.find(std::make_pair(r.pid, r.aux));
+            if (it != labels.end()) label = it->second;
+        }
+
+        if (r.event == mvd_trace::EV_PROCESS_START && !label.empty() && namedPids.insert(r.pid).second) {
+            out << (first ? "" : ",") << "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << r.pid
+                << ",\"tid\":" << r.pid << ",\"args\":{\"name\":\"" << json_escape(label) << "\"}}";
+            first = false;
+        }
+
+        std::string name = info.name ? info.name : ("event_" + std::to_string(r.event));
+        // Spans that carry a label are named after it so begin/end pairs stay distinct per command
+        if (!label.empty() && (r.phase == mvd_trace::PH_BEGIN || r.phase == mvd_trace::PH_END)) {
+            name += " " + label;
+        }
+
+        const char* ph = "i";
+        if (r.phase == mvd_trace::PH_BEGIN) ph = "b";
+        else if (r.phase == mvd_trace::PH_END) ph = "e";
+        else if (r.scope != 0) ph = "n";
+
+        char ts[48];
+        std::uint64_t rel = r.ts - origin;
+        std::snprintf(ts, sizeof(ts), "%llu.%03llu",
+                      static_cast<unsigned long long>(rel / 1000), static_cast<unsigned long long>(rel % 1000));
+
+        out << (first ? "" : ",") << "\n{\"name\":\"" << json_escape(name) << "\",\"cat\":\"mvd\",\"ph\":\"" << ph
+            << "\",\"ts\":" << ts << ",\"pid\":" << r.pid << ",\"tid\":" << r.pid;
+        first = false;
+
+        if (ph[0] == 'i') {
+            out << ",\"s\":\"p\"";
+        } else {
+            char id[16];
+            std::snprintf(id, sizeof(id), "0x%08x", r.scope);
+            out << ",\"id\":\"" << id << "\"";
+        }
+
+        out << ",\"args\":{";
+        bool firstArg = true;
+        if (!label.empty()) {
+            out << "\"label\":\"" << json_escape(label) << "\"";
+            firstArg = false;
+        } else if (info.auxName) {
+            out << "\"" << info.auxName << "\":" << r.aux;
+            firstArg = false;
+        }
+        if (info.valueName && (r.value != 0 || !info.name)) {
+            out << (firstArg ? "" : ",") << "\"" << info.valueName << "\":" << static_cast<unsigned long long>(r.value);
+        }
+        out << "}}";
+    }
+
+    out << "\n]}\n";
+    out.flush();
+    if (!out) {
+        std::cerr << "Error writing output" << std::endl;
+        return ERR_WRITE;
+    }
+    return SUCCESS;
+}
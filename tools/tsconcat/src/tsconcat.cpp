@@ -0,0 +1,445 @@
+// Native MPEG-TS concatenation for HLS `-c copy` outputs.
+// Validates sync bytes and continuity counters per PID, renumbers counters across segment
+// boundaries, rebases PCR/PTS/DTS when a segment jumps in time, drops null packets and writes
+// the result with large sequential writes instead of a full ffmpeg demux/mux pass.
+//
+// Usage:
+//   mvd-tsconcat --output out.ts [--no-rebase] [--hash xxh3,sha256] seg1.ts seg2.ts ...
+//   mvd-tsconcat --output out.ts [--no-rebase] [--hash xxh3,sha256] --stdin-list   (one segment path per line until EOF)
+//
+// Stdout:
+//   SEGMENT=<index> BYTES=<output bytes so far>    after each segment
+//   REPORT=<json>                                   health report at the end
+//   XXH3=<hex> SHA256=<hex>                         digests of the output file (--hash), on success
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../../common/mvd_hash.h"
+#include "../../common/mvd_trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+enum ExitCode {
+    SUCCESS = 0,
+    ERR_ARGS = 2,
+    ERR_INPUT = 3,
+    ERR_OUTPUT = 4,
+    ERR_FORMAT = 5
+};
+
+static const std::size_t TS_PACKET = 188;
+static const std::size_t WRITE_CHUNK = 4 * 1024 * 1024;
+static const std::uint16_t NULL_PID = 0x1FFF;
+static const std::int64_t PCR_WRAP = (1LL << 33) * 300;
+static const std::int64_t PCR_HZ = 27000000;
+static const std::int64_t PCR_JUMP_LIMIT = 10 * PCR_HZ; // matches ffmpeg's -dts_delta_threshold default
+static const std::int64_t PCR_DEFAULT_STEP = PCR_HZ / 25;
+
+struct PidState {
+    bool seen = false;
+    std::size_t segment = 0;
+    std::uint8_t lastInCc = 0;
+    std::uint8_t lastOutCc = 0;
+    std::uint8_t ccOffset = 0;
+    std::uint64_t packets = 0;
+    std::uint64_t ccErrors = 0;
+};
+
+struct Report {
+    std::uint64_t segments = 0;
+    std::uint64_t emptySegments = 0;
+    std::uint64_t packets = 0;
+    std::uint64_t bytesIn = 0;
+    std::uint64_t bytesOut = 0;
+    std::uint64_t resyncs = 0;
+    std::uint64_t droppedBytes = 0;
+    std::uint64_t nullPackets = 0;
+    std::uint64_t transportErrors = 0;
+    std::uint64_t duplicates = 0;
+    std::uint64_t ccErrors = 0;
+    std::uint64_t ccBoundaryFixes = 0;
+    std::uint64_t pcrJumps = 0;
+    std::uint64_t timestampRebases = 0;
+};
+
+static FILE* open_file(const std::string& path, const char* mode) {
+#ifdef _WIN32
+    int len = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    if (len == 0) return nullptr;
+    std::wstring wpath(len, 0);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wpath[0], len);
+    std::wstring wmode(mode, mode + std::strlen(mode));
+    return _wfopen(wpath.c_str(), wmode.c_str());
+#else
+    return std::fopen(path.c_str(), mode);
+#endif
+}
+
+static bool read_whole(const std::string& path, std::vector<std::uint8_t>& data) {
+    FILE* f = open_file(path, "rb");
+    if (!f) return false;
+    data.clear();
+    std::uint8_t chunk[1 << 16];
+    std::size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+    bool ok = !std::ferror(f);
+    std::fclose(f);
+    return ok;
+}
+
+static std::int64_t read_pcr(const std::uint8_t* p) {
+    std::int64_t base = (static_cast<std::int64_t>(p[0]) << 25) | (p[1] << 17) | (p[2] << 9) | (p[3] << 1) | (p[4] >> 7);
+    std::int64_t ext = ((p[4] & 0x01) << 8) | p[5];
+    return base * 300 + ext;
+}
+
+static void write_pcr(std::uint8_t* p, std::int64_t pcr) {
+    std::int64_t base = (pcr / 300) & ((1LL << 33) - 1);
+    std::int64_t ext = pcr % 300;
+    p[0] = static_cast<std::uint8_t>(base >> 25);
+    p[1] = static_cast<std::uint8_t>(base >> 17);
+    p[2] = static_cast<std::uint8_t>(base >> 9);
+    p[3] = static_cast<std::uint8_t>(base >> 1);
+    p[4] = static_cast<std::uint8_t>(((base & 1) << 7) | 0x7E | ((ext >> 8) & 1));
+    p[5] = static_cast<std::uint8_t>(ext & 0xFF);
+}
+
+static std::int64_t read_ts(const std::uint8_t* p) {
+    return (static_cast<std::int64_t>((p[0] >> 1) & 0x07) << 30) | (p[1] << 22) | ((p[2] >> 1) << 15) | (p[3] << 7) | (p[4] >> 1);
+}
+
+static void write_ts(std::uint8_t* p, std::int64_t ts) {
+    ts &= (1LL << 33) - 1;
+    p[0] = static_cast<std::uint8_t>((p[0] & 0xF0) | ((ts >> 29) & 0x0E) | 0x01);
+    p[1] = static_cast<std::uint8_t>(ts >> 22);
+    p[2] = static_cast<std::uint8_t>(((ts >> 14) & 0xFE) | 0x01);
+    p[3] = static_cast<std::uint8_t>(ts >> 7);
+    p[4] = static_cast<std::uint8_t>(((ts << 1) & 0xFE) | 0x01);
+}
+
+// Signed distance a - b on the 33-bit PCR clock
+static std::int64_t pcr_delta(std::int64_t a, std::int64_t b) {
+    std::int64_t d = (a - b) % PCR_WRAP;
+    if (d < 0) d += PCR_WRAP;
+    if (d > PCR_WRAP / 2) d -= PCR_WRAP;
+    return d;
+}
+
+static bool packet_pcr(const std::uint8_t* pkt, std::int64_t& pcr) {
+    std::uint8_t afc = (pkt[3] >> 4) & 0x03;
+    if (!(afc & 0x02) || pkt[4] < 7 || !(pkt[5] & 0x10)) return false;
+    pcr = read_pcr(pkt + 6);
+    return true;
+}
+
+class Concatenator {
+public:
+    Concatenator(FILE* out, bool rebase, mvd_hash::Digests& digests) : out_(out), rebase_(rebase), digests_(digests) { buffer_.reserve(WRITE_CHUNK); }
+
+    bool add_segment(const std::vector<std::uint8_t>& data) {
+        std::size_t index = report_.segments++;
+        report_.bytesIn += data.size();
+
+        std::vector<std::size_t> offsets;
+        collect_packets(data, offsets);
+        if (offsets.empty()) {
+            report_.emptySegments++;
+            return true;
+        }
+
+        plan_rebase(data, offsets);
+
+        for (std::size_t off : offsets) {
+            std::uint8_t pkt[TS_PACKET];
+            std::memcpy(pkt, &data[off], TS_PACKET);
+            if (!process_packet(pkt, index)) continue;
+            if (!append(pkt, TS_PACKET)) return false;
+        }
+        return true;
+    }
+
+    bool finish() {
+        return flush();
+    }
+
+    std::uint64_t produced() const { return report_.bytesOut + buffer_.size(); }
+    const Report& report() const { return report_; }
+    const std::map<std::uint16_t, PidState>& pids() const { return pids_; }
+
+private:
+    // Sync-byte scan with resync: a packet is accepted when the next one also starts with 0x47
+    void collect_packets(const std::vector<std::uint8_t>& data, std::vector<std::size_t>& offsets) {
+        std::size_t pos = 0;
+        const std::size_t size = data.size();
+        while (pos + TS_PACKET <= size) {
+            bool synced = data[pos] == 0x47 && (pos + TS_PACKET >= size || data[pos + TS_PACKET] == 0x47);
+            if (synced) {
+                offsets.push_back(pos);
+                pos += TS_PACKET;
+                continue;
+            }
+            std::size_t next = pos + 1;
+            while (next + TS_PACKET <= size && !(data[next] == 0x47 && (next + TS_PACKET >= size || data[next + TS_PACKET] == 0x47))) {
+                next++;
+            }
+            if (next + TS_PACKET > size) next = size;
+            report_.resyncs++;
+            report_.droppedBytes += next - pos;
+            pos = next;
+        }
+        if (pos < size) report_.droppedBytes += size - pos;
+    }
+
+    // Decide the timeline shift for this segment from its first PCR before any packet is written,
+    // so PES timestamps that precede the PCR in the segment get the same correction
+    void plan_rebase(const std::vector<std::uint8_t>& data, const std::vector<std::size_t>& offsets) {
+        for (std::size_t off : offsets) {
+            const std::uint8_t* pkt = &data[off];
+            std::uint16_t pid = static_cast<std::uint16_t>(((pkt[1] & 0x1F) << 8) | pkt[2]);
+            std::int64_t pcr;
+            if (!packet_pcr(pkt, pcr)) continue;
+            if (pcrPid_ < 0) pcrPid_ = pid;
+            if (pid != pcrPid_) continue;
+            if (!havePcr_) return;
+
+            std::int64_t delta = pcr_delta(pcr + shift_, lastPcr_);
+            if (delta < 0 || delta > PCR_JUMP_LIMIT) {
+                report_.pcrJumps++;
+                if (rebase_) {
+                    shift_ += pcr_delta(lastPcr_ + pcrStep_, pcr + shift_);
+                    report_.timestampRebases++;
+                } else {
+                    markDiscontinuity_ = true;
+                }
+            }
+            return;
+        }
+    }
+
+    bool process_packet(std::uint8_t* pkt, std::size_t segment) {
+        std::uint16_t pid = static_cast<std::uint16_t>(((pkt[1] & 0x1F) << 8) | pkt[2]);
+        if (pkt[1] & 0x80) report_.transportErrors++;
+        if (pid == NULL_PID) {
+            report_.nullPackets++;
+            return false;
+        }
+
+        std::uint8_t afc = (pkt[3] >> 4) & 0x03;
+        std::uint8_t cc = pkt[3] & 0x0F;
+        bool hasPayload = (afc & 0x01) != 0;
+        bool discontinuity = (afc & 0x02) && pkt[4] > 0 && (pkt[5] & 0x80);
+
+        PidState& st = pids_[pid];
+        st.packets++;
+        report_.packets++;
+
+        if (st.seen && st.segment != segment) {
+            // First packet of this PID in a new segment: continue the output sequence
+            std::uint8_t desired = hasPayload ? static_cast<std::uint8_t>((st.lastOutCc + 1) & 0x0F) : st.lastOutCc;
+            st.ccOffset = static_cast<std::uint8_t>((desired - cc) & 0x0F);
+            if (st.ccOffset != 0) report_.ccBoundaryFixes++;
+        } else if (st.seen && hasPayload && !discontinuity) {
+            std::uint8_t expected = static_cast<std::uint8_t>((st.lastInCc + 1) & 0x0F);
+            if (cc == st.lastInCc) {
+                report_.duplicates++;
+            } else if (cc != expected) {
+                st.ccErrors++;
+                report_.ccErrors++;
+            }
+        } else if (!st.seen) {
+            st.ccOffset = 0;
+        }
+
+        st.seen = true;
+        st.segment = segment;
+        st.lastInCc = cc;
+        st.lastOutCc = static_cast<std::uint8_t>((cc + st.ccOffset) & 0x0F);
+        pkt[3] = static_cast<std::uint8_t>((pkt[3] & 0xF0) | st.lastOutCc);
+
+        std::int64_t pcr;
+        if (packet_pcr(pkt, pcr)) {
+            if (shift_ != 0) {
+                pcr = (pcr + shift_) % PCR_WRAP;
+                if (pcr < 0) pcr += PCR_WRAP;
+                write_pcr(pkt + 6, pcr);
+            }
+            if (static_cast<int>(pid) == pcrPid_) {
+                if (markDiscontinuity_) {
+                    pkt[5] |= 0x80;
+                    markDiscontinuity_ = false;
+                }
+                if (havePcr_) {
+                    std::int64_t step = pcr_delta(pcr, lastPcr_);
+                    if (step > 0 && step <= PCR_HZ) pcrStep_ = step;
+                }
+                lastPcr_ = pcr;
+                havePcr_ = true;
+            }
+        }
+
+        if (shift_ != 0 && hasPayload && (pkt[1] & 0x40)) rebase_pes(pkt, afc);
+        return true;
+    }
+
+    void rebase_pes(std::uint8_t* pkt, std::uint8_t afc) {
+        std::size_t start = 4;
+        if (afc & 0x02) start += 1 + pkt[4];
+        if (start + 19 > TS_PACKET) return;
+        std::uint8_t* pes = pkt + start;
+        if (pes[0] != 0x00 || pes[1] != 0x00 || pes[2] != 0x01) return;
+        std::uint8_t streamId = pes[3];
+        if (streamId == 0xBC || streamId == 0xBE || streamId == 0xBF || streamId == 0xF0 ||
+            streamId == 0xF1 || streamId == 0xF2 || streamId == 0xF8 || streamId == 0xFF) {
+            return;
+        }
+        std::uint8_t flags = pes[7] >> 6;
+        std::int64_t shift90 = shift_ / 300;
+        if (flags & 0x02) write_ts(pes + 9, read_ts(pes + 9) + shift90);
+        if (flags == 0x03) write_ts(pes + 14, read_ts(pes + 14) + shift90);
+    }
+
+    bool append(const std::uint8_t* data, std::size_t len) {
+        buffer_.insert(buffer_.end(), data, data + len);
+        if (buffer_.size() >= WRITE_CHUNK) return flush();
+        return true;
+    }
+
+    bool flush() {
+        if (buffer_.empty()) return true;
+        digests_.update(buffer_.data(), buffer_.size());
+        std::size_t written = std::fwrite(buffer_.data(), 1, buffer_.size(), out_);
+        report_.bytesOut += written;
+        bool ok = written == buffer_.size();
+        buffer_.clear();
+        return ok;
+    }
+
+    FILE* out_;
+    bool rebase_;
+    mvd_hash::Digests& digests_;
+    std::vector<std::uint8_t> buffer_;
+    std::map<std::uint16_t, PidState> pids_;
+    Report report_;
+    int pcrPid_ = -1;
+    bool havePcr_ = false;
+    bool markDiscontinuity_ = false;
+    std::int64_t lastPcr_ = 0;
+    std::int64_t pcrStep_ = PCR_DEFAULT_STEP;
+    std::int64_t shift_ = 0;
+};
+
+static void print_report(const Concatenator& cat) {
+    const Report& r = cat.report();
+    std::cout << "REPORT={\"segments\":" << r.segments
+              << ",\"emptySegments\":" << r.emptySegments
+              << ",\"packets\":" << r.packets
+              << ",\"bytesIn\":" << r.bytesIn
+              << ",\"bytesOut\":" << r.bytesOut
+              << ",\"resyncs\":" << r.resyncs
+              << ",\"droppedBytes\":" << r.droppedBytes
+              << ",\"nullPackets\":" << r.nullPackets
+              << ",\"transportErrors\":" << r.transportErrors
+              << ",\"duplicates\":" << r.duplicates
+              << ",\"ccErrors\":" << r.ccErrors
+              << ",\"ccBoundaryFixes\":" << r.ccBoundaryFixes
+              << ",\"pcrJumps\":" << r.pcrJumps
+              << ",\"timestampRebases\":" << r.timestampRebases
+              << ",\"pids\":[";
+    bool first = true;
+    for (const auto& kv : cat.pids()) {
+        std::cout << (first ? "" : ",") << "{\"pid\":" << kv.first << ",\"packets\":" << kv.second.packets
+                  << ",\"ccErrors\":" << kv.second.ccErrors << "}";
+        first = false;
+    }
+    std::cout << "]}" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    mvd_trace::HelperSpan traceSpan("mvd-tsconcat");
+
+    std::string outputPath;
+    bool stdinList = false;
+    bool rebase = true;
+    mvd_hash::Digests digests;
+    bool hashOk = true;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "--stdin-list") {
+            stdinList = true;
+        } else if (arg == "--no-rebase") {
+            rebase = false;
+        } else if (arg == "--hash" && i + 1 < argc) {
+            hashOk = digests.configure(argv[++i]);
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (outputPath.empty() || (!stdinList && inputs.empty()) || !hashOk) {
+        std::cerr << "Usage: " << argv[0] << " --output <out.ts> [--no-rebase] [--hash xxh3,sha256] (--stdin-list | <segment>...)" << std::endl;
+        return ERR_ARGS;
+    }
+
+    FILE* out = open_file(outputPath, "wb");
+    if (!out) {
+        std::perror("Error opening output");
+        return ERR_OUTPUT;
+    }
+    std::setvbuf(out, nullptr, _IONBF, 0); // writes are already batched into WRITE_CHUNK blocks
+
+    Concatenator cat(out, rebase, digests);
+    std::vector<std::uint8_t> data;
+    std::size_t index = 0;
+    int rc = SUCCESS;
+
+    auto handle = [&](const std::string& path) -> bool {
+        if (!read_whole(path, data)) {
+            std::cerr << "Error reading segment " << index << ": " << path << std::endl;
+            rc = ERR_INPUT;
+            return false;
+        }
+        if (!cat.add_segment(data)) {
+            std::perror("Error writing output");
+            rc = ERR_OUTPUT;
+            return false;
+        }
+        std::cout << "SEGMENT=" << index++ << " BYTES=" << cat.produced() << std::endl;
+        return true;
+    };
+
+    if (stdinList) {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            if (!handle(line)) break;
+        }
+    } else {
+        for (const std::string& path : inputs) {
+            if (!handle(path)) break;
+        }
+    }
+
+    if (!cat.finish() && rc == SUCCESS) {
+        std::perror("Error writing output");
+        rc = ERR_OUTPUT;
+    }
+    if (std::fclose(out) != 0 && rc == SUCCESS) rc = ERR_OUTPUT;
+
+    print_report(cat);
+    if (rc == SUCCESS && cat.report().packets == 0) rc = ERR_FORMAT;
+    if (rc == SUCCESS) digests.print(std::cout);
+    return rc;
+}
@@ -0,0 +1,1011 @@
+// Native sink for direct downloads: the host pipes the response body to stdin and this
+// helper writes it to disk with large, queued writes.
+//
+// Backends:
+//   io_uring  Linux 5.1+. Registered (fixed) buffers, batched submissions and, with
+//             --sync-range, a write linked to a sync_file_range so dirty pages are pushed
+//             out steadily instead of in one burst at close. Plain writev ops are used when
+//             the memlock limit refuses buffer registration.
+//   pwrite    Everything else (and old kernels): a small thread pool issuing pwrite calls,
+//             so one slow write never stalls reading from the pipe.
+// Raw syscalls and local ABI structs keep the linux-x64 build on glibc 2.17.
+//
+// With --fetch the helper downloads a plain-HTTP URL itself and splices the socket into
+// the file (Linux), so the body never passes through the host or userspace at all.
+//
+// --hash xxh3,sha256 digests the bytes on their way to disk (see common/mvd_hash.h). A
+// hashed --fetch reads the socket with recv instead of splicing, since the data has to be
+// seen once in userspace anyway.
+//
+// --dirty-mb N bounds how much of the output stays in the page cache behind the write head
+// (Linux: sync_file_range windows plus POSIX_FADV_DONTNEED; macOS: F_NOCACHE), so a
+// multi-hour recording neither evicts the user's working set nor builds up a writeback
+// stall. Supersedes --sync-range.
+//
+// --preallocate N reserves N bytes for the output before the first write (fallocate with
+// FALLOC_FL_KEEP_SIZE on Linux, F_PREALLOCATE on macOS), so a known-size download gets
+// contiguous extents and its space is claimed up front; `auto` uses the --fetch
+// Content-Length. The host only asks on filesystems mvd-fsutil probe reports FALLOCATE=1.
+//
+// Usage:
+//   mvd-writer --output <file> [--backend auto|io_uring|pwrite] [--queue-depth N] [--chunk-kb N] [--sync-range] [--dirty-mb N] [--preallocate N] [--hash LIST]
+//   mvd-writer --output <file> --fetch <http://...> [--header "Name: value"]... [--timeout-ms N] [--dirty-mb N] [--preallocate N|auto] [--hash LIST]
+//
+// Stdout:
+//   BACKEND=<io_uring|pwrite|splice|recv>    backend in use
+//   STATUS=<code> CONTENT_LENGTH=<n>         response details (--fetch)
+//   PROGRESS=<n>                             bytes written so far, every 250ms (--fetch)
+//   UNSUPPORTED=<reason>                     --fetch cannot serve this URL; nothing was written
+//   PREALLOCATED=<n>                         bytes reserved up front (--preallocate)
+//   XXH3=<hex> SHA256=<hex>                  digests of the written bytes (--hash), on success
+//   DROPPED=<n>                              bytes evicted from the page cache (--dirty-mb, Linux), on success
+//   BYTES=<n>                                total bytes written, on success
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "../../common/mvd_hash.h"
+#include "../../common/mvd_trace.h"
+
+enum ExitCode {
+    SUCCESS = 0,
+    ERR_ARGS = 2,
+    ERR_INPUT = 3,
+    ERR_OUTPUT = 4,
+    ERR_HTTP = 5,
+    ERR_NETWORK = 6,
+    ERR_UNSUPPORTED = 7
+};
+
+static const std::size_t DEFAULT_CHUNK = 1024 * 1024;
+static const unsigned DEFAULT_QUEUE_DEPTH = 8;
+static const unsigned PWRITE_THREADS = 4;
+static const std::uint64_t SYNC_WINDOW = 32ULL * 1024 * 1024; // bytes between sync_file_range calls
+static const std::uint64_t MIN_BEHIND_WINDOW = 1024 * 1024;
+static const std::size_t MAX_HEADER_BYTES = 64 * 1024;
+static const int MAX_REDIRECTS = 5;
+
+#ifndef F_SETPIPE_SZ
+#define F_SETPIPE_SZ 1031
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#ifndef SOCK_CLOEXEC
+#define SOCK_CLOEXEC 0
+#endif
+
+struct Options {
+    std::string output;
+    std::string backend = "auto";
+    unsigned queueDepth = DEFAULT_QUEUE_DEPTH;
+    std::size_t chunk = DEFAULT_CHUNK;
+    bool syncRange = false;
+    std::string fetchUrl;
+    std::vector<std::string> headers;
+    unsigned timeoutMs = 30000;
+    std::string hash;
+    std::uint64_t dirtyBudget = 0; // bytes, 0 = leave caching to the kernel
+    std::uint64_t preallocate = 0;
+    bool preallocateAuto = false;
+};
+
+static bool write_full_at(int fd, const std::uint8_t* data, std::size_t len, std::uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<std::size_t>(n);
+        offset += static_cast<std::uint64_t>(n);
+    }
+    return true;
+}
+
+// Fill buf from stdin; returns bytes read (short only at EOF) or -1 on error
+static long fill_from_stdin(std::uint8_t* buf, std::size_t cap) {
+    std::size_t got = 0;
+    while (got < cap) {
+        ssize_t n = read(STDIN_FILENO, buf + got, cap - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) break;
+        got += static_cast<std::size_t>(n);
+    }
+    return static_cast<long>(got);
+}
+
+static bool stdin_ready() {
+    struct pollfd pfd;
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) > 0;
+}
+
+static void sync_range(int fd, std::uint64_t offset, std::uint64_t len) {
+#ifdef __linux__
+    sync_file_range(fd, static_cast<off64_t>(offset), static_cast<off64_t>(len), SYNC_FILE_RANGE_WRITE);
+#else
+    (void)fd; (void)offset; (void)len;
+#endif
+}
+
+#if defined(__linux__) && !defined(FALLOC_FL_KEEP_SIZE)
+#define FALLOC_FL_KEEP_SIZE 0x01
+#endif
+
+// Reserve space without changing the file size, so progress (which stats the file) and a
+// short body both still see only what was written. Failure just means no reservation.
+static void preallocate(int fd, std::uint64_t bytes) {
+    if (bytes == 0) return;
+#ifdef __linux__
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(bytes)) != 0) return;
+#elif defined(__APPLE__)
+    fstore_t store;
+    std::memset(&store, 0, sizeof(store));
+    store.fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_length = static_cast<off_t>(bytes);
+    if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+        store.fst_flags = F_ALLOCATEALL;
+        if (fcntl(fd, F_PREALLOCATE, &store) == -1) return;
+    }
+#else
+    (void)fd;
+    return;
+#endif
+    std::cout << "PREALLOCATED=" << bytes << std::endl;
+}
+
+// --- Write-behind (--dirty-mb) ---------------------------------------------
+// Completed bytes are queued for writeback a window at a time, and everything more than the
+// budget behind the write head is waited on and dropped from the cache. The wait is on pages
+// written long ago, so it only blocks when the disk is slower than the input; that is the
+// throttle the kernel would otherwise apply all at once when its dirty limit is hit.
+
+class WriteBehind {
+public:
+    WriteBehind(int fd, std::uint64_t budget) : fd_(fd), budget_(budget) {
+        window_ = budget / 4;
+        if (window_ < MIN_BEHIND_WINDOW) window_ = MIN_BEHIND_WINDOW;
+        if (window_ > SYNC_WINDOW) window_ = SYNC_WINDOW;
+#ifdef __APPLE__
+        if (budget_ > 0) fcntl(fd_, F_NOCACHE, 1);
+#endif
+    }
+
+    bool enabled() const { return budget_ > 0; }
+    std::uint64_t dropped() const { return dropped_; }
+
+    // Every byte below `written` has reached the file
+    void advance(std::uint64_t written) {
+#ifdef __linux__
+        if (budget_ == 0 || written - queued_ < window_) return;
+        sync_file_range(fd_, static_cast<off64_t>(queued_), static_cast<off64_t>(written - queued_), SYNC_FILE_RANGE_WRITE);
+        queued_ = written;
+        if (queued_ - dropped_ > budget_) {
+            const std::uint64_t end = queued_ - budget_;
+            sync_file_range(fd_, static_cast<off64_t>(dropped_), static_cast<off64_t>(end - dropped_),
+                            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            posix_fadvise(fd_, static_cast<off_t>(dropped_), static_cast<off_t>(end - dropped_), POSIX_FADV_DONTNEED);
+            dropped_ = end;
+        }
+#else
+        (void)written;
+#endif
+    }
+
+    // Start writeback of the tail and drop whatever is already clean; waiting for the last
+    // budget's worth would only delay the exit
+    void finish(std::uint64_t total) {
+#ifdef __linux__
+        if (budget_ == 0 || total <= dropped_) return;
+        if (total > queued_) sync_file_range(fd_, static_cast<off64_t>(queued_), static_cast<off64_t>(total - queued_), SYNC_FILE_RANGE_WRITE);
+        posix_fadvise(fd_, static_cast<off_t>(dropped_), static_cast<off_t>(total - dropped_), POSIX_FADV_DONTNEED);
+#else
+        (void)total;
+#endif
+    }
+
+private:
+    int fd_;
+    std::uint64_t budget_;
+    std::uint64_t window_;
+    std::uint64_t queued_ = 0;  // writeback started below this offset
+    std::uint64_t dropped_ = 0; // evicted below this offset
+};
+
+// Writes complete out of order; this tracks the offset below which all of them are done
+class CompletionMark {
+public:
+    void complete(std::uint64_t offset, std::uint64_t len) {
+        pending_[offset] = offset + len;
+        while (!pending_.empty() && pending_.begin()->first == mark_) {
+            mark_ = pending_.begin()->second;
+            pending_.erase(pending_.begin());
+        }
+    }
+    std::uint64_t mark() const { return mark_; }
+
+private:
+    std::map<std::uint64_t, std::uint64_t> pending_;
+    std::uint64_t mark_ = 0;
+};
+
+// --- io_uring ---------------------------------------------------------------
+
+#ifdef __linux__
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#define __NR_io_uring_enter 426
+#define __NR_io_uring_register 427
+#endif
+
+namespace uring {
+
+enum {
+    OP_WRITEV = 2,
+    OP_WRITE_FIXED = 5,
+    OP_SYNC_FILE_RANGE = 8,
+    SQE_IO_LINK = 1 << 2,
+    ENTER_GETEVENTS = 1,
+    REGISTER_BUFFERS = 0,
+    FEAT_SINGLE_MMAP = 1
+};
+
+static const off_t OFF_SQ_RING = 0;
+static const off_t OFF_CQ_RING = 0x8000000;
+static const off_t OFF_SQES = 0x10000000;
+
+struct SqringOffsets { std::uint32_t head, tail, ring_mask, ring_entries, flags, dropped, array, resv1; std::uint64_t resv2; };
+struct CqringOffsets { std::uint32_t head, tail, ring_mask, ring_entries, overflow, cqes, flags, resv1; std::uint64_t resv2; };
+struct Params {
+    std::uint32_t sq_entries, cq_entries, flags, sq_thread_cpu, sq_thread_idle, features, wq_fd, resv[3];
+    SqringOffsets sq_off;
+    CqringOffsets cq_off;
+};
+struct Sqe {
+    std::uint8_t opcode;
+    std::uint8_t flags;
+    std::uint16_t ioprio;
+    std::int32_t fd;
+    std::uint64_t off;
+    std::uint64_t addr;
+    std::uint32_t len;
+    std::uint32_t op_flags;
+    std::uint64_t user_data;
+    std::uint16_t buf_index;
+    std::uint16_t personality;
+    std::int32_t splice_fd_in;
+    std::uint64_t pad[2];
+};
+struct Cqe { std::uint64_t user_data; std::int32_t res; std::uint32_t flags; };
+
+static_assert(sizeof(Params) == 120, "io_uring_params ABI");
+static_assert(sizeof(Sqe) == 64, "io_uring_sqe ABI");
+static_assert(sizeof(Cqe) == 16, "io_uring_cqe ABI");
+
+class Ring {
+public:
+    ~Ring() {
+        if (sqes_) munmap(sqes_, sqesSize_);
+        if (cqPtr_ && cqPtr_ != sqPtr_) munmap(cqPtr_, cqSize_);
+        if (sqPtr_) munmap(sqPtr_, sqSize_);
+        if (fd_ >= 0) close(fd_);
+    }
+
+    bool init(unsigned entries) {
+        Params p;
+        std::memset(&p, 0, sizeof(p));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if (fd_ < 0) return false;
+
+        sqSize_ = p.sq_off.array + p.sq_entries * sizeof(std::uint32_t);
+        cqSize_ = p.cq_off.cqes + p.cq_entries * sizeof(Cqe);
+        bool single = (p.features & FEAT_SINGLE_MMAP) != 0;
+        if (single && cqSize_ > sqSize_) sqSize_ = cqSize_;
+
+        sqPtr_ = mmap(nullptr, sqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, OFF_SQ_RING);
+        if (sqPtr_ == MAP_FAILED) { sqPtr_ = nullptr; return false; }
+        if (single) {
+            cqPtr_ = sqPtr_;
+        } else {
+            cqPtr_ = mmap(nullptr, cqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, OFF_CQ_RING);
+            if (cqPtr_ == MAP_FAILED) { cqPtr_ = nullptr; return false; }
+        }
+        sqesSize_ = p.sq_entries * sizeof(Sqe);
+        void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        sqes_ = static_cast<Sqe*>(sqes);
+
+        std::uint8_t* sq = static_cast<std::uint8_t*>(sqPtr_);
+        std::uint8_t* cq = static_cast<std::uint8_t*>(cqPtr_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<Cqe*>(cq + p.cq_off.cqes);
+        sqEntries_ = p.sq_entries;
+        return true;
+    }
+
+    bool register_buffers(const std::vector<struct iovec>& iovs) {
+        return syscall(__NR_io_uring_register, fd_, REGISTER_BUFFERS, iovs.data(), static_cast<unsigned>(iovs.size())) == 0;
+    }
+
+    // Returns a zeroed SQE or nullptr when the submission ring is full
+    Sqe* next_sqe() {
+        unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (localTail_ - head >= sqEntries_) return nullptr;
+        unsigned index = localTail_ & sqMask_;
+        Sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray_[index] = index;
+        localTail_++;
+        return sqe;
+    }
+
+    unsigned pending() const { return localTail_ - *sqTail_; }
+
+    // Publish queued SQEs and optionally wait for at least minComplete completions
+    bool submit(unsigned minComplete) {
+        unsigned toSubmit = pending();
+        __atomic_store_n(sqTail_, localTail_, __ATOMIC_RELEASE);
+        if (toSubmit == 0 && minComplete == 0) return true;
+        for (;;) {
+            long rc = syscall(__NR_io_uring_enter, fd_, toSubmit, minComplete, minComplete ? ENTER_GETEVENTS : 0, nullptr, 0);
+            if (rc >= 0) return true;
+            if (errno != EINTR) return false;
+        }
+    }
+
+    bool pop(Cqe& out) {
+        unsigned head = *cqHead_;
+        if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) return false;
+        out = cqes_[head & cqMask_];
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    void* sqPtr_ = nullptr;
+    void* cqPtr_ = nullptr;
+    std::size_t sqSize_ = 0, cqSize_ = 0, sqesSize_ = 0;
+    Sqe* sqes_ = nullptr;
+    unsigned *sqHead_ = nullptr, *sqTail_ = nullptr, *sqArray_ = nullptr;
+    unsigned *cqHead_ = nullptr, *cqTail_ = nullptr;
+    unsigned sqMask_ = 0, cqMask_ = 0, sqEntries_ = 0;
+    unsigned localTail_ = 0;
+    Cqe* cqes_ = nullptr;
+};
+
+} // namespace uring
+
+static const std::uint64_t SYNC_TAG = ~0ULL;
+
+// Returns -1 when io_uring is unavailable (caller falls back), otherwise an ExitCode
+static int run_io_uring(int fd, const Options& opt, WriteBehind& behind, mvd_hash::Digests& digests, std::uint64_t& total) {
+    const unsigned depth = opt.queueDepth;
+    uring::Ring ring;
+    if (!ring.init(depth * 2)) return -1;
+
+    std::vector<std::uint8_t*> buffers(depth, nullptr);
+    std::vector<struct iovec> iovs(depth);
+    for (unsigned i = 0; i < depth; ++i) {
+        void* mem = nullptr;
+        if (posix_memalign(&mem, 4096, opt.chunk) != 0) return ERR_OUTPUT;
+        buffers[i] = static_cast<std::uint8_t*>(mem);
+        iovs[i].iov_base = mem;
+        iovs[i].iov_len = opt.chunk;
+    }
+    bool fixed = ring.register_buffers(iovs);
+
+    struct Slot { std::uint64_t offset = 0; std::size_t len = 0; };
+    std::vector<Slot> slots(depth);
+    std::vector<unsigned> freeSlots;
+    for (unsigned i = depth; i-- > 0;) freeSlots.push_back(i);
+
+    std::cout << "BACKEND=io_uring" << (fixed ? "" : " FIXED_BUFFERS=0") << std::endl;
+
+    unsigned inflight = 0;
+    int rc = SUCCESS;
+    std::uint64_t offset = 0;
+    std::uint64_t syncFrom = 0;
+    bool eof = false;
+    CompletionMark completed;
+
+    auto reap = [&](unsigned minComplete) -> bool {
+        if (!ring.submit(minComplete)) return false;
+        uring::Cqe cqe;
+        while (ring.pop(cqe)) {
+            if (cqe.user_data == SYNC_TAG) {
+                inflight--;
+                continue; // sync_file_range is advisory; a failure does not lose data
+            }
+            unsigned index = static_cast<unsigned>(cqe.user_data);
+            Slot& slot = slots[index];
+            if (cqe.res < 0) {
+                errno = -cqe.res;
+                return false;
+            }
+            if (static_cast<std::size_t>(cqe.res) < slot.len) {
+                // Short write: finish the remainder synchronously
+                std::size_t done = static_cast<std::size_t>(cqe.res);
+                if (!write_full_at(fd, buffers[index] + done, slot.len - done, slot.offset + done)) return false;
+            }
+            completed.complete(slot.offset, slot.len);
+            inflight--;
+            freeSlots.push_back(index);
+        }
+        behind.advance(completed.mark());
+        return true;
+    };
+
+    while (!eof) {
+        while (freeSlots.empty()) {
+            if (!reap(1)) { rc = ERR_OUTPUT; break; }
+        }
+        if (rc != SUCCESS) break;
+
+        // Hand queued writes to the kernel before blocking on the pipe
+        if (ring.pending() > 0 && !stdin_ready()) {
+            if (!reap(0)) { rc = ERR_OUTPUT; break; }
+        }
+
+        unsigned index = freeSlots.back();
+        long got = fill_from_stdin(buffers[index], opt.chunk);
+        if (got < 0) { rc = ERR_INPUT; break; }
+        if (got == 0) break;
+        if (static_cast<std::size_t>(got) < opt.chunk) eof = true;
+        digests.update(buffers[index], static_cast<std::size_t>(got));
+        freeSlots.pop_back();
+
+        slots[index].offset = offset;
+        slots[index].len = static_cast<std::size_t>(got);
+        bool wantSync = opt.syncRange && !behind.enabled() && (offset + got - syncFrom >= SYNC_WINDOW || eof);
+
+        uring::Sqe* sqe = ring.next_sqe();
+        while (!sqe) {
+            if (!reap(1)) { rc = ERR_OUTPUT; break; }
+            sqe = ring.next_sqe();
+        }
+        if (rc != SUCCESS) break;
+        sqe->fd = fd;
+        sqe->off = offset;
+        sqe->user_data = index;
+        if (fixed) {
+            sqe->opcode = uring::OP_WRITE_FIXED;
+            sqe->addr = reinterpret_cast<std::uint64_t>(buffers[index]);
+            sqe->len = static_cast<std::uint32_t>(got);
+            sqe->buf_index = static_cast<std::uint16_t>(index);
+        } else {
+            iovs[index].iov_len = static_cast<std::size_t>(got);
+            sqe->opcode = uring::OP_WRITEV;
+            sqe->addr = reinterpret_cast<std::uint64_t>(&iovs[index]);
+            sqe->len = 1;
+        }
+        inflight++;
+        offset += static_cast<std::uint64_t>(got);
+
+        if (wantSync) {
+            uring::Sqe* sync = ring.next_sqe();
+            if (sync) {
+                // Linked so the range is only flushed once the write landed
+                sqe->flags |= uring::SQE_IO_LINK;
+                sync->opcode = uring::OP_SYNC_FILE_RANGE;
+                sync->fd = fd;
+                sync->off = syncFrom;
+                sync->len = static_cast<std::uint32_t>(offset - syncFrom);
+                sync->op_flags = SYNC_FILE_RANGE_WRITE;
+                sync->user_data = SYNC_TAG;
+                inflight++;
+                syncFrom = offset;
+            }
+        }
+    }
+
+    while (rc == SUCCESS && inflight > 0) {
+        if (!reap(1)) rc = ERR_OUTPUT;
+    }
+
+    for (std::uint8_t* buf : buffers) std::free(buf);
+    total = offset;
+    return rc;
+}
+#endif
+
+// --- pwrite thread pool -----------------------------------------------------
+
+static int run_pwrite_pool(int fd, const Options& opt, WriteBehind& behind, mvd_hash::Digests& digests, std::uint64_t& total) {
+    const unsigned depth = opt.queueDepth;
+    std::vector<std::vector<std::uint8_t> > buffers(depth, std::vector<std::uint8_t>(opt.chunk));
+
+    struct Task { unsigned index; std::uint64_t offset; std::size_t len; };
+    std::mutex mutex;
+    std::condition_variable taskReady;
+    std::condition_variable slotFree;
+    std::deque<Task> tasks;
+    std::vector<unsigned> freeSlots;
+    for (unsigned i = depth; i-- > 0;) freeSlots.push_back(i);
+    bool done = false;
+    int writeErrno = 0;
+    std::uint64_t syncFrom = 0;
+    CompletionMark completed;
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < PWRITE_THREADS; ++t) {
+        workers.push_back(std::thread([&]() {
+            for (;;) {
+                Task task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    taskReady.wait(lock, [&]() { return done || !tasks.empty(); });
+                    if (tasks.empty()) return;
+                    task = tasks.front();
+                    tasks.pop_front();
+                }
+                bool ok = write_full_at(fd, &buffers[task.index][0], task.len, task.offset);
+                int err = ok ? 0 : errno;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!ok && !writeErrno) writeErrno = err ? err : EIO;
+                    completed.complete(task.offset, task.len);
+                    freeSlots.push_back(task.index);
+                }
+                slotFree.notify_one();
+            }
+        }));
+    }
+
+    std::cout << "BACKEND=pwrite" << std::endl;
+
+    int rc = SUCCESS;
+    std::uint64_t offset = 0;
+    for (;;) {
+        unsigned index;
+        std::uint64_t mark;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slotFree.wait(lock, [&]() { return !freeSlots.empty() || writeErrno; });
+            if (writeErrno) { rc = ERR_OUTPUT; break; }
+            index = freeSlots.back();
+            freeSlots.pop_back();
+            mark = completed.mark();
+        }
+        behind.advance(mark);
+        long got = fill_from_stdin(&buffers[index][0], opt.chunk);
+        if (got <= 0) {
+            if (got < 0) rc = ERR_INPUT;
+            break;
+        }
+        digests.update(&buffers[index][0], static_cast<std::size_t>(got));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Task task = { index, offset, static_cast<std::size_t>(got) };
+            tasks.push_back(task);
+        }
+        taskReady.notify_one();
+        offset += static_cast<std::uint64_t>(got);
+        if (opt.syncRange && !behind.enabled() && offset - syncFrom >= SYNC_WINDOW) {
+            // Completed writes are picked up, in-flight ones are simply left for the next window
+            sync_range(fd, syncFrom, offset - syncFrom);
+            syncFrom = offset;
+        }
+        if (static_cast<std::size_t>(got) < opt.chunk) break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    taskReady.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    if (writeErrno) {
+        errno = writeErrno;
+        rc = ERR_OUTPUT;
+    }
+    total = offset;
+    return rc;
+}
+
+// --- Plain-HTTP fetch (--fetch) ---------------------------------------------
+// The helper opens the connection itself and, on Linux, splices socket -> pipe -> file so
+// the payload never enters userspace. Anything it does not handle (TLS, chunked bodies,
+// redirects leaving http) exits with ERR_UNSUPPORTED before writing, and the host retries
+// with its own HTTP stack.
+
+struct HttpUrl {
+    std::string host;
+    std::string port = "80";
+    std::string hostHeader;
+    std::string target = "/";
+};
+
+static bool parse_http_url(const std::string& url, HttpUrl& out) {
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0) return false;
+    std::size_t start = scheme.size();
+    std::size_t slash = url.find_first_of("/?#", start);
+    std::string authority = url.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+    if (authority.empty() || authority.find('@') != std::string::npos) return false;
+    if (slash != std::string::npos) {
+        out.target = url.substr(slash);
+        std::size_t hash = out.target.find('#');
+        if (hash != std::string::npos) out.target.erase(hash);
+        if (out.target.empty() || out.target[0] != '/') out.target = "/" + out.target;
+    }
+    out.hostHeader = authority;
+    if (authority[0] == '[') {
+        std::size_t close = authority.find(']');
+        if (close == std::string::npos) return false;
+        out.host = authority.substr(1, close - 1);
+        if (close + 1 < authority.size() && authority[close + 1] == ':') out.port = authority.substr(close + 2);
+    } else {
+        std::size_t colon = authority.rfind(':');
+        out.host = authority.substr(0, colon);
+        if (colon != std::string::npos) out.port = authority.substr(colon + 1);
+    }
+    return !out.host.empty() && !out.port.empty();
+}
+
+static int connect_to(const HttpUrl& url, unsigned timeoutMs) {
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &result) != 0) return -1;
+
+    int sock = -1;
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (sock < 0) continue;
+        struct timeval tv;
+        tv.tv_sec = timeoutMs / 1000;
+        tv.tv_usec = (timeoutMs % 1000) * 1000;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(result);
+    return sock;
+}
+
+static bool send_all(int sock, const std::string& data) {
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(sock, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+static std::string lower(std::string s) {
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+static bool write_all_fd(int fd, const char* data, std::size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+class ProgressReporter {
+public:
+    void add(std::uint64_t bytes) {
+        total_ += bytes;
+        std::uint64_t now = mvd_trace::now_ns();
+        if (now - last_ >= PROGRESS_INTERVAL_NS) {
+            last_ = now;
+            std::cout << "PROGRESS=" << total_ << std::endl;
+        }
+    }
+    std::uint64_t total() const { return total_; }
+
+private:
+    static const std::uint64_t PROGRESS_INTERVAL_NS = 250000000ULL;
+    std::uint64_t total_ = 0;
+    std::uint64_t last_ = 0;
+};
+
+// Moves the body from sock to fd; `remaining` is UINT64_MAX when the length is unknown
+static int copy_body(int sock, int fd, std::uint64_t remaining, ProgressReporter& progress, WriteBehind& behind, mvd_hash::Digests& digests, bool& spliced) {
+    bool known = remaining != UINT64_MAX;
+#ifdef __linux__
+    int pipefd[2];
+    if (!digests.active() && pipe2(pipefd, O_CLOEXEC) == 0) {
+        fcntl(pipefd[1], F_SETPIPE_SZ, static_cast<int>(DEFAULT_CHUNK));
+        int rc = SUCCESS;
+        bool fallback = false;
+        while (!known || remaining > 0) {
+            std::size_t want = (!known || remaining > DEFAULT_CHUNK) ? DEFAULT_CHUNK : static_cast<std::size_t>(remaining);
+            ssize_t n = splice(sock, nullptr, pipefd[1], nullptr, want, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS) && progress.total() == 0) {
+                fallback = true;
+                break;
+            }
+            if (n < 0) { rc = ERR_NETWORK; break; }
+            if (n == 0) break;
+            // Drain the pipe into the file; splice's return values are the progress count
+            ssize_t left = n;
+            while (left > 0) {
+                ssize_t m = splice(pipefd[0], nullptr, fd, nullptr, static_cast<std::size_t>(left), SPLICE_F_MOVE | SPLICE_F_MORE);
+                if (m < 0 && errno == EINTR) continue;
+                if (m <= 0) { rc = ERR_OUTPUT; break; }
+                left -= m;
+                progress.add(static_cast<std::uint64_t>(m));
+            }
+            behind.advance(progress.total());
+            if (rc != SUCCESS) break;
+            if (known) remaining -= static_cast<std::uint64_t>(n);
+        }
+        close(pipefd[0]);
+        close(pipefd[1]);
+        if (!fallback) {
+            spliced = true;
+            if (rc == SUCCESS && known && remaining > 0) rc = ERR_NETWORK;
+            return rc;
+        }
+    }
+#endif
+    std::vector<char> buffer(DEFAULT_CHUNK);
+    while (!known || remaining > 0) {
+        std::size_t want = (!known || remaining > buffer.size()) ? buffer.size() : static_cast<std::size_t>(remaining);
+        ssize_t n = recv(sock, &buffer[0], want, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return ERR_NETWORK;
+        if (n == 0) break;
+        digests.update(&buffer[0], static_cast<std::size_t>(n));
+        if (!write_all_fd(fd, &buffer[0], static_cast<std::size_t>(n))) return ERR_OUTPUT;
+        progress.add(static_cast<std::uint64_t>(n));
+        behind.advance(progress.total());
+        if (known) remaining -= static_cast<std::uint64_t>(n);
+    }
+    return (known && remaining > 0) ? ERR_NETWORK : SUCCESS;
+}
+
+static int run_fetch(int fd, const Options& opt, WriteBehind& behind, mvd_hash::Digests& digests, std::uint64_t& total) {
+    std::string url = opt.fetchUrl;
+    for (int redirects = 0; redirects <= MAX_REDIRECTS; ++redirects) {
+        HttpUrl target;
+        if (!parse_http_url(url, target)) {
+            std::cout << "UNSUPPORTED=scheme" << std::endl;
+            return ERR_UNSUPPORTED;
+        }
+
+        int sock = connect_to(target, opt.timeoutMs);
+        if (sock < 0) {
+            std::cerr << "Cannot connect to " << target.hostHeader << std::endl;
+            return ERR_NETWORK;
+        }
+
+        std::string request = "GET " + target.target + " HTTP/1.1\r\nHost: " + target.hostHeader + "\r\n";
+        for (const std::string& header : opt.headers) {
+            std::string name = lower(header.substr(0, header.find(':')));
+            if (name == "host" || name == "connection" || name == "accept-encoding" || name == "range") continue;
+            request += header + "\r\n";
+        }
+        request += "Accept-Encoding: identity\r\nConnection: close\r\n\r\n";
+        if (!send_all(sock, request)) {
+            close(sock);
+            return ERR_NETWORK;
+        }
+
+        // Read just past the header block; anything after it is the start of the body
+        std::string head;
+        std::size_t headerEnd = std::string::npos;
+        char buf[16384];
+        while (headerEnd == std::string::npos && head.size() < MAX_HEADER_BYTES) {
+            ssize_t n = recv(sock, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            head.append(buf, static_cast<std::size_t>(n));
+            headerEnd = head.find("\r\n\r\n");
+        }
+        if (headerEnd == std::string::npos) {
+            close(sock);
+            std::cerr << "Malformed HTTP response" << std::endl;
+            return ERR_NETWORK;
+        }
+
+        int status = 0;
+        std::sscanf(head.c_str(), "HTTP/%*s %d", &status);
+        std::uint64_t contentLength = UINT64_MAX;
+        std::string location;
+        bool chunked = false;
+        std::size_t lineStart = head.find("\r\n") + 2;
+        while (lineStart < headerEnd) {
+            std::size_t lineEnd = head.find("\r\n", lineStart);
+            std::string line = head.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd + 2;
+            std::size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::string name = lower(line.substr(0, colon));
+            std::size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+            std::string value = valueStart == std::string::npos ? "" : line.substr(valueStart);
+            if (name == "content-length") contentLength = std::strtoull(value.c_str(), nullptr, 10);
+            else if (name == "location") location = value;
+            else if (name == "transfer-encoding" && lower(value).find("chunked") != std::string::npos) chunked = true;
+        }
+
+        if ((status == 301 || status == 302 || status == 303 || status == 307 || status == 308) && !location.empty()) {
+            close(sock);
+            if (location[0] == '/') location = "http://" + target.hostHeader + location;
+            url = location;
+            continue;
+        }
+
+        std::cout << "STATUS=" << status << std::endl;
+        if (status < 200 || status >= 300) {
+            close(sock);
+            return ERR_HTTP;
+        }
+        if (chunked) {
+            close(sock);
+            std::cout << "UNSUPPORTED=chunked" << std::endl;
+            return ERR_UNSUPPORTED;
+        }
+        if (contentLength != UINT64_MAX) {
+            std::cout << "CONTENT_LENGTH=" << contentLength << std::endl;
+            if (opt.preallocateAuto) preallocate(fd, contentLength);
+        }
+
+        ProgressReporter progress;
+        std::size_t bodyStart = headerEnd + 4;
+        std::size_t early = head.size() - bodyStart;
+        if (contentLength != UINT64_MAX && early > contentLength) early = static_cast<std::size_t>(contentLength);
+        if (early > 0) {
+            digests.update(head.data() + bodyStart, early);
+            if (!write_all_fd(fd, head.data() + bodyStart, early)) {
+                close(sock);
+                return ERR_OUTPUT;
+            }
+            progress.add(early);
+        }
+
+        bool spliced = false;
+        std::uint64_t remaining = contentLength == UINT64_MAX ? UINT64_MAX : contentLength - early;
+        int rc = copy_body(sock, fd, remaining, progress, behind, digests, spliced);
+        close(sock);
+        total = progress.total();
+        std::cout << "BACKEND=" << (spliced ? "splice" : "recv") << std::endl;
+        if (rc == ERR_NETWORK) std::cerr << "Connection closed after " << total << " bytes" << std::endl;
+        return rc;
+    }
+    std::cerr << "Redirect limit exceeded" << std::endl;
+    return ERR_NETWORK;
+}
+
+int main(int argc, char* argv[]) {
+    mvd_trace::HelperSpan traceSpan("mvd-writer");
+
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--output" && i + 1 < argc) {
+            opt.output = argv[++i];
+        } else if (arg == "--backend" && i + 1 < argc) {
+            opt.backend = argv[++i];
+        } else if (arg == "--queue-depth" && i + 1 < argc) {
+            opt.queueDepth = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--chunk-kb" && i + 1 < argc) {
+            opt.chunk = static_cast<std::size_t>(std::strtoul(argv[++i], nullptr, 10)) * 1024;
+        } else if (arg == "--sync-range") {
+            opt.syncRange = true;
+        } else if (arg == "--fetch" && i + 1 < argc) {
+            opt.fetchUrl = argv[++i];
+        } else if (arg == "--header" && i + 1 < argc) {
+            opt.headers.push_back(argv[++i]);
+        } else if (arg == "--timeout-ms" && i + 1 < argc) {
+            opt.timeoutMs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--hash" && i + 1 < argc) {
+            opt.hash = argv[++i];
+        } else if (arg == "--dirty-mb" && i + 1 < argc) {
+            opt.dirtyBudget = static_cast<std::uint64_t>(std::strtoull(argv[++i], nullptr, 10)) * 1024 * 1024;
+        } else if (arg == "--preallocate" && i + 1 < argc) {
+            std::string value = argv[++i];
+            opt.preallocateAuto = value == "auto";
+            opt.preallocate = std::strtoull(value.c_str(), nullptr, 10);
+        } else {
+            opt.output.clear();
+            break;
+        }
+    }
+
+    mvd_hash::Digests digests;
+    if (opt.output.empty() || opt.queueDepth == 0 || opt.queueDepth > 64 || opt.chunk < 4096 || opt.chunk > 64 * 1024 * 1024 ||
+        (opt.backend != "auto" && opt.backend != "io_uring" && opt.backend != "pwrite") || !digests.configure(opt.hash)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " --output <file> [--backend auto|io_uring|pwrite] [--queue-depth 1-64] [--chunk-kb N] [--sync-range] [--dirty-mb N] [--preallocate N] [--hash xxh3,sha256]\n"
+                  << "       " << argv[0] << " --output <file> --fetch <http://...> [--header \"Name: value\"]... [--timeout-ms N] [--dirty-mb N] [--preallocate N|auto] [--hash xxh3,sha256]" << std::endl;
+        return ERR_ARGS;
+    }
+
+    int fd = open(opt.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::perror("Error opening output");
+        return ERR_OUTPUT;
+    }
+
+    if (!opt.preallocateAuto) preallocate(fd, opt.preallocate);
+    WriteBehind behind(fd, opt.dirtyBudget);
+    std::uint64_t total = 0;
+    int rc = -1;
+    if (!opt.fetchUrl.empty()) {
+        rc = run_fetch(fd, opt, behind, digests, total);
+    }
+#ifdef __linux__
+    else if (opt.backend != "pwrite") {
+        rc = run_io_uring(fd, opt, behind, digests, total);
+    }
+#endif
+    if (rc < 0) {
+        if (opt.backend == "io_uring") {
+            std::cerr << "io_uring is not available" << std::endl;
+            close(fd);
+            return ERR_OUTPUT;
+        }
+        rc = run_pwrite_pool(fd, opt, behind, digests, total);
+    }
+    if (rc == SUCCESS) behind.finish(total);
+    // A body shorter than announced would keep the rest of the reservation past EOF
+    if (rc == SUCCESS && total < opt.preallocate && ftruncate(fd, static_cast<off_t>(total)) != 0) rc = ERR_OUTPUT;
+
+    if (rc == ERR_OUTPUT) std::perror("Error writing output");
+    else if (rc == ERR_INPUT) std::perror("Error reading input");
+    if (close(fd) != 0 && rc == SUCCESS) {
+        std::perror("Error closing output");
+        rc = ERR_OUTPUT;
+    }
+    if (rc == SUCCESS) {
+        digests.print(std::cout);
+#ifdef __linux__
+        if (behind.enabled()) std::cout << "DROPPED=" << behind.dropped() << std::endl;
+#endif
+        std::cout << "BYTES=" << total << std::endl;
+    }
+    return rc;
+}